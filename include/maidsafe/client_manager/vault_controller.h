@@ -41,17 +41,36 @@ namespace client_manager {
 
 class LocalTcpTransport;
 
+namespace detail { class Heartbeat; }
+
+// ClientManager restarts a vault which hangs, either while starting up or afterwards.  So that a
+// vault whose main loop has stopped making progress is seen to hang even though the controller's
+// own threads carry on, the vault beats by calling Heartbeat() from that loop, at least every
+// detail::Heartbeat::kDefaultInterval().  The controller only beats on the vault's behalf while
+// WaitForTakeover blocks it.
+//
+// When ClientManager replaces a running vault (e.g. to upgrade it), it starts the replacement as a
+// standby.  A standby may get its identity and join the network straight away, so that the vault
+// never drops off the network, and the vault being replaced is only asked to stop once it has.  But
+// since both use the same chunkstore, the standby mustn't touch it until WaitForTakeover returns.
 class VaultController {
  public:
   VaultController(const std::string& client_manager_identifier,
                   std::function<void()> stop_callback);
   ~VaultController();
 
+  // Returns false if the vault has already been asked to stop.
   bool GetIdentity(std::unique_ptr<passport::Pmid>& pmid,
                    std::vector<boost::asio::ip::udp::endpoint>& bootstrap_endpoints);
+  // Blocks a standby until the vault it's replacing has exited, and returns at once for any other
+  // vault.  Returns false if the vault is asked to stop first.  A standby tells ClientManager once
+  // it has taken over, so that the time the vault was unavailable can be measured.
+  bool WaitForTakeover();
   void ConfirmJoin();
   bool SendEndpointToClientManager(const boost::asio::ip::udp::endpoint& endpoint);
   bool GetBootstrapNodes(std::vector<boost::asio::ip::udp::endpoint>& bootstrap_endpoints);
+  // Thread-safe and cheap.  Does nothing if ClientManager isn't watching this vault's heartbeat.
+  void Heartbeat();
 
  private:
   typedef std::shared_ptr<LocalTcpTransport> TransportPtr;
@@ -59,9 +78,12 @@ class VaultController {
   VaultController& operator=(const VaultController&);
   void HandleVaultJoinedAck(const std::string& message, std::function<void()> callback);
   void RequestVaultIdentity(uint16_t listening_port);
+  void OpenHeartbeat();
+  void ConfirmTakeover();
   void HandleVaultIdentityResponse(const std::string& message, std::mutex& mutex);
   void HandleReceivedRequest(const std::string& message, uint16_t peer_port);
   void HandleVaultShutdownRequest(const std::string& request, std::string& response);
+  void HandleVaultTakeover(const std::string& request);
   void HandleSendEndpointToClientManagerResponse(
       const std::string& message, std::function<void(bool)> callback);  // NOLINT (Philip)
   void HandleBootstrapResponse(const std::string& message,
@@ -72,6 +94,10 @@ class VaultController {
   std::unique_ptr<passport::Pmid> pmid_;
   std::vector<boost::asio::ip::udp::endpoint> bootstrap_endpoints_;
   std::function<void()> stop_callback_;
+  bool standby_, stopping_;
+  std::mutex standby_mutex_;
+  std::condition_variable standby_cond_var_;
+  std::unique_ptr<detail::Heartbeat> heartbeat_;
   AsioService asio_service_;
   TransportPtr receiving_transport_;
 };
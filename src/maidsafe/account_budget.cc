@@ -0,0 +1,221 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/account_budget.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+namespace {
+
+void AddUsage(AccountUsage& total, const VaultUsage& usage) {
+  total.chunkstore_bytes += usage.chunkstore_bytes;
+  total.memory += usage.memory;
+  total.cpu += usage.cpu;
+}
+
+// Saturates, so that rounding can't leave a total below zero.
+void SubtractUsage(AccountUsage& total, const VaultUsage& usage) {
+  total.chunkstore_bytes -= std::min(total.chunkstore_bytes, usage.chunkstore_bytes);
+  total.memory -= std::min(total.memory, usage.memory);
+  total.cpu = std::max(total.cpu - usage.cpu, 0.0);
+}
+
+}  // unnamed namespace
+
+AccountLedger::AccountLedger()
+    : default_budget_(), budgets_(), usages_(), vaults_(), mutex_() {}
+
+bool AccountLedger::SetDefaultBudget(const AccountBudget& budget) {
+  if (!budget.IsValid()) {
+    LOG(kError) << "Invalid default account budget.";
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  default_budget_ = budget;
+  return true;
+}
+
+bool AccountLedger::SetBudget(const std::string& account, const AccountBudget& budget) {
+  if (!budget.IsValid()) {
+    LOG(kError) << "Invalid budget for account " << account;
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (budget.Empty())
+    budgets_.erase(account);
+  else
+    budgets_[account] = budget;
+  return true;
+}
+
+AccountBudget AccountLedger::default_budget() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return default_budget_;
+}
+
+AccountBudget AccountLedger::budget(const std::string& account) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return BudgetFor(account);
+}
+
+std::map<std::string, AccountBudget> AccountLedger::budgets() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::map<std::string, AccountBudget>(budgets_.begin(), budgets_.end());
+}
+
+AdmissionRefusal AccountLedger::Admit(const std::string& account) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const AccountBudget& budget(BudgetFor(account));
+  auto itr(usages_.find(account));
+  if (budget.Empty() || itr == usages_.end())
+    return AdmissionRefusal::kNone;
+  const AccountUsage& usage(itr->second);
+  AdmissionRefusal refusal(AdmissionRefusal::kNone);
+  if (budget.max_vaults != 0 && usage.vaults >= budget.max_vaults)
+    refusal = AdmissionRefusal::kAccountVaults;
+  else if (budget.max_chunkstore_bytes != 0 &&
+           usage.chunkstore_bytes >= budget.max_chunkstore_bytes)
+    refusal = AdmissionRefusal::kAccountStorage;
+  else if (budget.max_memory != 0 && usage.memory >= budget.max_memory)
+    refusal = AdmissionRefusal::kAccountMemory;
+  else if (budget.max_cpu != 0.0 && usage.cpu >= budget.max_cpu)
+    refusal = AdmissionRefusal::kAccountCpu;
+  if (refusal != AdmissionRefusal::kNone) {
+    LOG(kWarning) << "Not starting vault for account " << account << " ("
+                  << AdmissionRefusalString(refusal) << "): " << usage.vaults << " vaults using "
+                  << (usage.chunkstore_bytes >> 20) << " MiB of chunkstore, "
+                  << (usage.memory >> 20) << " MiB of memory and " << usage.cpu << " CPUs";
+  }
+  return refusal;
+}
+
+void AccountLedger::StartVault(ProcessIndex index, const std::string& account) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto result(vaults_.insert(std::make_pair(index, Vault())));
+  Vault& vault(result.first->second);
+  if (result.second)
+    vault.account = account;
+  else if (vault.counted)
+    return;
+  vault.counted = true;
+  ++usages_[vault.account].vaults;
+}
+
+void AccountLedger::StopVault(ProcessIndex index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(vaults_.find(index));
+  if (itr == vaults_.end() || !itr->second.counted)
+    return;
+  Vault& vault(itr->second);
+  AccountUsage& usage(usages_[vault.account]);
+  --usage.vaults;
+  usage.memory -= std::min(usage.memory, vault.usage.memory);
+  usage.cpu = std::max(usage.cpu - vault.usage.cpu, 0.0);
+  vault.usage.memory = 0;
+  vault.usage.cpu = 0.0;
+  vault.counted = false;
+}
+
+void AccountLedger::RemoveVault(ProcessIndex index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(vaults_.find(index));
+  if (itr == vaults_.end())
+    return;
+  AccountUsage& usage(usages_[itr->second.account]);
+  if (itr->second.counted)
+    --usage.vaults;
+  SubtractUsage(usage, itr->second.usage);
+  vaults_.erase(itr);
+}
+
+void AccountLedger::SetVaultUsage(ProcessIndex index, const VaultUsage& usage) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(vaults_.find(index));
+  if (itr == vaults_.end())
+    return;
+  Vault& vault(itr->second);
+  VaultUsage recorded(usage);
+  if (!vault.counted) {
+    recorded.memory = 0;
+    recorded.cpu = 0.0;
+  }
+  AccountUsage& total(usages_[vault.account]);
+  SubtractUsage(total, vault.usage);
+  AddUsage(total, recorded);
+  vault.usage = recorded;
+}
+
+AccountUsage AccountLedger::Usage(const std::string& account) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(usages_.find(account));
+  return itr == usages_.end() ? AccountUsage() : itr->second;
+}
+
+std::vector<std::pair<std::string, AdmissionRefusal>> AccountLedger::Overspent() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::pair<std::string, AdmissionRefusal>> overspent;
+  for (const auto& usage : usages_) {
+    const AccountBudget& budget(BudgetFor(usage.first));
+    if (budget.max_chunkstore_bytes != 0 &&
+        usage.second.chunkstore_bytes > budget.max_chunkstore_bytes) {
+      overspent.push_back(std::make_pair(usage.first, AdmissionRefusal::kAccountStorage));
+    }
+    if (budget.max_memory != 0 && usage.second.memory > budget.max_memory)
+      overspent.push_back(std::make_pair(usage.first, AdmissionRefusal::kAccountMemory));
+  }
+  return overspent;
+}
+
+ResourceLimits AccountLedger::VaultLimits(const std::string& account) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const AccountBudget& budget(BudgetFor(account));
+  ResourceLimits limits;
+  if (budget.max_cpu == 0.0 && budget.max_memory == 0)
+    return limits;
+  auto itr(usages_.find(account));
+  const uint32_t kShares(std::max(itr == usages_.end() ? 0U : itr->second.vaults, 1U));
+  if (budget.max_cpu != 0.0) {
+    // The kernel won't accept a quota of less than 1 ms.
+    double quota(budget.max_cpu * limits.cpu_period.count() / kShares);
+    limits.cpu_quota = std::max(std::chrono::microseconds(static_cast<int64_t>(std::floor(quota))),
+                                std::chrono::microseconds(std::chrono::milliseconds(1)));
+  }
+  if (budget.max_memory != 0)
+    limits.memory_high = std::max(budget.max_memory / kShares, static_cast<uint64_t>(1));
+  return limits;
+}
+
+const AccountBudget& AccountLedger::BudgetFor(const std::string& account) const {
+  auto itr(budgets_.find(account));
+  return itr == budgets_.end() ? default_budget_ : itr->second;
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,140 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_ACCOUNT_BUDGET_H_
+#define MAIDSAFE_CLIENT_MANAGER_ACCOUNT_BUDGET_H_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "maidsafe/client_manager/admission_controller.h"
+#include "maidsafe/client_manager/resource_limits.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+typedef uint32_t ProcessIndex;
+
+// The resources an account's vaults may use between them.  A value of zero means unlimited.
+struct AccountBudget {
+  AccountBudget() : max_vaults(0), max_chunkstore_bytes(0), max_memory(0), max_cpu(0.0) {}
+  bool IsValid() const { return max_cpu >= 0.0; }
+  bool Empty() const {
+    return max_vaults == 0 && max_chunkstore_bytes == 0 && max_memory == 0 && max_cpu == 0.0;
+  }
+  // Vaults running or starting at once.  A stopped vault no longer counts.
+  uint32_t max_vaults;
+  // Disk space used by all of the account's chunkstores, including those of stopped vaults.
+  uint64_t max_chunkstore_bytes;
+  // Resident memory, in bytes.
+  uint64_t max_memory;
+  // In CPUs, e.g. 0.5 for half of one CPU's time.
+  double max_cpu;
+};
+
+// The latest measurements of one vault.  Memory and CPU are zero while it isn't running.
+struct VaultUsage {
+  VaultUsage() : chunkstore_bytes(0), memory(0), cpu(0.0) {}
+  uint64_t chunkstore_bytes, memory;
+  double cpu;
+};
+
+// Totals over an account's vaults.
+struct AccountUsage {
+  AccountUsage() : vaults(0), chunkstore_bytes(0), memory(0), cpu(0.0) {}
+  uint32_t vaults;
+  uint64_t chunkstore_bytes, memory;
+  double cpu;
+};
+
+namespace detail {
+
+// Keeps each account's usage as running totals, adjusted whenever one of its vaults is started,
+// stopped or measured, so that checking a request against a budget costs the same however many
+// vaults there are.  Accounts without a budget of their own use the default one, which is empty
+// (unlimited) unless set.
+class AccountLedger {
+ public:
+  AccountLedger();
+  bool SetDefaultBudget(const AccountBudget& budget);
+  // An empty budget removes the account's own budget, leaving it on the default.
+  bool SetBudget(const std::string& account, const AccountBudget& budget);
+  AccountBudget default_budget() const;
+  AccountBudget budget(const std::string& account) const;
+  // The accounts with budgets of their own.
+  std::map<std::string, AccountBudget> budgets() const;
+
+  // Returns kNone if 'account' may start another vault.  The vault's own needs aren't known in
+  // advance, so it's only refused if the account is already at or over a limit.
+  AdmissionRefusal Admit(const std::string& account) const;
+
+  // Counts the vault toward its account's vaults.  Does nothing if it's already counted.  A vault's
+  // account can't change.
+  void StartVault(ProcessIndex index, const std::string& account);
+  // Stops counting the vault toward its account's vaults, memory and CPU.  Its chunkstore still
+  // counts.
+  void StopVault(ProcessIndex index);
+  // Forgets the vault entirely, e.g. once another process has taken it over.
+  void RemoveVault(ProcessIndex index);
+  // Ignored for vaults never started.  For a stopped vault, only the chunkstore is recorded.
+  void SetVaultUsage(ProcessIndex index, const VaultUsage& usage);
+  AccountUsage Usage(const std::string& account) const;
+
+  // Returns the accounts using more chunkstore space or memory than their budgets allow, once for
+  // each which was exceeded.  Unlike the other functions, this takes time proportional to the
+  // number of accounts.
+  std::vector<std::pair<std::string, AdmissionRefusal>> Overspent() const;
+  // The cgroup limits to apply to each of the account's vaults so that together they can't exceed
+  // its CPU budget and are throttled before exceeding its memory budget, by sharing the budget
+  // evenly between the vaults currently counted.  Empty if the account has no CPU or memory budget.
+  ResourceLimits VaultLimits(const std::string& account) const;
+
+ private:
+  struct Vault {
+    Vault() : account(), counted(false), usage() {}
+    std::string account;
+    bool counted;
+    VaultUsage usage;
+  };
+
+  AccountLedger(const AccountLedger&);
+  AccountLedger& operator=(const AccountLedger&);
+  // NOTE: mutex_ must be locked when calling this function.
+  const AccountBudget& BudgetFor(const std::string& account) const;
+
+  AccountBudget default_budget_;
+  std::unordered_map<std::string, AccountBudget> budgets_;
+  std::unordered_map<std::string, AccountUsage> usages_;
+  std::unordered_map<ProcessIndex, Vault> vaults_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_ACCOUNT_BUDGET_H_
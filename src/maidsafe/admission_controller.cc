@@ -0,0 +1,178 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/admission_controller.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace {
+
+#ifdef MAIDSAFE_LINUX
+
+// Returns the length read into 'buffer', or 0 on failure.
+size_t ReadSmallFile(const char* path, char* buffer, size_t size) {
+  int fd(open(path, O_RDONLY | O_CLOEXEC));
+  if (fd == -1)
+    return 0;
+  ssize_t length(read(fd, buffer, size - 1));
+  close(fd);
+  if (length <= 0)
+    return 0;
+  buffer[length] = '\0';
+  return static_cast<size_t>(length);
+}
+
+// Returns the value following 'key' in 'text', or 'fallback' if 'key' isn't present.
+uint64_t FindValue(const char* text, const char* key, uint64_t fallback) {
+  const char* position(std::strstr(text, key));
+  return position ? std::strtoull(position + std::strlen(key), nullptr, 10) : fallback;
+}
+
+#endif
+
+}  // unnamed namespace
+
+std::string AdmissionRefusalString(AdmissionRefusal refusal) {
+  switch (refusal) {
+    case AdmissionRefusal::kNone:
+      return "none";
+    case AdmissionRefusal::kLowMemory:
+      return "low memory";
+    case AdmissionRefusal::kHighLoad:
+      return "high load";
+    case AdmissionRefusal::kVaultMemoryBudget:
+      return "vault memory budget exhausted";
+    case AdmissionRefusal::kAccountVaults:
+      return "account vault limit reached";
+    case AdmissionRefusal::kAccountStorage:
+      return "account storage budget exhausted";
+    case AdmissionRefusal::kAccountMemory:
+      return "account memory budget exhausted";
+    case AdmissionRefusal::kAccountCpu:
+      return "account CPU budget exhausted";
+    default:
+      return "unknown (" + std::to_string(static_cast<int32_t>(refusal)) + ")";
+  }
+}
+
+namespace detail {
+
+bool ReadHostLoad(HostLoad& host_load) {
+#ifdef MAIDSAFE_LINUX
+  char buffer[4096];
+  if (ReadSmallFile("/proc/meminfo", buffer, sizeof(buffer)) == 0)
+    return false;
+  // MemAvailable was only added in Linux 3.14; before that, free memory plus the page cache is the
+  // usual approximation.
+  const uint64_t kNotFound(std::numeric_limits<uint64_t>::max());
+  uint64_t available(FindValue(buffer, "MemAvailable:", kNotFound));
+  if (available == kNotFound) {
+    available = FindValue(buffer, "MemFree:", 0) + FindValue(buffer, "Buffers:", 0) +
+                FindValue(buffer, "Cached:", 0);
+  }
+  host_load.available_memory = available * 1024;
+
+  if (ReadSmallFile("/proc/loadavg", buffer, sizeof(buffer)) == 0)
+    return false;
+  host_load.load_average = std::strtod(buffer, nullptr);
+  host_load.cpu_count = static_cast<unsigned>(std::max(sysconf(_SC_NPROCESSORS_ONLN), 1L));
+  return true;
+#else
+  static_cast<void>(host_load);
+  return false;
+#endif
+}
+
+AdmissionController::AdmissionController(const AdmissionThresholds& thresholds)
+    : thresholds_(thresholds), mutex_() {}
+
+bool AdmissionController::SetThresholds(const AdmissionThresholds& thresholds) {
+  if (!thresholds.IsValid()) {
+    LOG(kError) << "Invalid admission thresholds.";
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  thresholds_ = thresholds;
+  return true;
+}
+
+AdmissionThresholds AdmissionController::thresholds() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return thresholds_;
+}
+
+AdmissionDecision AdmissionController::Admit(uint64_t vault_memory, size_t vault_count) const {
+  HostLoad host_load;
+  if (!ReadHostLoad(host_load)) {
+    LOG(kWarning) << "Failed to read host load, so admitting vault unconditionally.";
+    return AdmissionDecision();
+  }
+  host_load.vault_memory = vault_memory;
+  host_load.vault_count = vault_count;
+  return Decide(host_load);
+}
+
+AdmissionDecision AdmissionController::Decide(const HostLoad& host_load) const {
+  const AdmissionThresholds thresholds(this->thresholds());
+  const uint64_t kEstimate(host_load.vault_count == 0 ? 0 : host_load.vault_memory /
+                                                                host_load.vault_count);
+  AdmissionDecision decision;
+  if (thresholds.max_vault_memory != 0 &&
+      host_load.vault_memory + kEstimate > thresholds.max_vault_memory) {
+    decision.outcome = AdmissionDecision::Outcome::kReject;
+    decision.refusal = AdmissionRefusal::kVaultMemoryBudget;
+  } else if (host_load.available_memory < thresholds.min_available_memory + kEstimate) {
+    decision.outcome = AdmissionDecision::Outcome::kDefer;
+    decision.refusal = AdmissionRefusal::kLowMemory;
+  } else if (host_load.load_average / std::max(host_load.cpu_count, 1U) >
+             thresholds.max_load_per_cpu) {
+    decision.outcome = AdmissionDecision::Outcome::kDefer;
+    decision.refusal = AdmissionRefusal::kHighLoad;
+  } else {
+    return decision;
+  }
+  if (decision.outcome == AdmissionDecision::Outcome::kDefer)
+    decision.retry_after = thresholds.retry_after;
+  LOG(kWarning) << "Not starting vault (" << AdmissionRefusalString(decision.refusal)
+                << "): available memory " << (host_load.available_memory >> 20) << " MiB, load "
+                << host_load.load_average << " on " << host_load.cpu_count << " CPUs, "
+                << host_load.vault_count << " vaults using " << (host_load.vault_memory >> 20)
+                << " MiB";
+  return decision;
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
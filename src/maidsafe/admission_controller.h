@@ -0,0 +1,125 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_ADMISSION_CONTROLLER_H_
+#define MAIDSAFE_CLIENT_MANAGER_ADMISSION_CONTROLLER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace maidsafe {
+
+namespace client_manager {
+
+// Why a vault wasn't started.  Sent to the client as StartVaultResponse::refusal_reason.
+enum class AdmissionRefusal : int32_t {
+  kNone = 0,
+  // Starting another vault would leave too little memory available on the host.
+  kLowMemory = 1,
+  // The host's load average per CPU is too high.
+  kHighLoad = 2,
+  // The running vaults already use as much memory as they are allowed in total.
+  kVaultMemoryBudget = 3,
+  // The account already has as many vaults, or its vaults already use as much chunkstore space,
+  // memory or CPU, as its AccountBudget allows.
+  kAccountVaults = 4,
+  kAccountStorage = 5,
+  kAccountMemory = 6,
+  kAccountCpu = 7
+};
+
+std::string AdmissionRefusalString(AdmissionRefusal refusal);
+
+// Beyond these, new vaults aren't started.  A new vault is assumed to need as much memory as the
+// average running vault.
+struct AdmissionThresholds {
+  AdmissionThresholds()
+      : min_available_memory(256 * 1024 * 1024),
+        max_load_per_cpu(2.0),
+        max_vault_memory(0),
+        retry_after(std::chrono::seconds(60)) {}
+  bool IsValid() const { return max_load_per_cpu > 0.0 && retry_after.count() >= 0; }
+  // In bytes, as reported by "MemAvailable" in /proc/meminfo.
+  uint64_t min_available_memory;
+  // The one-minute load average divided by the number of online CPUs.
+  double max_load_per_cpu;
+  // The total resident memory of all running vaults, in bytes.  0 means unlimited.
+  uint64_t max_vault_memory;
+  // Suggested to a client whose request is deferred.
+  std::chrono::seconds retry_after;
+};
+
+// A snapshot of the host's state, and of the vaults' share of it.
+struct HostLoad {
+  HostLoad()
+      : available_memory(0), load_average(0.0), cpu_count(1), vault_memory(0), vault_count(0) {}
+  uint64_t available_memory;
+  double load_average;
+  unsigned cpu_count;
+  uint64_t vault_memory;
+  size_t vault_count;
+};
+
+// A request is deferred if the host is only temporarily too busy (i.e. the client should retry
+// after 'retry_after'), and rejected if it can't succeed until a running vault is stopped.
+struct AdmissionDecision {
+  enum class Outcome {
+    kAdmit,
+    kDefer,
+    kReject
+  };
+
+  AdmissionDecision()
+      : outcome(Outcome::kAdmit), refusal(AdmissionRefusal::kNone), retry_after(0) {}
+  Outcome outcome;
+  AdmissionRefusal refusal;
+  std::chrono::seconds retry_after;
+};
+
+namespace detail {
+
+// Reads the memory and load figures from /proc.  Returns false on failure, or if not on Linux.
+bool ReadHostLoad(HostLoad& host_load);
+
+// Decides whether another vault may be started.  Thresholds may be changed at any time.
+class AdmissionController {
+ public:
+  explicit AdmissionController(const AdmissionThresholds& thresholds = AdmissionThresholds());
+  bool SetThresholds(const AdmissionThresholds& thresholds);
+  AdmissionThresholds thresholds() const;
+  // Reads the host's load and decides.  If the load can't be read, the vault is admitted.
+  AdmissionDecision Admit(uint64_t vault_memory, size_t vault_count) const;
+  AdmissionDecision Decide(const HostLoad& host_load) const;
+
+ private:
+  AdmissionController(const AdmissionController&);
+  AdmissionController& operator=(const AdmissionController&);
+
+  AdmissionThresholds thresholds_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_ADMISSION_CONTROLLER_H_
@@ -0,0 +1,256 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/artifact_store.h"
+
+#include <algorithm>
+#include <ctime>
+#include <set>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+namespace {
+
+uint64_t NowInMilliseconds() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Version and artifact names become file names, so mustn't be able to refer elsewhere.
+bool IsValidName(const std::string& name) {
+  return !name.empty() && name != "." && name != ".." &&
+         name.find_first_of("/\\") == std::string::npos;
+}
+
+bool WithinGracePeriod(const fs::path& path) {
+  boost::system::error_code error_code;
+  std::time_t modified(fs::last_write_time(path, error_code));
+  return !error_code &&
+         std::time(nullptr) - modified <
+             std::chrono::duration_cast<std::chrono::seconds>(ArtifactStore::kGracePeriod())
+                 .count();
+}
+
+}  // unnamed namespace
+
+ArtifactStore::ArtifactStore(const fs::path& root) : kRoot_(root), mutex_() {}
+
+bool ArtifactStore::AddVersion(const std::string& version,
+                               const std::map<std::string, fs::path>& files) {
+  if (!IsValidName(version)) {
+    LOG(kError) << "Invalid version name \"" << version << '"';
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  protobuf::ArtifactVersion record;
+  record.set_version(version);
+  record.set_added(NowInMilliseconds());
+  for (const auto& file : files) {
+    if (!IsValidName(file.first)) {
+      LOG(kError) << "Invalid artifact name \"" << file.first << '"';
+      return false;
+    }
+    std::string hash;
+    if (!StoreObject(file.second, hash))
+      return false;
+    protobuf::StoredArtifact* artifact(record.add_artifacts());
+    artifact->set_name(file.first);
+    artifact->set_hash(hash);
+  }
+  if (!WriteAtomically(VersionPath(version), record.SerializeAsString()))
+    return false;
+  LOG(kInfo) << "Stored version " << version << " in " << kRoot_;
+  return true;
+}
+
+bool ArtifactStore::Activate(const std::string& version) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  protobuf::ArtifactVersion record;
+  if (!ReadVersion(version, record))
+    return false;
+  for (const auto& artifact : record.artifacts()) {
+    boost::system::error_code error_code;
+    if (!fs::exists(ObjectPath(artifact.hash()), error_code)) {
+      LOG(kError) << "Can't activate version " << version << " since " << artifact.name()
+                  << " is missing from the store.";
+      return false;
+    }
+  }
+  if (!WriteAtomically(kRoot_ / "active", version))
+    return false;
+  LOG(kInfo) << "Version " << version << " is now active.";
+  return true;
+}
+
+std::string ArtifactStore::ActiveVersion() const {
+  std::string version;
+  ReadFile(kRoot_ / "active", &version);
+  return version;
+}
+
+std::vector<std::string> ArtifactStore::Versions() const {
+  std::vector<protobuf::ArtifactVersion> records(ReadVersions());
+  std::vector<std::string> versions;
+  for (auto itr(records.rbegin()); itr != records.rend(); ++itr)
+    versions.push_back(itr->version());
+  return versions;
+}
+
+fs::path ArtifactStore::Path(const std::string& version, const std::string& name) const {
+  protobuf::ArtifactVersion record;
+  if (!ReadVersion(version, record))
+    return fs::path();
+  for (const auto& artifact : record.artifacts()) {
+    if (artifact.name() != name)
+      continue;
+    fs::path object_path(ObjectPath(artifact.hash()));
+    boost::system::error_code error_code;
+    return fs::exists(object_path, error_code) ? object_path : fs::path();
+  }
+  return fs::path();
+}
+
+void ArtifactStore::CollectGarbage(const RetentionPolicy& policy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::string kActiveVersion(ActiveVersion());
+  const uint64_t kNow(NowInMilliseconds()), kMinAge(std::chrono::duration_cast<
+      std::chrono::milliseconds>(policy.min_age).count());
+  std::set<std::string> referenced;
+  uint32_t kept(0);
+  boost::system::error_code error_code;
+  for (const auto& record : ReadVersions()) {
+    if (record.version() == kActiveVersion || kept < policy.versions ||
+        kNow - std::min(record.added(), kNow) < kMinAge) {
+      if (record.version() != kActiveVersion)
+        ++kept;
+      for (const auto& artifact : record.artifacts())
+        referenced.insert(HexEncode(artifact.hash()));
+      continue;
+    }
+    LOG(kInfo) << "Removing version " << record.version() << " from " << kRoot_;
+    fs::remove(VersionPath(record.version()), error_code);
+  }
+
+  // Temporary files are only left behind by processes which died while writing them.
+  for (const auto& directory : {kRoot_ / "objects", kRoot_ / "tmp"}) {
+    fs::directory_iterator itr(directory, error_code), end;
+    for (; !error_code && itr != end; itr.increment(error_code)) {
+      if (referenced.count(itr->path().filename().string()) != 0 ||
+          WithinGracePeriod(itr->path())) {
+        continue;
+      }
+      boost::system::error_code remove_error;
+      if (fs::remove(itr->path(), remove_error))
+        LOG(kVerbose) << "Removed unreferenced " << itr->path();
+    }
+  }
+}
+
+bool ArtifactStore::ReadVersion(const std::string& version,
+                                protobuf::ArtifactVersion& record) const {
+  std::string serialised;
+  if (!IsValidName(version) || !ReadFile(VersionPath(version), &serialised) ||
+      !record.ParseFromString(serialised) || record.version() != version) {
+    LOG(kError) << "Version " << version << " isn't in " << kRoot_;
+    return false;
+  }
+  return true;
+}
+
+std::vector<protobuf::ArtifactVersion> ArtifactStore::ReadVersions() const {
+  std::vector<protobuf::ArtifactVersion> records;
+  boost::system::error_code error_code;
+  fs::directory_iterator itr(kRoot_ / "versions", error_code), end;
+  for (; !error_code && itr != end; itr.increment(error_code)) {
+    protobuf::ArtifactVersion record;
+    if (ReadVersion(itr->path().filename().string(), record))
+      records.push_back(record);
+  }
+  std::sort(records.begin(), records.end(),
+            [](const protobuf::ArtifactVersion& lhs, const protobuf::ArtifactVersion& rhs) {
+    return lhs.added() != rhs.added() ? lhs.added() > rhs.added() : lhs.version() > rhs.version();
+  });
+  return records;
+}
+
+bool ArtifactStore::StoreObject(const fs::path& source, std::string& hash) const {
+  std::string content;
+  if (!ReadFile(source, &content)) {
+    LOG(kError) << "Failed to read " << source;
+    return false;
+  }
+  hash = crypto::Hash<crypto::SHA512>(content).string();
+  fs::path object_path(ObjectPath(hash));
+  boost::system::error_code error_code;
+  if (fs::exists(object_path, error_code)) {
+    // Keeps another process's garbage collection off it until the version's record is written.
+    fs::last_write_time(object_path, std::time(nullptr), error_code);
+    return true;
+  }
+  // Binaries need to stay executable.
+  return WriteAtomically(object_path, content, fs::status(source, error_code).permissions());
+}
+
+bool ArtifactStore::WriteAtomically(const fs::path& path, const std::string& content,
+                                    fs::perms permissions) const {
+  boost::system::error_code error_code;
+  fs::create_directories(path.parent_path(), error_code);
+  fs::create_directories(kRoot_ / "tmp", error_code);
+  fs::path temp_path(kRoot_ / "tmp" / RandomAlphaNumericString(16));
+  if (!WriteFile(temp_path, content)) {
+    LOG(kError) << "Failed to write " << temp_path;
+    return false;
+  }
+  if (permissions != fs::perms_not_known)
+    fs::permissions(temp_path, permissions, error_code);
+  fs::rename(temp_path, path, error_code);
+  if (error_code) {
+    LOG(kError) << "Failed to move " << temp_path << " to " << path << ": "
+                << error_code.message();
+    fs::remove(temp_path, error_code);
+    return false;
+  }
+  return true;
+}
+
+fs::path ArtifactStore::ObjectPath(const std::string& hash) const {
+  return kRoot_ / "objects" / HexEncode(hash);
+}
+
+fs::path ArtifactStore::VersionPath(const std::string& version) const {
+  return kRoot_ / "versions" / version;
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
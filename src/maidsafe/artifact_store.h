@@ -0,0 +1,104 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_ARTIFACT_STORE_H_
+#define MAIDSAFE_CLIENT_MANAGER_ARTIFACT_STORE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/client_manager/vault_info.pb.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+// Which versions ArtifactStore::CollectGarbage keeps besides the active one: the 'versions' most
+// recently added, and any added less than 'min_age' ago.
+struct RetentionPolicy {
+  RetentionPolicy() : versions(2), min_age(std::chrono::hours(0)) {}
+  uint32_t versions;
+  std::chrono::hours min_age;
+};
+
+namespace detail {
+
+// Holds the installers and binaries of each version downloaded, so that a previous version can be
+// returned to without downloading it again.  Files are stored under '<root>/objects', named by the
+// hex encoding of their SHA-512, so identical files in several versions are stored once.  Each
+// version's record of which file is which is kept in '<root>/versions', and the name of the active
+// version in '<root>/active'; rolling back rewrites just that.
+//
+// Several ClientManagers on a host may share a store.  Files are only ever written under temporary
+// names and renamed into place, and garbage collection leaves anything written in the last
+// kGracePeriod() so that it can't remove an object another process is about to refer to.
+class ArtifactStore {
+ public:
+  explicit ArtifactStore(const boost::filesystem::path& root);
+  // Stores 'files', which maps each artifact's name to where it currently is, as 'version'.  The
+  // files are copied, and only if not already stored.  Replaces any existing record of 'version'.
+  bool AddVersion(const std::string& version,
+                  const std::map<std::string, boost::filesystem::path>& files);
+  // Fails if 'version' isn't stored complete.
+  bool Activate(const std::string& version);
+  // Empty if none has been activated.
+  std::string ActiveVersion() const;
+  // Oldest first.
+  std::vector<std::string> Versions() const;
+  // Where artifact 'name' of 'version' is stored, or an empty path if it isn't.
+  boost::filesystem::path Path(const std::string& version, const std::string& name) const;
+  // Forgets versions outside 'policy', then removes objects no remaining version refers to.
+  void CollectGarbage(const RetentionPolicy& policy);
+  boost::filesystem::path root() const { return kRoot_; }
+
+  static std::chrono::hours kGracePeriod() { return std::chrono::hours(1); }
+
+ private:
+  ArtifactStore(const ArtifactStore&);
+  ArtifactStore& operator=(const ArtifactStore&);
+  bool ReadVersion(const std::string& version, protobuf::ArtifactVersion& record) const;
+  // Newest first.
+  std::vector<protobuf::ArtifactVersion> ReadVersions() const;
+  bool StoreObject(const boost::filesystem::path& source, std::string& hash) const;
+  // Writes to a temporary file which is then given 'permissions', if known, and renamed to 'path'.
+  bool WriteAtomically(
+      const boost::filesystem::path& path, const std::string& content,
+      boost::filesystem::perms permissions = boost::filesystem::perms_not_known) const;
+  boost::filesystem::path ObjectPath(const std::string& hash) const;
+  boost::filesystem::path VersionPath(const std::string& version) const;
+
+  const boost::filesystem::path kRoot_;
+  // Keeps this process's garbage collection from running alongside its other changes.
+  mutable std::mutex mutex_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_ARTIFACT_STORE_H_
@@ -0,0 +1,213 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/bootstrap_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/client_manager/vault_info.pb.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+size_t BootstrapCache::EndPointHash::operator()(const EndPoint& endpoint) const {
+  return std::hash<std::string>()(endpoint.first) ^ (static_cast<size_t>(endpoint.second) << 1);
+}
+
+BootstrapCache::BootstrapCache(size_t max_size)
+    : kMaxSize_(max_size == 0 ? 1 : max_size),
+      entries_(),
+      index_(),
+      mutex_(),
+      file_mutex_() {}
+
+bool BootstrapCache::Add(const EndPoint& endpoint) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool added(false);
+  Touch(endpoint, added);
+  EvictExcess();
+  return added;
+}
+
+void BootstrapCache::RecordSuccess(const EndPoint& endpoint,
+                                   const std::chrono::milliseconds& latency) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(index_.find(endpoint));
+  if (itr == index_.end())
+    return;
+  Entry& entry(*itr->second);
+  ++entry.success_count;
+  entry.consecutive_failures = 0;
+  int32_t latency_ms(static_cast<int32_t>(latency.count()));
+  if (entry.latency_ms == kUnknownLatency())
+    entry.latency_ms = latency_ms;
+  else  // Exponentially weighted moving average, giving the new sample a weight of 1/4.
+    entry.latency_ms = (3 * entry.latency_ms + latency_ms) / 4;
+}
+
+void BootstrapCache::RecordFailure(const EndPoint& endpoint) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(index_.find(endpoint));
+  if (itr == index_.end())
+    return;
+  ++itr->second->failure_count;
+  ++itr->second->consecutive_failures;
+}
+
+void BootstrapCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  index_.clear();
+  entries_.clear();
+}
+
+bool BootstrapCache::Empty() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.empty();
+}
+
+size_t BootstrapCache::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+std::vector<EndPoint> BootstrapCache::Endpoints() const {
+  std::vector<EndPoint> endpoints;
+  std::lock_guard<std::mutex> lock(mutex_);
+  endpoints.reserve(entries_.size());
+  for (const auto& entry : entries_)
+    endpoints.push_back(entry.endpoint);
+  return endpoints;
+}
+
+std::vector<BootstrapCache::Entry> BootstrapCache::Entries() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::vector<Entry>(entries_.begin(), entries_.end());
+}
+
+std::vector<EndPoint> BootstrapCache::RankedEndpoints() const {
+  std::vector<std::pair<double, const EndPoint*>> costs;
+  std::vector<EndPoint> endpoints;
+  std::lock_guard<std::mutex> lock(mutex_);
+  costs.reserve(entries_.size());
+  for (const auto& entry : entries_) {
+    double latency(static_cast<double>(entry.latency_ms == kUnknownLatency()
+                                           ? kAssumedLatency().count()
+                                           : entry.latency_ms));
+    // Laplace-smoothed, so that an unprobed endpoint has an estimated success rate of 1/2.
+    double success_rate((entry.success_count + 1.0) /
+                        (entry.success_count + entry.failure_count + 2.0));
+    double cost(std::max(latency, 1.0) / success_rate);
+    cost *= static_cast<double>(1U << std::min(entry.consecutive_failures, 16U));
+    costs.push_back(std::make_pair(cost, &entry.endpoint));
+  }
+  std::stable_sort(costs.begin(), costs.end(),
+                   [](const std::pair<double, const EndPoint*>& lhs,
+                      const std::pair<double, const EndPoint*>& rhs) {
+    return lhs.first < rhs.first;
+  });
+  endpoints.reserve(costs.size());
+  for (const auto& cost : costs)
+    endpoints.push_back(*cost.second);
+  return endpoints;
+}
+
+bool BootstrapCache::ReadFromFile(const fs::path& file_path) {
+  std::string content;
+  {
+    std::lock_guard<std::mutex> lock(file_mutex_);
+    if (!ReadFile(file_path, &content) || content.empty()) {
+      LOG(kWarning) << "Failed to read bootstrap file " << file_path;
+      return false;
+    }
+  }
+  protobuf::BootstrapCache cache;
+  if (!cache.ParseFromString(content)) {
+    LOG(kError) << "Failed to parse bootstrap file " << file_path;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  index_.clear();
+  entries_.clear();
+  // The file is ordered most recent first, so adding each entry to the back preserves the order.
+  for (int i(0); i != cache.endpoints_size() && entries_.size() < kMaxSize_; ++i) {
+    const protobuf::CachedEndpoint& cached(cache.endpoints(i));
+    EndPoint endpoint(cached.endpoint().ip(), static_cast<uint16_t>(cached.endpoint().port()));
+    if (index_.count(endpoint) != 0)
+      continue;
+    entries_.push_back(Entry(endpoint));
+    entries_.back().success_count = cached.success_count();
+    entries_.back().failure_count = cached.failure_count();
+    if (cached.has_latency_ms())
+      entries_.back().latency_ms = static_cast<int32_t>(cached.latency_ms());
+    index_.insert(std::make_pair(endpoint, std::prev(entries_.end())));
+  }
+  return true;
+}
+
+bool BootstrapCache::WriteToFile(const fs::path& file_path) const {
+  protobuf::BootstrapCache cache;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : entries_) {
+      protobuf::CachedEndpoint* cached(cache.add_endpoints());
+      cached->mutable_endpoint()->set_ip(entry.endpoint.first);
+      cached->mutable_endpoint()->set_port(entry.endpoint.second);
+      cached->set_success_count(entry.success_count);
+      cached->set_failure_count(entry.failure_count);
+      if (entry.latency_ms != kUnknownLatency())
+        cached->set_latency_ms(static_cast<uint32_t>(entry.latency_ms));
+    }
+  }
+  std::lock_guard<std::mutex> lock(file_mutex_);
+  if (!WriteFile(file_path, cache.SerializeAsString())) {
+    LOG(kError) << "Failed to write bootstrap file " << file_path;
+    return false;
+  }
+  return true;
+}
+
+void BootstrapCache::Touch(const EndPoint& endpoint, bool& added) {
+  auto itr(index_.find(endpoint));
+  if (itr != index_.end()) {
+    added = false;
+    entries_.splice(entries_.begin(), entries_, itr->second);
+    return;
+  }
+  added = true;
+  entries_.push_front(Entry(endpoint));
+  index_.insert(std::make_pair(endpoint, entries_.begin()));
+}
+
+void BootstrapCache::EvictExcess() {
+  while (entries_.size() > kMaxSize_) {
+    index_.erase(entries_.back().endpoint);
+    entries_.pop_back();
+  }
+}
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
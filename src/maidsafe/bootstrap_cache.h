@@ -0,0 +1,114 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_BOOTSTRAP_CACHE_H_
+#define MAIDSAFE_CLIENT_MANAGER_BOOTSTRAP_CACHE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+typedef std::pair<std::string, uint16_t> EndPoint;
+
+// Bounded set of bootstrap endpoints, ordered by recency.  Membership checks, insertions and
+// evictions are all O(1).  When full, adding a new endpoint evicts the least recently added or
+// used one.  Each endpoint also carries counts of successful and failed contact attempts and a
+// smoothed contact latency, from which RankedEndpoints() orders them.  All public functions are
+// thread-safe.
+class BootstrapCache {
+ public:
+  struct Entry {
+    Entry()
+        : endpoint(),
+          success_count(0),
+          failure_count(0),
+          consecutive_failures(0),
+          latency_ms(kUnknownLatency()) {}
+    explicit Entry(EndPoint endpoint_in)
+        : endpoint(std::move(endpoint_in)),
+          success_count(0),
+          failure_count(0),
+          consecutive_failures(0),
+          latency_ms(kUnknownLatency()) {}
+    EndPoint endpoint;
+    uint32_t success_count, failure_count, consecutive_failures;
+    int32_t latency_ms;
+  };
+
+  explicit BootstrapCache(size_t max_size = kDefaultMaxSize());
+
+  // Moves 'endpoint' to the front of the cache, adding it if necessary.  Returns true if the
+  // endpoint was not already held.
+  bool Add(const EndPoint& endpoint);
+  // These are no-ops if 'endpoint' isn't held.  Neither affects the recency order.
+  void RecordSuccess(const EndPoint& endpoint, const std::chrono::milliseconds& latency);
+  void RecordFailure(const EndPoint& endpoint);
+  void Clear();
+  bool Empty() const;
+  size_t Size() const;
+  // Most recent first.
+  std::vector<EndPoint> Endpoints() const;
+  std::vector<Entry> Entries() const;
+  // Best first.  Endpoints are ordered by their expected contact cost: the smoothed latency (or
+  // kAssumedLatency() if not yet measured) divided by the estimated success rate, and doubled for
+  // each consecutive failure.  Ties are resolved by recency.
+  std::vector<EndPoint> RankedEndpoints() const;
+
+  // Replaces the current contents with those held in 'file_path'.
+  bool ReadFromFile(const boost::filesystem::path& file_path);
+  bool WriteToFile(const boost::filesystem::path& file_path) const;
+
+  static size_t kDefaultMaxSize() { return 1000; }
+  static int32_t kUnknownLatency() { return -1; }
+  static std::chrono::milliseconds kAssumedLatency() { return std::chrono::milliseconds(500); }
+
+ private:
+  typedef std::list<Entry> EntryList;
+  struct EndPointHash {
+    size_t operator()(const EndPoint& endpoint) const;
+  };
+
+  BootstrapCache(const BootstrapCache&);
+  BootstrapCache& operator=(const BootstrapCache&);
+
+  // NOTE: mutex_ must be locked when calling these functions.
+  void Touch(const EndPoint& endpoint, bool& added);
+  void EvictExcess();
+
+  const size_t kMaxSize_;
+  EntryList entries_;
+  std::unordered_map<EndPoint, EntryList::iterator, EndPointHash> index_;
+  mutable std::mutex mutex_, file_mutex_;
+};
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_BOOTSTRAP_CACHE_H_
@@ -0,0 +1,172 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/bootstrap_prober.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "boost/asio/ip/tcp.hpp"
+
+#include "maidsafe/common/log.h"
+
+namespace asio = boost::asio;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+struct BootstrapProber::Round {
+  Round(std::vector<EndPoint> endpoints_in, std::function<void()> on_complete_in)
+      : endpoints(std::move(endpoints_in)),
+        on_complete(std::move(on_complete_in)),
+        mutex(),
+        next(0),
+        outstanding(0) {}
+  const std::vector<EndPoint> endpoints;
+  const std::function<void()> on_complete;
+  std::mutex mutex;
+  size_t next, outstanding;
+};
+
+BootstrapProber::BootstrapProber(asio::io_service& asio_service, BootstrapCache& bootstrap_cache,
+                                 Probe probe)
+    : asio_service_(asio_service),
+      bootstrap_cache_(bootstrap_cache),
+      probe_(probe ? std::move(probe) : TcpConnectProbe(asio_service)),
+      interval_(bptime::pos_infin),
+      on_round_complete_(),
+      timer_(asio_service),
+      timer_mutex_(),
+      running_(false) {}
+
+void BootstrapProber::Start(const bptime::time_duration& interval,
+                            std::function<void()> on_round_complete) {
+  interval_ = interval;
+  on_round_complete_ = std::move(on_round_complete);
+  running_ = true;
+  auto self(shared_from_this());
+  ProbeAll([self] { self->ScheduleNextRound(); });
+}
+
+void BootstrapProber::Stop() {
+  running_ = false;
+  std::lock_guard<std::mutex> lock(timer_mutex_);
+  boost::system::error_code ec;
+  timer_.cancel(ec);
+}
+
+void BootstrapProber::ScheduleNextRound() {
+  if (on_round_complete_)
+    on_round_complete_();
+  if (!running_)
+    return;
+  std::lock_guard<std::mutex> lock(timer_mutex_);
+  timer_.expires_from_now(interval_);
+  auto self(shared_from_this());
+  timer_.async_wait([self](const boost::system::error_code& ec) {
+    if (ec || !self->running_)
+      return;
+    self->ProbeAll([self] { self->ScheduleNextRound(); });
+  });
+}
+
+void BootstrapProber::ProbeAll(std::function<void()> on_round_complete) {
+  auto round(std::make_shared<Round>(bootstrap_cache_.Endpoints(), std::move(on_round_complete)));
+  if (round->endpoints.empty()) {
+    if (round->on_complete)
+      round->on_complete();
+    return;
+  }
+  LOG(kVerbose) << "Probing " << round->endpoints.size() << " bootstrap endpoints.";
+  for (size_t i(0); i != kMaxConcurrentProbes(); ++i)
+    ProbeNext(round);
+}
+
+void BootstrapProber::ProbeNext(std::shared_ptr<Round> round) {
+  EndPoint endpoint;
+  {
+    std::lock_guard<std::mutex> lock(round->mutex);
+    if (round->next == round->endpoints.size())
+      return;
+    endpoint = round->endpoints[round->next++];
+    ++round->outstanding;
+  }
+
+  auto self(shared_from_this());
+  auto start(std::chrono::steady_clock::now());
+  auto reported(std::make_shared<std::atomic<bool>>(false));
+  probe_(endpoint, kProbeTimeout(), [self, round, endpoint, start, reported](bool responded) {
+    if (reported->exchange(true))
+      return;
+    if (responded) {
+      self->bootstrap_cache_.RecordSuccess(
+          endpoint, std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start));
+    } else {
+      self->bootstrap_cache_.RecordFailure(endpoint);
+    }
+    bool round_complete(false);
+    {
+      std::lock_guard<std::mutex> lock(round->mutex);
+      --round->outstanding;
+      round_complete = (round->outstanding == 0 && round->next == round->endpoints.size());
+    }
+    if (round_complete) {
+      if (round->on_complete)
+        round->on_complete();
+    } else {
+      // Posted rather than called directly, since a probe may report synchronously.
+      self->asio_service_.post([self, round] { self->ProbeNext(round); });
+    }
+  });
+}
+
+BootstrapProber::Probe BootstrapProber::TcpConnectProbe(asio::io_service& asio_service) {
+  return [&asio_service](const EndPoint& endpoint, const bptime::time_duration& timeout,
+                         std::function<void(bool)> on_result) {
+    boost::system::error_code ec;
+    asio::ip::tcp::endpoint target(asio::ip::address::from_string(endpoint.first, ec),
+                                   endpoint.second);
+    if (ec) {
+      LOG(kWarning) << "Invalid bootstrap endpoint address " << endpoint.first;
+      return on_result(false);
+    }
+    auto socket(std::make_shared<asio::ip::tcp::socket>(asio_service));
+    auto timer(std::make_shared<asio::deadline_timer>(asio_service, timeout));
+    timer->async_wait([socket](const boost::system::error_code& timer_ec) {
+      if (!timer_ec) {
+        boost::system::error_code close_ec;
+        socket->close(close_ec);
+      }
+    });
+    socket->async_connect(target, [socket, timer, on_result](
+                                      const boost::system::error_code& connect_ec) {
+      boost::system::error_code ignored_ec;
+      timer->cancel(ignored_ec);
+      socket->close(ignored_ec);
+      on_result(!connect_ec || connect_ec == asio::error::connection_refused);
+    });
+  };
+}
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
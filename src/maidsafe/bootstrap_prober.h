@@ -0,0 +1,92 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_BOOTSTRAP_PROBER_H_
+#define MAIDSAFE_CLIENT_MANAGER_BOOTSTRAP_PROBER_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/date_time/posix_time/posix_time_duration.hpp"
+
+#include "maidsafe/client_manager/bootstrap_cache.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+// Periodically contacts every endpoint held in a BootstrapCache and records the outcome and
+// latency of each attempt in the cache, so that BootstrapCache::RankedEndpoints() can put the
+// reachable and fast endpoints first.  Rounds are run on the supplied io_service with at most
+// kMaxConcurrentProbes() attempts outstanding at a time.
+class BootstrapProber : public std::enable_shared_from_this<BootstrapProber> {
+ public:
+  // A probe must invoke 'on_result' exactly once, within (or shortly after) 'timeout', passing true
+  // if the endpoint responded.  The prober measures the latency itself.
+  typedef std::function<void(const EndPoint& endpoint,
+                             const boost::posix_time::time_duration& timeout,
+                             std::function<void(bool)> on_result)> Probe;  // NOLINT (Fraser)
+
+  // If 'probe' is empty, TcpConnectProbe() is used.
+  BootstrapProber(boost::asio::io_service& asio_service, BootstrapCache& bootstrap_cache,
+                  Probe probe = Probe());
+  // Runs a round immediately, then one every 'interval' until Stop() is called.
+  // 'on_round_complete' (if non-empty) is invoked at the end of each round.
+  void Start(const boost::posix_time::time_duration& interval,
+             std::function<void()> on_round_complete = std::function<void()>());
+  void Stop();
+  // Runs a single round, invoking 'on_round_complete' (if non-empty) when every endpoint which was
+  // in the cache at the start of the round has been probed.
+  void ProbeAll(std::function<void()> on_round_complete);
+
+  static boost::posix_time::time_duration kProbeTimeout() {
+    return boost::posix_time::seconds(3);
+  }
+  static size_t kMaxConcurrentProbes() { return 16; }
+
+  // Attempts a TCP connection.  A refused connection still counts as a response, since the
+  // round-trip to the host is what's being measured and bootstrap nodes generally listen over UDP.
+  static Probe TcpConnectProbe(boost::asio::io_service& asio_service);
+
+ private:
+  struct Round;
+
+  BootstrapProber(const BootstrapProber&);
+  BootstrapProber& operator=(const BootstrapProber&);
+  void ScheduleNextRound();
+  void ProbeNext(std::shared_ptr<Round> round);
+
+  boost::asio::io_service& asio_service_;
+  BootstrapCache& bootstrap_cache_;
+  Probe probe_;
+  boost::posix_time::time_duration interval_;
+  std::function<void()> on_round_complete_;
+  boost::asio::deadline_timer timer_;
+  std::mutex timer_mutex_;
+  std::atomic<bool> running_;
+};
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_BOOTSTRAP_PROBER_H_
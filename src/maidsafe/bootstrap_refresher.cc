@@ -0,0 +1,107 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/bootstrap_refresher.h"
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#include "maidsafe/common/log.h"
+
+namespace asio = boost::asio;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+BootstrapRefresher::BootstrapRefresher(asio::io_service& asio_service,
+                                       BootstrapCache& bootstrap_cache, Fetch fetch,
+                                       const bptime::time_duration& retry_interval)
+    : bootstrap_cache_(bootstrap_cache),
+      fetch_functor_(std::move(fetch)),
+      retry_interval_(retry_interval),
+      last_fetch_(),
+      last_fetch_mutex_(),
+      retry_timer_(asio_service),
+      retry_timer_mutex_(),
+      running_(true),
+      retrying_(false),
+      fetch_([this] { return FetchAndRecordTime(); }) {}
+
+void BootstrapRefresher::FetchInBackground() {
+  if (!running_ || !bootstrap_cache_.Empty())
+    return;
+  retrying_ = true;
+  fetch_.Run();
+}
+
+void BootstrapRefresher::Stop() {
+  running_ = false;
+  {
+    std::lock_guard<std::mutex> lock(retry_timer_mutex_);
+    boost::system::error_code ec;
+    retry_timer_.cancel(ec);
+  }
+  fetch_.Wait();
+}
+
+std::vector<EndPoint> BootstrapRefresher::Endpoints(const std::chrono::milliseconds& max_wait) {
+  if (bootstrap_cache_.Empty())
+    fetch_.Run().wait_for(max_wait);
+  else if (Stale())
+    fetch_.Run();
+  return bootstrap_cache_.RankedEndpoints();
+}
+
+bool BootstrapRefresher::FetchAndRecordTime() {
+  if (!running_)
+    return false;
+  bool result(fetch_functor_());
+  if (result) {
+    std::lock_guard<std::mutex> lock(last_fetch_mutex_);
+    last_fetch_ = bptime::microsec_clock::universal_time();
+  }
+  if (!bootstrap_cache_.Empty())
+    retrying_ = false;
+  else if (retrying_)
+    ScheduleRetry();
+  return result;
+}
+
+void BootstrapRefresher::ScheduleRetry() {
+  LOG(kWarning) << "Failed to obtain bootstrap information; will retry in " << retry_interval_;
+  std::lock_guard<std::mutex> lock(retry_timer_mutex_);
+  if (!running_)
+    return;
+  auto self(shared_from_this());
+  retry_timer_.expires_from_now(retry_interval_);
+  retry_timer_.async_wait([self](const boost::system::error_code& ec) {
+    if (ec != asio::error::operation_aborted)
+      self->FetchInBackground();
+  });
+}
+
+bool BootstrapRefresher::Stale() const {
+  std::lock_guard<std::mutex> lock(last_fetch_mutex_);
+  return last_fetch_.is_not_a_date_time() ||
+         bptime::microsec_clock::universal_time() - last_fetch_ > kRefreshInterval();
+}
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
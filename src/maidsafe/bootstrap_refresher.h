@@ -0,0 +1,94 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_BOOTSTRAP_REFRESHER_H_
+#define MAIDSAFE_CLIENT_MANAGER_BOOTSTRAP_REFRESHER_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/date_time/posix_time/posix_time_duration.hpp"
+#include "boost/date_time/posix_time/ptime.hpp"
+
+#include "maidsafe/client_manager/bootstrap_cache.h"
+#include "maidsafe/client_manager/single_flight.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+// Keeps a BootstrapCache filled from the bootstrap server without ever making a caller wait longer
+// than it chooses to.  Concurrent fetches are collapsed into one, stale lists are served while a
+// refresh runs in the background, and an empty cache can be refilled in the background so that
+// startup needn't wait on the server.
+class BootstrapRefresher : public std::enable_shared_from_this<BootstrapRefresher> {
+ public:
+  // Should fetch from the server and add the results to the cache, returning true on success.
+  typedef std::function<bool()> Fetch;
+
+  BootstrapRefresher(boost::asio::io_service& asio_service, BootstrapCache& bootstrap_cache,
+                     Fetch fetch,
+                     const boost::posix_time::time_duration& retry_interval = kRetryInterval());
+  // Returns immediately.  If the cache is empty, starts a fetch, retrying every 'retry_interval'
+  // until the cache is non-empty or Stop() is called.  No io_service thread is held up meanwhile.
+  void FetchInBackground();
+  // Cancels any pending retry and waits for a fetch in flight to complete.  No fetch is made
+  // afterwards, so the owner of anything 'fetch' refers to may then be destroyed.
+  void Stop();
+  // Returns the ranked endpoints.  If the cache is empty, waits up to 'max_wait' for the (possibly
+  // already in-flight) fetch; if it's merely stale, returns the stale list and starts a refresh.
+  std::vector<EndPoint> Endpoints(const std::chrono::milliseconds& max_wait);
+  bool FetchInFlight() const { return fetch_.InFlight(); }
+
+  // Once the last successful fetch is this old, the cached list is considered stale.
+  static boost::posix_time::time_duration kRefreshInterval() {
+    return boost::posix_time::hours(1);
+  }
+  static boost::posix_time::time_duration kRetryInterval() {
+    return boost::posix_time::seconds(10);
+  }
+
+ private:
+  BootstrapRefresher(const BootstrapRefresher&);
+  BootstrapRefresher& operator=(const BootstrapRefresher&);
+  bool FetchAndRecordTime();
+  void ScheduleRetry();
+  bool Stale() const;
+
+  BootstrapCache& bootstrap_cache_;
+  const Fetch fetch_functor_;
+  const boost::posix_time::time_duration retry_interval_;
+  boost::posix_time::ptime last_fetch_;
+  mutable std::mutex last_fetch_mutex_;
+  boost::asio::deadline_timer retry_timer_;
+  std::mutex retry_timer_mutex_;
+  std::atomic<bool> running_, retrying_;
+  SingleFlight<bool> fetch_;
+};
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_BOOTSTRAP_REFRESHER_H_
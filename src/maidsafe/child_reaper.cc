@@ -0,0 +1,232 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/child_reaper.h"
+
+#include <algorithm>
+
+#ifdef MAIDSAFE_WIN32
+#include <windows.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef MAIDSAFE_LINUX
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+
+#if defined MAIDSAFE_LINUX && !defined SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+namespace {
+
+#ifdef MAIDSAFE_LINUX
+const uint64_t kWakeTag(static_cast<uint64_t>(-1));
+#endif
+
+}  // unnamed namespace
+
+ChildReaper::ChildReaper(bool use_pidfds)
+    : children_(),
+      polled_count_(0),
+      mutex_(),
+#ifdef MAIDSAFE_LINUX
+      kUsePidfds_(use_pidfds),
+      epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      event_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+  if (epoll_fd_ == -1 || event_fd_ == -1) {
+    LOG(kError) << "Failed to create epoll instance or eventfd.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::unable_to_handle_request));
+  }
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = kWakeTag;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &event) == -1) {
+    LOG(kError) << "Failed to add eventfd to epoll instance.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::unable_to_handle_request));
+  }
+}
+#else
+      cond_var_(),
+      woken_(false) {
+  static_cast<void>(use_pidfds);
+}
+#endif
+
+ChildReaper::~ChildReaper() {
+#ifdef MAIDSAFE_LINUX
+  for (const auto& child : children_) {
+    if (child.second.pidfd != -1)
+      close(child.second.pidfd);
+  }
+  if (event_fd_ != -1)
+    close(event_fd_);
+  if (epoll_fd_ != -1)
+    close(epoll_fd_);
+#endif
+}
+
+void ChildReaper::Add(ProcessIndex index, const boost::process::child& child) {
+#ifdef MAIDSAFE_WIN32
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    children_.insert(std::make_pair(index, Child(child.proc_info.hProcess)));
+    ++polled_count_;
+  }
+  Wake();
+#else
+  int pidfd(-1);
+#ifdef MAIDSAFE_LINUX
+  if (kUsePidfds_)
+    pidfd = static_cast<int>(syscall(SYS_pidfd_open, child.pid, 0));
+  if (pidfd != -1) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = index;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, pidfd, &event) == -1) {
+      close(pidfd);
+      pidfd = -1;
+    }
+  }
+#endif
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    children_.insert(std::make_pair(index, Child(child.pid, pidfd)));
+    if (pidfd == -1)
+      ++polled_count_;
+  }
+  // A thread already in Wait() may be sleeping for its full timeout, not kPollInterval().
+  if (pidfd == -1)
+    Wake();
+#endif
+}
+
+std::vector<ChildReaper::Exit> ChildReaper::Wait(const std::chrono::milliseconds& timeout) {
+  std::vector<Exit> exits;
+#ifdef MAIDSAFE_LINUX
+  std::chrono::milliseconds wait(timeout);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (polled_count_ != 0)
+      wait = std::min(wait, kPollInterval());
+  }
+  const int kMaxEvents(64);
+  epoll_event events[kMaxEvents];
+  int count(epoll_wait(epoll_fd_, events, kMaxEvents, static_cast<int>(wait.count())));
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i(0); i < count; ++i) {
+    if (events[i].data.u64 == kWakeTag) {
+      uint64_t value(0);
+      while (read(event_fd_, &value, sizeof(value)) > 0) {}
+      continue;
+    }
+    auto itr(children_.find(static_cast<ProcessIndex>(events[i].data.u64)));
+    int exit_code(0);
+    if (itr == children_.end() || !TryReap(itr->second, exit_code))
+      continue;
+    // Closing the pidfd also removes it from the epoll set.
+    close(itr->second.pidfd);
+    exits.emplace_back(itr->first, exit_code);
+    children_.erase(itr);
+  }
+  if (polled_count_ == 0)
+    return exits;
+#else
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_var_.wait_for(lock, std::min(timeout, kPollInterval()), [this] { return woken_; });
+  woken_ = false;
+#endif
+  for (auto itr(children_.begin()); itr != children_.end();) {
+    int exit_code(0);
+#ifndef MAIDSAFE_WIN32
+    if (itr->second.pidfd != -1) {
+      ++itr;
+      continue;
+    }
+#endif
+    if (TryReap(itr->second, exit_code)) {
+      exits.emplace_back(itr->first, exit_code);
+      --polled_count_;
+      itr = children_.erase(itr);
+    } else {
+      ++itr;
+    }
+  }
+  return exits;
+}
+
+void ChildReaper::Wake() {
+#ifdef MAIDSAFE_LINUX
+  uint64_t value(1);
+  if (write(event_fd_, &value, sizeof(value)) == -1)
+    LOG(kWarning) << "Failed to wake reaper.";
+#else
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    woken_ = true;
+  }
+  cond_var_.notify_one();
+#endif
+}
+
+size_t ChildReaper::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return children_.size();
+}
+
+bool ChildReaper::TryReap(const Child& child, int& exit_code) const {
+#ifdef MAIDSAFE_WIN32
+  if (WaitForSingleObject(child.handle, 0) != WAIT_OBJECT_0)
+    return false;
+  DWORD code(0);
+  GetExitCodeProcess(child.handle, &code);
+  exit_code = static_cast<int>(code);
+  return true;
+#else
+  int status(0);
+  pid_t result(waitpid(child.pid, &status, WNOHANG));
+  if (result == 0)
+    return false;
+  if (result == -1) {
+    // Already reaped elsewhere, so the exit code is lost.
+    exit_code = -1;
+    return true;
+  }
+  exit_code = WIFEXITED(status) ? WEXITSTATUS(status)
+                                : (WIFSIGNALED(status) ? 128 + WTERMSIG(status) : -1);
+  return true;
+#endif
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
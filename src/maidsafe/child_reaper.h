@@ -0,0 +1,102 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_CHILD_REAPER_H_
+#define MAIDSAFE_CLIENT_MANAGER_CHILD_REAPER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "boost/process/child.hpp"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+typedef uint32_t ProcessIndex;
+
+namespace detail {
+
+// Waits on any number of child processes from a single thread.  On Linux, each child's pidfd is
+// registered with an epoll instance along with an eventfd used by Wake(), so Wait() sleeps until a
+// child exits.  Where pidfds aren't available (kernels older than 5.3 and other platforms), the
+// children are polled every kPollInterval() instead.
+class ChildReaper {
+ public:
+  struct Exit {
+    Exit(ProcessIndex index_in, int exit_code_in) : index(index_in), exit_code(exit_code_in) {}
+    ProcessIndex index;
+    // As reported by a shell, i.e. 128 + the signal number if the child was killed by a signal.
+    int exit_code;
+  };
+
+  // If 'use_pidfds' is false, every child is polled as though pidfds weren't available.
+  explicit ChildReaper(bool use_pidfds = true);
+  ~ChildReaper();
+  // Thread-safe.  A child which has to be polled wakes any thread blocked in Wait(), so that its
+  // exit is seen within kPollInterval() rather than when that Wait() times out.  'child' must
+  // remain valid until it has been returned by Wait().
+  void Add(ProcessIndex index, const boost::process::child& child);
+  // Blocks until at least one child has exited, Wake() is called or 'timeout' expires.  Exited
+  // children are reaped, and won't be returned again.
+  std::vector<Exit> Wait(const std::chrono::milliseconds& timeout);
+  void Wake();
+  size_t Size() const;
+
+  static std::chrono::milliseconds kPollInterval() { return std::chrono::milliseconds(100); }
+
+ private:
+  struct Child {
+#ifdef MAIDSAFE_WIN32
+    explicit Child(void* handle_in) : handle(handle_in) {}
+    void* handle;
+#else
+    Child(pid_t pid_in, int pidfd_in) : pid(pid_in), pidfd(pidfd_in) {}
+    pid_t pid;
+    int pidfd;
+#endif
+  };
+
+  ChildReaper(const ChildReaper&);
+  ChildReaper& operator=(const ChildReaper&);
+  // Returns true and sets 'exit_code' if the child has exited.
+  bool TryReap(const Child& child, int& exit_code) const;
+
+  std::unordered_map<ProcessIndex, Child> children_;
+  size_t polled_count_;
+  mutable std::mutex mutex_;
+#ifdef MAIDSAFE_LINUX
+  const bool kUsePidfds_;
+  int epoll_fd_, event_fd_;
+#else
+  std::condition_variable cond_var_;
+  bool woken_;
+#endif
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_CHILD_REAPER_H_
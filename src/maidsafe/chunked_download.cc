@@ -0,0 +1,197 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/chunked_download.h"
+
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <utility>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+namespace {
+
+bool Matches(const std::string& content, const DownloadChunk& chunk) {
+  return content.size() == chunk.length &&
+         crypto::Hash<crypto::SHA512>(content).string() == chunk.hash;
+}
+
+}  // unnamed namespace
+
+std::vector<DownloadChunk> DownloadChunks(const protobuf::UpdateFile& file) {
+  std::vector<DownloadChunk> chunks;
+  if (file.chunk_hashes_size() == 0) {
+    chunks.push_back(DownloadChunk(0, file.size(), file.hash()));
+    return chunks;
+  }
+  if (file.chunk_size() == 0 ||
+      (file.size() + file.chunk_size() - 1) / file.chunk_size() !=
+          static_cast<uint64_t>(file.chunk_hashes_size())) {
+    LOG(kError) << "Chunk hashes of " << file.name() << " don't match its size.";
+    return chunks;
+  }
+  for (int i(0); i != file.chunk_hashes_size(); ++i) {
+    uint64_t offset(static_cast<uint64_t>(i) * file.chunk_size());
+    uint64_t length(std::min<uint64_t>(file.chunk_size(), file.size() - offset));
+    chunks.push_back(DownloadChunk(offset, length, file.chunk_hashes(i)));
+  }
+  return chunks;
+}
+
+ChunkedDownload::ChunkedDownload(UpdateFetcher fetcher, int parallelism)
+    : fetcher_(std::move(fetcher)),
+      kParallelism_(std::max(parallelism, 1)),
+      stopped_(false),
+      bytes_fetched_(0) {}
+
+bool ChunkedDownload::Download(const protobuf::UpdateFile& file, const fs::path& target) {
+  std::vector<DownloadChunk> chunks(DownloadChunks(file)), missing;
+  if (chunks.empty())
+    return false;
+  fs::path part_path(target.string() + ".part");
+  if (!MissingChunks(part_path, chunks, missing))
+    return false;
+  if (!missing.empty() && missing.size() != chunks.size()) {
+    LOG(kInfo) << "Resuming download of " << file.name() << " with " << missing.size() << " of "
+               << chunks.size() << " chunks left.";
+  }
+  if (!FetchChunks(file.name(), part_path, missing))
+    return false;
+  boost::system::error_code error_code;
+  fs::rename(part_path, target, error_code);
+  if (error_code) {
+    LOG(kError) << "Failed to move " << part_path << " to " << target << ": "
+                << error_code.message();
+    return false;
+  }
+  return true;
+}
+
+bool ChunkedDownload::MissingChunks(const fs::path& part_path,
+                                    const std::vector<DownloadChunk>& chunks,
+                                    std::vector<DownloadChunk>& missing) const {
+  const uint64_t kSize(chunks.back().offset + chunks.back().length);
+  boost::system::error_code error_code;
+  if (!fs::exists(part_path, error_code) || fs::file_size(part_path, error_code) != kSize) {
+    if (!WriteFile(part_path, std::string())) {
+      LOG(kError) << "Failed to create " << part_path;
+      return false;
+    }
+    fs::resize_file(part_path, kSize, error_code);
+    if (error_code) {
+      LOG(kError) << "Failed to allocate " << kSize << " bytes for " << part_path << ": "
+                  << error_code.message();
+      return false;
+    }
+    missing = chunks;
+    return true;
+  }
+
+  std::ifstream stream(part_path.string(), std::ios::binary);
+  std::string content;
+  for (const auto& chunk : chunks) {
+    content.resize(static_cast<size_t>(chunk.length));
+    if (!content.empty())
+      stream.read(&content[0], content.size());
+    if (!stream || !Matches(content, chunk))
+      missing.push_back(chunk);
+  }
+  return true;
+}
+
+bool ChunkedDownload::FetchChunks(const std::string& name, const fs::path& part_path,
+                                  const std::vector<DownloadChunk>& chunks) {
+  std::atomic<size_t> next(0);
+  std::atomic<bool> failed(false);
+  auto fetch_chunks([&] {
+    std::fstream stream(part_path.string(), std::ios::in | std::ios::out | std::ios::binary);
+    if (!stream) {
+      LOG(kError) << "Failed to open " << part_path;
+      failed = true;
+      return;
+    }
+    for (size_t i(next++); i < chunks.size() && !failed && !stopped_; i = next++) {
+      const DownloadChunk& chunk(chunks[i]);
+      std::string content;
+      bool fetched(false);
+      for (int attempt(0); attempt != kMaxAttempts() && !fetched && !stopped_; ++attempt) {
+        content.clear();
+        if (!fetcher_(name, chunk.offset, chunk.length, content)) {
+          LOG(kWarning) << "Failed to fetch " << chunk.length << " bytes of " << name << " at "
+                        << chunk.offset;
+          continue;
+        }
+        bytes_fetched_ += content.size();
+        fetched = Matches(content, chunk);
+        if (!fetched) {
+          LOG(kWarning) << "Fetched " << content.size() << " bytes of " << name << " at "
+                        << chunk.offset << " don't match the update manifest.";
+        }
+      }
+      if (!fetched) {
+        failed = true;
+        return;
+      }
+      stream.seekp(static_cast<std::streamoff>(chunk.offset));
+      stream.write(content.data(), content.size());
+      if (!stream) {
+        LOG(kError) << "Failed to write to " << part_path;
+        failed = true;
+        return;
+      }
+    }
+    stream.flush();
+    if (!stream) {
+      LOG(kError) << "Failed to write to " << part_path;
+      failed = true;
+    }
+  });
+
+  std::vector<std::thread> threads;
+  size_t thread_count(std::min(static_cast<size_t>(kParallelism_), chunks.size()));
+  for (size_t i(0); i != thread_count; ++i)
+    threads.push_back(std::thread(fetch_chunks));
+  for (auto& thread : threads)
+    thread.join();
+  if (failed || stopped_) {
+    LOG(kError) << "Download of " << name << " " << (stopped_ ? "stopped" : "failed")
+                << "; it will resume from " << part_path;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
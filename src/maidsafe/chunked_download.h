@@ -0,0 +1,94 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_CHUNKED_DOWNLOAD_H_
+#define MAIDSAFE_CLIENT_MANAGER_CHUNKED_DOWNLOAD_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/client_manager/vault_info.pb.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+// Fetches 'length' bytes from 'offset' of one of a version's files, by its name relative to the
+// version's directory on the server.  Called from several threads at once.
+typedef std::function<bool(const std::string& name, uint64_t offset, uint64_t length,
+                           std::string& content)> UpdateFetcher;
+
+// The byte ranges a file listed in an update manifest is downloaded in, and the hash of each.
+struct DownloadChunk {
+  DownloadChunk(uint64_t offset_in, uint64_t length_in, const std::string& hash_in)
+      : offset(offset_in), length(length_in), hash(hash_in) {}
+  uint64_t offset, length;
+  std::string hash;
+};
+// Empty if the file's chunk hashes don't cover its size.
+std::vector<DownloadChunk> DownloadChunks(const protobuf::UpdateFile& file);
+
+// Downloads files listed in a signed update manifest as chunks fetched in parallel.  Each chunk is
+// checked against the manifest as soon as it arrives and written straight to '<target>.part', which
+// is only renamed to 'target' once every chunk has been.  A download which fails or is stopped can
+// be resumed: chunks already in the .part file which match the manifest aren't fetched again.
+class ChunkedDownload {
+ public:
+  ChunkedDownload(UpdateFetcher fetcher, int parallelism = kDefaultParallelism());
+  bool Download(const protobuf::UpdateFile& file, const boost::filesystem::path& target);
+  // Makes in-progress downloads fail as soon as their current chunks have been fetched, keeping
+  // what they have so far, and later ones fail at once.
+  void Stop() { stopped_ = true; }
+  uint64_t bytes_fetched() const { return bytes_fetched_; }
+
+  static int kDefaultParallelism() { return 4; }
+  // Each chunk is fetched up to this many times before the download is abandoned.
+  static int kMaxAttempts() { return 3; }
+
+ private:
+  ChunkedDownload(const ChunkedDownload&);
+  ChunkedDownload& operator=(const ChunkedDownload&);
+  // Sets 'missing' to the chunks not already in 'part_path', first creating it with the file's full
+  // size if need be.
+  bool MissingChunks(const boost::filesystem::path& part_path,
+                     const std::vector<DownloadChunk>& chunks,
+                     std::vector<DownloadChunk>& missing) const;
+  bool FetchChunks(const std::string& name, const boost::filesystem::path& part_path,
+                   const std::vector<DownloadChunk>& chunks);
+
+  const UpdateFetcher fetcher_;
+  const int kParallelism_;
+  std::atomic<bool> stopped_;
+  std::atomic<uint64_t> bytes_fetched_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_CHUNKED_DOWNLOAD_H_
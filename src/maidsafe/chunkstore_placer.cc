@@ -0,0 +1,158 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/chunkstore_placer.h"
+
+#ifndef MAIDSAFE_WIN32
+#include <sys/statvfs.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/log.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+bool ReadStorageCapacity(StorageRootUsage& usage) {
+#ifdef MAIDSAFE_WIN32
+  boost::system::error_code error_code;
+  fs::space_info space(fs::space(usage.root, error_code));
+  if (error_code) {
+    LOG(kWarning) << "Failed to read capacity of " << usage.root << ": " << error_code.message();
+    return false;
+  }
+  usage.free_bytes = space.available;
+  usage.free_inodes = usage.total_inodes = 0;
+#else
+  struct statvfs stats;
+  if (statvfs(usage.root.string().c_str(), &stats) != 0) {
+    LOG(kWarning) << "Failed to read capacity of " << usage.root << ": " << std::strerror(errno);
+    return false;
+  }
+  usage.free_bytes = static_cast<uint64_t>(stats.f_bavail) * stats.f_frsize;
+  usage.free_inodes = stats.f_favail;
+  usage.total_inodes = stats.f_files;
+#endif
+  return true;
+}
+
+ChunkstorePlacer::ChunkstorePlacer(uint64_t min_free_bytes, double min_free_inode_fraction)
+    : kMinFreeBytes_(min_free_bytes),
+      kMinFreeInodeFraction_(min_free_inode_fraction),
+      roots_(),
+      mutex_() {}
+
+void ChunkstorePlacer::SetRoots(const std::vector<fs::path>& roots) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<fs::path, size_t> retained;
+  for (const auto& root : roots) {
+    auto itr(roots_.find(root));
+    retained[root] = (itr == roots_.end() ? 0 : itr->second);
+  }
+  roots_.swap(retained);
+}
+
+std::vector<fs::path> ChunkstorePlacer::roots() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<fs::path> roots;
+  for (const auto& root : roots_)
+    roots.push_back(root.first);
+  return roots;
+}
+
+void ChunkstorePlacer::AddVault(const fs::path& root) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(roots_.find(root));
+  if (itr != roots_.end())
+    ++itr->second;
+}
+
+void ChunkstorePlacer::ClearVaults() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& root : roots_)
+    root.second = 0;
+}
+
+fs::path ChunkstorePlacer::Choose() const {
+  std::vector<StorageRootUsage> usages(Usage());
+  int chosen(Select(usages, kMinFreeBytes_, kMinFreeInodeFraction_));
+  if (chosen == -1) {
+    if (!usages.empty())
+      LOG(kError) << "None of the " << usages.size() << " storage roots has enough free space.";
+    return fs::path();
+  }
+  LOG(kInfo) << "Placing chunkstore under " << usages[chosen].root << " ("
+             << (usages[chosen].free_bytes >> 20) << " MiB free, "
+             << usages[chosen].vault_count << " vaults)";
+  return usages[chosen].root;
+}
+
+std::vector<StorageRootUsage> ChunkstorePlacer::Usage() const {
+  std::vector<StorageRootUsage> usages;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& root : roots_) {
+      StorageRootUsage usage;
+      usage.root = root.first;
+      usage.vault_count = root.second;
+      usages.push_back(usage);
+    }
+  }
+  // statvfs can block on a slow or network volume, so is called without mutex_ locked.
+  for (auto& usage : usages) {
+    if (!ReadStorageCapacity(usage))
+      usage.free_bytes = usage.free_inodes = 0;
+  }
+  return usages;
+}
+
+int ChunkstorePlacer::Select(const std::vector<StorageRootUsage>& usages,
+                             uint64_t min_free_bytes, double min_free_inode_fraction) {
+  int chosen(-1);
+  double best_score(0.0);
+  for (size_t i(0); i != usages.size(); ++i) {
+    const StorageRootUsage& usage(usages[i]);
+    if (usage.free_bytes < min_free_bytes || usage.free_bytes == 0)
+      continue;
+    if (usage.total_inodes != 0 &&
+        usage.free_inodes < min_free_inode_fraction * usage.total_inodes)
+      continue;
+    double score(static_cast<double>(usage.free_bytes) / (usage.vault_count + 1));
+    if (chosen == -1 || score > best_score) {
+      chosen = static_cast<int>(i);
+      best_score = score;
+    }
+  }
+  return chosen;
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
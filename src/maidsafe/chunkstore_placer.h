@@ -0,0 +1,97 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_CHUNKSTORE_PLACER_H_
+#define MAIDSAFE_CLIENT_MANAGER_CHUNKSTORE_PLACER_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+// The capacity of the volume holding a storage root, and the number of vaults with their
+// chunkstores under it.
+struct StorageRootUsage {
+  StorageRootUsage()
+      : root(), free_bytes(0), free_inodes(0), total_inodes(0), vault_count(0) {}
+  boost::filesystem::path root;
+  // Only what is available to unprivileged users is counted.
+  uint64_t free_bytes, free_inodes;
+  // 0 if the filesystem doesn't have a fixed number of inodes (e.g. btrfs).
+  uint64_t total_inodes;
+  size_t vault_count;
+};
+
+namespace detail {
+
+// Returns false if the capacity of the volume holding 'root' can't be read (e.g. if it doesn't
+// exist).
+bool ReadStorageCapacity(StorageRootUsage& usage);
+
+// Chooses the storage root on which to create each new vault's chunkstore.  Roots whose volumes
+// have less than 'min_free_bytes' free, or less than 'min_free_inode_fraction' of their inodes
+// free, are skipped.  Of the rest, the one with the most free space per vault (counting the new
+// one) is chosen, which spreads vaults across volumes in proportion to their free space.  Capacity
+// is read afresh on each choice, so space used by other programs is taken into account.
+class ChunkstorePlacer {
+ public:
+  explicit ChunkstorePlacer(uint64_t min_free_bytes = kDefaultMinFreeBytes(),
+                            double min_free_inode_fraction = kDefaultMinFreeInodeFraction());
+  // Vault counts are kept for roots which are retained.
+  void SetRoots(const std::vector<boost::filesystem::path>& roots);
+  std::vector<boost::filesystem::path> roots() const;
+  // Records that a vault's chunkstore is under 'root', either because it has just been placed there
+  // or because it was read from the config file.  Ignored if 'root' isn't a current root.
+  void AddVault(const boost::filesystem::path& root);
+  // Zeroes every root's vault count, so that they can be recounted from the config file.
+  void ClearVaults();
+  // Returns an empty path if there are no roots, or if none has enough headroom.  Doesn't record
+  // the choice; AddVault() should be called once the vault has been created.
+  boost::filesystem::path Choose() const;
+  std::vector<StorageRootUsage> Usage() const;
+  // Returns the index in 'usages' of the root to choose, or -1.
+  static int Select(const std::vector<StorageRootUsage>& usages, uint64_t min_free_bytes,
+                    double min_free_inode_fraction);
+
+  static uint64_t kDefaultMinFreeBytes() { return 1024ULL * 1024 * 1024; }
+  static double kDefaultMinFreeInodeFraction() { return 0.05; }
+
+ private:
+  ChunkstorePlacer(const ChunkstorePlacer&);
+  ChunkstorePlacer& operator=(const ChunkstorePlacer&);
+
+  const uint64_t kMinFreeBytes_;
+  const double kMinFreeInodeFraction_;
+  // Vault count per root.
+  std::map<boost::filesystem::path, size_t> roots_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_CHUNKSTORE_PLACER_H_
@@ -20,6 +20,7 @@
 
 #include <chrono>
 #include <limits>
+#include <string>
 
 #include "boost/filesystem/operations.hpp"
 
@@ -30,6 +31,7 @@
 
 #include "maidsafe/passport/passport.h"
 
+#include "maidsafe/client_manager/admission_controller.h"
 #include "maidsafe/client_manager/controller_messages.pb.h"
 #include "maidsafe/client_manager/client_manager.h"
 #include "maidsafe/client_manager/local_tcp_transport.h"
@@ -44,6 +46,22 @@ namespace maidsafe {
 
 namespace client_manager {
 
+namespace {
+
+void LogRefusal(const protobuf::StartVaultResponse& response) {
+  if (!response.has_refusal_reason())
+    return;
+  LOG(kWarning) << "ClientManager refused to start vault: "
+                << AdmissionRefusalString(static_cast<AdmissionRefusal>(response.refusal_reason()))
+                << (response.has_retry_after()
+                        ? ".  Retry after " + std::to_string(response.retry_after()) + " s."
+                        : ".");
+}
+
+void LogRefusal(const protobuf::StopVaultResponse& /*response*/) {}
+
+}  // unnamed namespace
+
 typedef std::function<void(bool)> VoidFunctionBoolParam;  // NOLINT (Philip)
 
 ClientController::ClientController(
@@ -370,6 +388,7 @@ void ClientController::HandleStartStopVaultResponse(
     return;
   }
 
+  LogRefusal(vault_response);
   callback(vault_response.result());
 }
 
@@ -18,8 +18,11 @@
 
 #include "maidsafe/client_manager/client_manager.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <thread>
 
 #include "boost/filesystem/path.hpp"
 #include "boost/filesystem/operations.hpp"
@@ -44,14 +47,61 @@ namespace maidsafe {
 
 namespace client_manager {
 
+namespace {
+
+void AdmissionThresholdsToProtobuf(const AdmissionThresholds& thresholds,
+                                   protobuf::AdmissionThresholds* pb_thresholds) {
+  pb_thresholds->set_min_available_memory(thresholds.min_available_memory);
+  pb_thresholds->set_max_load_per_cpu(thresholds.max_load_per_cpu);
+  pb_thresholds->set_max_vault_memory(thresholds.max_vault_memory);
+  pb_thresholds->set_retry_after(static_cast<uint32_t>(thresholds.retry_after.count()));
+}
+
+AdmissionThresholds AdmissionThresholdsFromProtobuf(
+    const protobuf::AdmissionThresholds& pb_thresholds) {
+  AdmissionThresholds thresholds;
+  thresholds.min_available_memory = pb_thresholds.min_available_memory();
+  thresholds.max_load_per_cpu = pb_thresholds.max_load_per_cpu();
+  thresholds.max_vault_memory = pb_thresholds.max_vault_memory();
+  thresholds.retry_after = std::chrono::seconds(pb_thresholds.retry_after());
+  return thresholds;
+}
+
+void AccountBudgetToProtobuf(const AccountBudget& budget, protobuf::AccountBudget* pb_budget) {
+  pb_budget->set_max_vaults(budget.max_vaults);
+  pb_budget->set_max_chunkstore_bytes(budget.max_chunkstore_bytes);
+  pb_budget->set_max_memory(budget.max_memory);
+  pb_budget->set_max_cpu(budget.max_cpu);
+}
+
+AccountBudget AccountBudgetFromProtobuf(const protobuf::AccountBudget& pb_budget) {
+  AccountBudget budget;
+  budget.max_vaults = pb_budget.max_vaults();
+  budget.max_chunkstore_bytes = pb_budget.max_chunkstore_bytes();
+  budget.max_memory = pb_budget.max_memory();
+  budget.max_cpu = pb_budget.max_cpu();
+  return budget;
+}
+
+}  // unnamed namespace
+
 ClientManager::VaultInfo::VaultInfo()
     : process_index(),
+      standby_process_index(ProcessManager::kInvalidIndex()),
+      retiring_process_index(ProcessManager::kInvalidIndex()),
+      account_name(),
       pmid(),
       chunkstore_path(),
+      storage_root(),
       vault_port(0),
       client_port(0),
+      standby_port(0),
       requested_to_run(false),
       joined_network(false),
+      standby_join_time(),
+      standby_deadline(),
+      retired_time(),
+      alternate_log(false),
 #ifdef TESTING
       identity_index(-1),
 #endif
@@ -61,6 +111,9 @@ ClientManager::VaultInfo::VaultInfo()
 void ClientManager::VaultInfo::ToProtobuf(protobuf::VaultInfo* pb_vault_info) const {
   pb_vault_info->set_pmid(passport::SerialisePmid(*pmid).string());
   pb_vault_info->set_chunkstore_path(chunkstore_path);
+  if (!storage_root.empty())
+    pb_vault_info->set_storage_root(storage_root);
+  pb_vault_info->set_account_name(account_name);
   pb_vault_info->set_requested_to_run(requested_to_run);
   pb_vault_info->set_version(vault_version);
 }
@@ -68,12 +121,14 @@ void ClientManager::VaultInfo::ToProtobuf(protobuf::VaultInfo* pb_vault_info) co
 void ClientManager::VaultInfo::FromProtobuf(const protobuf::VaultInfo& pb_vault_info) {
   pmid.reset(new passport::Pmid(passport::ParsePmid(NonEmptyString(pb_vault_info.pmid()))));
   chunkstore_path = pb_vault_info.chunkstore_path();
+  storage_root = pb_vault_info.storage_root();
+  account_name = pb_vault_info.account_name();
   requested_to_run = pb_vault_info.requested_to_run();
   vault_version = pb_vault_info.version();
 }
 
-ClientManager::ClientManager()
-    : process_manager_(),
+ClientManager::ClientManager(SpawnBackend spawn_backend, PlacementStrategy placement_strategy)
+    : process_manager_(spawn_backend),
       download_manager_(),
 #ifdef TESTING
       local_port_(detail::GetTestClientManagerPort() == 0
@@ -87,21 +142,49 @@ ClientManager::ClientManager()
       local_port_(kDefaultPort()),
       config_file_path_(GetSystemAppSupportDir() / detail::kGlobalConfigFilename),
 #endif
+      bootstrap_file_path_(config_file_path_.parent_path() / detail::kGlobalBootstrapFilename),
       latest_local_installer_path_(),
       vault_infos_(),
       vault_infos_mutex_(),
+      running_vaults_(),
+      handover_exits_(),
+      running_vaults_mutex_(),
+      admission_controller_(),
+      account_ledger_(),
+      storage_overspent_accounts_(),
+      vaults_awaiting_endpoints_(),
+      chunkstore_placer_(),
+      disk_usage_tracker_(),
+      upgrade_batch_size_(0),
+      rolling_upgrade_(),
+      upgrade_version_(),
+      artifact_store_(config_file_path_.parent_path() / "artifacts"),
       client_ports_and_versions_(),
       client_ports_mutex_(),
-      endpoints_(),
+      bootstrap_cache_(),
       config_file_mutex_(),
       need_to_stop_(false),
       asio_service_(3),
       update_interval_(kMinUpdateInterval()),
       update_mutex_(),
       update_timer_(asio_service_.service()),
+      budget_timer_(asio_service_.service()),
+      upgrade_timer_(asio_service_.service()),
+      bootstrap_prober_(
+          std::make_shared<BootstrapProber>(asio_service_.service(), bootstrap_cache_)),
+      bootstrap_refresher_(
+          std::make_shared<BootstrapRefresher>(asio_service_.service(), bootstrap_cache_,
+                                               [this] { return RefreshBootstrapEndpoints(); })),
       transport_(/*std::make_shared<LocalTcpTransport>(asio_service_.service())*/ nullptr),
       maid_(passport::Anmaid()),
-      initial_contact_memory_(maid_) {
+      initial_contact_memory_(maid_),
+      process_event_connection_(process_manager_.on_process_event().connect(
+          [this](const ProcessEvent & event) { HandleProcessEvent(event); })),
+      update_check_([this]()->bool {
+        UpdateExecutor();
+        return true;
+      }) {
+  process_manager_.SetPlacementStrategy(placement_strategy);
   //  WriteFile(GetUserAppDir() / "ServiceVersion.txt", kApplicationVersion());
   //  passport::Anmaid anmaid;
   //  passport::Maid maid(anmaid);
@@ -122,6 +205,7 @@ void ClientManager::Initialise() {
     LOG(kError) << "Transport reported error code: " << error;
   });
 
+  auto start_time(std::chrono::steady_clock::now());
   boost::system::error_code error_code;
   if (!fs::exists(config_file_path_, error_code) ||
       error_code.value() == boost::system::errc::no_such_file_or_directory) {
@@ -140,19 +224,39 @@ void ClientManager::Initialise() {
     LOG(kError) << "ClientManager failed to create a listening port. Shutting down.";
     Sleep(std::chrono::seconds(1));
   }
+  LOG(kInfo) << "Listening after " << std::chrono::duration_cast<std::chrono::milliseconds>(
+                                          std::chrono::steady_clock::now() - start_time).count()
+             << " ms";
 
-  UpdateExecutor();
+  // Vaults should start on the latest binary, so this first check is waited for.  Initialise isn't
+  // run on an io_service thread.
+  update_check_.Run().wait();
 
   ReadConfigFileAndStartVaults();
 
+  // Any vault or client asking for endpoints before this completes waits at most
+  // kMaxBootstrapWait() for it.
+  bootstrap_refresher_->FetchInBackground();
+
+  bootstrap_prober_->Start(kBootstrapProbeInterval(),
+                           [this] { bootstrap_cache_.WriteToFile(bootstrap_file_path_); });
+
   update_timer_.expires_from_now(update_interval_);
   update_timer_.async_wait([this](const boost::system::error_code &
                                   ec) { CheckForUpdates(ec); });  // NOLINT (Fraser)
+  budget_timer_.expires_from_now(bptime::milliseconds(kBudgetCheckInterval().count()));
+  budget_timer_.async_wait([this](const boost::system::error_code& ec) { EnforceBudgets(ec); });
 
   LOG(kInfo) << "ClientManager started";
 }
 
 ClientManager::~ClientManager() {
+  // This waits for any fetch in flight, since the refresher's fetch calls back into this object.
+  bootstrap_refresher_->Stop();
+  bootstrap_prober_->Stop();
+  update_timer_.cancel();
+  budget_timer_.cancel();
+  upgrade_timer_.cancel();
   //  std::cout << "~~~~~~~~~~~~~~~~~~~~~~ 1" << std::endl;
   //  need_to_stop_ = true;
   //  std::cout << "~~~~~~~~~~~~~~~~~~~~~~ 2" << std::endl;
@@ -182,14 +286,14 @@ void ClientManager::RestartClientManager(const std::string& /*latest_file*/,
 }
 
 bool ClientManager::CreateConfigFile() {
+  // Bootstrap info is fetched later by bootstrap_refresher_, so as not to delay startup.
   protobuf::ClientManagerConfig config;
   config.set_update_interval(update_interval_.total_seconds());
+  SaveBootstrapEndpoints(config.mutable_bootstrap_endpoints());
+  // The default thresholds are written out so that they can be found and edited.
+  AdmissionThresholdsToProtobuf(admission_controller_.thresholds(),
+                                config.mutable_admission_thresholds());
 
-  int count(0);
-  while (!ObtainBootstrapInformation(config) && count++ < 10) {
-    LOG(kError) << "Failed to obtain bootstrap information from server.";
-    //    return false;
-  }
   boost::system::error_code error_code;
   std::lock_guard<std::mutex> lock(config_file_mutex_);
   if (!fs::exists(config_file_path_.parent_path(), error_code)) {
@@ -210,36 +314,116 @@ bool ClientManager::CreateConfigFile() {
 }
 
 bool ClientManager::ReadConfigFileAndStartVaults() {
-  std::string content;
-  {
-    std::lock_guard<std::mutex> lock(config_file_mutex_);
-    if (!ReadFile(config_file_path_, &content)) {
-      LOG(kError) << "Failed to read config file " << config_file_path_;
-      return false;
-    }
-  }
   protobuf::ClientManagerConfig config;
-  if (!config.ParseFromString(content)) {
-    LOG(kError) << "Failed to parse config file " << config_file_path_;
+  if (!ReadFileToClientManagerConfig(config_file_path_, config))
     return false;
-  }
+  StartVaultsFromConfig(config);
+  return true;
+}
 
+void ClientManager::StartVaultsFromConfig(const protobuf::ClientManagerConfig& config) {
   update_interval_ = bptime::seconds(config.update_interval());
+  upgrade_batch_size_ = config.upgrade_batch_size();
+  if (config.has_admission_thresholds() &&
+      !admission_controller_.SetThresholds(
+          AdmissionThresholdsFromProtobuf(config.admission_thresholds()))) {
+    LOG(kWarning) << "Ignoring invalid admission thresholds in config file " << config_file_path_;
+  }
+  if (config.has_vault_permissions()) {
+    const protobuf::VaultPermissions& permissions(config.vault_permissions());
+    if (permissions.has_default_budget() &&
+        !account_ledger_.SetDefaultBudget(AccountBudgetFromProtobuf(permissions.default_budget())))
+      LOG(kWarning) << "Ignoring invalid default account budget in " << config_file_path_;
+    for (const auto& pb_budget : permissions.account_budgets()) {
+      if (!account_ledger_.SetBudget(pb_budget.account_name(),
+                                     AccountBudgetFromProtobuf(pb_budget)))
+        LOG(kWarning) << "Ignoring invalid account budget in " << config_file_path_;
+    }
+    bool cpu_budgeted(account_ledger_.default_budget().max_cpu != 0.0);
+    for (const auto& budget : account_ledger_.budgets())
+      cpu_budgeted = cpu_budgeted || budget.second.max_cpu != 0.0;
+    if (cpu_budgeted && !process_manager_.CpuLimitsAvailable()) {
+      LOG(kWarning) << "CPU limits can't be applied on this host, so accounts' CPU budgets won't "
+                    << "be enforced.";
+    }
+  }
+  std::vector<fs::path> storage_roots;
+  for (const auto& storage_root : config.storage_roots())
+    storage_roots.push_back(storage_root);
+  chunkstore_placer_.SetRoots(storage_roots);
+  // Every vault's chunkstore occupies its root, whether or not the vault is to be run.  This may be
+  // a re-read (e.g. after an update), in which case the vaults were already counted.
+  chunkstore_placer_.ClearVaults();
+  for (const auto& pb_vault_info : config.vault_info()) {
+    if (pb_vault_info.has_storage_root())
+      chunkstore_placer_.AddVault(pb_vault_info.storage_root());
+  }
 
-  protobuf::Bootstrap end_points(config.bootstrap_endpoints());
+  // The bootstrap file holds every endpoint learned since the config file was created.  If it's
+  // missing (e.g. on the first run after upgrading), seed it from the config file's list.
+  if (!bootstrap_cache_.ReadFromFile(bootstrap_file_path_) || bootstrap_cache_.Empty())
+    LoadBootstrapEndpoints(config.bootstrap_endpoints());
 
-  LoadBootstrapEndpoints(end_points);
+  StartRequestedVaults(config);
+}
 
+void ClientManager::StartRequestedVaults(const protobuf::ClientManagerConfig& config) {
+  std::vector<int> requested;
   for (int i(0); i != config.vault_info_size(); ++i) {
-    VaultInfoPtr vault_info(new VaultInfo);
-    vault_info->FromProtobuf(config.vault_info(i));
-    if (vault_info->requested_to_run) {
-      if (!StartVaultProcess(vault_info))
-        LOG(kError) << "Failed to start vault ID" << Base64Substr(vault_info->pmid->name().value);
-    }
+    if (config.vault_info(i).requested_to_run())
+      requested.push_back(i);
   }
+  if (requested.empty())
+    return;
 
-  return true;
+  // Parsing each PMID (and hence decoding its keys) dominates the cost here, so the entries are
+  // shared out across a pool of workers.  Each worker starts its vault as soon as that vault's keys
+  // are decoded rather than waiting for the whole config to be processed.  vault_infos_mutex_ is
+  // only held while the vault is registered and admitted, so workers don't queue behind each
+  // other's spawns.  An exception from one entry mustn't escape its worker thread, nor stop the
+  // other entries.
+  std::atomic<size_t> next(0);
+  auto hydrate_and_start([&] {
+    for (size_t n(next++); n < requested.size(); n = next++) {
+      try {
+        VaultInfoPtr vault_info(std::make_shared<VaultInfo>());
+        vault_info->FromProtobuf(config.vault_info(requested[n]));
+        if (vault_info->chunkstore_path.empty()) {
+          LOG(kError) << "Vault ID " << Base64Substr(vault_info->pmid->name().value)
+                      << " has no chunkstore path in config file.";
+          continue;
+        }
+        if (!AddVaultProcess(vault_info)) {
+          LOG(kError) << "Failed to start vault ID "
+                      << Base64Substr(vault_info->pmid->name().value);
+          continue;
+        }
+        {
+          // Admitting and charging together, under the lock, stops concurrent workers from each
+          // seeing room for one more of an account's vaults.
+          std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+          RegisterVault(vault_info);
+          if (!AdmitAndChargeVault(vault_info))
+            continue;
+        }
+        process_manager_.StartProcess(vault_info->process_index);
+      }
+      catch (const std::exception& e) {
+        LOG(kError) << "Failed to start vault " << requested[n] << " from config file: "
+                    << e.what();
+      }
+    }
+  });
+
+  size_t worker_count(std::min(requested.size(),
+                               static_cast<size_t>(std::max(std::thread::hardware_concurrency(),
+                                                            1U))));
+  std::vector<std::thread> workers;
+  for (size_t i(1); i < worker_count; ++i)
+    workers.emplace_back(hydrate_and_start);
+  hydrate_and_start();
+  for (auto& worker : workers)
+    worker.join();
 }
 
 bool ClientManager::WriteConfigFile() {
@@ -248,6 +432,19 @@ bool ClientManager::WriteConfigFile() {
     std::lock_guard<std::mutex> lock(update_mutex_);
     config.set_update_interval(update_interval_.total_seconds());
   }
+  AdmissionThresholdsToProtobuf(admission_controller_.thresholds(),
+                                config.mutable_admission_thresholds());
+  for (const auto& storage_root : chunkstore_placer_.roots())
+    config.add_storage_roots(storage_root.string());
+  config.set_upgrade_batch_size(upgrade_batch_size_);
+  SaveBootstrapEndpoints(config.mutable_bootstrap_endpoints());
+  protobuf::VaultPermissions* permissions(config.mutable_vault_permissions());
+  AccountBudgetToProtobuf(account_ledger_.default_budget(), permissions->mutable_default_budget());
+  for (const auto& budget : account_ledger_.budgets()) {
+    protobuf::AccountBudget* pb_budget(permissions->add_account_budgets());
+    pb_budget->set_account_name(budget.first);
+    AccountBudgetToProtobuf(budget.second, pb_budget);
+  }
   {
     std::lock_guard<std::mutex> lock(vault_infos_mutex_);
     for (auto& vault_info : vault_infos_) {
@@ -318,6 +515,12 @@ void ClientManager::HandleReceivedMessage(const std::string& message, Port peer_
     case MessageType::kBootstrapRequest:
       HandleBootstrapRequest(payload, response);
       break;
+    case MessageType::kVaultResourceUsageRequest:
+      HandleVaultResourceUsageRequest(payload, response);
+      break;
+    case MessageType::kVaultTakeoverConfirmation:
+      HandleVaultTakeoverConfirmation(payload);
+      return;
     default:
       return;
   }
@@ -339,26 +542,9 @@ void ClientManager::HandleClientRegistrationRequest(const std::string& request,
   }
 
   protobuf::ClientRegistrationResponse client_response;
-  if (endpoints_.empty()) {
-    protobuf::ClientManagerConfig config;
-    if (!ReadFileToClientManagerConfig(config_file_path_, config)) {
-      // TODO(Team): Should have counter for failures to trigger recreation?
-      LOG(kError) << "Failed to read & parse config file " << config_file_path_;
-    }
-    if (!ObtainBootstrapInformation(config)) {
-      LOG(kError) << "Failed to get endpoints from bootstrap server";
-    } else {
-      std::lock_guard<std::mutex> lock(config_file_mutex_);
-      if (!WriteFile(config_file_path_, config.SerializeAsString())) {
-        LOG(kError) << "Failed to write config file after obtaining bootstrap info.";
-      }
-    }
-  } else {
-    std::for_each(endpoints_.begin(), endpoints_.end(),
-                  [&client_response](const EndPoint & element) {
-      client_response.add_bootstrap_endpoint_ip(element.first);
-      client_response.add_bootstrap_endpoint_port(element.second);
-    });
+  for (const auto& endpoint : bootstrap_refresher_->Endpoints(kMaxBootstrapWait())) {
+    client_response.add_bootstrap_endpoint_ip(endpoint.first);
+    client_response.add_bootstrap_endpoint_port(endpoint.second);
   }
 
   LOG(kVerbose) << "Version that we might inform the user "
@@ -386,6 +572,15 @@ void ClientManager::HandleStartVaultRequest(const std::string& request, std::str
     response = detail::WrapMessage(MessageType::kStartVaultResponse,
                                    start_vault_response.SerializeAsString());
   });
+  auto refuse([&response](const AdmissionDecision& decision) {
+    protobuf::StartVaultResponse start_vault_response;
+    start_vault_response.set_result(false);
+    start_vault_response.set_refusal_reason(static_cast<int32_t>(decision.refusal));
+    if (decision.outcome == AdmissionDecision::Outcome::kDefer)
+      start_vault_response.set_retry_after(static_cast<uint32_t>(decision.retry_after.count()));
+    response = detail::WrapMessage(MessageType::kStartVaultResponse,
+                                   start_vault_response.SerializeAsString());
+  });
 
   uint16_t client_port(static_cast<uint16_t>(start_vault_request.client_port()));
   {
@@ -420,8 +615,15 @@ void ClientManager::HandleStartVaultRequest(const std::string& request, std::str
 
       if (!start_vault_request.credential_change()) {
         if (!(*itr)->joined_network) {
+          if (process_manager_.GetProcessStatus((*itr)->process_index) !=
+              ProcessStatus::kRunning) {
+            AdmissionDecision decision(AdmitVault((*itr)->account_name));
+            if (decision.outcome != AdmissionDecision::Outcome::kAdmit)
+              return refuse(decision);
+          }
           (*itr)->client_port = client_port;
           (*itr)->requested_to_run = true;
+          ChargeVault(*itr);
           process_manager_.StartProcess((*itr)->process_index);
         }
       } else {
@@ -438,18 +640,30 @@ void ClientManager::HandleStartVaultRequest(const std::string& request, std::str
       }
     } else {
       // The vault is not already registered.
+      AdmissionDecision decision(AdmitVault(start_vault_request.account_name()));
+      if (decision.outcome != AdmissionDecision::Outcome::kAdmit)
+        return refuse(decision);
       vault_info->pmid.reset(new passport::Pmid(request_pmid));
       vault_info->account_name = start_vault_request.account_name();
+      // Placement is done with vault_infos_mutex_ locked, so that concurrent requests each see the
+      // vaults placed by the others.
+      fs::path parent_path;
+      if (start_vault_request.has_chunkstore_path()) {
+        parent_path = start_vault_request.chunkstore_path();
+      } else if (!chunkstore_placer_.roots().empty()) {
+        parent_path = chunkstore_placer_.Choose();
+        if (parent_path.empty()) {
+          LOG(kError) << "No storage root has room for vault ID: "
+                      << Base64Substr(vault_info->pmid->name().value);
+          return set_response(false);
+        }
+        vault_info->storage_root = parent_path.string();
+      } else {
+        parent_path = config_file_path_.parent_path();
+      }
       bool exists(true);
       while (exists) {
-        std::string random_appendix(RandomAlphaNumericString(16));
-        if (start_vault_request.has_chunkstore_path()) {
-          vault_info->chunkstore_path =
-              (fs::path(start_vault_request.chunkstore_path()) / random_appendix).string();
-        } else {
-          vault_info->chunkstore_path =
-              (config_file_path_.parent_path() / random_appendix).string();
-        }
+        vault_info->chunkstore_path = (parent_path / RandomAlphaNumericString(16)).string();
         boost::system::error_code error_code;
         exists = fs::exists(vault_info->chunkstore_path, error_code);
       }
@@ -459,6 +673,8 @@ void ClientManager::HandleStartVaultRequest(const std::string& request, std::str
                     << Base64Substr(vault_info->pmid->name().value);
         return set_response(false);
       }
+      if (!vault_info->storage_root.empty())
+        chunkstore_placer_.AddVault(vault_info->storage_root);
     }
     if (!AmendVaultDetailsInConfigFile(vault_info, existing_vault)) {
       LOG(kError) << "Failed to amend details in config file for vault ID: "
@@ -481,50 +697,53 @@ void ClientManager::HandleVaultIdentityRequest(const std::string& request,
 
   protobuf::VaultIdentityResponse vault_identity_response;
   bool successful_response(false);
+  // Fetched before locking vault_infos_mutex_ so that other vaults' requests aren't held up while
+  // waiting on the bootstrap server.
+  std::vector<EndPoint> endpoints(bootstrap_refresher_->Endpoints(kMaxBootstrapWait()));
   std::lock_guard<std::mutex> lock(vault_infos_mutex_);
   NonEmptyString serialised_pmid;
   auto itr(FindFromProcessIndex(vault_identity_request.process_index()));
+  bool standby(false);
+  if (itr == vault_infos_.end()) {
+    itr = std::find_if(vault_infos_.begin(), vault_infos_.end(),
+                       [&vault_identity_request](const VaultInfoPtr& vault_info) {
+      return vault_info->standby_process_index == vault_identity_request.process_index();
+    });
+    standby = (itr != vault_infos_.end());
+  }
   if (itr == vault_infos_.end()) {
     LOG(kError) << "Vault with process_index " << vault_identity_request.process_index()
                 << " hasn't been added.";
     successful_response = false;
     // TODO(Team): Should this be dropped silently?
+  } else if (endpoints.empty()) {
+    LOG(kError) << "Failed to get endpoints for process_index "
+                << vault_identity_request.process_index();
+    successful_response = false;
+    // Without a reply the vault exits, and may be given up on before the endpoints arrive, so it's
+    // started again once they do.  The refresher keeps trying meanwhile.
+    if (!standby)
+      vaults_awaiting_endpoints_.insert(vault_identity_request.process_index());
+    bootstrap_refresher_->FetchInBackground();
   } else {
     serialised_pmid = passport::SerialisePmid(*(*itr)->pmid);
-    if (endpoints_.empty()) {
-      protobuf::ClientManagerConfig config;
-      if (!ReadFileToClientManagerConfig(config_file_path_, config)) {
-        // TODO(Team): Should have counter for failures to trigger recreation?
-        LOG(kError) << "Failed to read & parse config file " << config_file_path_;
-        successful_response = false;
-      }
-      if (!ObtainBootstrapInformation(config)) {
-        LOG(kError) << "Failed to get endpoints for process_index "
-                    << vault_identity_request.process_index();
-        successful_response = false;
-      } else {
-        std::lock_guard<std::mutex> lock(config_file_mutex_);
-        if (!WriteFile(config_file_path_, config.SerializeAsString())) {
-          LOG(kError) << "Failed to write config file after obtaining bootstrap info.";
-        } else {
-          successful_response = true;
-        }
-      }
-    } else {
-      successful_response = true;
-    }
+    successful_response = true;
   }
   if (successful_response) {
-    itr = FindFromProcessIndex(vault_identity_request.process_index());
+    vaults_awaiting_endpoints_.erase(vault_identity_request.process_index());
     vault_identity_response.set_pmid(serialised_pmid.string());
     vault_identity_response.set_chunkstore_path((*itr)->chunkstore_path);
-    (*itr)->vault_port = static_cast<uint16_t>(vault_identity_request.listening_port());
+    if (standby) {
+      vault_identity_response.set_standby(true);
+      (*itr)->standby_port = static_cast<uint16_t>(vault_identity_request.listening_port());
+    } else {
+      (*itr)->vault_port = static_cast<uint16_t>(vault_identity_request.listening_port());
+    }
     (*itr)->vault_version = vault_identity_request.version();
-    std::for_each(endpoints_.begin(), endpoints_.end(),
-                  [&vault_identity_response](const EndPoint & element) {
-      vault_identity_response.add_bootstrap_endpoint_ip(element.first);
-      vault_identity_response.add_bootstrap_endpoint_port(element.second);
-    });
+    for (const auto& endpoint : endpoints) {
+      vault_identity_response.add_bootstrap_endpoint_ip(endpoint.first);
+      vault_identity_response.add_bootstrap_endpoint_port(endpoint.second);
+    }
   } else {
     vault_identity_response.clear_pmid();
     vault_identity_response.clear_chunkstore_path();
@@ -549,15 +768,31 @@ void ClientManager::HandleVaultJoinedNetworkRequest(const std::string& request,
   auto itr(FindFromProcessIndex(vault_joined_network.process_index()));
   bool join_result(false);
   if (itr == vault_infos_.end()) {
+    itr = std::find_if(vault_infos_.begin(), vault_infos_.end(),
+                       [&vault_joined_network](const VaultInfoPtr& vault_info) {
+      return vault_info->standby_process_index == vault_joined_network.process_index();
+    });
+    if (itr != vault_infos_.end()) {
+      // The handover carries on from here.  The vault's join is reported once the standby has
+      // taken over.
+      if ((*itr)->retiring_process_index == ProcessManager::kInvalidIndex())
+        HandleStandbyJoined(*itr, vault_joined_network.joined());
+      vault_joined_network_ack.set_ack(true);
+      response = detail::WrapMessage(MessageType::kVaultIdentityResponse,
+                                     vault_joined_network_ack.SerializeAsString());
+      return;
+    }
     LOG(kError) << "Vault with process_index " << vault_joined_network.process_index()
                 << " hasn't been added.";
     join_result = false;
   } else {
     join_result = true;
     (*itr)->joined_network = vault_joined_network.joined();
+    if (rolling_upgrade_)
+      rolling_upgrade_->Joined((*itr)->process_index, (*itr)->joined_network);
   }
   vault_joined_network_ack.set_ack(join_result);
-  if ((*itr)->client_port != 0)
+  if (itr != vault_infos_.end() && (*itr)->client_port != 0)
     SendVaultJoinConfirmation((*itr)->pmid->name(), join_result);
   response = detail::WrapMessage(MessageType::kVaultIdentityResponse,
                                  vault_joined_network_ack.SerializeAsString());
@@ -575,23 +810,34 @@ void ClientManager::HandleStopVaultRequest(const std::string& request, std::stri
   passport::Pmid::Name pmid_name(Identity(stop_vault_request.identity()));
   asymm::PlainText data(stop_vault_request.data());
   asymm::Signature signature(stop_vault_request.signature());
-  std::lock_guard<std::mutex> lock(vault_infos_mutex_);
-  auto itr(FindFromPmidName(pmid_name));
-  if (itr == vault_infos_.end()) {
-    LOG(kError) << "Vault with identity " << Base64Substr(pmid_name.value) << " hasn't been added.";
-    stop_vault_response.set_result(false);
-  } else if (!asymm::CheckSignature(data, signature, (*itr)->pmid->public_key())) {
-    LOG(kError) << "Failure to validate request to stop vault ID " << Base64Substr(pmid_name.value);
-    stop_vault_response.set_result(false);
-  } else {
-    LOG(kInfo) << "Shutting down vault with identity " << Base64Substr(pmid_name.value);
-    stop_vault_response.set_result(StopVault(pmid_name, data, signature, true));
-    if (!AmendVaultDetailsInConfigFile(*itr, true)) {
-      LOG(kError) << "Failed to amend details in config file for vault ID: "
-                  << Base64Substr((*itr)->pmid->name().value);
+  bool stopping(false);
+  ProcessIndex process_index(0);
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    auto itr(FindFromPmidName(pmid_name));
+    if (itr == vault_infos_.end()) {
+      LOG(kError) << "Vault with identity " << Base64Substr(pmid_name.value)
+                  << " hasn't been added.";
+      stop_vault_response.set_result(false);
+    } else if (!asymm::CheckSignature(data, signature, (*itr)->pmid->public_key())) {
+      LOG(kError) << "Failure to validate request to stop vault ID "
+                  << Base64Substr(pmid_name.value);
       stop_vault_response.set_result(false);
+    } else {
+      LOG(kInfo) << "Shutting down vault with identity " << Base64Substr(pmid_name.value);
+      stopping = StopVault(pmid_name, data, signature, true);
+      process_index = (*itr)->process_index;
+      stop_vault_response.set_result(stopping);
+      if (!AmendVaultDetailsInConfigFile(*itr, true)) {
+        LOG(kError) << "Failed to amend details in config file for vault ID: "
+                    << Base64Substr((*itr)->pmid->name().value);
+        stop_vault_response.set_result(false);
+      }
     }
   }
+  // As in RestartVaults, the process is waited for without vault_infos_mutex_ locked.
+  if (stopping && !process_manager_.WaitForProcessToStop(process_index))
+    stop_vault_response.set_result(false);
   response =
       detail::WrapMessage(MessageType::kStopVaultResponse, stop_vault_response.SerializeAsString());
 }
@@ -644,28 +890,85 @@ void ClientManager::HandleBootstrapRequest(const std::string& request, std::stri
     LOG(kError) << "Failed to parse BootstrapRequest.";
     return;
   }
-  if (endpoints_.empty()) {
-    protobuf::ClientManagerConfig config;
-    if (!ReadFileToClientManagerConfig(config_file_path_, config)) {
-      // TODO(Team): Should have counter for failures to trigger recreation?
-      LOG(kError) << "Failed to read & parse config file " << config_file_path_;
+  for (const auto& endpoint : bootstrap_refresher_->Endpoints(kMaxBootstrapWait())) {
+    bootstrap_response.add_bootstrap_endpoint_ip(endpoint.first);
+    bootstrap_response.add_bootstrap_endpoint_port(endpoint.second);
+  }
+  response =
+      detail::WrapMessage(MessageType::kBootstrapResponse, bootstrap_response.SerializeAsString());
+}
+
+void ClientManager::HandleVaultResourceUsageRequest(const std::string& request,
+                                                    std::string& response) {
+  protobuf::VaultResourceUsageRequest usage_request;
+  protobuf::VaultResourceUsageResponse usage_response;
+  if (!usage_request.ParseFromString(request)) {
+    LOG(kError) << "Failed to parse VaultResourceUsageRequest.";
+    return;
+  }
+  std::unique_ptr<passport::Pmid::Name> pmid_name;
+  if (usage_request.has_identity())
+    pmid_name.reset(new passport::Pmid::Name(Identity(usage_request.identity())));
+  // Copied out so that neither process_manager_ nor disk_usage_tracker_ is called with
+  // vault_infos_mutex_ locked.
+  struct Vault {
+    std::string identity, chunkstore_path, storage_root;
+    ProcessIndex process_index;
+  };
+  std::vector<Vault> vaults;
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    for (const auto& vault_info : vault_infos_) {
+      if (!vault_info->pmid || (pmid_name && !(vault_info->pmid->name() == *pmid_name)))
+        continue;
+      Vault vault = {vault_info->pmid->name()->string(), vault_info->chunkstore_path,
+                     vault_info->storage_root, vault_info->process_index};
+      vaults.push_back(vault);
     }
-    if (!ObtainBootstrapInformation(config)) {
-      LOG(kError) << "Failed to get endpoints from bootstrap server";
-    } else {
-      if (!WriteFile(config_file_path_, config.SerializeAsString())) {
-        LOG(kError) << "Failed to write config file after obtaining bootstrap info.";
+  }
+  auto now(std::chrono::steady_clock::now());
+  std::map<std::string, DiskUsage> root_usages;
+  for (const auto& vault : vaults) {
+    protobuf::VaultResourceUsage* vault_usage(usage_response.add_vault_usage());
+    vault_usage->set_identity(vault.identity);
+    vault_usage->set_hang_count(process_manager_.GetHangCount(vault.process_index));
+    DiskUsage disk_usage;
+    if (disk_usage_tracker_.Usage(vault.chunkstore_path, disk_usage)) {
+      vault_usage->set_chunkstore_bytes(disk_usage.bytes);
+      vault_usage->set_chunkstore_files(disk_usage.files);
+      if (!vault.storage_root.empty()) {
+        DiskUsage& root_usage(root_usages[vault.storage_root]);
+        root_usage.bytes += disk_usage.bytes;
+        root_usage.files += disk_usage.files;
       }
     }
-  } else {
-    std::for_each(endpoints_.begin(), endpoints_.end(),
-                  [&bootstrap_response](const EndPoint & element) {
-      bootstrap_response.add_bootstrap_endpoint_ip(element.first);
-      bootstrap_response.add_bootstrap_endpoint_port(element.second);
-    });
+    for (const auto& sample : process_manager_.GetResourceSamples(vault.process_index)) {
+      protobuf::ResourceSample* pb_sample(vault_usage->add_samples());
+      pb_sample->set_age(
+          std::chrono::duration_cast<std::chrono::milliseconds>(now - sample.time).count());
+      pb_sample->set_cpu_time(sample.cpu_time.count());
+      pb_sample->set_rss(sample.rss);
+      pb_sample->set_swap(sample.swap);
+      pb_sample->set_read_bytes(sample.read_bytes);
+      pb_sample->set_write_bytes(sample.write_bytes);
+      pb_sample->set_context_switches(sample.context_switches);
+      pb_sample->set_open_fds(sample.open_fds);
+      pb_sample->set_threads(sample.threads);
+    }
   }
-  response =
-      detail::WrapMessage(MessageType::kBootstrapResponse, bootstrap_response.SerializeAsString());
+  if (!pmid_name) {
+    for (const auto& root : chunkstore_placer_.Usage()) {
+      protobuf::StorageRootUsage* root_usage(usage_response.add_root_usage());
+      const DiskUsage& disk_usage(root_usages[root.root.string()]);
+      root_usage->set_root(root.root.string());
+      root_usage->set_vault_count(static_cast<uint32_t>(root.vault_count));
+      root_usage->set_chunkstore_bytes(disk_usage.bytes);
+      root_usage->set_chunkstore_files(disk_usage.files);
+      root_usage->set_free_bytes(root.free_bytes);
+    }
+  }
+  response = detail::WrapMessage(MessageType::kVaultResourceUsageResponse,
+                                 usage_response.SerializeAsString());
 }
 
 bool ClientManager::SetUpdateInterval(const bptime::time_duration& update_interval) {
@@ -694,9 +997,12 @@ void ClientManager::CheckForUpdates(const boost::system::error_code& ec) {
     }
   }
 
-  UpdateExecutor();
+  if (update_check_.InFlight())
+    LOG(kInfo) << "Previous update check is still running.";
+  else
+    update_check_.Run();
 
-  update_timer_.expires_from_now(update_interval_);
+  update_timer_.expires_from_now(GetUpdateInterval());
   update_timer_.async_wait([this](const boost::system::error_code &
                                   ec) { CheckForUpdates(ec); });  // NOLINT (Fraser)
 }
@@ -851,6 +1157,11 @@ bool ClientManager::IsInstaller(const fs::path& path) {
 #endif
 
 void ClientManager::UpdateExecutor() {
+#ifdef TESTING
+  // A test environment runs the vault it was given rather than one from the server.
+  if (!detail::UsingDefaultEnvironment())
+    return;
+#endif
   std::vector<fs::path> updated_files;
   if (download_manager_.Update(updated_files) != kSuccess) {
     LOG(kVerbose) << "No update identified in the server.";
@@ -878,6 +1189,19 @@ void ClientManager::UpdateExecutor() {
     LOG(kInfo) << "No new vault exe.";
   }
 
+  // Kept for rolling back to later, since the downloads themselves are moved into place.  The
+  // vault is stored under kVaultName, which is how VaultExecutablePath looks it up.
+  const std::string kVersion(download_manager_.latest_remote_version());
+  std::map<std::string, fs::path> artifacts;
+  for (const auto& updated_file : updated_files) {
+    artifacts[updated_file == new_local_vault_path ? detail::kVaultName
+                                                   : updated_file.filename().string()] =
+        updated_file;
+  }
+  bool stored(!artifacts.empty() && artifact_store_.AddVersion(kVersion, artifacts));
+  if (!artifacts.empty() && !stored)
+    LOG(kWarning) << "Failed to store version " << kVersion << " for rollback.";
+
   //    WriteConfigFile();
   // #if defined MAIDSAFE_LINUX
   //  std::string command("dpkg -i " + latest_local_installer_path_.string());
@@ -902,18 +1226,423 @@ void ClientManager::UpdateExecutor() {
   }
 
   if (!new_local_vault_path.empty()) {
+    // The vaults are only ever run from the store (see VaultExecutablePath).
+    if (!stored) {
+      LOG(kError) << "Not updating vaults to version " << kVersion << " since it isn't stored.";
+      return;
+    }
+    if (upgrade_batch_size_ != 0) {
+      StartRollingUpgrade(kVersion);
+      return;
+    }
     StopAllVaults();
+    // The installed copy is only run if the store is lost.
     boost::system::error_code error_code;
     fs::rename(new_local_vault_path, GetAppInstallDir() / detail::kVaultName, error_code);
     if (error_code)
-      LOG(kError) << "Failed to move new vault executable.";
+      LOG(kWarning) << "Failed to move new vault executable.";
+    if (!ActivateVersion(kVersion))
+      LOG(kError) << "Failed to activate version " << kVersion << ".  Vaults will be restarted on "
+                  << "the previous one.";
 
+    if (!RestartVaultsFromConfigFile())
+      LOG(kError) << "Failed to restart vaults.";
+  }
+}
+
+bool ClientManager::RestartVaultsFromConfigFile() {
+  // The old vaults are only forgotten once the config is known to be readable, so that a bad file
+  // doesn't leave them all stopped and untracked.
+  protobuf::ClientManagerConfig config;
+  if (!ReadFileToClientManagerConfig(config_file_path_, config))
+    return false;
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    // The vaults are re-read under new process indices, so the old ones are forgotten.  Otherwise
+    // each stopped vault's chunkstore would still be counted toward its account alongside that of
+    // its new process, and would never be measured again.
+    for (const auto& vault_info : vault_infos_) {
+      account_ledger_.RemoveVault(vault_info->process_index);
+      if (!process_manager_.RemoveProcess(vault_info->process_index)) {
+        LOG(kWarning) << "Vault " << Base64Substr(vault_info->pmid->name().value)
+                      << " is still running under process_index " << vault_info->process_index;
+      }
+    }
+    vault_infos_.clear();
+    vaults_awaiting_endpoints_.clear();
+  }
+  StartVaultsFromConfig(config);
+  return true;
+}
+
+bool ClientManager::StartRollingUpgrade(const std::string& version) {
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    if (rolling_upgrade_) {
+      LOG(kWarning) << "Not upgrading to version " << version
+                    << " since an earlier upgrade is still in progress.";
+      return false;
+    }
+    // The previous version stays active until every vault has rejoined on the new one.
+    const fs::path kOldExecutable(VaultExecutablePath());
+    const fs::path kNewExecutable(artifact_store_.Path(version, detail::kVaultName));
+    if (kNewExecutable.empty()) {
+      LOG(kError) << "Version " << version << " has no vault executable stored.";
+      return false;
+    }
+
+    std::vector<ProcessIndex> running;
     {
-      std::lock_guard<std::mutex> lock(vault_infos_mutex_);
-      vault_infos_.clear();
+      std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+      for (const auto& vault_info : vault_infos_) {
+        if (running_vaults_.count(vault_info->process_index) != 0)
+          running.push_back(vault_info->process_index);
+      }
     }
-    if (!ReadConfigFileAndStartVaults())
-      LOG(kError) << "Failed to restart vaults.";
+    LOG(kInfo) << "Starting rolling upgrade of " << running.size() << " vault(s), "
+               << upgrade_batch_size_ << " at a time.";
+    rolling_upgrade_.reset(new detail::RollingUpgrade(kOldExecutable, kNewExecutable, running,
+                                                      upgrade_batch_size_, kUpgradeJoinTimeout()));
+    upgrade_version_ = version;
+  }
+  upgrade_timer_.expires_from_now(bptime::milliseconds(0));
+  upgrade_timer_.async_wait(
+      [this](const boost::system::error_code& ec) { ContinueRollingUpgrade(ec); });
+  return true;
+}
+
+void ClientManager::ContinueRollingUpgrade(const boost::system::error_code& ec) {
+  if (ec == boost::asio::error::operation_aborted)
+    return;
+  std::vector<ProcessIndex> process_indices;
+  bool roll_back(false);
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    if (!rolling_upgrade_)
+      return;
+    CheckStandbyDeadlines();
+    switch (rolling_upgrade_->Next(process_indices)) {
+      case detail::RollingUpgrade::Step::kWait:
+        break;
+      case detail::RollingUpgrade::Step::kUpgrade:
+        // Each vault of the batch is handed over to a standby, so that it's only offline while the
+        // standby takes over, rather than while a new process boots.
+        HandOverVaults(process_indices, rolling_upgrade_->new_executable());
+        break;
+      case detail::RollingUpgrade::Step::kRollBack:
+        // The previous version is still the active one.  Its binary may predate standby support,
+        // so the vaults are simply restarted on it.
+        LOG(kError) << "Upgrade to version " << upgrade_version_ << " failed.  Rolling "
+                    << process_indices.size() << " vault(s) back to version "
+                    << artifact_store_.ActiveVersion();
+        rolling_upgrade_.reset();
+        AbandonStandbys();
+        roll_back = true;
+        break;
+      case detail::RollingUpgrade::Step::kFinish:
+        // Every vault is now running the new version's binary from the store, so activating it is
+        // all that's left.
+        if (ActivateVersion(upgrade_version_)) {
+          LOG(kInfo) << "Rolling upgrade to version " << upgrade_version_ << " complete.";
+        } else {
+          LOG(kError) << "Failed to activate version " << upgrade_version_ << ".  Vaults will "
+                      << "carry on running it until they're next restarted.";
+        }
+        rolling_upgrade_.reset();
+        AbandonStandbys();
+        return;
+    }
+  }
+  if (roll_back) {
+    RestartVaults(process_indices, VaultExecutablePath());
+    return;
+  }
+  upgrade_timer_.expires_from_now(bptime::milliseconds(kUpgradeCheckInterval().count()));
+  upgrade_timer_.async_wait(
+      [this](const boost::system::error_code& ec) { ContinueRollingUpgrade(ec); });
+}
+
+bool ClientManager::ActivateVersion(const std::string& version) {
+  if (artifact_store_.Path(version, detail::kVaultName).empty()) {
+    LOG(kWarning) << "Version " << version << " has no vault executable stored.";
+    return false;
+  }
+  if (!artifact_store_.Activate(version))
+    return false;
+  // Collecting garbage walks every object in the store, and callers hold vault_infos_mutex_.
+  asio_service_.service().post([this] { artifact_store_.CollectGarbage(RetentionPolicy()); });
+  return true;
+}
+
+bool ClientManager::RollBack(const std::string& version) {
+  std::vector<ProcessIndex> process_indices;
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    if (rolling_upgrade_) {
+      LOG(kWarning) << "Not rolling back to version " << version
+                    << " since an upgrade is in progress.";
+      return false;
+    }
+    if (!ActivateVersion(version))
+      return false;
+    for (const auto& vault_info : vault_infos_)
+      process_indices.push_back(vault_info->process_index);
+  }
+  LOG(kInfo) << "Rolling " << process_indices.size() << " vault(s) back to version " << version;
+  RestartVaults(process_indices, VaultExecutablePath());
+  return true;
+}
+
+void ClientManager::HandOverVaults(const std::vector<ProcessIndex>& process_indices,
+                                   const fs::path& executable_path) {
+  const auto kDeadline(std::chrono::steady_clock::now() + kUpgradeJoinTimeout());
+  for (const auto& process_index : process_indices) {
+    auto itr(FindFromProcessIndex(process_index));
+    if (itr == vault_infos_.end())
+      continue;
+    bool running(false);
+    {
+      std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+      running = (running_vaults_.count(process_index) != 0);
+    }
+    if (!running) {
+      if (!process_manager_.SetExecutablePath(process_index, executable_path))
+        rolling_upgrade_->Joined(process_index, false);
+      else
+        rolling_upgrade_->Upgraded(process_index);
+      continue;
+    }
+    Process standby;
+    if (ConfigureVaultProcess(*itr, executable_path, true, standby))
+      (*itr)->standby_process_index = process_manager_.AddProcess(standby, local_port_);
+    if ((*itr)->standby_process_index == ProcessManager::kInvalidIndex()) {
+      LOG(kError) << "Failed to add standby for vault " << Base64Substr((*itr)->pmid->name().value);
+      rolling_upgrade_->Joined(process_index, false);
+      continue;
+    }
+    // The old process carries on while the standby boots and joins the network.
+    (*itr)->standby_port = 0;
+    (*itr)->standby_join_time = std::chrono::steady_clock::time_point();
+    (*itr)->standby_deadline = kDeadline;
+    process_manager_.StartProcess((*itr)->standby_process_index);
+  }
+}
+
+void ClientManager::HandleStandbyJoined(const VaultInfoPtr& vault_info, bool joined) {
+  if (!joined) {
+    LOG(kError) << "Standby for vault " << Base64Substr(vault_info->pmid->name().value)
+                << " failed to join the network.";
+    if (rolling_upgrade_)
+      rolling_upgrade_->Joined(vault_info->process_index, false);
+    AbandonStandby(vault_info);
+    return;
+  }
+  vault_info->standby_join_time = std::chrono::steady_clock::now();
+  // The vault may have been asked to stop for good, or the upgrade rolled back, meanwhile.
+  if (!vault_info->requested_to_run || !rolling_upgrade_) {
+    AbandonStandby(vault_info);
+    return;
+  }
+
+  // The standby takes over once the old process has exited (see HandleHandOverExit).  If it has
+  // already exited and isn't to be restarted, there's nothing to wait for.
+  const ProcessIndex kOldIndex(vault_info->process_index);
+  vault_info->retiring_process_index = kOldIndex;
+  {
+    std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+    handover_exits_.insert(kOldIndex);
+  }
+  asymm::PlainText random_data(RandomString(64));
+  asymm::Signature signature(asymm::Sign(random_data, vault_info->pmid->private_key()));
+  RequestVaultShutdown(vault_info, random_data, signature, false);
+  bool running(false);
+  {
+    std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+    running = (running_vaults_.count(kOldIndex) != 0);
+    if (!running)
+      handover_exits_.erase(kOldIndex);
+  }
+  // The process exited some time before, so the vault's unavailability is under-reported.
+  if (!running)
+    CompleteHandOver(vault_info, std::chrono::steady_clock::now());
+}
+
+void ClientManager::AbandonStandby(const VaultInfoPtr& vault_info) {
+  // The standby is removed once it has exited (see HandleHandOverExit).
+  {
+    std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+    handover_exits_.insert(vault_info->standby_process_index);
+  }
+  process_manager_.StopProcess(vault_info->standby_process_index);
+  vault_info->standby_process_index = ProcessManager::kInvalidIndex();
+  vault_info->standby_port = 0;
+}
+
+void ClientManager::AbandonStandbys() {
+  // Those which have joined are already taking over.
+  for (const auto& vault_info : vault_infos_) {
+    if (vault_info->standby_process_index != ProcessManager::kInvalidIndex() &&
+        vault_info->retiring_process_index == ProcessManager::kInvalidIndex())
+      AbandonStandby(vault_info);
+  }
+}
+
+void ClientManager::CheckStandbyDeadlines() {
+  auto now(std::chrono::steady_clock::now());
+  for (const auto& vault_info : vault_infos_) {
+    if (vault_info->standby_process_index == ProcessManager::kInvalidIndex() ||
+        vault_info->retiring_process_index != ProcessManager::kInvalidIndex() ||
+        now < vault_info->standby_deadline)
+      continue;
+    LOG(kError) << "Standby for vault " << Base64Substr(vault_info->pmid->name().value)
+                << " didn't join within " << kUpgradeJoinTimeout().count() << " ms.";
+    if (rolling_upgrade_)
+      rolling_upgrade_->Joined(vault_info->process_index, false);
+    AbandonStandby(vault_info);
+  }
+}
+
+void ClientManager::HandleHandOverExit(ProcessIndex process_index,
+                                       std::chrono::steady_clock::time_point exit_time) {
+  ProcessIndex rolled_back_index(ProcessManager::kInvalidIndex());
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    auto itr(std::find_if(vault_infos_.begin(), vault_infos_.end(),
+                          [process_index](const VaultInfoPtr& vault_info) {
+      return vault_info->retiring_process_index == process_index;
+    }));
+    if (itr == vault_infos_.end()) {
+      // An abandoned standby.
+      process_manager_.RemoveProcess(process_index);
+      return;
+    }
+    CompleteHandOver(*itr, exit_time);
+    // An upgrade rolled back while the old process was stopping has left the vault on the new
+    // binary.
+    if (!rolling_upgrade_ && (*itr)->requested_to_run)
+      rolled_back_index = (*itr)->process_index;
+  }
+  if (rolled_back_index != ProcessManager::kInvalidIndex())
+    RestartVaults(std::vector<ProcessIndex>(1, rolled_back_index), VaultExecutablePath());
+}
+
+void ClientManager::CompleteHandOver(const VaultInfoPtr& vault_info,
+                                     std::chrono::steady_clock::time_point exit_time) {
+  const ProcessIndex kOldIndex(vault_info->retiring_process_index);
+  process_manager_.RemoveProcess(kOldIndex);
+  LOG(kVerbose) << "Standby for vault " << Base64Substr(vault_info->pmid->name().value)
+                << " joined the network " << std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                 exit_time - vault_info->standby_join_time).count()
+                << " ms before the old process exited.";
+  vault_info->retired_time = exit_time;
+  vault_info->process_index = vault_info->standby_process_index;
+  vault_info->vault_port = vault_info->standby_port;
+  vault_info->standby_process_index = ProcessManager::kInvalidIndex();
+  vault_info->retiring_process_index = ProcessManager::kInvalidIndex();
+  vault_info->standby_port = 0;
+  vault_info->joined_network = true;
+  vault_info->alternate_log = !vault_info->alternate_log;
+  account_ledger_.RemoveVault(kOldIndex);
+  ChargeVault(vault_info);
+  if (rolling_upgrade_) {
+    rolling_upgrade_->ReplaceVault(kOldIndex, vault_info->process_index);
+    rolling_upgrade_->Joined(vault_info->process_index, true);
+  }
+  SendVaultTakeover(vault_info);
+  // The vault may have been asked to stop for good while its old process was stopping.
+  if (!vault_info->requested_to_run) {
+    asymm::PlainText random_data(RandomString(64));
+    asymm::Signature signature(asymm::Sign(random_data, vault_info->pmid->private_key()));
+    RequestVaultShutdown(vault_info, random_data, signature, true);
+  }
+}
+
+// The vault is unavailable from when its old process exits until the standby may use the
+// chunkstore.
+void ClientManager::HandleVaultTakeoverConfirmation(const std::string& message) {
+  protobuf::VaultTakeover vault_takeover;
+  if (!vault_takeover.ParseFromString(message)) {
+    LOG(kError) << "Failed to parse VaultTakeover.";
+    return;
+  }
+  auto now(std::chrono::steady_clock::now());
+  std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+  auto itr(FindFromProcessIndex(vault_takeover.process_index()));
+  if (itr == vault_infos_.end() ||
+      (*itr)->retired_time == std::chrono::steady_clock::time_point()) {
+    LOG(kWarning) << "Vault with process_index " << vault_takeover.process_index()
+                  << " confirmed a takeover it wasn't sent.";
+    return;
+  }
+  LOG(kInfo) << "Vault " << Base64Substr((*itr)->pmid->name().value) << " handed over.  It was "
+             << "unavailable for " << std::chrono::duration_cast<std::chrono::milliseconds>(
+                                          now - (*itr)->retired_time).count()
+             << " ms between its old process exiting and its replacement taking over.";
+  (*itr)->retired_time = std::chrono::steady_clock::time_point();
+}
+
+void ClientManager::SendVaultTakeover(const VaultInfoPtr& vault_info) {
+  protobuf::VaultTakeover vault_takeover;
+  vault_takeover.set_process_index(vault_info->process_index);
+  std::shared_ptr<LocalTcpTransport> sending_transport(
+      std::make_shared<LocalTcpTransport>(asio_service_.service()));
+  int result(0);
+  sending_transport->Connect(vault_info->vault_port, result);
+  if (result != kSuccess) {
+    LOG(kError) << "Failed to connect sending transport to vault.";
+    return;
+  }
+  sending_transport->Send(
+      detail::WrapMessage(MessageType::kVaultTakeover, vault_takeover.SerializeAsString()),
+      vault_info->vault_port);
+  LOG(kInfo) << "Sent takeover to vault on port " << vault_info->vault_port;
+}
+
+void ClientManager::RestartVaults(const std::vector<ProcessIndex>& process_indices,
+                                  const fs::path& executable_path) {
+  // As in StopAllVaults, the vaults are all asked to stop before waiting for any of them.
+  std::vector<std::pair<VaultInfoPtr, ProcessIndex>> stopping;
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    for (const auto& process_index : process_indices) {
+      auto itr(FindFromProcessIndex(process_index));
+      if (itr == vault_infos_.end())
+        continue;
+      if (!process_manager_.SetExecutablePath(process_index, executable_path)) {
+        LOG(kError) << "Failed to set executable path for: "
+                    << Base64Substr((*itr)->pmid->name().value);
+        continue;
+      }
+      {
+        std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+        if (running_vaults_.count(process_index) == 0)
+          continue;
+      }
+      asymm::PlainText random_data(RandomString(64));
+      asymm::Signature signature(asymm::Sign(random_data, (*itr)->pmid->private_key()));
+      RequestVaultShutdown(*itr, random_data, signature, false);
+      stopping.push_back(std::make_pair(*itr, process_index));
+    }
+  }
+
+  // As in HandOverVaults, the processes are waited for without vault_infos_mutex_ locked.
+  for (const auto& entry : stopping) {
+    if (!process_manager_.WaitForProcessToStop(entry.second)) {
+      LOG(kError) << "RestartVaults: failed to stop - "
+                  << Base64Substr(entry.first->pmid->name().value);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+  for (const auto& entry : stopping) {
+    const VaultInfoPtr& vault_info(entry.first);
+    // The vault may have been removed, or asked to stop for good, while it was stopping.
+    auto itr(FindFromProcessIndex(entry.second));
+    if (itr == vault_infos_.end() || *itr != vault_info || !vault_info->requested_to_run)
+      continue;
+    vault_info->joined_network = false;
+    if (AdmitAndChargeVault(vault_info))
+      process_manager_.StartProcess(entry.second);
   }
 }
 
@@ -937,6 +1666,181 @@ std::vector<ClientManager::VaultInfoPtr>::iterator ClientManager::FindFromProces
   });
 }
 
+AdmissionDecision ClientManager::AdmitVault(const std::string& account) const {
+  AdmissionDecision decision;
+  decision.refusal = account_ledger_.Admit(account);
+  if (decision.refusal != AdmissionRefusal::kNone) {
+    // Waiting won't help; one of the account's vaults must be stopped, or its budget raised.
+    decision.outcome = AdmissionDecision::Outcome::kReject;
+    return decision;
+  }
+  std::set<ProcessIndex> running_vaults;
+  {
+    std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+    running_vaults = running_vaults_;
+  }
+  uint64_t vault_memory(0);
+  for (const auto& index : running_vaults) {
+    std::vector<ResourceSample> samples(process_manager_.GetResourceSamples(index));
+    if (!samples.empty())
+      vault_memory += samples.back().rss;
+  }
+  return admission_controller_.Admit(vault_memory, running_vaults.size());
+}
+
+bool ClientManager::AdmitAndChargeVault(const VaultInfoPtr& vault_info) {
+  AdmissionDecision decision(AdmitVault(vault_info->account_name));
+  if (decision.outcome != AdmissionDecision::Outcome::kAdmit) {
+    LOG(kWarning) << "Not starting vault " << Base64Substr(vault_info->pmid->name().value)
+                  << " (" << AdmissionRefusalString(decision.refusal) << ").";
+    return false;
+  }
+  ChargeVault(vault_info);
+  return true;
+}
+
+void ClientManager::ChargeVault(const VaultInfoPtr& vault_info) {
+  account_ledger_.StartVault(vault_info->process_index, vault_info->account_name);
+  ApplyBudgetLimits(vault_info->account_name);
+}
+
+void ClientManager::ApplyBudgetLimits(const std::string& account) {
+  ResourceLimits limits(account_ledger_.VaultLimits(account));
+  if (limits.Empty())
+    return;
+  for (const auto& vault_info : vault_infos_) {
+    if (vault_info->account_name == account)
+      process_manager_.SetResourceLimits(vault_info->process_index, limits);
+  }
+}
+
+void ClientManager::EnforceBudgets(const boost::system::error_code& ec) {
+  if (ec == boost::asio::error::operation_aborted)
+    return;
+  std::set<ProcessIndex> running_vaults;
+  {
+    std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+    running_vaults = running_vaults_;
+  }
+  // Measuring the chunkstores and applying the limits can be slow, so only the vaults' details are
+  // copied under vault_infos_mutex_.  The ledger ignores any vault removed meanwhile.
+  struct VaultDetails {
+    ProcessIndex process_index;
+    std::string account_name, chunkstore_path;
+  };
+  std::vector<VaultDetails> vaults;
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    for (const auto& vault_info : vault_infos_) {
+      VaultDetails details = {vault_info->process_index, vault_info->account_name,
+                              vault_info->chunkstore_path};
+      vaults.push_back(details);
+    }
+  }
+  for (const auto& vault : vaults) {
+    VaultUsage usage;
+    DiskUsage disk_usage;
+    if (disk_usage_tracker_.Usage(vault.chunkstore_path, disk_usage))
+      usage.chunkstore_bytes = disk_usage.bytes;
+    if (running_vaults.count(vault.process_index) != 0) {
+      std::vector<ResourceSample> samples(process_manager_.GetResourceSamples(vault.process_index));
+      if (!samples.empty())
+        usage.memory = samples.back().rss;
+      if (samples.size() > 1) {
+        const ResourceSample& previous(samples[samples.size() - 2]);
+        std::chrono::duration<double> elapsed(samples.back().time - previous.time);
+        std::chrono::duration<double> cpu_time(samples.back().cpu_time - previous.cpu_time);
+        if (elapsed.count() > 0.0)
+          usage.cpu = cpu_time.count() / elapsed.count();
+      }
+    }
+    account_ledger_.SetVaultUsage(vault.process_index, usage);
+  }
+  // Stopped vaults' shares are handed back to the account's remaining vaults.
+  std::map<std::string, ResourceLimits> account_limits;
+  for (const auto& vault : vaults) {
+    auto itr(account_limits.find(vault.account_name));
+    if (itr == account_limits.end()) {
+      itr = account_limits.insert(std::make_pair(vault.account_name,
+                                                 account_ledger_.VaultLimits(vault.account_name)))
+                .first;
+    }
+    if (!itr->second.Empty())
+      process_manager_.SetResourceLimits(vault.process_index, itr->second);
+  }
+
+  // A stopped vault's chunkstore still counts, so stopping vaults can't bring an account back
+  // within its chunkstore budget; instead Admit refuses the account any further vaults until space
+  // is freed.  Memory is cured by stopping vaults, one per account each time, since stopping one
+  // may be enough.  The vaults are only marked as stopped under vault_infos_mutex_; their processes
+  // are stopped and the config file amended after it's unlocked.
+  struct Stopping {
+    ProcessIndex process_index;
+    uint16_t vault_port;
+    asymm::PlainText data;
+    asymm::Signature signature;
+    VaultInfoPtr config_details;
+  };
+  std::vector<Stopping> stopping;
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    std::set<std::string> storage_overspent;
+    for (const auto& overspent : account_ledger_.Overspent()) {
+      if (overspent.second == AdmissionRefusal::kAccountStorage) {
+        if (storage_overspent_accounts_.count(overspent.first) == 0) {
+          LOG(kWarning) << "Account " << overspent.first << " is over its chunkstore budget.  "
+                        << "No more of its vaults will be started until space is freed.";
+        }
+        storage_overspent.insert(overspent.first);
+        continue;
+      }
+      auto itr(std::find_if(vault_infos_.rbegin(), vault_infos_.rend(),
+                            [&](const VaultInfoPtr& vault_info) {
+        return vault_info->account_name == overspent.first && vault_info->requested_to_run &&
+               running_vaults.count(vault_info->process_index) != 0;
+      }));
+      if (itr == vault_infos_.rend())
+        continue;
+      LOG(kWarning) << "Stopping vault " << Base64Substr((*itr)->pmid->name().value)
+                    << " since account " << overspent.first << " is over budget ("
+                    << AdmissionRefusalString(overspent.second) << ").";
+      if (rolling_upgrade_)
+        rolling_upgrade_->RemoveVault((*itr)->process_index);
+      // The vault stays stopped, as if its owner had stopped it, so that it isn't started again
+      // only to be stopped once more.
+      (*itr)->requested_to_run = false;
+      account_ledger_.StopVault((*itr)->process_index);
+      // AmendVaultDetailsInConfigFile only reads these.
+      VaultInfoPtr config_details(std::make_shared<VaultInfo>());
+      config_details->pmid.reset(new passport::Pmid(*(*itr)->pmid));
+      config_details->chunkstore_path = (*itr)->chunkstore_path;
+      config_details->storage_root = (*itr)->storage_root;
+      config_details->account_name = (*itr)->account_name;
+      config_details->requested_to_run = false;
+      config_details->vault_version = (*itr)->vault_version;
+      asymm::PlainText random_data(RandomString(64));
+      Stopping stop = {(*itr)->process_index, (*itr)->vault_port, random_data,
+                       asymm::Sign(random_data, (*itr)->pmid->private_key()), config_details};
+      stopping.push_back(stop);
+    }
+    for (const auto& account : storage_overspent_accounts_) {
+      if (storage_overspent.count(account) == 0)
+        LOG(kInfo) << "Account " << account << " is back within its chunkstore budget.";
+    }
+    storage_overspent_accounts_.swap(storage_overspent);
+  }
+  for (const auto& stop : stopping) {
+    process_manager_.StopProcess(stop.process_index, true);
+    SendVaultShutdownRequest(stop.process_index, stop.vault_port, stop.data, stop.signature);
+    if (!AmendVaultDetailsInConfigFile(stop.config_details, true)) {
+      LOG(kError) << "Failed to amend details in config file for vault ID: "
+                  << Base64Substr(stop.config_details->pmid->name().value);
+    }
+  }
+  budget_timer_.expires_from_now(bptime::milliseconds(kBudgetCheckInterval().count()));
+  budget_timer_.async_wait([this](const boost::system::error_code& ec) { EnforceBudgets(ec); });
+}
+
 void ClientManager::RestartVault(const passport::Pmid::Name& pmid_name) {
   std::lock_guard<std::mutex> lock(vault_infos_mutex_);
   auto itr(FindFromPmidName(pmid_name));
@@ -944,12 +1848,11 @@ void ClientManager::RestartVault(const passport::Pmid::Name& pmid_name) {
     LOG(kError) << "Vault with identity " << Base64Substr(pmid_name.value) << " hasn't been added.";
     return;
   }
-  process_manager_.StartProcess((*itr)->process_index);
+  if (AdmitAndChargeVault(*itr))
+    process_manager_.StartProcess((*itr)->process_index);
 }
 
 // NOTE: vault_infos_mutex_ must be locked before calling this function.
-// TODO(Fraser#5#): 2012-08-17 - This is pretty heavy-handed - locking for duration of function.
-//                               Try to reduce lock scope eventually.
 bool ClientManager::StopVault(const passport::Pmid::Name& pmid_name,
                                  const asymm::PlainText& data, const asymm::Signature& signature,
                                  bool permanent) {
@@ -958,40 +1861,112 @@ bool ClientManager::StopVault(const passport::Pmid::Name& pmid_name,
     LOG(kError) << "Vault with identity " << Base64Substr(pmid_name.value) << " hasn't been added.";
     return false;
   }
-  (*itr)->requested_to_run = !permanent;
-  process_manager_.LetProcessDie((*itr)->process_index);
+  if (rolling_upgrade_)
+    rolling_upgrade_->RemoveVault((*itr)->process_index);
+  RequestVaultShutdown(*itr, data, signature, permanent);
+  return true;
+}
+
+// If the request can't be delivered, the process manager goes on to SIGTERM once the vault's
+// shutdown request stage has timed out.
+void ClientManager::RequestVaultShutdown(const VaultInfoPtr& vault_info,
+                                         const asymm::PlainText& data,
+                                         const asymm::Signature& signature, bool permanent) {
+  vault_info->requested_to_run = !permanent;
+  process_manager_.StopProcess(vault_info->process_index, true);
+  account_ledger_.StopVault(vault_info->process_index);
+  SendVaultShutdownRequest(vault_info->process_index, vault_info->vault_port, data, signature);
+}
+
+void ClientManager::SendVaultShutdownRequest(ProcessIndex process_index, uint16_t vault_port,
+                                             const asymm::PlainText& data,
+                                             const asymm::Signature& signature) {
   protobuf::VaultShutdownRequest vault_shutdown_request;
-  vault_shutdown_request.set_process_index((*itr)->process_index);
+  vault_shutdown_request.set_process_index(process_index);
   vault_shutdown_request.set_data(data.string());
   vault_shutdown_request.set_signature(signature.string());
   std::shared_ptr<LocalTcpTransport> sending_transport(
       std::make_shared<LocalTcpTransport>(asio_service_.service()));
   int result(0);
-  sending_transport->Connect((*itr)->vault_port, result);
+  sending_transport->Connect(vault_port, result);
   if (result != kSuccess) {
     LOG(kError) << "Failed to connect sending transport to vault.";
-    return false;
+    return;
   }
 
   sending_transport->Send(detail::WrapMessage(MessageType::kVaultShutdownRequest,
                                               vault_shutdown_request.SerializeAsString()),
-                          (*itr)->vault_port);
-  LOG(kInfo) << "Sent shutdown request to vault on port " << (*itr)->vault_port;
-  return process_manager_.WaitForProcessToStop((*itr)->process_index);
+                          vault_port);
+  LOG(kInfo) << "Sent shutdown request to vault on port " << vault_port;
 }
 
 void ClientManager::StopAllVaults() {
-  std::lock_guard<std::mutex> lock(vault_infos_mutex_);
-  std::for_each(vault_infos_.begin(), vault_infos_.end(), [this](const VaultInfoPtr & info) {
-    if (process_manager_.GetProcessStatus(info->process_index) != ProcessStatus::kRunning) {
-      return;
+  // Every vault is asked to stop before waiting for any of them, so they shut down concurrently.
+  std::vector<VaultInfoPtr> stopping;
+  {
+    std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+    for (const auto& info : vault_infos_) {
+      {
+        std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+        if (running_vaults_.count(info->process_index) == 0)
+          continue;
+      }
+      asymm::PlainText random_data(RandomString(64));
+      asymm::Signature signature(asymm::Sign(random_data, info->pmid->private_key()));
+      RequestVaultShutdown(info, random_data, signature, false);
+      stopping.push_back(info);
     }
-    asymm::PlainText random_data(RandomString(64));
-    asymm::Signature signature(asymm::Sign(random_data, info->pmid->private_key()));
-    if (!StopVault(info->pmid->name(), random_data, signature, false)) {
+  }
+  // As in RestartVaults, the processes are waited for without vault_infos_mutex_ locked.
+  for (const auto& info : stopping) {
+    if (!process_manager_.WaitForProcessToStop(info->process_index))
       LOG(kError) << "StopAllVaults: failed to stop - " << Base64Substr(info->pmid->name().value);
+  }
+}
+
+// Runs on ProcessManager's supervisor thread, so mustn't call back into process_manager_.
+void ClientManager::HandleProcessEvent(const ProcessEvent& event) {
+  switch (event.type) {
+    case ProcessEvent::Type::kSpawned: {
+      std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+      running_vaults_.insert(event.index);
+      break;
     }
-  });
+    case ProcessEvent::Type::kUnresponsive:
+      LOG(kError) << "Vault with process_index " << event.index << " is unresponsive (hang count "
+                  << event.hang_count << ").  Restarting it.";
+      break;
+    case ProcessEvent::Type::kExited: {
+      bool handover_exit(false);
+      {
+        std::lock_guard<std::mutex> lock(running_vaults_mutex_);
+        running_vaults_.erase(event.index);
+        handover_exit = (handover_exits_.erase(event.index) != 0);
+      }
+      // Completing the handover calls back into process_manager_, so isn't done on this thread.
+      if (handover_exit) {
+        ProcessIndex index(event.index);
+        auto exit_time(std::chrono::steady_clock::now());
+        asio_service_.service().post([this, index, exit_time] {
+          HandleHandOverExit(index, exit_time);
+        });
+      }
+      if (event.stop_stage == TerminationStage::kKill)
+        LOG(kWarning) << "Vault with process_index " << event.index << " had to be killed.";
+      else if (event.stop_stage == TerminationStage::kTerminate)
+        LOG(kWarning) << "Vault with process_index " << event.index << " had to be terminated.";
+      else if (event.exit_code != 0)
+        LOG(kWarning) << "Vault with process_index " << event.index << " exited with code "
+                      << event.exit_code;
+      break;
+    }
+    case ProcessEvent::Type::kGivenUp:
+      LOG(kError) << "Vault with process_index " << event.index << " will not be restarted.";
+      account_ledger_.StopVault(event.index);
+      break;
+    default:
+      break;
+  }
 }
 
 /*
@@ -1039,9 +2014,35 @@ void ClientManager::StopAllVaults() {
 //  }
 */
 
-bool ClientManager::ObtainBootstrapInformation(protobuf::ClientManagerConfig& config) {
-  protobuf::Bootstrap* bootstrap_list(config.mutable_bootstrap_endpoints());
+bool ClientManager::RefreshBootstrapEndpoints() {
+  if (!ObtainBootstrapInformation()) {
+    LOG(kError) << "Failed to get endpoints from bootstrap server";
+    return false;
+  }
+  // The prober's first round may well have run on an empty cache, so the new endpoints are ranked
+  // now rather than only after kBootstrapProbeInterval().
+  bootstrap_prober_->ProbeAll([this] { bootstrap_cache_.WriteToFile(bootstrap_file_path_); });
+  RestartVaultsAwaitingEndpoints();
+  return true;
+}
 
+void ClientManager::RestartVaultsAwaitingEndpoints() {
+  std::lock_guard<std::mutex> lock(vault_infos_mutex_);
+  for (const auto& process_index : vaults_awaiting_endpoints_) {
+    auto itr(FindFromProcessIndex(process_index));
+    // A vault which is running again (e.g. restarted by its restart policy) will get its identity.
+    if (itr == vault_infos_.end() || !(*itr)->requested_to_run ||
+        process_manager_.GetProcessStatus(process_index) == ProcessStatus::kRunning)
+      continue;
+    LOG(kInfo) << "Restarting vault " << Base64Substr((*itr)->pmid->name().value)
+               << " now that bootstrap endpoints are available.";
+    if (AdmitAndChargeVault(*itr))
+      process_manager_.StartProcess(process_index);
+  }
+  vaults_awaiting_endpoints_.clear();
+}
+
+bool ClientManager::ObtainBootstrapInformation() {
   protobuf::Bootstrap end_points;
 #ifdef TESTING
   if (detail::UsingDefaultEnvironment()) {
@@ -1056,6 +2057,7 @@ bool ClientManager::ObtainBootstrapInformation(protobuf::ClientManagerConfig& co
     }
 #ifdef TESTING
   } else {
+    Sleep(detail::BootstrapServerDelay());
     if (end_points.bootstrap_contacts_size() == 0) {
       if (detail::GetBootstrapIps().empty()) {
         protobuf::Endpoint* local_endpoint(end_points.add_bootstrap_contacts());
@@ -1072,46 +2074,67 @@ bool ClientManager::ObtainBootstrapInformation(protobuf::ClientManagerConfig& co
   }
 #endif
   LoadBootstrapEndpoints(end_points);
-
-  bootstrap_list->CopyFrom(end_points);
   return true;
 }
 
 void ClientManager::LoadBootstrapEndpoints(const protobuf::Bootstrap& end_points) {
-  int max_index(end_points.bootstrap_contacts_size());
-  std::lock_guard<std::mutex> lock(config_file_mutex_);
-  endpoints_.clear();
-  for (int n(0); n < max_index; ++n) {
-    std::string ip(end_points.bootstrap_contacts(n).ip());
-    uint16_t port(static_cast<uint16_t>(end_points.bootstrap_contacts(n).port()));
-    endpoints_.push_back(std::make_pair(ip, port));
+  // Add in reverse so that the first endpoint in the list ends up as the most recent in the cache.
+  for (int n(end_points.bootstrap_contacts_size() - 1); n >= 0; --n) {
+    bootstrap_cache_.Add(EndPoint(end_points.bootstrap_contacts(n).ip(),
+                                  static_cast<uint16_t>(end_points.bootstrap_contacts(n).port())));
   }
+  bootstrap_cache_.WriteToFile(bootstrap_file_path_);
 }
 
-bool ClientManager::StartVaultProcess(VaultInfoPtr& vault_info) {
-  Process process;
+void ClientManager::SaveBootstrapEndpoints(protobuf::Bootstrap* end_points) const {
+  end_points->Clear();
+  for (const auto& endpoint : bootstrap_cache_.Endpoints()) {
+    protobuf::Endpoint* contact(end_points->add_bootstrap_contacts());
+    contact->set_ip(endpoint.first);
+    contact->set_port(endpoint.second);
+  }
+}
+
+fs::path ClientManager::VaultExecutablePath() const {
+  // Vaults run straight from the store, so that rolling back only needs the version activated.
+  fs::path stored_path(artifact_store_.Path(artifact_store_.ActiveVersion(), detail::kVaultName));
+  if (!stored_path.empty())
+    return stored_path;
 #ifdef TESTING
   fs::path executable_path(detail::GetPathToVault());
   if (executable_path.empty())
     executable_path = fs::path(".");
-  std::string user_id;
 #ifdef MAIDSAFE_WIN32
   TCHAR file_name[MAX_PATH];
   if (GetModuleFileName(NULL, file_name, MAX_PATH))
     executable_path = fs::path(file_name).parent_path();
-#else
-  user_id = detail::GetUserId();
 #endif
 #else
   fs::path executable_path(GetAppInstallDir());
 #endif
-  if (!process.SetExecutablePath(executable_path / detail::kVaultName)) {
+  return executable_path / detail::kVaultName;
+}
+
+bool ClientManager::ConfigureVaultProcess(const VaultInfoPtr& vault_info,
+                                          const fs::path& executable_path, bool standby,
+                                          Process& process) {
+  if (!process.SetExecutablePath(executable_path)) {
     LOG(kError) << "Failed to set executable path for: "
                 << Base64Substr(vault_info->pmid->name().value);
     return false;
   }
   // --vmid argument is added automatically by process_manager_.AddProcess(...)
 
+  // Each vault's output is logged next to the config file, named after its chunkstore.  While it's
+  // being handed over, its standby logs to the other of its two files.
+  const std::string kLogName(fs::path(vault_info->chunkstore_path).filename().string());
+  process.SetOutputLogFile(config_file_path_.parent_path() / "logs" /
+                           (kLogName + (vault_info->alternate_log != standby ? ".alt" : "") +
+                            ".log"));
+
+  process.SetHeartbeatPolicy(
+      HeartbeatPolicy(kVaultHeartbeatTimeout(), kVaultStartupTimeout(), true));
+
   process.AddArgument("--start");
   process.AddArgument("--chunk_path " + vault_info->chunkstore_path);
 #if defined TESTING
@@ -1121,6 +2144,13 @@ bool ClientManager::StartVaultProcess(VaultInfoPtr& vault_info) {
 //  if (!user_id.empty())
 //    process.AddArgument("--usr_id " + user_id);
 #endif
+  return true;
+}
+
+bool ClientManager::AddVaultProcess(VaultInfoPtr& vault_info) {
+  Process process;
+  if (!ConfigureVaultProcess(vault_info, VaultExecutablePath(), false, process))
+    return false;
 
   LOG(kInfo) << "Process Name: " << process.name();
   vault_info->process_index = process_manager_.AddProcess(process, local_port_);
@@ -1128,8 +2158,22 @@ bool ClientManager::StartVaultProcess(VaultInfoPtr& vault_info) {
     LOG(kError) << "Error starting vault with ID: " << Base64Substr(vault_info->pmid->name().value);
     return false;
   }
+  return true;
+}
 
+void ClientManager::RegisterVault(const VaultInfoPtr& vault_info) {
   vault_infos_.push_back(vault_info);
+  // It's started on the old binary, so if an upgrade is under way, it's included in a later batch.
+  if (rolling_upgrade_)
+    rolling_upgrade_->AddVault(vault_info->process_index);
+  disk_usage_tracker_.Add(vault_info->chunkstore_path);
+}
+
+bool ClientManager::StartVaultProcess(VaultInfoPtr& vault_info) {
+  if (!AddVaultProcess(vault_info))
+    return false;
+  RegisterVault(vault_info);
+  ChargeVault(vault_info);
   process_manager_.StartProcess(vault_info->process_index);
   return true;
 }
@@ -1156,44 +2200,11 @@ bool ClientManager::ReadFileToClientManagerConfig(const fs::path& file_path,
 }
 
 bool ClientManager::AddBootstrapEndPoint(const std::string& ip, uint16_t port) {
-  std::unique_lock<std::mutex> lock(config_file_mutex_);
-  auto it(std::find_if(endpoints_.begin(), endpoints_.end(),
-                                               [&ip, &port](const EndPoint & element)->bool {
-    return element.first == ip && element.second == port;
-  }));
-
-  if (it == endpoints_.end()) {
-    endpoints_.push_back(std::make_pair(ip, port));
-    while (endpoints_.size() > 1000U) {  // TODO(Philip) add constant for max bootstrap file size
-      auto itr(endpoints_.begin());
-      endpoints_.erase(itr);
-    }
-    lock.unlock();
-    protobuf::ClientManagerConfig config;
-    if (!ReadFileToClientManagerConfig(config_file_path_, config)) {
-      // TODO(Team): Should have counter for failures to trigger recreation?
-      LOG(kError) << "Failed to read & parse config file " << config_file_path_;
-      return false;
-    }
-    protobuf::Bootstrap* eps = config.mutable_bootstrap_endpoints();
-    eps->Clear();
-    protobuf::Endpoint* node;
-    lock.lock();
-    for (const auto& elem : endpoints_) {
-      node = eps->add_bootstrap_contacts();
-      node->set_ip((elem).first);
-      node->set_port((elem).second);
-    }
-    if (!WriteFile(config_file_path_, config.SerializeAsString())) {
-      LOG(kError) << "Failed to write config file after adding endpoint.";
-      return false;
-    }
-    lock.unlock();
-  } else {
-    LOG(kInfo) << "Endpoint " << ip << ":" << port << " already in config file.";
+  if (!bootstrap_cache_.Add(EndPoint(ip, port))) {
+    LOG(kInfo) << "Endpoint " << ip << ":" << port << " already in bootstrap file.";
+    return true;
   }
-
-  return true;
+  return bootstrap_cache_.WriteToFile(bootstrap_file_path_);
 }
 
 bool ClientManager::AmendVaultDetailsInConfigFile(const VaultInfoPtr& vault_info,
@@ -1212,6 +2223,9 @@ bool ClientManager::AmendVaultDetailsInConfigFile(const VaultInfoPtr& vault_info
         protobuf::VaultInfo* p_info = config.mutable_vault_info(n);
         p_info->set_pmid(passport::SerialisePmid(*vault_info->pmid).string());
         p_info->set_chunkstore_path(vault_info->chunkstore_path);
+        if (!vault_info->storage_root.empty())
+          p_info->set_storage_root(vault_info->storage_root);
+        p_info->set_account_name(vault_info->account_name);
         p_info->set_requested_to_run(vault_info->requested_to_run);
         p_info->set_version(vault_info->vault_version);
         n = config.vault_info_size();
@@ -1221,6 +2235,9 @@ bool ClientManager::AmendVaultDetailsInConfigFile(const VaultInfoPtr& vault_info
     protobuf::VaultInfo* p_info = config.add_vault_info();
     p_info->set_pmid(passport::SerialisePmid(*vault_info->pmid).string());
     p_info->set_chunkstore_path(vault_info->chunkstore_path);
+    if (!vault_info->storage_root.empty())
+      p_info->set_storage_root(vault_info->storage_root);
+    p_info->set_account_name(vault_info->account_name);
     p_info->set_requested_to_run(true);
     p_info->set_version(kInvalidVersion);
     {
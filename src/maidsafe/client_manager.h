@@ -19,12 +19,14 @@
 #ifndef MAIDSAFE_CLIENT_MANAGER_CLIENT_MANAGER_H_
 #define MAIDSAFE_CLIENT_MANAGER_CLIENT_MANAGER_H_
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -32,6 +34,7 @@
 #include "boost/asio/deadline_timer.hpp"
 #include "boost/date_time/posix_time/posix_time_duration.hpp"
 #include "boost/filesystem/path.hpp"
+#include "boost/signals2/connection.hpp"
 #include "boost/thread/condition_variable.hpp"
 #include "boost/thread/mutex.hpp"
 #include "boost/thread/thread.hpp"
@@ -41,9 +44,19 @@
 
 #include "maidsafe/passport/types.h"
 
+#include "maidsafe/client_manager/account_budget.h"
+#include "maidsafe/client_manager/admission_controller.h"
+#include "maidsafe/client_manager/artifact_store.h"
+#include "maidsafe/client_manager/bootstrap_cache.h"
+#include "maidsafe/client_manager/bootstrap_prober.h"
+#include "maidsafe/client_manager/bootstrap_refresher.h"
+#include "maidsafe/client_manager/chunkstore_placer.h"
+#include "maidsafe/client_manager/disk_usage_tracker.h"
 #include "maidsafe/client_manager/download_manager.h"
 #include "maidsafe/client_manager/process_manager.h"
+#include "maidsafe/client_manager/rolling_upgrade.h"
 #include "maidsafe/client_manager/shared_memory_communication.h"
+#include "maidsafe/client_manager/single_flight.h"
 #include "maidsafe/client_manager/utils.h"
 #include "maidsafe/client_manager/vault_info.pb.h"
 
@@ -55,6 +68,12 @@ namespace detail {
 class Platform;
 }
 
+#ifdef TESTING
+namespace test {
+class ClientManagerTest;
+}
+#endif
+
 class LocalTcpTransport;
 
 enum class MessageType {
@@ -80,7 +99,11 @@ enum class MessageType {
   kNewVersionAvailable,
   kNewVersionAvailableAck,
   kBootstrapRequest,
-  kBootstrapResponse
+  kBootstrapResponse,
+  kVaultResourceUsageRequest,
+  kVaultResourceUsageResponse,
+  kVaultTakeover,
+  kVaultTakeoverConfirmation
 };
 
 // The ClientManager has several responsibilities:
@@ -90,7 +113,9 @@ enum class MessageType {
 // * Regularly checks for (and downloads) updated client or vault executables.
 class ClientManager {
  public:
-  ClientManager();
+  // 'spawn_backend' and 'placement_strategy' are passed to the ProcessManager running the vaults.
+  explicit ClientManager(SpawnBackend spawn_backend = SpawnBackend::kBoostProcess,
+                         PlacementStrategy placement_strategy = PlacementStrategy::kNone);
   ~ClientManager();
   static uint16_t kDefaultPort() { return kLivePort; }
   static uint16_t kMaxRangeAboveDefaultPort() { return 10; }
@@ -102,6 +127,27 @@ class ClientManager {
   static boost::posix_time::time_duration kMaxUpdateInterval() {
     return boost::posix_time::hours(24 * 7);
   }
+  static boost::posix_time::time_duration kBootstrapProbeInterval() {
+    return boost::posix_time::minutes(10);
+  }
+  // The longest a request handler waits for bootstrap info when none is cached.  Kept below the
+  // vaults' and clients' own response timeouts so they still get a (possibly empty) reply.
+  static std::chrono::milliseconds kMaxBootstrapWait() { return std::chrono::seconds(2); }
+  // A vault which fails to beat within these is restarted.  The startup timeout covers fetching
+  // its identity and joining the network, after which the vault's main loop beats.  A vault binary
+  // which never beats isn't watched.
+  static std::chrono::milliseconds kVaultHeartbeatTimeout() { return std::chrono::seconds(10); }
+  static std::chrono::milliseconds kVaultStartupTimeout() { return std::chrono::seconds(30); }
+  // How often the vaults' usage is measured against their accounts' budgets.
+  static std::chrono::milliseconds kBudgetCheckInterval() { return std::chrono::seconds(10); }
+  // During a rolling upgrade, how long each batch of vaults has to rejoin the network on the new
+  // binary before the upgrade is rolled back, and how often the batch is checked.
+  static std::chrono::milliseconds kUpgradeJoinTimeout() { return std::chrono::minutes(5); }
+  static std::chrono::milliseconds kUpgradeCheckInterval() { return std::chrono::seconds(1); }
+
+#ifdef TESTING
+  friend class test::ClientManagerTest;
+#endif
 
  private:
   typedef std::shared_ptr<LocalTcpTransport> TransportPtr;
@@ -109,19 +155,27 @@ class ClientManager {
     VaultInfo();
     void ToProtobuf(protobuf::VaultInfo* pb_vault_info) const;
     void FromProtobuf(const protobuf::VaultInfo& pb_vault_info);
-    ProcessIndex process_index;
+    // While the vault is being handed over, the replacement's process and listening port, and the
+    // old process once it has been asked to stop.
+    ProcessIndex process_index, standby_process_index, retiring_process_index;
     std::string account_name;
     std::unique_ptr<passport::Pmid> pmid;
-    std::string chunkstore_path;
-    uint16_t vault_port, client_port;
+    std::string chunkstore_path, storage_root;
+    uint16_t vault_port, client_port, standby_port;
     bool requested_to_run, joined_network;
+    // When the standby joined the network (default-constructed until it has), and by when it must.
+    // Once it has been told to take over, when the old process exited, so that the time the vault
+    // was unavailable can be measured when the standby confirms it has taken over.
+    std::chrono::steady_clock::time_point standby_join_time, standby_deadline, retired_time;
+    // Whether the current process logs to the vault's alternate output log.  A standby uses the
+    // other one, so that its output isn't mixed with that of the process it's replacing.
+    bool alternate_log;
 #ifdef TESTING
     int identity_index;
 #endif
     int vault_version;
   };
   typedef std::shared_ptr<VaultInfo> VaultInfoPtr;
-  typedef std::pair<std::string, uint16_t> EndPoint;
 
   ClientManager(const ClientManager&);
   ClientManager operator=(const ClientManager&);
@@ -133,6 +187,12 @@ class ClientManager {
   // Config file handling
   bool CreateConfigFile();
   bool ReadConfigFileAndStartVaults();
+  // Applies the config's settings, then starts the vaults requested to run.
+  void StartVaultsFromConfig(const protobuf::ClientManagerConfig& config);
+  // Forgets every vault, then starts those requested to run afresh from the config file.  Used once
+  // the vaults have all been stopped, e.g. to update them.
+  bool RestartVaultsFromConfigFile();
+  void StartRequestedVaults(const protobuf::ClientManagerConfig& config);
   bool WriteConfigFile();
   bool ReadFileToClientManagerConfig(const boost::filesystem::path& file_path,
                                         protobuf::ClientManagerConfig& config);
@@ -148,6 +208,7 @@ class ClientManager {
   void HandleSendEndpointToClientManagerRequest(const std::string& request,
                                                    std::string& response);
   void HandleBootstrapRequest(const std::string& request, std::string& response);
+  void HandleVaultResourceUsageRequest(const std::string& request, std::string& response);
 
   // Must be in range [kMinUpdateInterval, kMaxUpdateInterval]
   void HandleUpdateIntervalRequest(const std::string& request, std::string& response);
@@ -169,45 +230,171 @@ class ClientManager {
                                     std::function<void(bool)> callback);  // NOLINT (Philip)
 
   // Update handling
+  // Starts an update check on update_check_ and reschedules itself without waiting for the check,
+  // so that downloads never hold up an io_service thread.
   void CheckForUpdates(const boost::system::error_code& ec);
   bool IsInstaller(const boost::filesystem::path& path);
   void UpdateExecutor();
+  // Starts replacing the running vaults in batches of upgrade_batch_size_ with ones running the
+  // binary stored for 'version'.  Returns false if it isn't stored or an upgrade is already under
+  // way.
+  bool StartRollingUpgrade(const std::string& version);
+  // Makes 'version' the active one in artifact_store_, and so the one VaultExecutablePath returns,
+  // then posts dropping versions outside the retention policy to asio_service_.  Returns false if
+  // it has no vault stored.
+  bool ActivateVersion(const std::string& version);
+  // Activates 'version', which must already be stored, and restarts every vault on it.  Returns
+  // false if it can't be activated or a rolling upgrade is under way.
+  bool RollBack(const std::string& version);
+  void ContinueRollingUpgrade(const boost::system::error_code& ec);
+  // Points the vaults' processes at 'executable_path', and restarts those which are running.
+  // NOTE: vault_infos_mutex_ must not be locked when calling this function.  It isn't held while
+  // waiting for processes to stop, so that requests from clients and other vaults aren't held up.
+  void RestartVaults(const std::vector<ProcessIndex>& process_indices,
+                     const boost::filesystem::path& executable_path);
 
   // General
   bool InTestMode() const;
   std::vector<VaultInfoPtr>::iterator FindFromPmidName(const passport::Pmid::Name& pmid_name);
   std::vector<ClientManager::VaultInfoPtr>::iterator FindFromProcessIndex(
       ProcessIndex process_index);
+  // The active version's binary in artifact_store_, or the installed one if none is stored.
+  boost::filesystem::path VaultExecutablePath() const;
+  bool ConfigureVaultProcess(const VaultInfoPtr& vault_info,
+                             const boost::filesystem::path& executable_path, bool standby,
+                             Process& process);
+  // Adds a process for a vault not yet in vault_infos_ to process_manager_, without starting it, so
+  // needn't be called with vault_infos_mutex_ locked.
+  bool AddVaultProcess(VaultInfoPtr& vault_info);
+  // Adds the vault to vault_infos_, ready for its process to be started once it has been charged.
+  // NOTE: vault_infos_mutex_ must be locked when calling these functions.
+  void RegisterVault(const VaultInfoPtr& vault_info);
   bool StartVaultProcess(VaultInfoPtr& vault_info);
+  // Starts replacing each running vault of the upgrade's batch with a standby process running
+  // 'executable_path'.  Vaults not running just have their executable path changed.  Nothing is
+  // waited for: the old process is only asked to stop once the standby has joined the network
+  // (HandleStandbyJoined), so the vault stays on it throughout, and the standby takes over the
+  // chunkstore once the old process has exited (HandleHandOverExit).  A standby which fails to
+  // join, or doesn't within kUpgradeJoinTimeout() (CheckStandbyDeadlines), is abandoned and the
+  // vault is left running as it was.  Each outcome is reported to rolling_upgrade_.
+  // NOTE: vault_infos_mutex_ must be locked when calling this function and the four following.
+  void HandOverVaults(const std::vector<ProcessIndex>& process_indices,
+                      const boost::filesystem::path& executable_path);
+  void HandleStandbyJoined(const VaultInfoPtr& vault_info, bool joined);
+  void CheckStandbyDeadlines();
+  // Stops the vault's standby, which is removed from process_manager_ once it has exited.
+  void AbandonStandby(const VaultInfoPtr& vault_info);
+  // Abandons every standby which hasn't yet joined, once the upgrade is over.
+  void AbandonStandbys();
+  // Run on an io_service thread once a process in handover_exits_ has exited at 'exit_time'.
+  void HandleHandOverExit(ProcessIndex process_index,
+                          std::chrono::steady_clock::time_point exit_time);
+  // Moves the vault onto its standby, and removes its old process (which exited at 'exit_time')
+  // from process_manager_.
+  // NOTE: vault_infos_mutex_ must be locked when calling this function.
+  void CompleteHandOver(const VaultInfoPtr& vault_info,
+                        std::chrono::steady_clock::time_point exit_time);
+  void HandleVaultTakeoverConfirmation(const std::string& message);
+  void SendVaultTakeover(const VaultInfoPtr& vault_info);
+  // Decides whether the account may start another vault and, if so, whether the host can take it
+  // given the memory used by those running.
+  AdmissionDecision AdmitVault(const std::string& account) const;
+  // Counts the vault toward its account's budget, and shares the account's CPU and memory budgets
+  // between its vaults (including this one) before it's started.
+  // NOTE: vault_infos_mutex_ must be locked when calling these functions.
+  void ChargeVault(const VaultInfoPtr& vault_info);
+  // As for a client's request, checks the vault may be started before charging it.  Returns false,
+  // having logged why, if it's refused, in which case it's left recorded but not started.
+  bool AdmitAndChargeVault(const VaultInfoPtr& vault_info);
+  void ApplyBudgetLimits(const std::string& account);
+  // Runs every kBudgetCheckInterval(): updates the accounts' usage, re-shares their budgets, and
+  // stops the newest running vault of each account over its memory budget.  Accounts over their
+  // chunkstore budgets are only logged, since Admit already refuses them further vaults.  Locks
+  // vault_infos_mutex_ itself, only while reading or marking the vaults.
+  void EnforceBudgets(const boost::system::error_code& ec);
   void RestartVault(const passport::Pmid::Name& pmid_name);
+  // Asks the vault to shut down, returning false if it isn't known.  Doesn't wait for it to exit,
+  // so the caller can do so once vault_infos_mutex_ is unlocked.
   bool StopVault(const passport::Pmid::Name& pmid_name, const asymm::PlainText& data,
                  const asymm::Signature& signature, bool permanent);
+  // Starts stopping the vault's process, then asks the vault to shut down.  Doesn't wait for it to
+  // exit.
+  void RequestVaultShutdown(const VaultInfoPtr& vault_info, const asymm::PlainText& data,
+                            const asymm::Signature& signature, bool permanent);
+  // Doesn't need vault_infos_mutex_ locked.
+  void SendVaultShutdownRequest(ProcessIndex process_index, uint16_t vault_port,
+                                const asymm::PlainText& data, const asymm::Signature& signature);
   void StopAllVaults();
+  void HandleProcessEvent(const ProcessEvent& event);
   //  void EraseVault(const std::string& identity);
   //  int32_t ListVaults(bool select) const;
-  bool ObtainBootstrapInformation(protobuf::ClientManagerConfig& config);
+  // Adds the server's endpoints to bootstrap_cache_ and persists them to the bootstrap file.
+  bool ObtainBootstrapInformation();
+  // Fetches bootstrap info from the server.  Only ever run via bootstrap_refresher_ so that
+  // concurrent callers share a single request to the server.  The config file isn't rewritten; its
+  // copy of the list is only refreshed whenever the config is next written.  On success, starts a
+  // round of probing the endpoints without waiting for it.
+  bool RefreshBootstrapEndpoints();
+  // Starts those vaults refused their identities for want of bootstrap endpoints which aren't
+  // running, e.g. having been given up on by their restart policies.
+  void RestartVaultsAwaitingEndpoints();
   void LoadBootstrapEndpoints(const protobuf::Bootstrap& end_points);
+  // The config file's bootstrap list is required, so it's always written, from bootstrap_cache_
+  // (possibly empty).
+  void SaveBootstrapEndpoints(protobuf::Bootstrap* end_points) const;
   bool AddBootstrapEndPoint(const std::string& ip, uint16_t port);
   bool AmendVaultDetailsInConfigFile(const VaultInfoPtr& vault_info, bool existing_vault);
 
   ProcessManager process_manager_;
   DownloadManager download_manager_;
   uint16_t local_port_;
-  boost::filesystem::path config_file_path_, latest_local_installer_path_;
+  boost::filesystem::path config_file_path_, bootstrap_file_path_, latest_local_installer_path_;
   std::vector<VaultInfoPtr> vault_infos_;
   mutable std::mutex vault_infos_mutex_;
+  // Process indices of vaults currently running, as reported by process_manager_'s events.
+  std::set<ProcessIndex> running_vaults_;
+  // Processes whose exit moves a handover on: the old processes of vaults being handed over, and
+  // abandoned standbys.  Guarded by running_vaults_mutex_.
+  std::set<ProcessIndex> handover_exits_;
+  mutable std::mutex running_vaults_mutex_;
+  detail::AdmissionController admission_controller_;
+  detail::AccountLedger account_ledger_;
+  // Accounts found over their chunkstore budgets at the last check.  Guarded by vault_infos_mutex_.
+  std::set<std::string> storage_overspent_accounts_;
+  // Vaults whose last identity request couldn't be answered since there were no bootstrap
+  // endpoints.  Guarded by vault_infos_mutex_.
+  std::set<ProcessIndex> vaults_awaiting_endpoints_;
+  // Chooses where to put chunkstores when the client doesn't specify a path.  If no storage roots
+  // are configured, they are put in the config file's directory.
+  detail::ChunkstorePlacer chunkstore_placer_;
+  // Disk space used by each vault's chunkstore.
+  detail::DiskUsageTracker disk_usage_tracker_;
+  // If non-zero, a new vault binary is rolled out this many vaults at a time rather than by
+  // stopping and restarting them all.  rolling_upgrade_ is guarded by vault_infos_mutex_.
+  uint32_t upgrade_batch_size_;
+  std::unique_ptr<detail::RollingUpgrade> rolling_upgrade_;
+  // The version being rolled out, activated in artifact_store_ only once every vault runs it.
+  std::string upgrade_version_;
+  // Every version downloaded, shared with any other ClientManager on the host.
+  detail::ArtifactStore artifact_store_;
   std::map<uint16_t, int> client_ports_and_versions_;
   mutable std::mutex client_ports_mutex_;
-  std::vector<EndPoint> endpoints_;
+  BootstrapCache bootstrap_cache_;
   std::mutex config_file_mutex_;
   bool need_to_stop_;
   AsioService asio_service_;
   boost::posix_time::time_duration update_interval_;
   mutable std::mutex update_mutex_;
-  boost::asio::deadline_timer update_timer_;
+  boost::asio::deadline_timer update_timer_, budget_timer_, upgrade_timer_;
+  std::shared_ptr<BootstrapProber> bootstrap_prober_;
+  std::shared_ptr<BootstrapRefresher> bootstrap_refresher_;
   std::shared_ptr<LocalTcpTransport> transport_;
   passport::Maid maid_;
   SafeReadOnlySharedMemory initial_contact_memory_;
+  boost::signals2::scoped_connection process_event_connection_;
+  // Runs UpdateExecutor on its own thread.  Declared last so that it's destroyed first, waiting for
+  // any check in progress while the members it uses still exist.
+  SingleFlight<bool> update_check_;
 };
 
 }  // namespace client_manager
@@ -46,6 +46,15 @@ namespace po = boost::program_options;
 
 namespace {
 
+// How the vaults are launched and placed.  The defaults are ProcessManager's own.
+struct SupervisionOptions {
+  SupervisionOptions()
+      : spawn_backend(maidsafe::client_manager::SpawnBackend::kBoostProcess),
+        placement_strategy(maidsafe::client_manager::PlacementStrategy::kNone) {}
+  maidsafe::client_manager::SpawnBackend spawn_backend;
+  maidsafe::client_manager::PlacementStrategy placement_strategy;
+};
+
 std::mutex g_mutex;
 std::condition_variable g_cond_var;
 bool g_shutdown_service(false);
@@ -169,9 +178,12 @@ std::vector<boost::asio::ip::udp::endpoint> ParseIps(const std::string& paramete
 }
 #endif
 
-void HandleProgramOptions(int argc, char** argv) {
+SupervisionOptions HandleProgramOptions(int argc, char** argv) {
   po::options_description options_description("Allowed options");
   options_description.add_options()
+      ("spawn_backend", po::value<std::string>(),
+       "How vaults are launched: boost_process (default), posix_spawn or zygote")
+      ("numa_placement", "Confine each vault to one NUMA node, the nodes being used in turn")
 #ifdef TESTING
       ("port", po::value<int>(), "Listening port")("vault_path", po::value<std::string>(),
                                                    "Path to the vault executable including name")(
@@ -192,6 +204,23 @@ void HandleProgramOptions(int argc, char** argv) {
     BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::uninitialised));
   }
 
+  SupervisionOptions supervision_options;
+  if (variables_map.count("spawn_backend") != 0) {
+    std::string spawn_backend(variables_map["spawn_backend"].as<std::string>());
+    if (spawn_backend == "posix_spawn") {
+      supervision_options.spawn_backend = maidsafe::client_manager::SpawnBackend::kPosixSpawn;
+    } else if (spawn_backend == "zygote") {
+      supervision_options.spawn_backend = maidsafe::client_manager::SpawnBackend::kZygote;
+    } else if (spawn_backend != "boost_process") {
+      LOG(kError) << "Unknown spawn_backend " << spawn_backend;
+      BOOST_THROW_EXCEPTION(maidsafe::MakeError(maidsafe::CommonErrors::invalid_parameter));
+    }
+  }
+  if (variables_map.count("numa_placement") != 0) {
+    supervision_options.placement_strategy =
+        maidsafe::client_manager::PlacementStrategy::kRoundRobinNodes;
+  }
+
 #ifdef TESTING
   uint16_t port(maidsafe::client_manager::ClientManager::kDefaultPort() + 100);
   if (variables_map.count("port") != 0) {
@@ -215,6 +244,7 @@ void HandleProgramOptions(int argc, char** argv) {
   maidsafe::client_manager::detail::SetTestEnvironmentVariables(port, root_dir, path_to_vault,
                                                                    booststrap_ips);
 #endif
+  return supervision_options;
 }
 
 }  // unnamed namespace
@@ -224,9 +254,10 @@ int main(int argc, char** argv) {
 #ifdef MAIDSAFE_WIN32
 #ifdef TESTING
   try {
-    HandleProgramOptions(argc, argv);
+    SupervisionOptions supervision_options(HandleProgramOptions(argc, argv));
     if (SetConsoleCtrlHandler(reinterpret_cast<PHANDLER_ROUTINE>(CtrlHandler), TRUE)) {
-      maidsafe::client_manager::ClientManager client_manager;
+      maidsafe::client_manager::ClientManager client_manager(
+          supervision_options.spawn_backend, supervision_options.placement_strategy);
       std::unique_lock<std::mutex> lock(g_mutex);
       g_cond_var.wait(lock, [] { return g_shutdown_service; });  // NOLINT (Fraser)
     } else {
@@ -249,8 +280,9 @@ int main(int argc, char** argv) {
 #endif
 #else
   //  try {
-  HandleProgramOptions(argc, argv);
-  maidsafe::client_manager::ClientManager client_manager;
+  SupervisionOptions supervision_options(HandleProgramOptions(argc, argv));
+  maidsafe::client_manager::ClientManager client_manager(supervision_options.spawn_backend,
+                                                         supervision_options.placement_strategy);
   std::cout << "Successfully started client_mgr" << std::endl;
   signal(SIGINT, ShutDownClientManager);
   signal(SIGTERM, ShutDownClientManager);
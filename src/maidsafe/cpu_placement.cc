@@ -0,0 +1,173 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/cpu_placement.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "boost/filesystem/fstream.hpp"
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/log.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace {
+
+const uint32_t kMaxCpus(1024);
+
+std::vector<uint32_t> ReadCpuList(const fs::path& path) {
+  fs::ifstream file(path);
+  std::string cpu_list;
+  std::getline(file, cpu_list);
+  return detail::ParseCpuList(cpu_list);
+}
+
+}  // unnamed namespace
+
+bool CpuPlacement::IsValid() const {
+  if (std::any_of(cpus.begin(), cpus.end(), [](uint32_t cpu) { return cpu >= kMaxCpus; })) {
+    LOG(kError) << "CPU numbers must be less than " << kMaxCpus;
+    return false;
+  }
+  if (numa_node >= static_cast<int32_t>(kMaxCpus)) {
+    LOG(kError) << "NUMA node numbers must be less than " << kMaxCpus;
+    return false;
+  }
+  if (bind_memory && numa_node < 0) {
+    LOG(kError) << "Memory can only be bound to a NUMA node if one is given.";
+    return false;
+  }
+  return true;
+}
+
+namespace detail {
+
+std::vector<uint32_t> ParseCpuList(const std::string& cpu_list) {
+  std::vector<uint32_t> cpus;
+  std::istringstream ranges(cpu_list);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    range.erase(std::remove_if(range.begin(), range.end(), ::isspace), range.end());
+    if (range.empty())
+      continue;
+    unsigned long first(0), last(0);  // NOLINT (Fraser)
+    char* end(nullptr);
+    first = std::strtoul(range.c_str(), &end, 10);
+    if (end == range.c_str())
+      return std::vector<uint32_t>();
+    last = first;
+    if (*end == '-') {
+      const char* second(end + 1);
+      last = std::strtoul(second, &end, 10);
+      if (end == second)
+        return std::vector<uint32_t>();
+    }
+    if (*end != '\0' || last < first || last >= kMaxCpus)
+      return std::vector<uint32_t>();
+    for (auto cpu(first); cpu <= last; ++cpu)
+      cpus.push_back(static_cast<uint32_t>(cpu));
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+CpuTopology::CpuTopology(const fs::path& sysfs_root) : nodes_() {
+  boost::system::error_code ec;
+  fs::path node_dir(sysfs_root / "devices" / "system" / "node");
+  if (fs::is_directory(node_dir, ec)) {
+    for (fs::directory_iterator itr(node_dir, ec), end; !ec && itr != end; itr.increment(ec)) {
+      std::string name(itr->path().filename().string());
+      if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+          name.find_first_not_of("0123456789", 4) != std::string::npos)
+        continue;
+      // Memory-only nodes have an empty CPU list and are of no use for placement.
+      std::vector<uint32_t> cpus(ReadCpuList(itr->path() / "cpulist"));
+      if (!cpus.empty())
+        nodes_.emplace_back(static_cast<uint32_t>(std::stoul(name.substr(4))), std::move(cpus));
+    }
+  }
+  std::sort(nodes_.begin(), nodes_.end(),
+            [](const Node & lhs, const Node & rhs) { return lhs.id < rhs.id; });
+
+  if (nodes_.empty()) {
+    std::vector<uint32_t> cpus(ReadCpuList(sysfs_root / "devices" / "system" / "cpu" / "online"));
+    if (!cpus.empty())
+      nodes_.emplace_back(0, std::move(cpus));
+  }
+  if (nodes_.empty())
+    LOG(kWarning) << "Failed to read CPU topology from " << sysfs_root;
+}
+
+CpuPlacement CpuTopology::RoundRobin(size_t count) const {
+  CpuPlacement placement;
+  if (nodes_.empty())
+    return placement;
+  const Node& node(nodes_[count % nodes_.size()]);
+  placement.cpus = node.cpus;
+  placement.numa_node = static_cast<int32_t>(node.id);
+  return placement;
+}
+
+#ifdef MAIDSAFE_LINUX
+PlacementMasks::PlacementMasks(const CpuPlacement& placement)
+    : cpus_(), has_cpus_(!placement.cpus.empty()), memory_mode_(-1), nodes_() {
+  CPU_ZERO(&cpus_);
+  for (const auto& cpu : placement.cpus)
+    CPU_SET(cpu, &cpus_);
+  std::memset(nodes_, 0, sizeof(nodes_));
+  if (placement.numa_node >= 0 && static_cast<size_t>(placement.numa_node) < kMaxNodes) {
+    memory_mode_ = placement.bind_memory ? MPOL_BIND : MPOL_PREFERRED;
+    const size_t kBitsPerWord(8 * sizeof(nodes_[0]));
+    nodes_[placement.numa_node / kBitsPerWord] |= 1UL << (placement.numa_node % kBitsPerWord);
+  }
+}
+
+bool PlacementMasks::Apply() const {
+  bool result(true);
+  if (has_cpus_ && sched_setaffinity(0, sizeof(cpus_), &cpus_) != 0)
+    result = false;
+  // The kernel reads one bit fewer than 'maxnode' from the mask.
+  if (memory_mode_ != -1 &&
+      syscall(SYS_set_mempolicy, memory_mode_, nodes_, kMaxNodes + 1) != 0)
+    result = false;
+  return result;
+}
+#endif
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,112 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_CPU_PLACEMENT_H_
+#define MAIDSAFE_CLIENT_MANAGER_CPU_PLACEMENT_H_
+
+#ifdef MAIDSAFE_LINUX
+#include <sched.h>
+#endif
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+// Where a process's threads may run and from which NUMA node its memory is allocated.  An empty
+// 'cpus' leaves the inherited affinity in place, and a negative 'numa_node' leaves the default
+// (local allocation) memory policy.  Only applied on Linux.
+struct CpuPlacement {
+  CpuPlacement() : cpus(), numa_node(-1), bind_memory(false) {}
+  bool IsValid() const;
+  bool Empty() const { return cpus.empty() && numa_node < 0; }
+
+  std::vector<uint32_t> cpus;
+  int32_t numa_node;
+  // If true, allocations may only come from 'numa_node'; otherwise it is preferred but others are
+  // used once it is full.
+  bool bind_memory;
+};
+
+enum class PlacementStrategy {
+  // Processes are only placed if given an explicit CpuPlacement.
+  kNone,
+  // Each process without an explicit CpuPlacement is given all the CPUs of one NUMA node and
+  // prefers that node's memory, the nodes being assigned in turn.
+  kRoundRobinNodes
+};
+
+namespace detail {
+
+// Parses a kernel CPU or node list such as "0-3,8,10-11".  Returns an empty vector if invalid.
+std::vector<uint32_t> ParseCpuList(const std::string& cpu_list);
+
+// The NUMA nodes which have CPUs, as read from sysfs.  Machines without NUMA support are treated as
+// a single node holding every online CPU.
+class CpuTopology {
+ public:
+  struct Node {
+    Node(uint32_t id_in, std::vector<uint32_t> cpus_in) : id(id_in), cpus(std::move(cpus_in)) {}
+    uint32_t id;
+    std::vector<uint32_t> cpus;
+  };
+
+  // 'sysfs_root' is only overridden by tests.
+  explicit CpuTopology(const boost::filesystem::path& sysfs_root = "/sys");
+  const std::vector<Node>& nodes() const { return nodes_; }
+  // Returns the placement of the 'count'th process under PlacementStrategy::kRoundRobinNodes, or
+  // an empty placement if the topology couldn't be read.
+  CpuPlacement RoundRobin(size_t count) const;
+
+ private:
+  std::vector<Node> nodes_;
+};
+
+#ifdef MAIDSAFE_LINUX
+// A CpuPlacement converted to the form the kernel takes ahead of forking, so that the child only
+// has to make the system calls.
+class PlacementMasks {
+ public:
+  explicit PlacementMasks(const CpuPlacement& placement);
+  // Applies the placement to the calling process.  Only makes async-signal-safe calls, so may be
+  // used between fork and exec.
+  bool Apply() const;
+
+ private:
+  static const size_t kMaxNodes = 1024;
+  cpu_set_t cpus_;
+  bool has_cpus_;
+  int memory_mode_;
+  unsigned long nodes_[kMaxNodes / (8 * sizeof(unsigned long))];  // NOLINT (Fraser)
+};
+#endif
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_CPU_PLACEMENT_H_
@@ -0,0 +1,261 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/delta_update.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+namespace {
+
+// Long enough that chance matches between unrelated runs are rare and the index of the source stays
+// small; short enough to find the runs left between small edits.
+const size_t kBlockSize(32);
+const uint64_t kHashBase(1099511628211ULL);
+
+enum Operation : char {
+  kCopy = 'C',
+  kInsert = 'I'
+};
+
+void AppendNumber(uint64_t number, std::string& delta) {
+  while (number >= 0x80) {
+    delta.push_back(static_cast<char>((number & 0x7f) | 0x80));
+    number >>= 7;
+  }
+  delta.push_back(static_cast<char>(number));
+}
+
+bool ReadNumber(const std::string& delta, size_t& position, uint64_t& number) {
+  number = 0;
+  for (int shift(0); shift < 64 && position != delta.size(); shift += 7) {
+    unsigned char byte(static_cast<unsigned char>(delta[position++]));
+    number |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+void AppendInsert(const std::string& target, size_t begin, size_t end, std::string& delta) {
+  if (begin == end)
+    return;
+  delta.push_back(kInsert);
+  AppendNumber(end - begin, delta);
+  delta.append(target, begin, end - begin);
+}
+
+void AppendCopy(size_t offset, size_t length, std::string& delta) {
+  delta.push_back(kCopy);
+  AppendNumber(offset, delta);
+  AppendNumber(length, delta);
+}
+
+uint64_t BlockHash(const char* block) {
+  uint64_t hash(0);
+  for (size_t i(0); i != kBlockSize; ++i)
+    hash = hash * kHashBase + static_cast<unsigned char>(block[i]);
+  return hash;
+}
+
+std::string HashOf(const std::string& content) {
+  return crypto::Hash<crypto::SHA512>(content).string();
+}
+
+}  // unnamed namespace
+
+std::string CreateDelta(const std::string& source, const std::string& target) {
+  std::string delta;
+  AppendNumber(target.size(), delta);
+
+  // Only whole blocks of the source are indexed, but each offset in the target is looked up, so a
+  // run is found wherever it has moved to.
+  std::unordered_map<uint64_t, size_t> blocks;
+  for (size_t offset(0); offset + kBlockSize <= source.size(); offset += kBlockSize)
+    blocks.insert(std::make_pair(BlockHash(&source[offset]), offset));
+  uint64_t outgoing_factor(1);
+  for (size_t i(1); i != kBlockSize; ++i)
+    outgoing_factor *= kHashBase;
+
+  size_t position(0), literal_begin(0);
+  uint64_t hash(target.size() >= kBlockSize ? BlockHash(&target[0]) : 0);
+  while (position + kBlockSize <= target.size()) {
+    auto itr(blocks.find(hash));
+    if (itr != blocks.end() &&
+        std::memcmp(&source[itr->second], &target[position], kBlockSize) == 0) {
+      size_t source_offset(itr->second), length(kBlockSize);
+      while (position + length != target.size() && source_offset + length != source.size() &&
+             source[source_offset + length] == target[position + length]) {
+        ++length;
+      }
+      // The match may also extend back into bytes not yet copied.
+      while (position != literal_begin && source_offset != 0 &&
+             source[source_offset - 1] == target[position - 1]) {
+        --position;
+        --source_offset;
+        ++length;
+      }
+      AppendInsert(target, literal_begin, position, delta);
+      AppendCopy(source_offset, length, delta);
+      position += length;
+      literal_begin = position;
+      if (position + kBlockSize <= target.size())
+        hash = BlockHash(&target[position]);
+      continue;
+    }
+    if (position + kBlockSize != target.size()) {
+      hash = (hash - static_cast<unsigned char>(target[position]) * outgoing_factor) * kHashBase +
+             static_cast<unsigned char>(target[position + kBlockSize]);
+    }
+    ++position;
+  }
+  AppendInsert(target, literal_begin, target.size(), delta);
+  return delta;
+}
+
+bool ApplyDelta(const std::string& source, const std::string& delta, std::string& target) {
+  size_t position(0);
+  uint64_t target_size(0);
+  if (!ReadNumber(delta, position, target_size)) {
+    LOG(kError) << "Delta is truncated.";
+    return false;
+  }
+  target.clear();
+  // The size is only a hint until the delta has been checked to produce it.
+  target.reserve(static_cast<size_t>(std::min(target_size, static_cast<uint64_t>(delta.size()) +
+                                                               source.size())));
+  while (position != delta.size()) {
+    char operation(delta[position++]);
+    uint64_t offset(0), length(0);
+    if (operation == kCopy) {
+      if (!ReadNumber(delta, position, offset) || !ReadNumber(delta, position, length) ||
+          offset > source.size() || length > source.size() - offset) {
+        LOG(kError) << "Delta has an invalid copy.";
+        return false;
+      }
+      target.append(source, static_cast<size_t>(offset), static_cast<size_t>(length));
+    } else if (operation == kInsert) {
+      if (!ReadNumber(delta, position, length) || length > delta.size() - position) {
+        LOG(kError) << "Delta has an invalid insert.";
+        return false;
+      }
+      target.append(delta, position, static_cast<size_t>(length));
+      position += static_cast<size_t>(length);
+    } else {
+      LOG(kError) << "Delta has an unknown operation.";
+      return false;
+    }
+    if (target.size() > target_size) {
+      LOG(kError) << "Delta produces more than the " << target_size << " bytes expected.";
+      return false;
+    }
+  }
+  if (target.size() != target_size) {
+    LOG(kError) << "Delta produces " << target.size() << " bytes rather than " << target_size;
+    return false;
+  }
+  return true;
+}
+
+DeltaUpdater::DeltaUpdater(const asymm::PublicKey& public_key, UpdateFetcher fetcher,
+                           int parallelism)
+    : kPublicKey_(public_key),
+      fetcher_(std::move(fetcher)),
+      download_(fetcher_, parallelism),
+      bytes_fetched_(0) {}
+
+bool DeltaUpdater::ReadManifest(const std::string& serialised_signed_manifest,
+                                protobuf::UpdateManifest& manifest) const {
+  protobuf::SignedUpdateManifest signed_manifest;
+  if (!signed_manifest.ParseFromString(serialised_signed_manifest)) {
+    LOG(kError) << "Failed to parse signed update manifest.";
+    return false;
+  }
+  if (!asymm::CheckSignature(asymm::PlainText(signed_manifest.serialised_manifest()),
+                             asymm::Signature(signed_manifest.signature()), kPublicKey_)) {
+    LOG(kError) << "Update manifest has an invalid signature.";
+    return false;
+  }
+  if (!manifest.ParseFromString(signed_manifest.serialised_manifest())) {
+    LOG(kError) << "Failed to parse update manifest.";
+    return false;
+  }
+  return true;
+}
+
+bool DeltaUpdater::UpdateFile(const protobuf::UpdateFile& file, const fs::path& installed,
+                              const fs::path& target) {
+  std::string installed_content, content;
+  if (!ReadFile(installed, &installed_content) || !Patch(file, installed_content, content))
+    return download_.Download(file, target);
+  if (!WriteFile(target, content)) {
+    LOG(kError) << "Failed to write " << target;
+    return false;
+  }
+  return true;
+}
+
+bool DeltaUpdater::Patch(const protobuf::UpdateFile& file, const std::string& installed_content,
+                         std::string& content) {
+  std::string installed_hash(HashOf(installed_content));
+  if (installed_hash == file.hash()) {
+    content = installed_content;
+    return true;
+  }
+  for (const auto& delta_info : file.deltas()) {
+    if (delta_info.from_hash() != installed_hash)
+      continue;
+    std::string delta;
+    if (!fetcher_(delta_info.name(), 0, delta_info.size(), delta)) {
+      LOG(kWarning) << "Failed to fetch " << delta_info.name();
+      break;
+    }
+    bytes_fetched_ += delta.size();
+    if (!ApplyDelta(installed_content, delta, content) || HashOf(content) != file.hash()) {
+      LOG(kWarning) << "Patching " << file.name() << " with " << delta_info.name()
+                    << " didn't give the expected result.";
+      break;
+    }
+    LOG(kInfo) << "Updated " << file.name() << " by fetching a " << delta.size()
+               << " byte patch rather than " << file.size() << " bytes.";
+    return true;
+  }
+  LOG(kInfo) << "No usable patch for installed " << file.name() << "; fetching all of it.";
+  return false;
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,86 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_DELTA_UPDATE_H_
+#define MAIDSAFE_CLIENT_MANAGER_DELTA_UPDATE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/rsa.h"
+
+#include "maidsafe/client_manager/chunked_download.h"
+#include "maidsafe/client_manager/vault_info.pb.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+// Returns a patch which ApplyDelta turns 'source' into 'target' with.  Runs of 'target' found
+// anywhere in 'source' are copied from it, so code or data which has merely moved between versions
+// costs a few bytes rather than its length.  Everything else is carried in the patch.
+std::string CreateDelta(const std::string& source, const std::string& target);
+
+// Fails, leaving 'target' unspecified, if 'delta' is malformed or refers outside 'source'.
+bool ApplyDelta(const std::string& source, const std::string& delta, std::string& target);
+
+// Brings installed files up to the version given by a signed manifest.  Where the manifest lists a
+// delta against the installed file's hash, only that is fetched and patched; otherwise, or if
+// patching fails, the complete file is downloaded by a ChunkedDownload.  Either way, 'target' isn't
+// written unless the result matches the hashes in the manifest.
+class DeltaUpdater {
+ public:
+  DeltaUpdater(const asymm::PublicKey& public_key, UpdateFetcher fetcher,
+               int parallelism = ChunkedDownload::kDefaultParallelism());
+  // Fails if the manifest isn't signed by 'public_key'.
+  bool ReadManifest(const std::string& serialised_signed_manifest,
+                    protobuf::UpdateManifest& manifest) const;
+  // Writes the new version of 'file' to 'target'.  'installed' needn't exist.  A failed download of
+  // the complete file resumes on the next call for the same 'target'.
+  bool UpdateFile(const protobuf::UpdateFile& file, const boost::filesystem::path& installed,
+                  const boost::filesystem::path& target);
+  // Bytes of patches and files fetched so far, for reporting the savings.
+  uint64_t bytes_fetched() const { return bytes_fetched_ + download_.bytes_fetched(); }
+  void Stop() { download_.Stop(); }
+
+ private:
+  DeltaUpdater(const DeltaUpdater&);
+  DeltaUpdater& operator=(const DeltaUpdater&);
+  bool Patch(const protobuf::UpdateFile& file, const std::string& installed_content,
+             std::string& content);
+
+  const asymm::PublicKey kPublicKey_;
+  const UpdateFetcher fetcher_;
+  ChunkedDownload download_;
+  // Bytes of patches only; download_ counts the rest.
+  std::atomic<uint64_t> bytes_fetched_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_DELTA_UPDATE_H_
@@ -0,0 +1,471 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/disk_usage_tracker.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+#ifndef MAIDSAFE_WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+namespace {
+
+#ifdef MAIDSAFE_LINUX
+// Writes are only counted once the file is closed, which is when a chunk is complete.
+const uint32_t kWatchMask(IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+                          IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK);
+#endif
+
+void AddUsage(DiskUsage& total, const DiskUsage& usage) {
+  total.bytes += usage.bytes;
+  total.files += usage.files;
+}
+
+// Saturates, so that a total which has drifted can't wrap round.
+void SubtractUsage(DiskUsage& total, const DiskUsage& usage) {
+  total.bytes -= std::min(total.bytes, usage.bytes);
+  total.files -= std::min(total.files, usage.files);
+}
+
+}  // unnamed namespace
+
+bool ScanDirectory(const fs::path& directory, DiskUsage& usage,
+                   std::vector<fs::path>& subdirectories) {
+#ifdef MAIDSAFE_WIN32
+  boost::system::error_code error_code;
+  fs::directory_iterator itr(directory, error_code), end;
+  if (error_code)
+    return false;
+  for (; itr != end; itr.increment(error_code)) {
+    if (error_code)
+      break;
+    fs::file_status status(itr->symlink_status(error_code));
+    if (fs::is_directory(status)) {
+      subdirectories.push_back(itr->path());
+    } else if (fs::is_regular_file(status)) {
+      ++usage.files;
+      usage.bytes += fs::file_size(itr->path(), error_code);
+    }
+  }
+  return true;
+#else
+  int fd(open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+  if (fd == -1)
+    return false;
+  DIR* dir(fdopendir(fd));
+  if (!dir) {
+    close(fd);
+    return false;
+  }
+  while (dirent* entry = readdir(dir)) {
+    if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+      continue;
+    // Most filesystems give the type in the entry, which saves a stat call per subdirectory.
+    if (entry->d_type == DT_DIR) {
+      subdirectories.push_back(directory / entry->d_name);
+      continue;
+    }
+    struct stat status;
+    if (fstatat(fd, entry->d_name, &status, AT_SYMLINK_NOFOLLOW) != 0)
+      continue;  // Deleted since being listed.
+    if (S_ISDIR(status.st_mode)) {
+      subdirectories.push_back(directory / entry->d_name);
+    } else if (S_ISREG(status.st_mode)) {
+      ++usage.files;
+      usage.bytes += static_cast<uint64_t>(status.st_blocks) * 512;
+    }
+  }
+  closedir(dir);
+  return true;
+#endif
+}
+
+DiskUsageTracker::DiskUsageTracker(unsigned scan_threads,
+                                   std::chrono::milliseconds coalesce_interval,
+                                   std::chrono::milliseconds rescan_interval)
+    : kScanThreads_(std::max(scan_threads, 1U)),
+      kCoalesceInterval_(coalesce_interval),
+      kRescanInterval_(rescan_interval),
+      trees_(),
+      directories_(),
+      dirty_(),
+      dirty_since_(),
+      mutex_(),
+      cond_var_(),
+      stop_(false),
+#ifdef MAIDSAFE_LINUX
+      inotify_fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+      event_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+#else
+      inotify_fd_(-1),
+      event_fd_(-1),
+#endif
+      worker_() {
+#ifdef MAIDSAFE_LINUX
+  if (event_fd_ == -1) {
+    LOG(kError) << "Failed to create eventfd.";
+    if (inotify_fd_ != -1)
+      close(inotify_fd_);
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::unable_to_handle_request));
+  }
+  if (inotify_fd_ == -1) {
+    LOG(kWarning) << "Failed to initialise inotify (" << std::strerror(errno)
+                  << "), so disk usage will only be updated by rescans.";
+  }
+#endif
+  worker_ = boost::thread([this] { Run(); });
+}
+
+DiskUsageTracker::~DiskUsageTracker() {
+  stop_ = true;
+  Wake();
+  worker_.join();
+#ifdef MAIDSAFE_LINUX
+  if (inotify_fd_ != -1)
+    close(inotify_fd_);
+  close(event_fd_);
+#endif
+}
+
+unsigned DiskUsageTracker::kDefaultScanThreads() {
+  // Scanning is mostly waiting on the disk, so a few threads help even on a single core, but too
+  // many just contend.
+  return std::min(std::max(std::thread::hardware_concurrency(), 2U), 8U);
+}
+
+void DiskUsageTracker::Add(const fs::path& root) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!trees_.insert(std::make_pair(root, Tree())).second)
+      return;
+  }
+  Wake();
+}
+
+bool DiskUsageTracker::Usage(const fs::path& root, DiskUsage& usage) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(trees_.find(root));
+  if (itr == trees_.end() || !itr->second.scanned)
+    return false;
+  usage = itr->second.usage;
+  return true;
+}
+
+void DiskUsageTracker::Run() {
+  NewDirectories new_directories;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    TimePoint now(std::chrono::steady_clock::now()), deadline(TimePoint::max());
+    auto due(trees_.end());
+    for (auto itr(trees_.begin()); itr != trees_.end(); ++itr) {
+      if (itr->second.next_scan <= now) {
+        due = itr;
+        break;
+      }
+      deadline = std::min(deadline, itr->second.next_scan);
+    }
+    if (due != trees_.end()) {
+      const fs::path root(due->first);
+      due->second.next_scan = TimePoint::max();
+      lock.unlock();
+      ScanResult result(ScanTree(root, kScanThreads_));
+      lock.lock();
+      ApplyScan(root, result, true);
+      continue;
+    }
+    if (!new_directories.empty()) {
+      const std::pair<fs::path, fs::path> new_directory(new_directories.back());
+      new_directories.pop_back();
+      lock.unlock();
+      ScanResult result(ScanTree(new_directory.second, 1));
+      lock.lock();
+      ApplyScan(new_directory.first, result, false);
+      continue;
+    }
+    if (!dirty_.empty()) {
+      if (dirty_since_ + kCoalesceInterval_ <= now) {
+        ListDirty(lock);
+        continue;
+      }
+      deadline = std::min(deadline, dirty_since_ + kCoalesceInterval_);
+    }
+    Wait(lock, deadline);
+    ReadEvents(new_directories);
+  }
+}
+
+void DiskUsageTracker::Wait(std::unique_lock<std::mutex>& lock, TimePoint deadline) {
+#ifdef MAIDSAFE_LINUX
+  int timeout(-1);
+  if (deadline != TimePoint::max()) {
+    // Rounded up, so as not to wake just before the deadline.
+    int64_t remaining(std::chrono::duration_cast<std::chrono::milliseconds>(
+                          deadline - std::chrono::steady_clock::now()).count() + 1);
+    timeout = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(remaining, INT_MAX)));
+  }
+  lock.unlock();
+  pollfd fds[2] = {{event_fd_, POLLIN, 0}, {inotify_fd_, POLLIN, 0}};
+  if (poll(fds, inotify_fd_ == -1 ? 1 : 2, timeout) == -1 && errno != EINTR)
+    LOG(kError) << "Failed waiting for filesystem events: " << std::strerror(errno);
+  uint64_t value(0);
+  while (read(event_fd_, &value, sizeof(value)) > 0) {}
+  lock.lock();
+#else
+  if (deadline == TimePoint::max())
+    cond_var_.wait(lock);
+  else
+    cond_var_.wait_until(lock, deadline);
+#endif
+}
+
+void DiskUsageTracker::Wake() {
+#ifdef MAIDSAFE_LINUX
+  uint64_t value(1);
+  if (write(event_fd_, &value, sizeof(value)) == -1)
+    LOG(kError) << "Failed to wake disk usage tracker.";
+#else
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  cond_var_.notify_one();
+#endif
+}
+
+DiskUsageTracker::ScanResult DiskUsageTracker::ScanTree(const fs::path& root,
+                                                        unsigned thread_count) const {
+  ScanResult result;
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<fs::path> pending(1, root);
+  unsigned busy(0);
+  auto scan([&] {
+    std::vector<fs::path> subdirectories;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      cond_var.wait(lock, [&] { return !pending.empty() || busy == 0; });
+      if (pending.empty() || stop_)
+        return;
+      const fs::path directory(pending.back());
+      pending.pop_back();
+      ++busy;
+      lock.unlock();
+      int watch(-1), watch_error(0);
+#ifdef MAIDSAFE_LINUX
+      if (inotify_fd_ != -1) {
+        watch = inotify_add_watch(inotify_fd_, directory.c_str(), kWatchMask);
+        if (watch == -1)
+          watch_error = errno;
+      }
+#endif
+      DiskUsage usage;
+      subdirectories.clear();
+      bool listed(ScanDirectory(directory, usage, subdirectories));
+#ifdef MAIDSAFE_LINUX
+      if (!listed && watch != -1)
+        inotify_rm_watch(inotify_fd_, watch);
+#endif
+      lock.lock();
+      --busy;
+      if (listed) {
+        AddUsage(result.usage, usage);
+        if (watch != -1) {
+          Directory& watched(result.directories[watch]);
+          watched.path = directory;
+          watched.usage = usage;
+        } else {
+          result.watched = false;
+          result.watch_error = watch_error;
+        }
+        pending.insert(pending.end(), subdirectories.begin(), subdirectories.end());
+      } else if (directory == root) {
+        // Subdirectories which vanish during the scan are expected, but without the top one
+        // there's nothing to watch.
+        result.watched = false;
+      }
+      cond_var.notify_all();
+    }
+  });
+  std::vector<std::thread> threads;
+  for (unsigned i(1); i < thread_count; ++i)
+    threads.push_back(std::thread(scan));
+  scan();
+  for (auto& thread : threads)
+    thread.join();
+  return result;
+}
+
+void DiskUsageTracker::ListDirty(std::unique_lock<std::mutex>& lock) {
+  std::vector<std::pair<int, fs::path>> dirty;
+  for (int watch : dirty_)
+    dirty.push_back(std::make_pair(watch, directories_.at(watch).path));
+  dirty_.clear();
+  lock.unlock();
+  std::vector<DiskUsage> usages(dirty.size());
+  std::vector<fs::path> subdirectories;
+  std::vector<bool> listed(dirty.size());
+  for (size_t i(0); i != dirty.size(); ++i)
+    listed[i] = ScanDirectory(dirty[i].second, usages[i], subdirectories);
+  lock.lock();
+  for (size_t i(0); i != dirty.size(); ++i) {
+    // A directory which has gone will be removed when its IN_IGNORED event is read.
+    auto itr(directories_.find(dirty[i].first));
+    if (!listed[i] || itr == directories_.end() || itr->second.path != dirty[i].second)
+      continue;
+    Tree& tree(trees_.at(itr->second.root));
+    SubtractUsage(tree.usage, itr->second.usage);
+    AddUsage(tree.usage, usages[i]);
+    itr->second.usage = usages[i];
+  }
+}
+
+void DiskUsageTracker::ApplyScan(const fs::path& root, const ScanResult& result, bool replace) {
+  Tree& tree(trees_.at(root));
+  const TimePoint kNow(std::chrono::steady_clock::now());
+  if (replace) {
+    for (auto itr(directories_.begin()); itr != directories_.end();) {
+      if (itr->second.root == root && result.directories.count(itr->first) == 0) {
+#ifdef MAIDSAFE_LINUX
+        inotify_rm_watch(inotify_fd_, itr->first);
+#endif
+        dirty_.erase(itr->first);
+        itr = directories_.erase(itr);
+      } else {
+        ++itr;
+      }
+    }
+    if (!tree.scanned) {
+      LOG(kInfo) << "Chunkstore " << root << " holds " << result.usage.files << " files using "
+                 << (result.usage.bytes >> 20) << " MiB";
+    }
+    tree.usage = result.usage;
+    tree.scanned = true;
+    tree.watched = result.watched;
+    tree.next_scan = kNow + (result.watched ? kRescanInterval_ : kUnwatchedRescanInterval());
+  } else {
+    for (const auto& directory : result.directories) {
+      auto itr(directories_.find(directory.first));
+      if (itr != directories_.end())
+        SubtractUsage(tree.usage, itr->second.usage);
+    }
+    AddUsage(tree.usage, result.usage);
+    if (!result.watched && tree.watched) {
+      tree.watched = false;
+      tree.next_scan = std::min(tree.next_scan, kNow + kUnwatchedRescanInterval());
+    }
+  }
+  for (const auto& directory : result.directories) {
+    Directory& watched(directories_[directory.first]);
+    watched = directory.second;
+    watched.root = root;
+  }
+  if (result.watch_error != 0) {
+    LOG(kWarning) << "Failed to watch all of " << root << " (" << std::strerror(result.watch_error)
+                  << "), so it will be rescanned every " << kUnwatchedRescanInterval().count()
+                  << " ms.";
+  }
+}
+
+void DiskUsageTracker::ReadEvents(NewDirectories& new_directories) {
+#ifdef MAIDSAFE_LINUX
+  if (inotify_fd_ == -1)
+    return;
+  alignas(inotify_event) char buffer[64 * 1024];
+  const TimePoint kNow(std::chrono::steady_clock::now());
+  for (;;) {
+    ssize_t length(read(inotify_fd_, buffer, sizeof(buffer)));
+    if (length <= 0)
+      return;
+    for (char* position(buffer); position < buffer + length;) {
+      const inotify_event* event(reinterpret_cast<const inotify_event*>(position));
+      position += sizeof(inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        LOG(kWarning) << "Filesystem events were lost, so rescanning all chunkstores.";
+        for (auto& tree : trees_)
+          tree.second.next_scan = kNow;
+        continue;
+      }
+      auto itr(directories_.find(event->wd));
+      if (itr == directories_.end())
+        continue;
+      if (event->mask & IN_IGNORED) {
+        RemoveDirectory(event->wd);
+      } else if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+          new_directories.push_back(
+              std::make_pair(itr->second.root, itr->second.path / event->name));
+        } else if (event->mask & IN_MOVED_FROM) {
+          // The moved directory's watches still refer to their old paths.
+          trees_.at(itr->second.root).next_scan = kNow;
+        }
+      } else {
+        if (dirty_.empty())
+          dirty_since_ = kNow;
+        dirty_.insert(event->wd);
+      }
+    }
+  }
+#else
+  static_cast<void>(new_directories);
+#endif
+}
+
+void DiskUsageTracker::RemoveDirectory(int watch) {
+  auto itr(directories_.find(watch));
+  if (itr == directories_.end())
+    return;
+  Tree& tree(trees_.at(itr->second.root));
+  SubtractUsage(tree.usage, itr->second.usage);
+  if (itr->second.path == itr->second.root) {
+    // The chunkstore itself has gone.  Rescan until it reappears.
+    tree.watched = false;
+    tree.next_scan = std::min(tree.next_scan,
+                              std::chrono::steady_clock::now() + kUnwatchedRescanInterval());
+  }
+  dirty_.erase(watch);
+  directories_.erase(itr);
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
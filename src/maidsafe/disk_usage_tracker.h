@@ -0,0 +1,147 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_DISK_USAGE_TRACKER_H_
+#define MAIDSAFE_CLIENT_MANAGER_DISK_USAGE_TRACKER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+#include "boost/thread/thread.hpp"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+struct DiskUsage {
+  DiskUsage() : bytes(0), files(0) {}
+  // Space allocated on disk, which for small chunks is usually more than their size.  On Windows,
+  // file sizes are used instead.
+  uint64_t bytes, files;
+};
+
+namespace detail {
+
+// Adds up the files directly in 'directory' (not in its subdirectories) and appends the paths of
+// its subdirectories to 'subdirectories'.  Symlinks aren't followed.  Returns false if
+// 'directory' can't be read.
+bool ScanDirectory(const boost::filesystem::path& directory, DiskUsage& usage,
+                   std::vector<boost::filesystem::path>& subdirectories);
+
+// Keeps a running total of the disk space used under each of a set of directories (e.g. vaults'
+// chunkstores) without walking them on every query.  Each is scanned once when added, using up to
+// 'scan_threads' threads, and then kept up to date on Linux from inotify events: a directory in
+// which files are created, deleted, written or moved is re-listed (but not recursed into) once
+// 'coalesce_interval' has passed, so a burst of changes costs one listing.  Since inotify watches
+// aren't recursive, every directory in the tree is watched; chunkstores spread their chunks over
+// many small directories, so each re-listing is cheap.
+//
+// Trees are rescanned in full every 'rescan_interval' to correct any drift, and much more often
+// (every kUnwatchedRescanInterval()) if they couldn't be watched, e.g. because they didn't exist
+// yet, the watch limit was reached, or on other platforms.  They're also rescanned if the kernel's
+// event queue overflows.  Tracked directories mustn't be nested within one another.
+class DiskUsageTracker {
+ public:
+  explicit DiskUsageTracker(
+      unsigned scan_threads = kDefaultScanThreads(),
+      std::chrono::milliseconds coalesce_interval = kDefaultCoalesceInterval(),
+      std::chrono::milliseconds rescan_interval = kDefaultRescanInterval());
+  ~DiskUsageTracker();
+  // Starts tracking 'root' in the background.  Does nothing if it's already tracked.
+  void Add(const boost::filesystem::path& root);
+  // Returns false if 'root' isn't tracked, or if its first scan hasn't finished.
+  bool Usage(const boost::filesystem::path& root, DiskUsage& usage) const;
+
+  static unsigned kDefaultScanThreads();
+  static std::chrono::milliseconds kDefaultCoalesceInterval() { return std::chrono::seconds(2); }
+  static std::chrono::milliseconds kDefaultRescanInterval() { return std::chrono::hours(6); }
+  static std::chrono::milliseconds kUnwatchedRescanInterval() { return std::chrono::minutes(1); }
+
+ private:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+  struct Tree {
+    Tree() : usage(), scanned(false), watched(false), next_scan() {}
+    DiskUsage usage;
+    bool scanned, watched;
+    TimePoint next_scan;
+  };
+  // A watched directory, and the usage of the files directly in it.
+  struct Directory {
+    boost::filesystem::path path, root;
+    DiskUsage usage;
+  };
+  struct ScanResult {
+    ScanResult() : directories(), usage(), watched(true), watch_error(0) {}
+    // Keyed by watch descriptor.
+    std::unordered_map<int, Directory> directories;
+    DiskUsage usage;
+    // False if any directory couldn't be watched, or the top one couldn't be listed.
+    bool watched;
+    int watch_error;
+  };
+  typedef std::vector<std::pair<boost::filesystem::path, boost::filesystem::path>> NewDirectories;
+
+  DiskUsageTracker(const DiskUsageTracker&);
+  DiskUsageTracker& operator=(const DiskUsageTracker&);
+  void Run();
+  // Waits until 'deadline', or until woken or inotify has events.
+  void Wait(std::unique_lock<std::mutex>& lock, TimePoint deadline);
+  void Wake();
+  // Walks the tree under 'root' using 'thread_count' threads, watching each directory before
+  // listing it, so that changes made during the scan aren't missed.  Called without mutex_ locked.
+  ScanResult ScanTree(const boost::filesystem::path& root, unsigned thread_count) const;
+  // Re-lists the dirty directories, unlocking 'lock' while doing so.
+  void ListDirty(std::unique_lock<std::mutex>& lock);
+  // NOTE: These are called with mutex_ locked.
+  // If 'replace' is true, 'result' is a full scan of 'root' and replaces what was known of it.
+  // Otherwise it's a scan of a new directory within 'root'.
+  void ApplyScan(const boost::filesystem::path& root, const ScanResult& result, bool replace);
+  // Appends the (root, path) of each directory created in or moved into a tree.
+  void ReadEvents(NewDirectories& new_directories);
+  void RemoveDirectory(int watch);
+
+  const unsigned kScanThreads_;
+  const std::chrono::milliseconds kCoalesceInterval_, kRescanInterval_;
+  std::map<boost::filesystem::path, Tree> trees_;
+  std::unordered_map<int, Directory> directories_;
+  // Watched directories with changes not yet accounted for, and when the first change was seen.
+  std::set<int> dirty_;
+  TimePoint dirty_since_;
+  mutable std::mutex mutex_;
+  std::condition_variable cond_var_;
+  std::atomic<bool> stop_;
+  int inotify_fd_, event_fd_;
+  boost::thread worker_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_DISK_USAGE_TRACKER_H_
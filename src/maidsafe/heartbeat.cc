@@ -0,0 +1,80 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/heartbeat.h"
+
+#include <new>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+
+namespace bip = boost::interprocess;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Heartbeat counter must be lock-free to be shared.");
+
+std::string HeartbeatName(ProcessIndex index, uint16_t client_manager_port) {
+  return "maidsafe_heartbeat_" + std::to_string(client_manager_port) + "_" +
+         std::to_string(index);
+}
+
+HeartbeatMonitor::HeartbeatMonitor(const std::string& name)
+    : kName_(name),
+      shared_memory_(),
+      mapped_region_(),
+      counter_(nullptr) {
+  bip::shared_memory_object::remove(kName_.c_str());
+  bip::shared_memory_object(bip::create_only, kName_.c_str(), bip::read_write)
+      .swap(shared_memory_);
+  shared_memory_.truncate(sizeof(HeartbeatCounter));
+  bip::mapped_region(shared_memory_, bip::read_write).swap(mapped_region_);
+  counter_ = new (mapped_region_.get_address()) HeartbeatCounter;
+  counter_->count = 0;
+}
+
+HeartbeatMonitor::~HeartbeatMonitor() {
+  if (!bip::shared_memory_object::remove(kName_.c_str()))
+    LOG(kWarning) << "Failed to remove heartbeat shared memory " << kName_;
+}
+
+uint64_t HeartbeatMonitor::Count() const {
+  return counter_->count.load(std::memory_order_relaxed);
+}
+
+void HeartbeatMonitor::Reset() { counter_->count = 0; }
+
+Heartbeat::Heartbeat(const std::string& name)
+    : shared_memory_(bip::open_only, name.c_str(), bip::read_write),
+      mapped_region_(shared_memory_, bip::read_write),
+      counter_(static_cast<HeartbeatCounter*>(mapped_region_.get_address())) {
+  if (mapped_region_.get_size() < sizeof(HeartbeatCounter)) {
+    LOG(kError) << "Heartbeat shared memory " << name << " is too small.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_parameter));
+  }
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
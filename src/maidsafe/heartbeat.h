@@ -0,0 +1,116 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_HEARTBEAT_H_
+#define MAIDSAFE_CLIENT_MANAGER_HEARTBEAT_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "boost/interprocess/mapped_region.hpp"
+#include "boost/interprocess/shared_memory_object.hpp"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+typedef uint32_t ProcessIndex;
+
+// How long a supervised process may go without beating before it is deemed hung.  A process isn't
+// expected to beat until it has finished starting up (e.g. a vault only does so once it has joined
+// the network), so its first beat is allowed 'startup_timeout' from launch.  If
+// 'armed_by_first_beat' is set, a process which hasn't yet beaten is never deemed hung, so that a
+// binary which doesn't beat at all (e.g. an older vault) still runs, unwatched.  An empty policy
+// (the default) means the process isn't watched.
+struct HeartbeatPolicy {
+  HeartbeatPolicy() : timeout(0), startup_timeout(0), armed_by_first_beat(false) {}
+  HeartbeatPolicy(std::chrono::milliseconds timeout_in,
+                  std::chrono::milliseconds startup_timeout_in, bool armed_by_first_beat_in = false)
+      : timeout(timeout_in),
+        startup_timeout(startup_timeout_in),
+        armed_by_first_beat(armed_by_first_beat_in) {}
+  bool Empty() const { return timeout.count() == 0; }
+  bool IsValid() const {
+    return timeout.count() >= 0 && startup_timeout.count() >= 0 &&
+           (Empty() || startup_timeout.count() != 0);
+  }
+  std::chrono::milliseconds timeout, startup_timeout;
+  bool armed_by_first_beat;
+};
+
+namespace detail {
+
+// The counter through which a process signals that it is alive: a single 64-bit value in its own
+// shared memory object, incremented by the process and polled by the manager, so beating costs
+// neither side a system call.
+struct HeartbeatCounter {
+  std::atomic<uint64_t> count;
+};
+
+// The name of the shared memory object for the process with 'index' under the manager listening on
+// 'client_manager_port'.  The process can derive it from its --vmid argument.
+std::string HeartbeatName(ProcessIndex index, uint16_t client_manager_port);
+
+// Manager side: creates the shared memory object, replacing any left by a previous manager which
+// didn't exit cleanly, and removes it on destruction.  Throws if it can't be created.
+class HeartbeatMonitor {
+ public:
+  explicit HeartbeatMonitor(const std::string& name);
+  ~HeartbeatMonitor();
+  uint64_t Count() const;
+  // Called before each launch, so that a beat from the new process can't be confused with one from
+  // its predecessor.
+  void Reset();
+
+ private:
+  HeartbeatMonitor(const HeartbeatMonitor&);
+  HeartbeatMonitor& operator=(const HeartbeatMonitor&);
+
+  const std::string kName_;
+  boost::interprocess::shared_memory_object shared_memory_;
+  boost::interprocess::mapped_region mapped_region_;
+  HeartbeatCounter* counter_;
+};
+
+// Process side: opens the shared memory object created by the manager.  Throws if it doesn't exist
+// (e.g. if the manager isn't watching this process).
+class Heartbeat {
+ public:
+  explicit Heartbeat(const std::string& name);
+  void Beat() { counter_->count.fetch_add(1, std::memory_order_relaxed); }
+
+  static std::chrono::milliseconds kDefaultInterval() { return std::chrono::seconds(1); }
+
+ private:
+  Heartbeat(const Heartbeat&);
+  Heartbeat& operator=(const Heartbeat&);
+
+  boost::interprocess::shared_memory_object shared_memory_;
+  boost::interprocess::mapped_region mapped_region_;
+  HeartbeatCounter* counter_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_HEARTBEAT_H_
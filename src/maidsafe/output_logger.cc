@@ -0,0 +1,396 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/output_logger.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+namespace {
+
+#ifdef MAIDSAFE_LINUX
+const uint64_t kWakeTag(static_cast<uint64_t>(-1));
+const size_t kReadSize(64 * 1024);
+// Limits how long one busy pipe can hold up the others; epoll reports it again if it still has
+// data.
+const int kMaxReadsPerEvent(16);
+
+uint64_t MakeTag(ProcessIndex index, int fd) {
+  return (static_cast<uint64_t>(index) << 32) | static_cast<uint32_t>(fd);
+}
+
+ProcessIndex TagIndex(uint64_t tag) { return static_cast<ProcessIndex>(tag >> 32); }
+
+int TagFd(uint64_t tag) { return static_cast<int>(static_cast<uint32_t>(tag)); }
+
+std::string RotatedName(const fs::path& log_file, unsigned number) {
+  return log_file.string() + "." + std::to_string(number);
+}
+#endif
+
+}  // unnamed namespace
+
+OutputLogger::OutputLogger(uint64_t max_file_size, unsigned max_files, size_t max_buffered)
+    : kMaxFileSize_(max_file_size),
+      kMaxFiles_(max_files),
+      kMaxBuffered_(max_buffered),
+      sinks_(),
+      pipes_(),
+      queue_(),
+      mutex_(),
+      cond_var_(),
+      stop_reading_(false),
+      stop_writing_(false),
+#ifdef MAIDSAFE_LINUX
+      epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      event_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+#else
+      epoll_fd_(-1),
+      event_fd_(-1),
+#endif
+      reader_(),
+      writer_() {
+#ifdef MAIDSAFE_LINUX
+  if (epoll_fd_ == -1 || event_fd_ == -1) {
+    LOG(kError) << "Failed to create epoll instance or eventfd.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::unable_to_handle_request));
+  }
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = kWakeTag;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &event) == -1) {
+    LOG(kError) << "Failed to add eventfd to epoll instance.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::unable_to_handle_request));
+  }
+  reader_ = boost::thread([this] { Read(); });
+  writer_ = boost::thread([this] { Write(); });
+#endif
+}
+
+OutputLogger::~OutputLogger() {
+#ifdef MAIDSAFE_LINUX
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_reading_ = true;
+  }
+  uint64_t value(1);
+  if (write(event_fd_, &value, sizeof(value)) == -1)
+    LOG(kError) << "Failed to wake output reader.";
+  reader_.join();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_writing_ = true;
+  }
+  cond_var_.notify_one();
+  writer_.join();
+  for (auto& sink : sinks_) {
+    if (sink.second.fd != -1)
+      close(sink.second.fd);
+  }
+  close(event_fd_);
+  close(epoll_fd_);
+#endif
+}
+
+int OutputLogger::Open(ProcessIndex index, const fs::path& log_file) {
+#ifdef MAIDSAFE_LINUX
+  boost::system::error_code error_code;
+  if (log_file.has_parent_path()) {
+    fs::create_directories(log_file.parent_path(), error_code);
+    if (error_code) {
+      LOG(kError) << "Failed to create directory for " << log_file << ": " << error_code.message();
+      return -1;
+    }
+  }
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) != 0) {
+    LOG(kError) << "Failed to create output pipe: " << std::strerror(errno);
+    return -1;
+  }
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto result(sinks_.emplace(std::piecewise_construct, std::forward_as_tuple(index),
+                               std::forward_as_tuple(log_file)));
+    result.first->second.closing = false;
+    pipes_.insert(std::make_pair(fds[0], index));
+  }
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = MakeTag(index, fds[0]);
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fds[0], &event) == -1) {
+    LOG(kError) << "Failed to add output pipe to epoll instance: " << std::strerror(errno);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pipes_.erase(fds[0]);
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  return fds[1];
+#else
+  static_cast<void>(index);
+  static_cast<void>(log_file);
+  LOG(kInfo) << "Capturing process output is not supported on this platform.";
+  return -1;
+#endif
+}
+
+void OutputLogger::Close(ProcessIndex index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(sinks_.find(index));
+  if (itr == sinks_.end() || itr->second.closing)
+    return;
+  itr->second.closing = true;
+  Enqueue(index, itr->second);
+}
+
+uint64_t OutputLogger::DroppedBytes(ProcessIndex index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(sinks_.find(index));
+  return itr == sinks_.end() ? 0 : itr->second.total_dropped;
+}
+
+void OutputLogger::Read() {
+#ifdef MAIDSAFE_LINUX
+  std::vector<char> buffer(kReadSize);
+  const int kMaxEvents(64);
+  epoll_event events[kMaxEvents];
+  for (;;) {
+    int count(epoll_wait(epoll_fd_, events, kMaxEvents, -1));
+    if (count == -1 && errno != EINTR) {
+      LOG(kError) << "Failed waiting for process output: " << std::strerror(errno);
+      break;
+    }
+    for (int i(0); i < count; ++i) {
+      if (events[i].data.u64 == kWakeTag) {
+        uint64_t value(0);
+        while (read(event_fd_, &value, sizeof(value)) > 0) {}
+        continue;
+      }
+      int fd(TagFd(events[i].data.u64));
+      if (!Drain(fd, TagIndex(events[i].data.u64), buffer)) {
+        // Closing the pipe isn't enough to remove it from the epoll set while a child being
+        // spawned still holds a copy of it.  It's erased before being closed, since Open() could
+        // then reuse the descriptor.
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          pipes_.erase(fd);
+          // A closing sink waits for its last pipe before the writer forgets it.
+          ProcessIndex index(TagIndex(events[i].data.u64));
+          Sink& sink(sinks_.at(index));
+          if (sink.closing && !HasPipe(index))
+            Enqueue(index, sink);
+        }
+        close(fd);
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_reading_)
+      break;
+  }
+  // Collect whatever has already been written, without waiting for more.  Each pipe stays in
+  // pipes_ until drained, so that the writer doesn't forget its sink meanwhile.
+  std::unordered_map<int, ProcessIndex> pipes;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pipes = pipes_;
+  }
+  for (const auto& pipe : pipes) {
+    Drain(pipe.first, pipe.second, buffer);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pipes_.erase(pipe.first);
+    }
+    close(pipe.first);
+  }
+#endif
+}
+
+bool OutputLogger::Drain(int fd, ProcessIndex index, std::vector<char>& buffer) {
+#ifdef MAIDSAFE_LINUX
+  for (int i(0); i != kMaxReadsPerEvent; ++i) {
+    ssize_t length(read(fd, &buffer[0], buffer.size()));
+    if (length == 0)
+      return false;
+    if (length == -1) {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Sink& sink(sinks_.at(index));
+    size_t accepted(std::min(static_cast<size_t>(length), kMaxBuffered_ - sink.pending.size()));
+    sink.pending.append(&buffer[0], accepted);
+    sink.dropped += length - accepted;
+    sink.total_dropped += length - accepted;
+    if (accepted != 0 || sink.dropped != 0)
+      Enqueue(index, sink);
+  }
+  return true;
+#else
+  static_cast<void>(fd);
+  static_cast<void>(index);
+  static_cast<void>(buffer);
+  return false;
+#endif
+}
+
+void OutputLogger::Enqueue(ProcessIndex index, Sink& sink) {
+  if (sink.queued)
+    return;
+  sink.queued = true;
+  queue_.push_back(index);
+  cond_var_.notify_one();
+}
+
+bool OutputLogger::HasPipe(ProcessIndex index) const {
+  return std::any_of(pipes_.begin(), pipes_.end(),
+                     [index](const std::pair<const int, ProcessIndex>& pipe) {
+    return pipe.second == index;
+  });
+}
+
+void OutputLogger::Write() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cond_var_.wait(lock, [this] { return !queue_.empty() || stop_writing_; });
+    if (queue_.empty())
+      return;
+    const ProcessIndex kIndex(queue_.front());
+    Sink& sink(sinks_.at(kIndex));
+    queue_.pop_front();
+    std::string data;
+    data.swap(sink.pending);
+    uint64_t dropped(sink.dropped);
+    sink.dropped = 0;
+    sink.queued = false;
+    lock.unlock();
+    // Output is only discarded once the buffer is full, so the gap follows what was buffered.
+    if (dropped != 0)
+      data += "\n[" + std::to_string(dropped) + " bytes of output discarded]\n";
+    if (!data.empty())
+      WriteToFile(sink, data);
+    lock.lock();
+    // Anything read since was queued again; the reader queues the sink once more when its last
+    // pipe closes.
+    if (sink.closing && !sink.queued && !HasPipe(kIndex)) {
+#ifdef MAIDSAFE_LINUX
+      if (sink.fd != -1)
+        close(sink.fd);
+#endif
+      sinks_.erase(kIndex);
+    }
+  }
+}
+
+void OutputLogger::WriteToFile(Sink& sink, const std::string& data) {
+#ifdef MAIDSAFE_LINUX
+  if (sink.fd == -1 && !OpenFile(sink))
+    return;
+  if (sink.file_size != 0 && sink.file_size + data.size() > kMaxFileSize_)
+    Rotate(sink);
+  if (sink.fd == -1)
+    return;
+  size_t offset(0);
+  while (offset != data.size()) {
+    ssize_t written(write(sink.fd, data.data() + offset, data.size() - offset));
+    if (written == -1) {
+      if (errno == EINTR)
+        continue;
+      LOG(kError) << "Failed to write to " << sink.log_file << ": " << std::strerror(errno);
+      return;
+    }
+    offset += written;
+    sink.file_size += written;
+  }
+#else
+  static_cast<void>(sink);
+  static_cast<void>(data);
+#endif
+}
+
+bool OutputLogger::OpenFile(Sink& sink) {
+#ifdef MAIDSAFE_LINUX
+  sink.fd = open(sink.log_file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (sink.fd == -1) {
+    LOG(kError) << "Failed to open " << sink.log_file << ": " << std::strerror(errno);
+    return false;
+  }
+  struct stat status;
+  sink.file_size = fstat(sink.fd, &status) == 0 ? static_cast<uint64_t>(status.st_size) : 0;
+  return true;
+#else
+  static_cast<void>(sink);
+  return false;
+#endif
+}
+
+void OutputLogger::Rotate(Sink& sink) {
+#ifdef MAIDSAFE_LINUX
+  close(sink.fd);
+  sink.fd = -1;
+  if (kMaxFiles_ == 0) {
+    unlink(sink.log_file.c_str());
+  } else {
+    // Failures are expected here until there are 'max_files' old files.
+    for (unsigned number(kMaxFiles_ - 1); number != 0; --number) {
+      std::rename(RotatedName(sink.log_file, number).c_str(),
+                  RotatedName(sink.log_file, number + 1).c_str());
+    }
+    if (std::rename(sink.log_file.c_str(), RotatedName(sink.log_file, 1).c_str()) != 0)
+      LOG(kWarning) << "Failed to rotate " << sink.log_file << ": " << std::strerror(errno);
+  }
+  OpenFile(sink);
+#else
+  static_cast<void>(sink);
+#endif
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,136 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_OUTPUT_LOGGER_H_
+#define MAIDSAFE_CLIENT_MANAGER_OUTPUT_LOGGER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+#include "boost/thread/thread.hpp"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+typedef uint32_t ProcessIndex;
+
+namespace detail {
+
+// Collects the stdout and stderr of child processes into one log file per process.  Each child
+// writes both streams to the write end of a pipe returned by Open().  A single thread waits on the
+// read ends of all the pipes (using epoll) and always drains them, so a child never blocks on a
+// full pipe however slowly the files are written.  What it reads is buffered per process and
+// written out by a second thread.  If a process's buffer reaches 'max_buffered' bytes, further
+// output from it is discarded until the buffer has been written, and a note of how much was lost is
+// added to the log.
+//
+// A log file is rotated once it would exceed 'max_file_size' bytes: "x.log" is renamed to
+// "x.log.1", "x.log.1" to "x.log.2" and so on, keeping at most 'max_files' old files.
+//
+// Only implemented on Linux; elsewhere Open() returns -1, and children inherit the manager's
+// streams.
+class OutputLogger {
+ public:
+  OutputLogger(uint64_t max_file_size = kDefaultMaxFileSize(),
+               unsigned max_files = kDefaultMaxFiles(),
+               size_t max_buffered = kDefaultMaxBuffered());
+  // Collects any output still in the pipes and writes everything buffered before returning.
+  ~OutputLogger();
+  // Returns a descriptor for the child's stdout and stderr, to be closed by the caller once the
+  // child has been started, or -1 on failure.  The descriptor is close-on-exec, so it must be
+  // duplicated onto the child's streams.  Any earlier pipe for 'index' remains open until its
+  // writers have all exited, and both are logged to 'log_file', which must be the same for every
+  // call with a given 'index'.
+  int Open(ProcessIndex index, const boost::filesystem::path& log_file);
+  // Stops logging for 'index' once it's no longer needed.  Returns at once; the writer thread
+  // closes the log file and forgets the process once everything read from its pipes has been
+  // written and the pipes have all been closed.
+  void Close(ProcessIndex index);
+  // The number of bytes discarded for 'index' because its buffer was full.
+  uint64_t DroppedBytes(ProcessIndex index) const;
+
+  static uint64_t kDefaultMaxFileSize() { return 10 * 1024 * 1024; }
+  static unsigned kDefaultMaxFiles() { return 5; }
+  static size_t kDefaultMaxBuffered() { return 1024 * 1024; }
+
+ private:
+  struct Sink {
+    explicit Sink(const boost::filesystem::path& log_file_in)
+        : log_file(log_file_in),
+          pending(),
+          dropped(0),
+          total_dropped(0),
+          queued(false),
+          closing(false),
+          fd(-1),
+          file_size(0) {}
+    const boost::filesystem::path log_file;
+    // Guarded by mutex_.
+    std::string pending;
+    uint64_t dropped, total_dropped;
+    bool queued, closing;
+    // Only used by the writer thread.
+    int fd;
+    uint64_t file_size;
+  };
+
+  OutputLogger(const OutputLogger&);
+  OutputLogger& operator=(const OutputLogger&);
+  void Read();
+  // Reads whatever is ready, up to a limit.  Returns false once the pipe has been closed by all
+  // its writers.
+  bool Drain(int fd, ProcessIndex index, std::vector<char>& buffer);
+  // NOTE: mutex_ must be locked when calling these functions.
+  void Enqueue(ProcessIndex index, Sink& sink);
+  bool HasPipe(ProcessIndex index) const;
+  void Write();
+  // NOTE: These are only called by the writer thread, without mutex_ locked.
+  void WriteToFile(Sink& sink, const std::string& data);
+  bool OpenFile(Sink& sink);
+  void Rotate(Sink& sink);
+
+  const uint64_t kMaxFileSize_;
+  const unsigned kMaxFiles_;
+  const size_t kMaxBuffered_;
+  // Sinks are only erased by the writer thread, so can be used by it without mutex_ locked.
+  std::unordered_map<ProcessIndex, Sink> sinks_;
+  // The read end of each open pipe.  Only erased from by the reader thread.
+  std::unordered_map<int, ProcessIndex> pipes_;
+  // Sinks with pending output, in the order they became non-empty.
+  std::deque<ProcessIndex> queue_;
+  mutable std::mutex mutex_;
+  std::condition_variable cond_var_;
+  bool stop_reading_, stop_writing_;
+  int epoll_fd_, event_fd_;
+  boost::thread reader_, writer_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_OUTPUT_LOGGER_H_
@@ -18,15 +18,23 @@
 
 #include "maidsafe/client_manager/process_manager.h"
 
+#ifdef MAIDSAFE_WIN32
+#include <windows.h>
+#else
+#include <signal.h>
+#include <unistd.h>
+#endif
+
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <future>
+#include <memory>
+#include <string>
 
 #include "boost/filesystem/fstream.hpp"
 #include "boost/filesystem/operations.hpp"
 #include "boost/process/child.hpp"
-#include "boost/process/execute.hpp"
-#include "boost/process/initializers.hpp"
-#include "boost/process/wait_for_exit.hpp"
 #include "boost/process/terminate.hpp"
 #include "boost/system/error_code.hpp"
 
@@ -48,6 +56,21 @@ namespace maidsafe {
 
 namespace client_manager {
 
+namespace {
+
+// Unique to each ProcessManager for the life of the system, e.g. "client_manager_1234_0".
+std::string MakeCgroupSubtree() {
+  static std::atomic<unsigned> instance_count(0);
+#ifdef MAIDSAFE_WIN32
+  const auto kPid(GetCurrentProcessId());
+#else
+  const auto kPid(getpid());
+#endif
+  return "client_manager_" + std::to_string(kPid) + "_" + std::to_string(instance_count++);
+}
+
+}  // unnamed namespace
+
 bool Process::SetExecutablePath(const fs::path& executable_path) {
   boost::system::error_code ec;
   if (!fs::exists(executable_path, ec) || ec) {
@@ -63,267 +86,661 @@ bool Process::SetExecutablePath(const fs::path& executable_path) {
     return false;
   }
   LOG(kInfo) << "Executable found at " << executable_path.string();
+  // When the path is replaced, the arguments already added are kept.
+  if (name_.empty())
+    args_.push_back(executable_path.string());
+  else
+    args_.front() = executable_path.string();
   name_ = executable_path.string();
-  args_.push_back(name_);
   return true;
 }
 
-ProcessManager::ProcessInfo::ProcessInfo(ProcessManager::ProcessInfo&& other)
-    : process(std::move(other.process)),
-      thread(std::move(other.thread)),
-      index(std::move(other.index)),
-      port(std::move(other.port)),
-      restart_count(std::move(other.restart_count)),
-      done(std::move(other.done)),
-      status(std::move(other.status)),
-      child(std::move(other.child)) {}
+bool Process::SetOutputLogFile(const fs::path& output_log_file) {
+  if (!output_log_file.has_filename()) {
+    LOG(kError) << output_log_file << " is not a valid log file path.";
+    return false;
+  }
+  output_log_file_ = output_log_file;
+  return true;
+}
+
+bool Process::SetRestartPolicy(const RestartPolicy& restart_policy) {
+  if (!restart_policy.IsValid())
+    return false;
+  restart_policy_ = restart_policy;
+  return true;
+}
+
+bool Process::SetResourceLimits(const ResourceLimits& resource_limits) {
+  if (!resource_limits.IsValid())
+    return false;
+  resource_limits_ = resource_limits;
+  return true;
+}
+
+bool Process::SetCpuPlacement(const CpuPlacement& cpu_placement) {
+  if (!cpu_placement.IsValid())
+    return false;
+  cpu_placement_ = cpu_placement;
+  return true;
+}
+
+bool Process::SetTerminationPolicy(const TerminationPolicy& termination_policy) {
+  if (!termination_policy.IsValid())
+    return false;
+  termination_policy_ = termination_policy;
+  return true;
+}
 
-ProcessManager::ProcessInfo& ProcessManager::ProcessInfo::operator=(
-    ProcessManager::ProcessInfo&& other) {
-  process = std::move(other.process);
-  thread = std::move(other.thread);
-  index = std::move(other.index);
-  port = std::move(other.port);
-  restart_count = std::move(other.restart_count);
-  done = std::move(other.done);
-  status = std::move(other.status);
-  child = std::move(other.child);
-  return *this;
+bool Process::SetHeartbeatPolicy(const HeartbeatPolicy& heartbeat_policy) {
+  if (!heartbeat_policy.IsValid())
+    return false;
+  heartbeat_policy_ = heartbeat_policy;
+  return true;
 }
 
-ProcessManager::ProcessManager() : processes_(), current_max_id_(0), mutex_(), cond_var_() {}
+ProcessManager::ProcessManager(SpawnBackend spawn_backend)
+    : spawner_(spawn_backend),
+      processes_(),
+      current_max_id_(0),
+      placement_strategy_(PlacementStrategy::kNone),
+      placed_count_(0),
+      processes_mutex_(),
+      schedule_(),
+      schedule_mutex_(),
+      mutex_(),
+      cond_var_(),
+      on_process_event_(),
+      kCgroupSubtree_(MakeCgroupSubtree()),
+      cgroups_(),
+      cpu_topology_(),
+      sampler_(),
+      output_logger_(),
+      reaper_(),
+      stop_supervising_(false),
+      supervisor_() {
+  supervisor_ = boost::thread([this] { Supervise(); });
+}
 
 ProcessManager::~ProcessManager() { TerminateAll(); }
 
+void ProcessManager::SetPlacementStrategy(PlacementStrategy placement_strategy) {
+  boost::unique_lock<boost::shared_mutex> lock(processes_mutex_);
+  placement_strategy_ = placement_strategy;
+}
+
 ProcessIndex ProcessManager::AddProcess(Process process, Port port) {
   if (process.name().empty()) {
     LOG(kError) << "Invalid process - executable path empty.";
     return kInvalidIndex();
   }
-  ProcessInfo info;
-  info.index = ++current_max_id_;
-  info.done = false;
-  info.status = ProcessStatus::kStopped;
-  info.restart_count = 0;
-  info.port = port;
-  LOG(kVerbose) << "Restart count on init: " << info.restart_count;
+  std::shared_ptr<ProcessInfo> info(new ProcessInfo);
+  info->done = false;
+  info->status = ProcessStatus::kStopped;
+  info->restart_tracker = detail::RestartTracker(process.restart_policy());
+  info->port = port;
+  boost::unique_lock<boost::shared_mutex> lock(processes_mutex_);
+  if (placement_strategy_ == PlacementStrategy::kRoundRobinNodes &&
+      process.cpu_placement().Empty())
+    process.SetCpuPlacement(cpu_topology_.RoundRobin(placed_count_++));
+  info->index = ++current_max_id_;
   process.AddArgument("--vmid");
-  process.AddArgument(detail::GenerateVmidParameter(info.index, info.port));
-  info.process = process;
-  std::lock_guard<std::mutex> lock(mutex_);
-  processes_.push_back(std::move(info));
-  return info.index;
+  process.AddArgument(detail::GenerateVmidParameter(info->index, info->port));
+  info->process = process;
+  info->argv = detail::SplitArguments(process.args());
+  info->command_line = process::ConstructCommandLine(process.args());
+  if (!process.heartbeat_policy().Empty()) {
+    try {
+      info->heartbeat.reset(
+          new detail::HeartbeatMonitor(detail::HeartbeatName(info->index, info->port)));
+    }
+    catch (const std::exception& e) {
+      LOG(kError) << "Failed to create heartbeat for process " << info->index << ", so it won't "
+                  << "be watched: " << e.what();
+    }
+  }
+  ProcessIndex index(info->index);
+  processes_.insert(std::make_pair(index, std::move(info)));
+  return index;
+}
+
+bool ProcessManager::RemoveProcess(ProcessIndex index) {
+  std::shared_ptr<ProcessInfo> process_info;
+  {
+    boost::unique_lock<boost::shared_mutex> lock(processes_mutex_);
+    auto itr(processes_.find(index));
+    if (itr == processes_.end())
+      return false;
+    std::lock_guard<std::mutex> entry_lock(itr->second->mutex);
+    if (itr->second->status == ProcessStatus::kRunning) {
+      LOG(kWarning) << "RemoveProcess: process " << index << " is still running.";
+      return false;
+    }
+    // Any restart or heartbeat check still scheduled finds no entry, so is dropped.
+    itr->second->done = true;
+    itr->second->restart_pending = false;
+    process_info = itr->second;
+    processes_.erase(itr);
+  }
+  sampler_.Erase(index);
+  output_logger_.Close(index);
+  LOG(kVerbose) << "RemoveProcess: ID: " << index;
+  // The entry (and with it the heartbeat's shared memory) is freed once no other thread holds it.
+  return true;
 }
 
 size_t ProcessManager::NumberOfProcesses() const {
-  std::lock_guard<std::mutex> lock(mutex_);
+  boost::shared_lock<boost::shared_mutex> lock(processes_mutex_);
   return processes_.size();
 }
 
 size_t ProcessManager::NumberOfLiveProcesses() const {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return std::count_if(processes_.begin(), processes_.end(), [](const ProcessInfo & process_info) {
-    return !process_info.done && process_info.thread.joinable();
+  size_t count(0);
+  ForEachProcess([&count](ProcessInfo & process_info) {
+    if (!process_info.done &&
+        (process_info.status == ProcessStatus::kRunning || process_info.restart_pending))
+      ++count;
   });
+  return count;
 }
 
 size_t ProcessManager::NumberOfSleepingProcesses() const {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return std::count_if(processes_.begin(), processes_.end(), [](const ProcessInfo & process_info) {
-    return !process_info.done;
-  });  // NOLINT (Fraser)
+  size_t count(0);
+  ForEachProcess([&count](ProcessInfo & process_info) {
+    if (!process_info.done)
+      ++count;
+  });
+  return count;
 }
 
-std::vector<ProcessManager::ProcessInfo>::iterator ProcessManager::FindProcess(ProcessIndex index) {
-  return std::find_if(processes_.begin(), processes_.end(), [index](ProcessInfo & process_info) {
-    return (process_info.index == index);
-  });
+std::shared_ptr<ProcessManager::ProcessInfo> ProcessManager::FindProcess(
+    ProcessIndex index) const {
+  boost::shared_lock<boost::shared_mutex> lock(processes_mutex_);
+  auto itr(processes_.find(index));
+  return itr == processes_.end() ? nullptr : itr->second;
 }
 
-void ProcessManager::StartProcess(ProcessIndex index) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto itr = FindProcess(index);
-  if (itr == processes_.end())
-    return;
-  (*itr).done = false;
-  (*itr).restart_count = 0;
-  LOG(kInfo) << "StartProcess: AddStatus. ID: " << index;
-  (*itr).thread =
-      std::move(boost::thread([=] { RunProcess(index, false, false); }));  // NOLINT (Fraser)
+void ProcessManager::ForEachProcess(std::function<void(ProcessInfo&)> functor) const {
+  boost::shared_lock<boost::shared_mutex> lock(processes_mutex_);
+  for (const auto& entry : processes_) {
+    std::lock_guard<std::mutex> entry_lock(entry.second->mutex);
+    functor(*entry.second);
+  }
 }
 
-void ProcessManager::RunProcess(ProcessIndex index, bool restart, bool logging) {
-  std::string process_name;
-  std::vector<std::string> process_args;
+void ProcessManager::NotifyStateChanged(const std::vector<ProcessEvent>& events) {
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  cond_var_.notify_all();
+  for (const auto& event : events)
+    on_process_event_(event);
+}
+
+void ProcessManager::StartProcess(ProcessIndex index) {
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
+    return;
+  std::vector<ProcessEvent> events;
   {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto itr = FindProcess(index);
-    if (itr == processes_.end()) {
-      LOG(kError) << "RunProcess: process with specified VMID cannot be found";
+    std::lock_guard<std::mutex> lock(process_info->mutex);
+    process_info->done = false;
+    process_info->restart_tracker.Reset();
+    process_info->restart_pending = false;
+    if (process_info->status == ProcessStatus::kRunning) {
+      LOG(kWarning) << "StartProcess: process " << index << " is already running.";
       return;
     }
-    process_name = (*itr).process.name();
-    process_args = (*itr).process.args();
+    LOG(kInfo) << "StartProcess: AddStatus. ID: " << index;
+    LaunchProcess(*process_info, events);
   }
+  NotifyStateChanged(events);
+}
 
-  if (restart) {
-    Sleep(std::chrono::milliseconds(600));
-    // SetInstruction(id, ProcessInstruction::kRun);
-    //    if (logging) {
-    //      log::FilterMap filter;
-    //      filter["*"] = log::kVerbose;
-    //      log::Logging::instance().SetFilter(filter);
-    //      log::Logging::instance().SetAsync(true);
-    //    }
-  }
+bool ProcessManager::LaunchProcess(ProcessInfo& process_info,
+                                   std::vector<ProcessEvent>& events) {
   boost::system::error_code error_code;
-  // TODO(Fraser#5#): 2012-08-29 - Handle logging to a file.  See:
-  // http://www.highscore.de/boost/process0.5/boost_process/tutorial.html#boost_process.tutorial.setting_up_standard_streams
-  // NOLINT (Fraser)
-  SetProcessStatus(index, ProcessStatus::kRunning);
-  bp::child child(bp::execute(
-      bp::initializers::run_exe(process_name),
-      bp::initializers::set_cmd_line(process::ConstructCommandLine(process_args)),
-      bp::initializers::set_on_error(error_code),
-      bp::initializers::inherit_env()));
-  boost::system::error_code error;
-  auto exit_code = wait_for_exit(child, error);
-  if (error) {
-    LOG(kError) << "Error waiting for child to exit: " << error.message();
+  int cgroup_fd(-1), output_fd(-1);
+#ifdef MAIDSAFE_LINUX
+  const ResourceLimits& limits(process_info.process.resource_limits());
+  if (!limits.Empty() && cgroups_.Prepare(CgroupName(process_info.index), limits))
+    cgroup_fd = cgroups_.OpenProcsFile(CgroupName(process_info.index));
+  const fs::path output_log_file(process_info.process.output_log_file());
+  if (!output_log_file.empty())
+    output_fd = output_logger_.Open(process_info.index, output_log_file);
+#endif
+  const CpuPlacement cpu_placement(process_info.process.cpu_placement());
+  if (process_info.heartbeat)
+    process_info.heartbeat->Reset();
+  bool spawned(spawner_.Spawn(
+      detail::SpawnRequest(process_info.process.name(), process_info.argv,
+                           process_info.command_line, cpu_placement, cgroup_fd, output_fd),
+      process_info.child, error_code));
+#ifdef MAIDSAFE_LINUX
+  if (cgroup_fd != -1)
+    close(cgroup_fd);
+  // The reader only sees the end of the pipe once the child has exited.
+  if (output_fd != -1)
+    close(output_fd);
+#endif
+  if (!spawned) {
+    LOG(kError) << "Failed to start process " << process_info.index << ": "
+                << error_code.message();
+    process_info.status = ProcessStatus::kError;
+    events.emplace_back(process_info.index, ProcessEvent::Type::kGivenUp);
+    return false;
   }
-  SetProcessStatus(index, ProcessStatus::kStopped);
-  LOG(kInfo) << "Process " << index << " has completed with exit code " << exit_code;
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto itr(FindProcess(index));
-    LOG(kInfo) << "Restart count = " << (*itr).restart_count;
-    if ((*itr).done)
-      return;
+  process_info.status = ProcessStatus::kRunning;
+  process_info.restart_tracker.OnStart(std::chrono::steady_clock::now());
+  reaper_.Add(process_info.index, process_info.child);
+  sampler_.Add(process_info.index, SystemProcessId(process_info.child));
+  if (process_info.heartbeat) {
+    process_info.heartbeat_count = 0;
+    process_info.heartbeat_deadline =
+        std::chrono::steady_clock::now() + process_info.process.heartbeat_policy().startup_timeout;
+    Schedule(process_info.heartbeat_deadline, process_info.index);
+  }
+  events.emplace_back(process_info.index, ProcessEvent::Type::kSpawned);
+  return true;
+}
 
-    if ((*itr).restart_count > 4) {
-      LOG(kInfo) << "A process " << (*itr).index << " is consistently failing. Stopping..."
-                 << " Restart count = " << (*itr).restart_count;
-      return;
+void ProcessManager::Supervise() {
+  const std::chrono::milliseconds kIdleWait(std::chrono::hours(1));
+  while (!stop_supervising_) {
+    std::chrono::milliseconds wait(kIdleWait);
+    {
+      std::lock_guard<std::mutex> lock(schedule_mutex_);
+      if (!schedule_.empty()) {
+        wait = std::max(std::chrono::milliseconds(0),
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                            schedule_.begin()->first - std::chrono::steady_clock::now()));
+      }
     }
 
-    if ((*itr).restart_count < 3) {
-      ++(*itr).restart_count;
-      logging = false;
-    } else {
-      ++(*itr).restart_count;
-      logging = true;
+    std::vector<ProcessEvent> events;
+    for (const auto& exit : reaper_.Wait(wait)) {
+      std::shared_ptr<ProcessInfo> process_info(FindProcess(exit.index));
+      if (!process_info)
+        continue;
+      std::lock_guard<std::mutex> lock(process_info->mutex);
+      HandleProcessExit(*process_info, exit.exit_code, events);
     }
+
+    std::vector<ProcessIndex> due;
+    {
+      std::lock_guard<std::mutex> lock(schedule_mutex_);
+      auto now(std::chrono::steady_clock::now());
+      while (!schedule_.empty() && schedule_.begin()->first <= now) {
+        due.push_back(schedule_.begin()->second);
+        schedule_.erase(schedule_.begin());
+      }
+    }
+    for (const auto& index : due) {
+      std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+      if (!process_info)
+        continue;
+      std::lock_guard<std::mutex> lock(process_info->mutex);
+      auto now(std::chrono::steady_clock::now());
+      if (process_info->termination_stage != TerminationStage::kNone &&
+          process_info->termination_deadline <= now)
+        EscalateTermination(*process_info);
+      if (process_info->heartbeat && process_info->heartbeat_deadline <= now)
+        CheckHeartbeat(*process_info, events);
+      if (!process_info->restart_pending || process_info->restart_time > now)
+        continue;
+      process_info->restart_pending = false;
+      if (!process_info->done)
+        LaunchProcess(*process_info, events);
+    }
+    NotifyStateChanged(events);
   }
-  RunProcess(index, true, logging);
+}
+
+void ProcessManager::HandleProcessExit(ProcessInfo& process_info, int exit_code,
+                                       std::vector<ProcessEvent>& events) {
+  process_info.status = ProcessStatus::kStopped;
+  process_info.stop_stage = process_info.termination_stage;
+  process_info.termination_stage = TerminationStage::kNone;
+  sampler_.Remove(process_info.index);
+  LOG(kInfo) << "Process " << process_info.index << " has completed with exit code " << exit_code
+             << " at termination stage " << static_cast<int>(process_info.stop_stage);
+  ProcessEvent exited(process_info.index, ProcessEvent::Type::kExited);
+  exited.exit_code = exit_code;
+  exited.stop_stage = process_info.stop_stage;
+  events.push_back(exited);
+  // A process which isn't being restarted has no further use for its cgroup.  If it's started again
+  // later, LaunchProcess recreates the group.
+  if (process_info.done) {
+    cgroups_.Remove(CgroupName(process_info.index));
+    return;
+  }
+
+  auto now(std::chrono::steady_clock::now());
+  std::chrono::milliseconds delay(0);
+  if (!process_info.restart_tracker.OnExit(now, delay)) {
+    LOG(kInfo) << "A process " << process_info.index << " is consistently failing. Stopping..."
+               << " Crashes in window = " << process_info.restart_tracker.crashes_in_window();
+    events.emplace_back(process_info.index, ProcessEvent::Type::kGivenUp);
+    cgroups_.Remove(CgroupName(process_info.index));
+    return;
+  }
+
+  LOG(kInfo) << "Restarting process " << process_info.index << " in " << delay.count()
+             << " ms.  Consecutive crashes = "
+             << process_info.restart_tracker.consecutive_crashes();
+  process_info.restart_pending = true;
+  process_info.restart_time = now + delay;
+  ProcessEvent restarting(process_info.index, ProcessEvent::Type::kRestarting);
+  restarting.restart_delay = delay;
+  events.push_back(restarting);
+  Schedule(process_info.restart_time, process_info.index);
+}
+
+void ProcessManager::BeginTermination(ProcessInfo& process_info, bool shutdown_requested) {
+  if (process_info.status != ProcessStatus::kRunning ||
+      process_info.termination_stage != TerminationStage::kNone)
+    return;
+  process_info.termination_stage = TerminationStage::kShutdownRequest;
+  // Nothing will ask the process to stop, so there's no point waiting for it to.
+  if (!shutdown_requested) {
+    EscalateTermination(process_info);
+    return;
+  }
+  process_info.termination_deadline =
+      std::chrono::steady_clock::now() +
+      process_info.process.termination_policy().shutdown_request_timeout;
+  Schedule(process_info.termination_deadline, process_info.index);
+}
+
+void ProcessManager::EscalateTermination(ProcessInfo& process_info) {
+  // Once reaped, the child's pid may have been reused.
+  if (process_info.status != ProcessStatus::kRunning)
+    return;
+  const TerminationPolicy policy(process_info.process.termination_policy());
+  switch (process_info.termination_stage) {
+    case TerminationStage::kShutdownRequest:
+#ifndef MAIDSAFE_WIN32
+      if (policy.terminate_timeout.count() != 0) {
+        LOG(kWarning) << "Process " << process_info.index << " is still running.  "
+                      << "Sending SIGTERM...";
+        kill(process_info.child.pid, SIGTERM);
+        process_info.termination_stage = TerminationStage::kTerminate;
+        process_info.termination_deadline =
+            std::chrono::steady_clock::now() + policy.terminate_timeout;
+        Schedule(process_info.termination_deadline, process_info.index);
+        break;
+      }
+#endif
+    // Fall through.
+    case TerminationStage::kTerminate:
+      LOG(kWarning) << "Process " << process_info.index << " still hasn't stopped.  Killing...";
+      bp::terminate(process_info.child);
+      process_info.termination_stage = TerminationStage::kKill;
+      process_info.termination_deadline = std::chrono::steady_clock::time_point::max();
+      break;
+    default:
+      break;
+  }
+}
+
+void ProcessManager::CheckHeartbeat(ProcessInfo& process_info,
+                                    std::vector<ProcessEvent>& events) {
+  if (process_info.status != ProcessStatus::kRunning ||
+      process_info.termination_stage != TerminationStage::kNone)
+    return;
+  const HeartbeatPolicy policy(process_info.process.heartbeat_policy());
+  uint64_t count(process_info.heartbeat->Count());
+  if (count != process_info.heartbeat_count) {
+    process_info.heartbeat_count = count;
+    process_info.heartbeat_deadline = std::chrono::steady_clock::now() + policy.timeout;
+    Schedule(process_info.heartbeat_deadline, process_info.index);
+    return;
+  }
+  if (count == 0 && policy.armed_by_first_beat) {
+    // Checked again later in case it's only slow to start.
+    process_info.heartbeat_deadline = std::chrono::steady_clock::now() + policy.timeout;
+    Schedule(process_info.heartbeat_deadline, process_info.index);
+    return;
+  }
+  ++process_info.hang_count;
+  LOG(kWarning) << "Process " << process_info.index << " has missed its heartbeat deadline ("
+                << (count == 0 ? "never beat" : "last count " + std::to_string(count))
+                << ").  Killing...  Hang count = " << process_info.hang_count;
+  events.emplace_back(process_info.index, ProcessEvent::Type::kUnresponsive);
+  events.back().hang_count = process_info.hang_count;
+  // The exit is then handled as a crash, so the process is restarted according to its policy.
+  bp::terminate(process_info.child);
+  process_info.heartbeat_deadline = std::chrono::steady_clock::time_point::max();
+}
+
+void ProcessManager::Schedule(std::chrono::steady_clock::time_point time, ProcessIndex index) {
+  bool earliest(false);
+  {
+    std::lock_guard<std::mutex> lock(schedule_mutex_);
+    earliest = schedule_.empty() || time < schedule_.begin()->first;
+    schedule_.insert(std::make_pair(time, index));
+  }
+  // The supervisor may need to wake earlier than it had planned to.
+  if (earliest)
+    reaper_.Wake();
 }
 
 void ProcessManager::LetProcessDie(ProcessIndex index) {
   LOG(kVerbose) << "LetProcessDie: ID: " << index;
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto itr = FindProcess(index);
-  if (itr == processes_.end())
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
     return;
-  (*itr).done = true;
+  {
+    std::lock_guard<std::mutex> lock(process_info->mutex);
+    process_info->done = true;
+  }
+  NotifyStateChanged();
 }
 
 void ProcessManager::LetAllProcessesDie() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  for (auto& process : processes_)
-    process.done = true;
+  ForEachProcess([](ProcessInfo & process_info) { process_info.done = true; });
+  NotifyStateChanged();
 }
 
 void ProcessManager::WaitForProcesses() {
-  bool done(false);
-  boost::thread thread;
-  while (!done) {
-    done = true;
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      for (auto& process : processes_) {
-        if (!process.done) {
-          done = false;
-          break;
-        }
-        if (process.thread.joinable()) {
-          thread = std::move(process.thread);
-          done = false;
-          break;
-        }
-      }
-    }
-    thread.join();
-    Sleep(std::chrono::milliseconds(100));
-  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_var_.wait(lock, [this]()->bool {
+    bool all_stopped(true);
+    ForEachProcess([&all_stopped](ProcessInfo & process_info) {
+      if (!process_info.done || process_info.status == ProcessStatus::kRunning)
+        all_stopped = false;
+    });
+    return all_stopped;
+  });
 }
 
 void ProcessManager::KillProcess(ProcessIndex index) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto itr = FindProcess(index);
-  if (itr == processes_.end())
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
     return;
-  (*itr).done = true;
-  bp::terminate((*itr).child);
+  {
+    std::lock_guard<std::mutex> lock(process_info->mutex);
+    process_info->done = true;
+    // Once reaped, the child's pid may have been reused.
+    if (process_info->status == ProcessStatus::kRunning) {
+      bp::terminate(process_info->child);
+      process_info->termination_stage = TerminationStage::kKill;
+      process_info->termination_deadline = std::chrono::steady_clock::time_point::max();
+    }
+  }
+  NotifyStateChanged();
 }
 
-void ProcessManager::StopProcess(ProcessIndex index) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto itr = FindProcess(index);
-  if (itr == processes_.end())
+void ProcessManager::StopProcess(ProcessIndex index, bool shutdown_requested) {
+  LOG(kVerbose) << "StopProcess: ID: " << index;
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
     return;
-  (*itr).done = true;
+  {
+    std::lock_guard<std::mutex> lock(process_info->mutex);
+    process_info->done = true;
+    BeginTermination(*process_info, shutdown_requested);
+  }
+  NotifyStateChanged();
 }
 
 void ProcessManager::RestartProcess(ProcessIndex index) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto itr = FindProcess(index);
-  if (itr == processes_.end())
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
     return;
-  (*itr).done = false;
+  std::lock_guard<std::mutex> lock(process_info->mutex);
+  process_info->done = false;
   // SetInstruction(id, ProcessInstruction::kTerminate);
 }
 
 ProcessStatus ProcessManager::GetProcessStatus(ProcessIndex index) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto itr = FindProcess(index);
-  if (itr == processes_.end())
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
     return ProcessStatus::kError;
-  return (*itr).status;
+  std::lock_guard<std::mutex> lock(process_info->mutex);
+  return process_info->status;
 }
 
 bool ProcessManager::WaitForProcessToStop(ProcessIndex index) {
-  std::unique_lock<std::mutex> lock(mutex_);
-  auto itr = FindProcess(index);
-  if (itr == processes_.end())
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
     return false;
-  if (cond_var_.wait_for(lock, std::chrono::seconds(5), [&]()->bool {
-        return (*itr).status != ProcessStatus::kRunning;
-      }))  // NOLINT (Philip)
+  // Only this process's exit is of interest, so rather than waking on every change of state via
+  // cond_var_, wait for its kExited event.
+  auto exited(std::make_shared<std::promise<void>>());
+  auto signalled(std::make_shared<std::atomic<bool>>(false));
+  boost::signals2::scoped_connection connection(on_process_event_.connect(
+      [index, exited, signalled](const ProcessEvent & event) {
+        if (event.index == index && event.type == ProcessEvent::Type::kExited &&
+            !signalled->exchange(true))
+          exited->set_value();
+      }));
+  TerminationPolicy policy;
+  bool let_die(false), stopped(false);
+  {
+    std::lock_guard<std::mutex> lock(process_info->mutex);
+    if (process_info->status != ProcessStatus::kRunning) {
+      // One waiting out its restart delay would otherwise be relaunched after this has returned.
+      if (process_info->restart_pending) {
+        process_info->restart_pending = false;
+        cgroups_.Remove(CgroupName(index));
+      }
+      process_info->done = true;
+      stopped = true;
+    } else {
+      policy = process_info->process.termination_policy();
+      let_die = process_info->done;
+    }
+  }
+  if (stopped) {
+    NotifyStateChanged();
     return true;
-  LOG(kError) << "Wait for process " << index << " to stop timed out. Terminating...";
-  lock.unlock();
-  KillProcess(index);
-  return true;
+  }
+  // Has no effect if the process is already being stopped.  One that's been let die is expected to
+  // exit of its own accord, so is given the kShutdownRequest stage to do so.
+  StopProcess(index, let_die);
+  // A killed process should be reaped almost at once, so this is only reached if it can't be.
+  const std::chrono::milliseconds kKillTimeout(std::chrono::seconds(5));
+  if (exited->get_future().wait_for(policy.shutdown_request_timeout + policy.terminate_timeout +
+                                    kKillTimeout) == std::future_status::ready)
+    return true;
+  LOG(kError) << "Process " << index << " still hasn't exited after being killed.";
+  return false;
 }
 
-bool ProcessManager::SetProcessStatus(ProcessIndex index, const ProcessStatus& status) {
+TerminationStage ProcessManager::GetStopStage(ProcessIndex index) const {
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
+    return TerminationStage::kNone;
+  std::lock_guard<std::mutex> lock(process_info->mutex);
+  return process_info->stop_stage;
+}
+
+unsigned ProcessManager::GetHangCount(ProcessIndex index) const {
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
+    return 0;
+  std::lock_guard<std::mutex> lock(process_info->mutex);
+  return process_info->hang_count;
+}
+
+uint32_t ProcessManager::GetSystemProcessId(ProcessIndex index) const {
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
+    return 0;
+  std::lock_guard<std::mutex> lock(process_info->mutex);
+  return process_info->status == ProcessStatus::kRunning ? SystemProcessId(process_info->child)
+                                                         : 0;
+}
+
+uint32_t ProcessManager::SystemProcessId(const bp::child& child) {
+#ifdef MAIDSAFE_WIN32
+  return child.proc_info.dwProcessId;
+#else
+  return static_cast<uint32_t>(child.pid);
+#endif
+}
+
+std::vector<ResourceSample> ProcessManager::GetResourceSamples(ProcessIndex index) const {
+  return sampler_.Samples(index);
+}
+
+bool ProcessManager::GetResourceUsage(ProcessIndex index, ResourceUsage& resource_usage) const {
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
+    return false;
   {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto itr = FindProcess(index);
-    if (itr == processes_.end())
+    std::lock_guard<std::mutex> lock(process_info->mutex);
+    if (process_info->status != ProcessStatus::kRunning ||
+        process_info->process.resource_limits().Empty())
       return false;
-    (*itr).status = status;
   }
-  cond_var_.notify_all();
+  return cgroups_.ReadUsage(CgroupName(index), resource_usage);
+}
+
+bool ProcessManager::SetResourceLimits(ProcessIndex index, const ResourceLimits& resource_limits) {
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
+    return false;
+  std::lock_guard<std::mutex> lock(process_info->mutex);
+  // A running process only has a group if it was launched with limits.
+  const bool kInGroup(process_info->status == ProcessStatus::kRunning &&
+                      !process_info->process.resource_limits().Empty());
+  if (!process_info->process.SetResourceLimits(resource_limits))
+    return false;
+  return !kInGroup || cgroups_.Prepare(CgroupName(index), resource_limits);
+}
+
+bool ProcessManager::CpuLimitsAvailable() { return cgroups_.CpuAvailable(); }
+
+bool ProcessManager::SetExecutablePath(ProcessIndex index, const fs::path& executable_path) {
+  std::shared_ptr<ProcessInfo> process_info(FindProcess(index));
+  if (!process_info)
+    return false;
+  std::lock_guard<std::mutex> lock(process_info->mutex);
+  if (!process_info->process.SetExecutablePath(executable_path))
+    return false;
+  process_info->argv = detail::SplitArguments(process_info->process.args());
+  process_info->command_line = process::ConstructCommandLine(process_info->process.args());
   return true;
 }
 
 void ProcessManager::TerminateAll() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  for (auto& process : processes_) {
-    LOG(kInfo) << "Terminating: " << process.index << ", port: " << process.port;
-    if (process.thread.joinable() && process.status == ProcessStatus::kRunning)
-      process.thread.join();
-  }
+  // Nothing is restarted once the manager is being destroyed, and every running process is taken
+  // through its termination stages concurrently.  No shutdown requests are sent from here, so they
+  // start at SIGTERM.
+  ForEachProcess([this](ProcessInfo & process_info) {
+    LOG(kInfo) << "Terminating: " << process_info.index << ", port: " << process_info.port;
+    process_info.done = true;
+    process_info.restart_pending = false;
+    BeginTermination(process_info, false);
+  });
+  WaitForProcesses();
+  stop_supervising_ = true;
+  reaper_.Wake();
+  supervisor_.join();
+  // Each process's cgroup has already been removed as the process was reaped, leaving the manager's
+  // own.
+  cgroups_.Remove(kCgroupSubtree_);
+  boost::unique_lock<boost::shared_mutex> lock(processes_mutex_);
   processes_.clear();
 }
 
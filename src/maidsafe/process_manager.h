@@ -19,17 +19,34 @@
 #ifndef MAIDSAFE_CLIENT_MANAGER_PROCESS_MANAGER_H_
 #define MAIDSAFE_CLIENT_MANAGER_PROCESS_MANAGER_H_
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <mutex>
 #include <condition_variable>
 #include <cstdint>
 #include <limits>
+#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "boost/filesystem/path.hpp"
+#include "boost/thread/shared_mutex.hpp"
 #include "boost/thread/thread.hpp"
 
 #include "boost/process/child.hpp"
+#include "boost/signals2/signal.hpp"
+
+#include "maidsafe/client_manager/child_reaper.h"
+#include "maidsafe/client_manager/cpu_placement.h"
+#include "maidsafe/client_manager/heartbeat.h"
+#include "maidsafe/client_manager/output_logger.h"
+#include "maidsafe/client_manager/process_sampler.h"
+#include "maidsafe/client_manager/resource_limits.h"
+#include "maidsafe/client_manager/restart_policy.h"
+#include "maidsafe/client_manager/spawner.h"
 
 namespace maidsafe {
 
@@ -66,24 +83,139 @@ struct ProcessManagerStruct {
   ProcessInstruction instruction;
 };*/
 
+// The stages through which StopProcess escalates: the process is first given the chance to exit
+// after having been asked to (e.g. over IPC), then sent SIGTERM, then SIGKILL.  On Windows,
+// kTerminate is skipped.
+enum class TerminationStage {
+  // The process wasn't being stopped when it exited.
+  kNone,
+  kShutdownRequest,
+  kTerminate,
+  kKill
+};
+
+// How long each stage of StopProcess may take before escalating to the next.  A zero timeout skips
+// that stage.
+struct TerminationPolicy {
+  TerminationPolicy()
+      : shutdown_request_timeout(std::chrono::seconds(5)),
+        terminate_timeout(std::chrono::seconds(5)) {}
+  TerminationPolicy(std::chrono::milliseconds shutdown_request_timeout_in,
+                    std::chrono::milliseconds terminate_timeout_in)
+      : shutdown_request_timeout(shutdown_request_timeout_in),
+        terminate_timeout(terminate_timeout_in) {}
+  bool IsValid() const {
+    return shutdown_request_timeout.count() >= 0 && terminate_timeout.count() >= 0;
+  }
+  std::chrono::milliseconds shutdown_request_timeout, terminate_timeout;
+};
+
+// A change in a supervised process's lifecycle.  Every exit is reported with kExited, followed by
+// kRestarting or kGivenUp unless the process had been told to stop.  Failing to launch the process
+// is reported as kGivenUp.  A process which misses its heartbeat deadline is reported as
+// kUnresponsive and killed, its exit then being handled like any other crash.
+struct ProcessEvent {
+  enum class Type {
+    kSpawned,
+    kUnresponsive,
+    kExited,
+    kRestarting,
+    kGivenUp
+  };
+
+  ProcessEvent(ProcessIndex index_in, Type type_in)
+      : index(index_in),
+        type(type_in),
+        exit_code(0),
+        stop_stage(TerminationStage::kNone),
+        restart_delay(0),
+        hang_count(0) {}
+  ProcessIndex index;
+  Type type;
+  // Only set for kExited.
+  int exit_code;
+  TerminationStage stop_stage;
+  // Only set for kRestarting.
+  std::chrono::milliseconds restart_delay;
+  // Only set for kUnresponsive, so that subscribers needn't call back into ProcessManager.
+  unsigned hang_count;
+};
+
+typedef boost::signals2::signal<void(const ProcessEvent&)> OnProcessEvent;
+
 class Process {
  public:
-  Process() : args_(), name_() {}
+  Process()
+      : args_(),
+        name_(),
+        restart_policy_(),
+        resource_limits_(),
+        cpu_placement_(),
+        termination_policy_(),
+        heartbeat_policy_(),
+        output_log_file_() {}
   bool SetExecutablePath(const boost::filesystem::path& executable_path);
+  // The process's stdout and stderr are written to 'output_log_file' (see detail::OutputLogger).
+  // If this isn't set, they are inherited from the manager.
+  bool SetOutputLogFile(const boost::filesystem::path& output_log_file);
   void AddArgument(const std::string& argument) { args_.push_back(argument); }
+  bool SetRestartPolicy(const RestartPolicy& restart_policy);
+  bool SetResourceLimits(const ResourceLimits& resource_limits);
+  bool SetCpuPlacement(const CpuPlacement& cpu_placement);
+  bool SetTerminationPolicy(const TerminationPolicy& termination_policy);
+  // The process is expected to beat via a detail::Heartbeat named by detail::HeartbeatName().
+  bool SetHeartbeatPolicy(const HeartbeatPolicy& heartbeat_policy);
   std::string name() const { return name_; }
   std::vector<std::string> args() const { return args_; }
+  RestartPolicy restart_policy() const { return restart_policy_; }
+  ResourceLimits resource_limits() const { return resource_limits_; }
+  CpuPlacement cpu_placement() const { return cpu_placement_; }
+  TerminationPolicy termination_policy() const { return termination_policy_; }
+  HeartbeatPolicy heartbeat_policy() const { return heartbeat_policy_; }
+  boost::filesystem::path output_log_file() const { return output_log_file_; }
 
  private:
   std::vector<std::string> args_;
   std::string name_;
+  RestartPolicy restart_policy_;
+  ResourceLimits resource_limits_;
+  CpuPlacement cpu_placement_;
+  TerminationPolicy termination_policy_;
+  HeartbeatPolicy heartbeat_policy_;
+  boost::filesystem::path output_log_file_;
 };
 
+// All child processes are supervised by a single thread, which is woken by detail::ChildReaper when
+// any of them exits and which also carries out any pending restarts and termination escalations
+// once they fall due.  Stopping many processes therefore takes no longer than stopping the slowest.
+//
+// Processes are held in a hash table of individually-allocated entries, each with its own mutex.
+// The table's shared_mutex is only held exclusively while adding or removing entries.  Entries are
+// shared, so a located entry can still be used after releasing it, even if it's since been removed.
+//
+// A process with non-empty ResourceLimits is placed in its own cgroup (see detail::Cgroups) before
+// it is exec'd, and the group is removed once the process is reaped and isn't to be restarted.  If
+// cgroups are unavailable, it is run without limits.  Similarly, a process's CpuPlacement (either
+// its own, or one assigned according to the PlacementStrategy when it is added) is applied to it
+// before it is exec'd.
+//
+// The output of every process with an output log file is collected by a single
+// detail::OutputLogger, which keeps writing to the same file across restarts.
+//
+// A process with a non-empty HeartbeatPolicy is given a detail::HeartbeatMonitor when it is added.
+// The supervisor checks its counter whenever the current deadline falls due, so a hang is detected
+// between one and two timeouts after the last beat.  Processes being stopped aren't checked.
 class ProcessManager {
  public:
-  ProcessManager();
+  explicit ProcessManager(SpawnBackend spawn_backend = SpawnBackend::kBoostProcess);
   ~ProcessManager();
+  // Only affects processes added subsequently.
+  void SetPlacementStrategy(PlacementStrategy placement_strategy);
   ProcessIndex AddProcess(Process process, uint16_t port);
+  // Forgets a process which isn't running, along with its heartbeat and samples, so that its index
+  // becomes invalid.  Its output log is closed once its remaining output has been written.  Returns
+  // false if the process is unknown or still running.
+  bool RemoveProcess(ProcessIndex index);
   size_t NumberOfProcesses() const;
   size_t NumberOfLiveProcesses() const;
   size_t NumberOfSleepingProcesses() const;
@@ -92,21 +224,61 @@ class ProcessManager {
   void LetAllProcessesDie();
   void WaitForProcesses();
   void KillProcess(ProcessIndex index);
-  void StopProcess(ProcessIndex index);
+  // Stops the process without restarting it, escalating according to its TerminationPolicy.
+  // Doesn't block.  The kShutdownRequest stage is only waited out if 'shutdown_requested' is true,
+  // i.e. if the caller has asked (or is about to ask) the process to shut down; otherwise SIGTERM
+  // is sent straight away.
+  void StopProcess(ProcessIndex index, bool shutdown_requested = false);
   void RestartProcess(ProcessIndex index);
   ProcessStatus GetProcessStatus(ProcessIndex index);
+  // Blocks until the process has exited, calling StopProcess first if it hasn't already been (with
+  // 'shutdown_requested' true only if LetProcessDie was called).  A restart pending after a crash
+  // is cancelled.  Returns false if the process is unknown, or if it fails to exit even after
+  // SIGKILL.
   bool WaitForProcessToStop(ProcessIndex index);
+  // The stage at which the process last exited.
+  TerminationStage GetStopStage(ProcessIndex index) const;
+  // The number of times the process has been killed for missing its heartbeat deadline.
+  unsigned GetHangCount(ProcessIndex index) const;
+  // Returns 0 if the process isn't running.
+  uint32_t GetSystemProcessId(ProcessIndex index) const;
+  // The most recent samples, oldest first, taken every detail::ProcessSampler::kDefaultInterval()
+  // while the process runs.  Retained after it exits, until it is restarted.
+  std::vector<ResourceSample> GetResourceSamples(ProcessIndex index) const;
+  // Returns false if the process isn't running in a cgroup.
+  bool GetResourceUsage(ProcessIndex index, ResourceUsage& resource_usage) const;
+  // Replaces the process's limits.  If it's running in a cgroup, they're applied immediately;
+  // otherwise they take effect the next time it's launched.
+  bool SetResourceLimits(ProcessIndex index, const ResourceLimits& resource_limits);
+  // Returns false if CPU limits can't be applied, in which case processes run with unlimited CPU.
+  bool CpuLimitsAvailable();
+  // Takes effect the next time the process is launched.
+  bool SetExecutablePath(ProcessIndex index, const boost::filesystem::path& executable_path);
+  // Handlers are invoked on the thread which caused the event (normally the supervisor thread) with
+  // no locks held, so they may call back into the manager, but they should return promptly.
+  OnProcessEvent& on_process_event() { return on_process_event_; }
   static ProcessIndex kInvalidIndex() { return std::numeric_limits<ProcessIndex>::max(); }
 
  private:
   struct ProcessInfo {
     ProcessInfo()
-        : process(),
-          thread(),
+        : mutex(),
+          process(),
           index(0),
           port(0),
-          restart_count(0),
+          argv(),
+          command_line(),
+          restart_tracker(),
           done(false),
+          restart_pending(false),
+          restart_time(),
+          termination_stage(TerminationStage::kNone),
+          termination_deadline(),
+          stop_stage(TerminationStage::kNone),
+          heartbeat(),
+          heartbeat_count(0),
+          heartbeat_deadline(),
+          hang_count(0),
           status(ProcessStatus::kStopped),
 #ifdef MAIDSAFE_WIN32
           child(PROCESS_INFORMATION()) {
@@ -114,29 +286,87 @@ class ProcessManager {
 #else
     child(0) {}
 #endif
-    ProcessInfo(ProcessInfo&& other);
-    ProcessInfo& operator=(ProcessInfo&& other);
+    std::mutex mutex;
     Process process;
-    boost::thread thread;
     ProcessIndex index;
     uint16_t port;
-    int32_t restart_count;
-    bool done;
+    // Built once from process.args(), in the forms required by the spawn backends.
+    std::vector<std::string> argv;
+    std::string command_line;
+    detail::RestartTracker restart_tracker;
+    bool done, restart_pending;
+    std::chrono::steady_clock::time_point restart_time;
+    // The stage currently reached by StopProcess, and when it escalates to the next.
+    TerminationStage termination_stage;
+    std::chrono::steady_clock::time_point termination_deadline;
+    // The stage at which the process last exited.
+    TerminationStage stop_stage;
+    // Only set if the process has a non-empty HeartbeatPolicy.  'heartbeat_count' is the count last
+    // seen, and 'heartbeat_deadline' when it is next checked.
+    std::unique_ptr<detail::HeartbeatMonitor> heartbeat;
+    uint64_t heartbeat_count;
+    std::chrono::steady_clock::time_point heartbeat_deadline;
+    unsigned hang_count;
     ProcessStatus status;
     boost::process::child child;
   };
 
+  typedef std::unordered_map<ProcessIndex, std::shared_ptr<ProcessInfo>> ProcessTable;
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
   ProcessManager(const ProcessManager&);
   ProcessManager& operator=(const ProcessManager&);
-  std::vector<ProcessInfo>::iterator FindProcess(ProcessIndex index);
-  void RunProcess(ProcessIndex index, bool restart, bool logging);
+  // Returns nullptr if not found.
+  std::shared_ptr<ProcessInfo> FindProcess(ProcessIndex index) const;
+  // Applies 'functor' to each entry in turn with its mutex locked.
+  void ForEachProcess(std::function<void(ProcessInfo&)> functor) const;  // NOLINT (Fraser)
+  // Wakes any threads waiting on cond_var_ and then publishes 'events'.  Must be called after
+  // changing an entry's status or done flag, once its mutex has been released.
+  void NotifyStateChanged(const std::vector<ProcessEvent>& events = std::vector<ProcessEvent>());
+  void Supervise();
+  // NOTE: process_info.mutex must be locked when calling these functions.  Resulting events are
+  // appended to 'events', to be published once the mutex has been released.
+  bool LaunchProcess(ProcessInfo& process_info, std::vector<ProcessEvent>& events);
+  void HandleProcessExit(ProcessInfo& process_info, int exit_code,
+                         std::vector<ProcessEvent>& events);
+  // NOTE: process_info.mutex must be locked when calling these functions.
+  void BeginTermination(ProcessInfo& process_info, bool shutdown_requested);
+  void EscalateTermination(ProcessInfo& process_info);
+  void CheckHeartbeat(ProcessInfo& process_info, std::vector<ProcessEvent>& events);
+  void Schedule(std::chrono::steady_clock::time_point time, ProcessIndex index);
   void TerminateAll();
-  bool SetProcessStatus(ProcessIndex index, const ProcessStatus& status);
+  std::string CgroupName(ProcessIndex index) const {
+    return kCgroupSubtree_ + "/process_" + std::to_string(index);
+  }
+  static uint32_t SystemProcessId(const boost::process::child& child);
 
-  std::vector<ProcessInfo> processes_;
+  // Declared first so that a zygote is forked before any of this manager's threads are started.
+  detail::Spawner spawner_;
+  ProcessTable processes_;
   ProcessIndex current_max_id_;
+  // Guarded by processes_mutex_, along with processes_ and current_max_id_.
+  PlacementStrategy placement_strategy_;
+  size_t placed_count_;
+  mutable boost::shared_mutex processes_mutex_;
+  // Restarts, termination escalations and heartbeat checks due, in time order.  Entries may be
+  // stale (e.g. if the process has since been stopped), so each is checked against its process's
+  // restart_time, termination_deadline or heartbeat_deadline before being acted on.
+  std::multimap<TimePoint, ProcessIndex> schedule_;
+  std::mutex schedule_mutex_;
+  // Only used along with cond_var_ when waiting for a change of state.
   mutable std::mutex mutex_;
   std::condition_variable cond_var_;
+  OnProcessEvent on_process_event_;
+  // This manager's processes' groups are kept beneath a group of its own, so that they can't clash
+  // with those of another manager sharing the delegated cgroup, e.g. while it's being replaced.
+  const std::string kCgroupSubtree_;
+  detail::Cgroups cgroups_;
+  const detail::CpuTopology cpu_topology_;
+  detail::ProcessSampler sampler_;
+  detail::OutputLogger output_logger_;
+  detail::ChildReaper reaper_;
+  std::atomic<bool> stop_supervising_;
+  boost::thread supervisor_;
 };
 
 }  // namespace client_manager
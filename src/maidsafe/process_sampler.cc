@@ -0,0 +1,254 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/process_sampler.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+namespace {
+
+#ifdef MAIDSAFE_LINUX
+
+// These files are small and generated on each read, so are read with a single system call into a
+// stack buffer rather than via iostreams.  Returns the length read, or 0 on failure.
+size_t ReadProcFile(uint32_t pid, const char* name, char* buffer, size_t size) {
+  char path[64];
+  std::snprintf(path, sizeof(path), "/proc/%u/%s", pid, name);
+  int fd(open(path, O_RDONLY | O_CLOEXEC));
+  if (fd == -1)
+    return 0;
+  ssize_t length(read(fd, buffer, size - 1));
+  close(fd);
+  if (length <= 0)
+    return 0;
+  buffer[length] = '\0';
+  return static_cast<size_t>(length);
+}
+
+// Returns the value following 'key' in 'text', e.g. 1024 for "VmSwap:" in "VmSwap:\t 1024 kB".
+uint64_t FindValue(const char* text, const char* key) {
+  const char* position(std::strstr(text, key));
+  return position ? std::strtoull(position + std::strlen(key), nullptr, 10) : 0;
+}
+
+uint32_t CountOpenFds(uint32_t pid) {
+  char path[64];
+  std::snprintf(path, sizeof(path), "/proc/%u/fd", pid);
+  // Since Linux 6.2 the directory's size is the number of open descriptors, which saves listing it.
+  struct stat fd_directory;
+  if (stat(path, &fd_directory) == 0 && fd_directory.st_size > 0)
+    return static_cast<uint32_t>(fd_directory.st_size);
+  DIR* directory(opendir(path));
+  if (!directory)
+    return 0;
+  uint32_t count(0);
+  while (dirent* entry = readdir(directory)) {
+    if (entry->d_name[0] != '.')
+      ++count;
+  }
+  closedir(directory);
+  return count;
+}
+
+#endif
+
+}  // unnamed namespace
+
+SampleRing::SampleRing(size_t capacity) : buffer_(capacity), next_(0), full_(false) {}
+
+void SampleRing::Push(const ResourceSample& sample) {
+  if (buffer_.empty())
+    return;
+  buffer_[next_] = sample;
+  if (++next_ == buffer_.size()) {
+    next_ = 0;
+    full_ = true;
+  }
+}
+
+std::vector<ResourceSample> SampleRing::Contents() const {
+  std::vector<ResourceSample> contents;
+  contents.reserve(Size());
+  if (full_)
+    contents.assign(buffer_.begin() + next_, buffer_.end());
+  contents.insert(contents.end(), buffer_.begin(), buffer_.begin() + next_);
+  return contents;
+}
+
+void SampleRing::Clear() {
+  next_ = 0;
+  full_ = false;
+}
+
+ProcessSampler::ProcessSampler(std::chrono::milliseconds interval, size_t window)
+    : kInterval_(std::move(interval)),
+      kWindow_(window),
+      entries_(),
+      mutex_(),
+      cond_var_(),
+      stop_(false),
+      thread_() {
+  thread_ = boost::thread([this] { Run(); });
+}
+
+ProcessSampler::~ProcessSampler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_var_.notify_one();
+  thread_.join();
+}
+
+void ProcessSampler::Add(ProcessIndex index, uint32_t pid) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(entries_.find(index));
+  if (itr == entries_.end()) {
+    entries_.insert(std::make_pair(index, Entry(pid, kWindow_)));
+  } else {
+    itr->second.pid = pid;
+    itr->second.active = true;
+    itr->second.samples.Clear();
+  }
+}
+
+void ProcessSampler::Remove(ProcessIndex index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(entries_.find(index));
+  if (itr != entries_.end())
+    itr->second.active = false;
+}
+
+void ProcessSampler::Erase(ProcessIndex index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.erase(index);
+}
+
+std::vector<ResourceSample> ProcessSampler::Samples(ProcessIndex index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(entries_.find(index));
+  return itr == entries_.end() ? std::vector<ResourceSample>() : itr->second.samples.Contents();
+}
+
+void ProcessSampler::SampleAll() {
+  std::vector<std::pair<ProcessIndex, uint32_t>> targets;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    targets.reserve(entries_.size());
+    for (const auto& entry : entries_) {
+      if (entry.second.active)
+        targets.emplace_back(entry.first, entry.second.pid);
+    }
+  }
+
+  // The files are read without holding mutex_, so a process may have been removed or re-added in
+  // the meantime; such samples are discarded.
+  std::vector<std::pair<size_t, ResourceSample>> samples;
+  samples.reserve(targets.size());
+  for (size_t i(0); i != targets.size(); ++i) {
+    ResourceSample sample;
+    if (Sample(targets[i].second, sample))
+      samples.emplace_back(i, sample);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& sample : samples) {
+    auto itr(entries_.find(targets[sample.first].first));
+    if (itr != entries_.end() && itr->second.active &&
+        itr->second.pid == targets[sample.first].second)
+      itr->second.samples.Push(sample.second);
+  }
+}
+
+#ifdef MAIDSAFE_LINUX
+bool ProcessSampler::Sample(uint32_t pid, ResourceSample& sample) {
+  static const int64_t kTicksPerSecond(sysconf(_SC_CLK_TCK));
+  static const uint64_t kPageSize(static_cast<uint64_t>(sysconf(_SC_PAGESIZE)));
+  char buffer[4096];
+
+  // The command name in parentheses may itself contain spaces or parentheses, so fields are
+  // located from the last ')', which is followed by " S " where S is the state (field 3).
+  if (ReadProcFile(pid, "stat", buffer, sizeof(buffer)) == 0)
+    return false;
+  char* position(std::strrchr(buffer, ')'));
+  if (!position || std::strlen(position) < 4)
+    return false;
+  sample.time = std::chrono::steady_clock::now();
+  position += 3;
+  // Fields 4 to 24.
+  uint64_t fields[21];
+  for (auto& field : fields)
+    field = std::strtoull(position, &position, 10);
+  // utime (field 14), stime (15), num_threads (20) and rss in pages (24).
+  sample.cpu_time = std::chrono::microseconds((fields[10] + fields[11]) * 1000000 /
+                                              kTicksPerSecond);
+  sample.threads = static_cast<uint32_t>(fields[16]);
+  sample.rss = fields[20] * kPageSize;
+
+  if (ReadProcFile(pid, "status", buffer, sizeof(buffer)) != 0) {
+    sample.swap = FindValue(buffer, "VmSwap:") * 1024;
+    sample.context_switches = FindValue(buffer, "\nvoluntary_ctxt_switches:") +
+                              FindValue(buffer, "nonvoluntary_ctxt_switches:");
+  }
+  // Requires the same permissions as ptrace, so may legitimately fail.
+  if (ReadProcFile(pid, "io", buffer, sizeof(buffer)) != 0) {
+    sample.read_bytes = FindValue(buffer, "\nread_bytes:");
+    sample.write_bytes = FindValue(buffer, "\nwrite_bytes:");
+  }
+  sample.open_fds = CountOpenFds(pid);
+  return true;
+}
+#else
+bool ProcessSampler::Sample(uint32_t /*pid*/, ResourceSample& /*sample*/) { return false; }
+#endif
+
+void ProcessSampler::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    if (cond_var_.wait_for(lock, kInterval_, [this] { return stop_; }))
+      return;
+    lock.unlock();
+    SampleAll();
+    lock.lock();
+  }
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
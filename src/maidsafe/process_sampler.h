@@ -0,0 +1,132 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_PROCESS_SAMPLER_H_
+#define MAIDSAFE_CLIENT_MANAGER_PROCESS_SAMPLER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "boost/thread/thread.hpp"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+typedef uint32_t ProcessIndex;
+
+// One reading of a process's resource usage.  Counters (cpu_time, read_bytes, write_bytes and
+// context_switches) are cumulative over the process's lifetime, so rates are found by comparing
+// successive samples.  Fields the manager isn't permitted to read are left at zero.
+struct ResourceSample {
+  ResourceSample()
+      : time(),
+        cpu_time(0),
+        rss(0),
+        swap(0),
+        read_bytes(0),
+        write_bytes(0),
+        context_switches(0),
+        open_fds(0),
+        threads(0) {}
+  std::chrono::steady_clock::time_point time;
+  // User plus system time.
+  std::chrono::microseconds cpu_time;
+  // In bytes.  'read_bytes' and 'write_bytes' only count I/O which reached the storage layer.
+  uint64_t rss, swap, read_bytes, write_bytes;
+  // Voluntary plus involuntary.
+  uint64_t context_switches;
+  uint32_t open_fds, threads;
+};
+
+namespace detail {
+
+// Fixed-capacity buffer holding the most recent samples for one process.  Storage is allocated up
+// front, so pushing never allocates.
+class SampleRing {
+ public:
+  explicit SampleRing(size_t capacity);
+  void Push(const ResourceSample& sample);
+  // Oldest first.
+  std::vector<ResourceSample> Contents() const;
+  void Clear();
+  size_t Size() const { return full_ ? buffer_.size() : next_; }
+
+ private:
+  std::vector<ResourceSample> buffer_;
+  size_t next_;
+  bool full_;
+};
+
+// Periodically reads each registered process's /proc/<pid>/stat, status and io files and counts
+// its open file descriptors, keeping the last 'window' samples per process.  All processes are
+// sampled in turn by a single thread.  On platforms other than Linux nothing is sampled.
+class ProcessSampler {
+ public:
+  ProcessSampler(std::chrono::milliseconds interval = kDefaultInterval(),
+                 size_t window = kDefaultWindow());
+  ~ProcessSampler();
+  // Starts sampling 'pid', discarding any samples previously held for 'index'.
+  void Add(ProcessIndex index, uint32_t pid);
+  // Stops sampling 'index', but retains its samples until it is next added.
+  void Remove(ProcessIndex index);
+  // Stops sampling 'index' and discards its samples.
+  void Erase(ProcessIndex index);
+  // Oldest first.  Empty if 'index' has never been added.
+  std::vector<ResourceSample> Samples(ProcessIndex index) const;
+  // Samples every process immediately.  Normally only called by the sampling thread.
+  void SampleAll();
+  // Returns false if the process no longer exists.
+  static bool Sample(uint32_t pid, ResourceSample& sample);
+
+  static std::chrono::milliseconds kDefaultInterval() { return std::chrono::seconds(5); }
+  static size_t kDefaultWindow() { return 60; }
+
+ private:
+  struct Entry {
+    Entry(uint32_t pid_in, size_t window) : pid(pid_in), active(true), samples(window) {}
+    uint32_t pid;
+    bool active;
+    SampleRing samples;
+  };
+
+  ProcessSampler(const ProcessSampler&);
+  ProcessSampler& operator=(const ProcessSampler&);
+  void Run();
+
+  const std::chrono::milliseconds kInterval_;
+  const size_t kWindow_;
+  std::unordered_map<ProcessIndex, Entry> entries_;
+  mutable std::mutex mutex_;
+  std::condition_variable cond_var_;
+  bool stop_;
+  boost::thread thread_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_PROCESS_SAMPLER_H_
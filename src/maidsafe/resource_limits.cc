@@ -0,0 +1,352 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/resource_limits.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <utility>
+
+#include "boost/filesystem/fstream.hpp"
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/log.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace {
+
+const uint32_t kMaxWeight(10000);
+
+#ifdef MAIDSAFE_LINUX
+
+// Cgroup control files already exist in each group, so they're never created here.
+bool WriteControlFile(const fs::path& path, const std::string& value) {
+  int fd(open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC));
+  if (fd == -1) {
+    LOG(kWarning) << "Failed to open " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  bool result(write(fd, value.data(), value.size()) == static_cast<ssize_t>(value.size()));
+  if (!result)
+    LOG(kWarning) << "Failed to write \"" << value << "\" to " << path << ": "
+                  << std::strerror(errno);
+  close(fd);
+  return result;
+}
+
+std::string ReadControlFile(const fs::path& path) {
+  fs::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// Returns the path of the cgroup v2 group containing this process, or an empty path if the unified
+// hierarchy isn't mounted.
+fs::path OwnCgroup() {
+  fs::path mount_point;
+  fs::ifstream mounts("/proc/self/mounts");
+  std::string line;
+  while (std::getline(mounts, line)) {
+    std::istringstream fields(line);
+    std::string device, mount, type;
+    if (fields >> device >> mount >> type && type == "cgroup2") {
+      mount_point = mount;
+      break;
+    }
+  }
+  if (mount_point.empty())
+    return fs::path();
+
+  // The unified hierarchy's entry is the one with hierarchy ID 0, e.g. "0::/user.slice/x.scope".
+  fs::ifstream cgroups("/proc/self/cgroup");
+  while (std::getline(cgroups, line)) {
+    if (line.compare(0, 3, "0::") == 0)
+      return mount_point / line.substr(3);
+  }
+  return fs::path();
+}
+
+#endif
+
+}  // unnamed namespace
+
+bool ResourceLimits::IsValid() const {
+  if (cpu_weight > kMaxWeight || io_weight > kMaxWeight) {
+    LOG(kError) << "CPU and IO weights must be in the range [1, " << kMaxWeight << "].";
+    return false;
+  }
+  if (cpu_period < std::chrono::milliseconds(1) || cpu_period > std::chrono::seconds(1)) {
+    LOG(kError) << "CPU period must be in the range [1 ms, 1 s].";
+    return false;
+  }
+  if (cpu_quota.count() != 0 && cpu_quota < std::chrono::milliseconds(1)) {
+    LOG(kError) << "CPU quota must be at least 1 ms.";
+    return false;
+  }
+  if (memory_high != 0 && memory_max != 0 && memory_high > memory_max) {
+    LOG(kError) << "memory_high must not exceed memory_max.";
+    return false;
+  }
+  return true;
+}
+
+bool ResourceLimits::Empty() const {
+  return cpu_weight == 0 && cpu_quota.count() == 0 && memory_high == 0 && memory_max == 0 &&
+         io_weight == 0;
+}
+
+namespace detail {
+
+Cgroups::Cgroups(fs::path root)
+    : root_(std::move(root)),
+      initialised_(false),
+      cpu_enabled_(false),
+      memory_enabled_(false),
+      io_enabled_(false),
+      parents_(),
+      mutex_() {}
+
+#ifdef MAIDSAFE_LINUX
+
+void Cgroups::Initialise() {
+  initialised_ = true;
+  if (root_.empty())
+    root_ = OwnCgroup();
+  boost::system::error_code ec;
+  if (root_.empty() || !fs::exists(root_ / "cgroup.controllers", ec)) {
+    LOG(kInfo) << "cgroup v2 is not available; processes will run without resource limits.";
+    return;
+  }
+
+  std::set<std::string> available;
+  std::istringstream controllers(ReadControlFile(root_ / "cgroup.controllers"));
+  std::string controller;
+  while (controllers >> controller)
+    available.insert(controller);
+
+  if (!available.count("cpu") && !available.count("memory") && !available.count("io")) {
+    LOG(kInfo) << "No cgroup controllers available in " << root_ << "; processes will run "
+               << "without resource limits.";
+    return;
+  }
+
+  // Only the hierarchy's root group, which has no cgroup.type file, may have both processes and
+  // controllers enabled for its children.
+  std::istringstream processes(ReadControlFile(root_ / "cgroup.procs"));
+  std::string pid;
+  if (fs::exists(root_ / "cgroup.type", ec) && processes >> pid) {
+    fs::path leaf(root_ / "client_manager");
+    fs::create_directory(leaf, ec);
+    if (ec || !WriteControlFile(leaf / "cgroup.procs", "0")) {
+      LOG(kWarning) << "Failed to move into " << leaf << "; processes will run without resource "
+                    << "limits.";
+      return;
+    }
+  }
+
+  auto enable([&](const std::string & name)->bool {
+    return available.count(name) != 0 &&
+           WriteControlFile(root_ / "cgroup.subtree_control", "+" + name);
+  });
+  cpu_enabled_ = enable("cpu");
+  memory_enabled_ = enable("memory");
+  io_enabled_ = enable("io");
+  LOG(kInfo) << "Using cgroup " << root_ << " with controllers: " << (cpu_enabled_ ? "cpu " : "")
+             << (memory_enabled_ ? "memory " : "") << (io_enabled_ ? "io" : "");
+}
+
+bool Cgroups::Prepare(const std::string& name, const ResourceLimits& limits) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!initialised_)
+    Initialise();
+  if (!cpu_enabled_ && !memory_enabled_ && !io_enabled_)
+    return false;
+
+  fs::path group(root_);
+  boost::system::error_code ec;
+  for (const auto& component : fs::path(name)) {
+    if (group != root_ && !EnableControllers(group))
+      return false;
+    group /= component;
+    fs::create_directory(group, ec);
+    if (ec) {
+      LOG(kWarning) << "Failed to create cgroup " << group << ": " << ec.message();
+      return false;
+    }
+  }
+
+  // Unset limits are written too, so that a group being reused doesn't keep stale values.
+  if (cpu_enabled_) {
+    WriteControlFile(group / "cpu.weight",
+                     std::to_string(limits.cpu_weight == 0 ? 100 : limits.cpu_weight));
+    WriteControlFile(group / "cpu.max",
+                     (limits.cpu_quota.count() == 0 ? std::string("max")
+                                                    : std::to_string(limits.cpu_quota.count())) +
+                         " " + std::to_string(limits.cpu_period.count()));
+  } else if (limits.cpu_weight != 0 || limits.cpu_quota.count() != 0) {
+    LOG(kWarning) << "cpu controller unavailable; not applying CPU limits to " << name;
+  }
+
+  if (memory_enabled_) {
+    auto bytes([](uint64_t value) { return value == 0 ? std::string("max") :
+                                                        std::to_string(value); });
+    WriteControlFile(group / "memory.high", bytes(limits.memory_high));
+    WriteControlFile(group / "memory.max", bytes(limits.memory_max));
+  } else if (limits.memory_high != 0 || limits.memory_max != 0) {
+    LOG(kWarning) << "memory controller unavailable; not applying memory limits to " << name;
+  }
+
+  if (io_enabled_) {
+    WriteControlFile(group / "io.weight",
+                     "default " + std::to_string(limits.io_weight == 0 ? 100 : limits.io_weight));
+  } else if (limits.io_weight != 0) {
+    LOG(kWarning) << "io controller unavailable; not applying IO weight to " << name;
+  }
+  return true;
+}
+
+bool Cgroups::EnableControllers(const fs::path& group) {
+  if (parents_.count(group) != 0)
+    return true;
+  std::string controllers;
+  if (cpu_enabled_)
+    controllers += "+cpu ";
+  if (memory_enabled_)
+    controllers += "+memory ";
+  if (io_enabled_)
+    controllers += "+io ";
+  controllers.erase(controllers.size() - 1);
+  if (!WriteControlFile(group / "cgroup.subtree_control", controllers))
+    return false;
+  parents_.insert(group);
+  return true;
+}
+
+int Cgroups::OpenProcsFile(const std::string& name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!cpu_enabled_ && !memory_enabled_ && !io_enabled_)
+    return -1;
+  int fd(open((root_ / name / "cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC));
+  if (fd == -1)
+    LOG(kWarning) << "Failed to open cgroup.procs for " << name << ": " << std::strerror(errno);
+  return fd;
+}
+
+bool Cgroups::ReadUsage(const std::string& name, ResourceUsage& usage) const {
+  fs::path group;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cpu_enabled_ && !memory_enabled_ && !io_enabled_)
+      return false;
+    group = root_ / name;
+  }
+  boost::system::error_code ec;
+  if (!fs::is_directory(group, ec))
+    return false;
+
+  usage = ResourceUsage();
+  if (fs::exists(group / "memory.current", ec)) {
+    std::istringstream memory(ReadControlFile(group / "memory.current"));
+    memory >> usage.memory_current;
+  }
+  // cpu.stat is always present, even without the cpu controller, and holds lines such as
+  // "usage_usec 1234".
+  std::istringstream cpu(ReadControlFile(group / "cpu.stat"));
+  std::string key;
+  int64_t value(0);
+  while (cpu >> key >> value) {
+    if (key == "usage_usec")
+      usage.cpu_usage = std::chrono::microseconds(value);
+    else if (key == "user_usec")
+      usage.cpu_user = std::chrono::microseconds(value);
+    else if (key == "system_usec")
+      usage.cpu_system = std::chrono::microseconds(value);
+  }
+  return true;
+}
+
+bool Cgroups::Remove(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!cpu_enabled_ && !memory_enabled_ && !io_enabled_)
+    return false;
+  // Cgroup directories are removed with rmdir despite appearing to contain files.
+  if (rmdir((root_ / name).c_str()) != 0 && errno != ENOENT) {
+    LOG(kWarning) << "Failed to remove cgroup " << name << ": " << std::strerror(errno);
+    return false;
+  }
+  parents_.erase(root_ / name);
+  return true;
+}
+
+bool Cgroups::Available() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!initialised_)
+    Initialise();
+  return cpu_enabled_ || memory_enabled_ || io_enabled_;
+}
+
+bool Cgroups::CpuAvailable() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!initialised_)
+    Initialise();
+  return cpu_enabled_;
+}
+
+#else
+
+void Cgroups::Initialise() { initialised_ = true; }
+
+bool Cgroups::EnableControllers(const fs::path& /*group*/) { return false; }
+
+bool Cgroups::Prepare(const std::string& /*name*/, const ResourceLimits& /*limits*/) {
+  return false;
+}
+
+int Cgroups::OpenProcsFile(const std::string& /*name*/) const { return -1; }
+
+bool Cgroups::ReadUsage(const std::string& /*name*/, ResourceUsage& /*usage*/) const {
+  return false;
+}
+
+bool Cgroups::Remove(const std::string& /*name*/) { return false; }
+
+bool Cgroups::Available() { return false; }
+
+bool Cgroups::CpuAvailable() { return false; }
+
+#endif
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,117 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_RESOURCE_LIMITS_H_
+#define MAIDSAFE_CLIENT_MANAGER_RESOURCE_LIMITS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+// Limits applied to a process via its own cgroup v2 group.  A value of zero leaves the
+// corresponding kernel default in place; if every value is zero, no group is created for the
+// process at all.  Weights are relative to the other supervised processes and must be in the range
+// [1, 10000].
+struct ResourceLimits {
+  ResourceLimits()
+      : cpu_weight(0),
+        cpu_quota(0),
+        cpu_period(std::chrono::milliseconds(100)),
+        memory_high(0),
+        memory_max(0),
+        io_weight(0) {}
+
+  bool IsValid() const;
+  bool Empty() const;
+
+  uint32_t cpu_weight;
+  // The process may use at most 'cpu_quota' of CPU time in each 'cpu_period'.
+  std::chrono::microseconds cpu_quota, cpu_period;
+  // In bytes.  Above 'memory_high' the process is throttled and reclaimed from; reaching
+  // 'memory_max' invokes the OOM killer.
+  uint64_t memory_high, memory_max;
+  uint32_t io_weight;
+};
+
+// As reported by the process's cgroup.  Fields for which the relevant controller isn't enabled are
+// left at zero.
+struct ResourceUsage {
+  ResourceUsage() : memory_current(0), cpu_usage(0), cpu_user(0), cpu_system(0) {}
+  uint64_t memory_current;
+  std::chrono::microseconds cpu_usage, cpu_user, cpu_system;
+};
+
+namespace detail {
+
+// Manages one cgroup v2 group per process beneath 'root', which must be a group delegated to this
+// process.  If 'root' is empty, the group this process belongs to is used.  The cpu, memory and io
+// controllers are enabled for child groups on first use; since the kernel only allows that for a
+// non-root group which has no processes of its own, this process may first be moved into a
+// "client_manager" leaf group.  A group's name may be a relative path, e.g. "manager/process_1", in
+// which case the controllers are enabled for the intermediate groups too, and those are left in
+// place until removed by name themselves.  Where cgroup v2 isn't mounted, isn't writable, or the
+// controllers can't be enabled, every function fails harmlessly and processes simply run
+// unconstrained.
+class Cgroups {
+ public:
+  explicit Cgroups(boost::filesystem::path root = boost::filesystem::path());
+  // Creates the group 'name' and any intermediate groups if required, and writes 'limits' to it.
+  // Returns true if the group exists and can be joined; limits which can't be applied are logged
+  // and skipped.
+  bool Prepare(const std::string& name, const ResourceLimits& limits);
+  // Returns a descriptor open for writing to the group's cgroup.procs, or -1 on failure.  Writing
+  // "0" to it moves the writing process into the group, so it can be passed to a forked child to
+  // join the group before exec.  The caller must close it.
+  int OpenProcsFile(const std::string& name) const;
+  bool ReadUsage(const std::string& name, ResourceUsage& usage) const;
+  // Fails if the group still contains processes.
+  bool Remove(const std::string& name);
+  bool Available();
+  // True if the cpu controller is enabled, i.e. if CPU limits are applied rather than skipped.
+  bool CpuAvailable();
+
+ private:
+  Cgroups(const Cgroups&);
+  Cgroups& operator=(const Cgroups&);
+  // NOTE: mutex_ must be locked when calling these functions.
+  void Initialise();
+  bool EnableControllers(const boost::filesystem::path& group);
+
+  boost::filesystem::path root_;
+  bool initialised_, cpu_enabled_, memory_enabled_, io_enabled_;
+  // Intermediate groups whose children have had the controllers enabled.
+  std::set<boost::filesystem::path> parents_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_RESOURCE_LIMITS_H_
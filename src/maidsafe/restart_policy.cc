@@ -0,0 +1,95 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/restart_policy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+bool RestartPolicy::IsValid() const {
+  if (initial_delay.count() < 0 || max_delay < initial_delay) {
+    LOG(kError) << "Restart delays must satisfy 0 <= initial_delay <= max_delay.";
+    return false;
+  }
+  if (backoff_factor < 1.0) {
+    LOG(kError) << "Restart backoff factor must be at least 1.";
+    return false;
+  }
+  if (jitter < 0.0 || jitter > 1.0) {
+    LOG(kError) << "Restart jitter must be in the range [0, 1].";
+    return false;
+  }
+  if (max_crashes < 0 || crash_window.count() < 0 || healthy_run.count() < 0) {
+    LOG(kError) << "Crash budget and healthy run duration must not be negative.";
+    return false;
+  }
+  return true;
+}
+
+namespace detail {
+
+RestartTracker::RestartTracker(RestartPolicy policy)
+    : policy_(std::move(policy)),
+      crashes_(),
+      last_start_(),
+      consecutive_crashes_(0),
+      random_engine_(RandomUint32()) {}
+
+void RestartTracker::Reset() {
+  crashes_.clear();
+  consecutive_crashes_ = 0;
+}
+
+void RestartTracker::OnStart(const TimePoint& now) { last_start_ = now; }
+
+bool RestartTracker::OnExit(const TimePoint& now, std::chrono::milliseconds& delay) {
+  if (now - last_start_ >= policy_.healthy_run)
+    consecutive_crashes_ = 0;
+  ++consecutive_crashes_;
+
+  crashes_.push_back(now);
+  while (!crashes_.empty() && now - crashes_.front() > policy_.crash_window)
+    crashes_.pop_front();
+  if (static_cast<int32_t>(crashes_.size()) > policy_.max_crashes)
+    return false;
+
+  double scaled(static_cast<double>(policy_.initial_delay.count()) *
+                std::pow(policy_.backoff_factor, consecutive_crashes_ - 1));
+  if (policy_.jitter > 0.0) {
+    std::uniform_real_distribution<double> distribution(1.0 - policy_.jitter,
+                                                        1.0 + policy_.jitter);
+    scaled *= distribution(random_engine_);
+  }
+  scaled = std::min(scaled, static_cast<double>(policy_.max_delay.count()));
+  delay = std::chrono::milliseconds(static_cast<int64_t>(scaled));
+  return true;
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,89 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_RESTART_POLICY_H_
+#define MAIDSAFE_CLIENT_MANAGER_RESTART_POLICY_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+
+namespace maidsafe {
+
+namespace client_manager {
+
+// Governs how a crashed process is restarted.  The delay before the first restart is
+// 'initial_delay', multiplied by 'backoff_factor' for each further consecutive crash up to
+// 'max_delay'.  A run lasting at least 'healthy_run' resets the backoff.  The process is given up
+// on once it has exited more than 'max_crashes' times within the last 'crash_window'.
+struct RestartPolicy {
+  RestartPolicy()
+      : initial_delay(std::chrono::milliseconds(600)),
+        max_delay(std::chrono::minutes(1)),
+        backoff_factor(2.0),
+        jitter(0.2),
+        healthy_run(std::chrono::minutes(5)),
+        max_crashes(5),
+        crash_window(std::chrono::minutes(10)) {}
+
+  bool IsValid() const;
+
+  std::chrono::milliseconds initial_delay, max_delay;
+  double backoff_factor;
+  // Each delay is scaled by a random factor in [1 - jitter, 1 + jitter] so that processes which
+  // crashed together don't all restart together.
+  double jitter;
+  std::chrono::milliseconds healthy_run;
+  int32_t max_crashes;
+  std::chrono::milliseconds crash_window;
+};
+
+namespace detail {
+
+// Applies a RestartPolicy to one process's history.  Times are passed in rather than read from a
+// clock so that the policy can be tested without waiting.
+class RestartTracker {
+ public:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  explicit RestartTracker(RestartPolicy policy = RestartPolicy());
+  void Reset();
+  void OnStart(const TimePoint& now);
+  // Returns false if the process has used up its crash budget, otherwise sets 'delay' to the time
+  // to wait before restarting it.
+  bool OnExit(const TimePoint& now, std::chrono::milliseconds& delay);
+  int32_t consecutive_crashes() const { return consecutive_crashes_; }
+  size_t crashes_in_window() const { return crashes_.size(); }
+  const RestartPolicy& policy() const { return policy_; }
+
+ private:
+  RestartPolicy policy_;
+  std::deque<TimePoint> crashes_;
+  TimePoint last_start_;
+  int32_t consecutive_crashes_;
+  std::mt19937 random_engine_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_RESTART_POLICY_H_
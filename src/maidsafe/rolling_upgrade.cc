@@ -0,0 +1,114 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/rolling_upgrade.h"
+
+#include <algorithm>
+
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+RollingUpgrade::RollingUpgrade(const boost::filesystem::path& old_executable,
+                               const boost::filesystem::path& new_executable,
+                               const std::vector<ProcessIndex>& vaults, size_t batch_size,
+                               std::chrono::milliseconds join_timeout)
+    : kOldExecutable_(old_executable),
+      kNewExecutable_(new_executable),
+      kBatchSize_(std::max(batch_size, static_cast<size_t>(1))),
+      kJoinTimeout_(join_timeout),
+      pending_(vaults.begin(), vaults.end()),
+      batch_(),
+      upgraded_(),
+      batch_deadline_(),
+      failed_(false) {}
+
+RollingUpgrade::Step RollingUpgrade::Next(std::vector<ProcessIndex>& vaults) {
+  vaults.clear();
+  if (!failed_ && !batch_.empty() && std::chrono::steady_clock::now() >= batch_deadline_) {
+    LOG(kError) << batch_.size() << " upgraded vault(s) failed to rejoin the network within "
+                << kJoinTimeout_.count() << " ms.";
+    failed_ = true;
+  }
+  if (failed_) {
+    vaults = upgraded_;
+    return Step::kRollBack;
+  }
+  if (!batch_.empty())
+    return Step::kWait;
+  if (pending_.empty())
+    return Step::kFinish;
+
+  while (!pending_.empty() && batch_.size() < kBatchSize_) {
+    batch_.insert(pending_.front());
+    pending_.pop_front();
+  }
+  vaults.assign(batch_.begin(), batch_.end());
+  batch_deadline_ = std::chrono::steady_clock::now() + kJoinTimeout_;
+  LOG(kInfo) << "Upgrading " << vaults.size() << " vault(s) to " << kNewExecutable_ << ", "
+             << pending_.size() << " to go.";
+  return Step::kUpgrade;
+}
+
+void RollingUpgrade::AddVault(ProcessIndex index) {
+  if (std::find(upgraded_.begin(), upgraded_.end(), index) == upgraded_.end() &&
+      std::find(pending_.begin(), pending_.end(), index) == pending_.end() &&
+      batch_.count(index) == 0)
+    pending_.push_back(index);
+}
+
+void RollingUpgrade::RemoveVault(ProcessIndex index) {
+  pending_.erase(std::remove(pending_.begin(), pending_.end(), index), pending_.end());
+  batch_.erase(index);
+  upgraded_.erase(std::remove(upgraded_.begin(), upgraded_.end(), index), upgraded_.end());
+}
+
+void RollingUpgrade::ReplaceVault(ProcessIndex old_index, ProcessIndex new_index) {
+  std::replace(pending_.begin(), pending_.end(), old_index, new_index);
+  std::replace(upgraded_.begin(), upgraded_.end(), old_index, new_index);
+  if (batch_.erase(old_index) != 0)
+    batch_.insert(new_index);
+}
+
+void RollingUpgrade::Joined(ProcessIndex index, bool joined) {
+  if (batch_.count(index) == 0)
+    return;
+  if (joined) {
+    batch_.erase(index);
+    upgraded_.push_back(index);
+  } else {
+    LOG(kError) << "Vault with process_index " << index << " failed to rejoin the network on "
+                << kNewExecutable_;
+    failed_ = true;
+  }
+}
+
+void RollingUpgrade::Upgraded(ProcessIndex index) {
+  if (batch_.erase(index) != 0)
+    upgraded_.push_back(index);
+}
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
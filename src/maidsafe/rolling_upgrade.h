@@ -0,0 +1,99 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_ROLLING_UPGRADE_H_
+#define MAIDSAFE_CLIENT_MANAGER_ROLLING_UPGRADE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+typedef uint32_t ProcessIndex;
+
+namespace detail {
+
+// Decides the order in which vaults are moved onto a new binary.  They're restarted in batches,
+// each of which must rejoin the network before the next is started.  If any vault of a batch
+// reports that it failed to join, or the batch doesn't rejoin within 'join_timeout', every vault
+// which has moved onto the new binary so far is to be rolled back onto the old one, which stays the
+// active version's until the upgrade is over.  A vault which failed to move is still on the old
+// binary, so it isn't rolled back.
+//
+// Not thread-safe: ClientManager only uses it with vault_infos_mutex_ locked.
+class RollingUpgrade {
+ public:
+  enum class Step {
+    kWait,
+    kUpgrade,
+    kRollBack,
+    kFinish
+  };
+
+  RollingUpgrade(const boost::filesystem::path& old_executable,
+                 const boost::filesystem::path& new_executable,
+                 const std::vector<ProcessIndex>& vaults, size_t batch_size,
+                 std::chrono::milliseconds join_timeout);
+  // For kUpgrade, 'vaults' is set to the batch to restart on the new binary, and for kRollBack to
+  // every vault which has moved onto it so far.  The upgrade is over once kRollBack or kFinish is returned.
+  Step Next(std::vector<ProcessIndex>& vaults);
+  // A vault started on the old binary during the upgrade is moved over in a later batch.
+  void AddVault(ProcessIndex index);
+  // A vault stopped during the upgrade is no longer waited for, nor rolled back.
+  void RemoveVault(ProcessIndex index);
+  // A vault handed over to a new process keeps its place under the new process's index.
+  void ReplaceVault(ProcessIndex old_index, ProcessIndex new_index);
+  // A vault of the current batch which has rejoined the network is running the new binary.  One
+  // which failed to is still running the old one.
+  void Joined(ProcessIndex index, bool joined);
+  // A vault of the current batch which isn't running has moved onto the new binary without having
+  // to rejoin.
+  void Upgraded(ProcessIndex index);
+  boost::filesystem::path old_executable() const { return kOldExecutable_; }
+  boost::filesystem::path new_executable() const { return kNewExecutable_; }
+
+ private:
+  RollingUpgrade(const RollingUpgrade&);
+  RollingUpgrade& operator=(const RollingUpgrade&);
+
+  const boost::filesystem::path kOldExecutable_, kNewExecutable_;
+  const size_t kBatchSize_;
+  const std::chrono::milliseconds kJoinTimeout_;
+  std::deque<ProcessIndex> pending_;
+  // Vaults of the current batch which haven't rejoined yet.
+  std::set<ProcessIndex> batch_;
+  // Vaults which have moved onto the new binary.
+  std::vector<ProcessIndex> upgraded_;
+  std::chrono::steady_clock::time_point batch_deadline_;
+  bool failed_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_ROLLING_UPGRADE_H_
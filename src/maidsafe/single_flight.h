@@ -0,0 +1,83 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_SINGLE_FLIGHT_H_
+#define MAIDSAFE_CLIENT_MANAGER_SINGLE_FLIGHT_H_
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <utility>
+
+namespace maidsafe {
+
+namespace client_manager {
+
+// Collapses concurrent requests for the result of an expensive operation into a single execution.
+// Run() starts the operation on a new thread if it isn't already running, otherwise it joins the
+// in-flight execution.  Either way, every caller gets the same shared result.  The destructor
+// blocks until any in-flight execution has completed.
+template <typename Result>
+class SingleFlight {
+ public:
+  explicit SingleFlight(std::function<Result()> functor)
+      : functor_(std::move(functor)), mutex_(), in_flight_() {}
+
+  std::shared_future<Result> Run() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!InFlightUnlocked())
+      in_flight_ = std::async(std::launch::async, functor_).share();
+    return in_flight_;
+  }
+
+  bool InFlight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return InFlightUnlocked();
+  }
+
+  // Blocks until the execution in flight when called (if any) has completed.
+  void Wait() const {
+    std::shared_future<Result> in_flight;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      in_flight = in_flight_;
+    }
+    if (in_flight.valid())
+      in_flight.wait();
+  }
+
+ private:
+  SingleFlight(const SingleFlight&);
+  SingleFlight& operator=(const SingleFlight&);
+
+  bool InFlightUnlocked() const {
+    return in_flight_.valid() &&
+           in_flight_.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+  }
+
+  const std::function<Result()> functor_;
+  mutable std::mutex mutex_;
+  std::shared_future<Result> in_flight_;
+};
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_SINGLE_FLIGHT_H_
@@ -0,0 +1,521 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/spawner.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+#include "boost/process/child.hpp"
+#include "boost/process/execute.hpp"
+#include "boost/process/initializers.hpp"
+
+#include "maidsafe/common/log.h"
+
+#ifdef MAIDSAFE_LINUX
+extern char** environ;
+#endif
+
+namespace bp = boost::process;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace detail {
+
+namespace {
+
+#ifdef MAIDSAFE_LINUX
+
+const size_t kMaxZygoteRequestSize(64 * 1024);
+const uint32_t kMaxArguments(1024);
+const size_t kMaxNodes(1024);
+const int kZygoteSocket(3);
+
+// Which of the cgroup and output descriptors were sent with the request, in that order.
+struct ZygoteRequestHeader {
+  uint32_t argc;
+  bool has_cgroup_fd, has_output_fd, place;
+  PlacementMasks placement_masks;
+};
+
+// 'error' is an errno value; if non-zero and 'pid' is non-zero, exec failed and the caller must
+// reap 'pid'.
+struct ZygoteReply {
+  int32_t pid;
+  int32_t error;
+};
+
+// Applies a placement to the calling thread only for the lifetime of this object.  A child
+// created by posix_spawn inherits the placement of the thread which spawned it.
+class ScopedThreadPlacement {
+ public:
+  explicit ScopedThreadPlacement(const CpuPlacement& placement)
+      : saved_(false), cpus_(), memory_mode_(0), nodes_() {
+    if (placement.Empty())
+      return;
+    CPU_ZERO(&cpus_);
+    std::memset(nodes_, 0, sizeof(nodes_));
+    if (sched_getaffinity(0, sizeof(cpus_), &cpus_) != 0 ||
+        syscall(SYS_get_mempolicy, &memory_mode_, nodes_, kMaxNodes, nullptr, 0) != 0) {
+      LOG(kWarning) << "Failed to read this thread's placement: " << std::strerror(errno);
+      return;
+    }
+    saved_ = true;
+    if (!PlacementMasks(placement).Apply())
+      LOG(kWarning) << "Failed to apply CPU placement: " << std::strerror(errno);
+  }
+
+  ~ScopedThreadPlacement() {
+    if (!saved_)
+      return;
+    if (sched_setaffinity(0, sizeof(cpus_), &cpus_) != 0 ||
+        syscall(SYS_set_mempolicy, memory_mode_, nodes_, kMaxNodes) != 0)
+      LOG(kError) << "Failed to restore this thread's placement: " << std::strerror(errno);
+  }
+
+ private:
+  ScopedThreadPlacement(const ScopedThreadPlacement&);
+  ScopedThreadPlacement& operator=(const ScopedThreadPlacement&);
+
+  bool saved_;
+  cpu_set_t cpus_;
+  int memory_mode_;
+  unsigned long nodes_[kMaxNodes / (8 * sizeof(unsigned long))];  // NOLINT (Fraser)
+};
+
+// Everything from here to RunZygote runs in the zygote.  The manager may have had other threads
+// when the zygote was forked, so only async-signal-safe functions are used: in particular,
+// nothing allocates.
+
+bool ParseZygoteRequest(char* buffer, size_t length, const ZygoteRequestHeader*& header,
+                        const char*& executable, char** argv) {
+  if (length < sizeof(ZygoteRequestHeader))
+    return false;
+  header = reinterpret_cast<const ZygoteRequestHeader*>(buffer);
+  if (header->argc > kMaxArguments)
+    return false;
+  // The executable, then each argument, each null-terminated.
+  char* position(buffer + sizeof(ZygoteRequestHeader));
+  char* const end(buffer + length);
+  for (uint32_t i(0); i != header->argc + 1; ++i) {
+    char* terminator(static_cast<char*>(std::memchr(position, '\0', end - position)));
+    if (!terminator)
+      return false;
+    if (i == 0)
+      executable = position;
+    else
+      argv[i - 1] = position;
+    position = terminator + 1;
+  }
+  argv[header->argc] = nullptr;
+  return true;
+}
+
+ZygoteReply ZygoteSpawn(const ZygoteRequestHeader& header, const char* executable, char** argv,
+                        int cgroup_fd, int output_fd) {
+  ZygoteReply reply = { 0, 0 };
+  // Reports a failed exec back to the zygote; closed on a successful one.
+  int exec_status[2];
+  if (pipe2(exec_status, O_CLOEXEC) != 0) {
+    reply.error = errno;
+    return reply;
+  }
+  // CLONE_PARENT makes the child a sibling of the zygote, i.e. a child of the manager, which can
+  // then wait for it exactly as for a child it forked itself.
+  long pid(syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0));  // NOLINT (Fraser)
+  if (pid == 0) {
+    close(exec_status[0]);
+    // As with the other backends, on failure the process simply runs unconstrained.
+    if (cgroup_fd != -1) {
+      ssize_t written(write(cgroup_fd, "0", 1));
+      static_cast<void>(written);
+    }
+    if (header.place)
+      header.placement_masks.Apply();
+    if (output_fd != -1) {
+      dup2(output_fd, STDOUT_FILENO);
+      dup2(output_fd, STDERR_FILENO);
+    }
+    execve(executable, argv, environ);
+    int error(errno);
+    ssize_t written(write(exec_status[1], &error, sizeof(error)));
+    static_cast<void>(written);
+    _exit(127);
+  }
+  close(exec_status[1]);
+  if (pid == -1) {
+    reply.error = errno;
+  } else {
+    reply.pid = static_cast<int32_t>(pid);
+    int error(0);
+    ssize_t length(0);
+    do {
+      length = read(exec_status[0], &error, sizeof(error));
+    } while (length == -1 && errno == EINTR);
+    if (length == sizeof(error))
+      reply.error = error;
+  }
+  close(exec_status[0]);
+  return reply;
+}
+
+void RunZygote(int socket) {
+  // Keep only the standard streams and the socket, moved to a known descriptor.
+  if (socket != kZygoteSocket) {
+    dup2(socket, kZygoteSocket);
+    close(socket);
+  }
+  fcntl(kZygoteSocket, F_SETFD, FD_CLOEXEC);
+  if (syscall(SYS_close_range, kZygoteSocket + 1, ~0U, 0) != 0) {
+    rlimit limit;
+    int max_fd(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+                   ? static_cast<int>(limit.rlim_cur)
+                   : 65536);
+    for (int fd(kZygoteSocket + 1); fd < max_fd; ++fd)
+      close(fd);
+  }
+
+  // Children should start with default signal handling, whatever the manager has set up.
+  sigset_t no_signals;
+  sigemptyset(&no_signals);
+  sigprocmask(SIG_SETMASK, &no_signals, nullptr);
+  struct sigaction default_action;
+  std::memset(&default_action, 0, sizeof(default_action));
+  default_action.sa_handler = SIG_DFL;
+  for (int signal_number(1); signal_number < NSIG; ++signal_number)
+    sigaction(signal_number, &default_action, nullptr);
+
+  alignas(ZygoteRequestHeader) static char buffer[kMaxZygoteRequestSize];
+  static char* argv[kMaxArguments + 1];
+  for (;;) {
+    iovec io_vector = { buffer, sizeof(buffer) };
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &io_vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t length(recvmsg(kZygoteSocket, &message, MSG_CMSG_CLOEXEC));
+    if (length == -1 && errno == EINTR)
+      continue;
+    // The manager has closed its end, or exited.
+    if (length <= 0)
+      _exit(0);
+
+    int fds[2] = { -1, -1 };
+    size_t fd_count(0);
+    cmsghdr* control_message(CMSG_FIRSTHDR(&message));
+    if (control_message && control_message->cmsg_level == SOL_SOCKET &&
+        control_message->cmsg_type == SCM_RIGHTS) {
+      fd_count = (control_message->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      std::memcpy(fds, CMSG_DATA(control_message), fd_count * sizeof(int));
+    }
+
+    const ZygoteRequestHeader* header(nullptr);
+    const char* executable(nullptr);
+    ZygoteReply reply = { 0, EINVAL };
+    if (!(message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) &&
+        ParseZygoteRequest(buffer, static_cast<size_t>(length), header, executable, argv) &&
+        fd_count == static_cast<size_t>(header->has_cgroup_fd + header->has_output_fd)) {
+      int cgroup_fd(header->has_cgroup_fd ? fds[0] : -1);
+      int output_fd(header->has_output_fd ? fds[fd_count - 1] : -1);
+      reply = ZygoteSpawn(*header, executable, argv, cgroup_fd, output_fd);
+    }
+    for (size_t i(0); i != fd_count; ++i)
+      close(fds[i]);
+    send(kZygoteSocket, &reply, sizeof(reply), MSG_NOSIGNAL);
+  }
+}
+
+#endif
+
+}  // unnamed namespace
+
+std::vector<std::string> SplitArguments(const std::vector<std::string>& args) {
+  std::vector<std::string> argv;
+  for (const auto& arg : args) {
+    std::string current;
+    bool in_quotes(false), have_token(false);
+    for (size_t i(0); i != arg.size(); ++i) {
+      char c(arg[i]);
+      if (c == '\\' && i + 1 != arg.size() && (arg[i + 1] == '"' || arg[i + 1] == '\\')) {
+        current += arg[++i];
+        have_token = true;
+      } else if (c == '"') {
+        in_quotes = !in_quotes;
+        have_token = true;
+      } else if (c == ' ' && !in_quotes) {
+        if (have_token)
+          argv.push_back(current);
+        current.clear();
+        have_token = false;
+      } else {
+        current += c;
+        have_token = true;
+      }
+    }
+    if (have_token)
+      argv.push_back(current);
+  }
+  return argv;
+}
+
+Spawner::Spawner(SpawnBackend backend)
+    :
+#ifdef MAIDSAFE_LINUX
+      zygote_socket_(-1),
+      zygote_pid_(0),
+      zygote_mutex_(),
+#endif
+      backend_(backend) {
+#ifdef MAIDSAFE_LINUX
+  if (backend_ == SpawnBackend::kZygote && !StartZygote()) {
+    LOG(kWarning) << "Failed to start zygote; using posix_spawn instead.";
+    backend_ = SpawnBackend::kPosixSpawn;
+  }
+#else
+  if (backend_ != SpawnBackend::kBoostProcess) {
+    LOG(kInfo) << "Only boost::process is supported on this platform.";
+    backend_ = SpawnBackend::kBoostProcess;
+  }
+#endif
+}
+
+Spawner::~Spawner() {
+#ifdef MAIDSAFE_LINUX
+  std::lock_guard<std::mutex> lock(zygote_mutex_);
+  StopZygote();
+#endif
+}
+
+bool Spawner::Spawn(const SpawnRequest& request, bp::child& child,
+                    boost::system::error_code& error_code) {
+  switch (backend_) {
+#ifdef MAIDSAFE_LINUX
+    case SpawnBackend::kZygote:
+      return SpawnWithZygote(request, child, error_code);
+    case SpawnBackend::kPosixSpawn:
+      return SpawnWithPosixSpawn(request, child, error_code);
+#endif
+    default:
+      return SpawnWithBoostProcess(request, child, error_code);
+  }
+}
+
+bool Spawner::SpawnWithBoostProcess(const SpawnRequest& request, bp::child& child,
+                                    boost::system::error_code& error_code) {
+#ifdef MAIDSAFE_LINUX
+  const int cgroup_fd(request.cgroup_fd), output_fd(request.output_fd);
+  const bool place(!request.placement.Empty());
+  const PlacementMasks placement_masks(request.placement);
+  child = bp::execute(
+      bp::initializers::run_exe(request.executable),
+      bp::initializers::set_cmd_line(request.command_line),
+      bp::initializers::set_on_error(error_code),
+      bp::initializers::inherit_env(),
+      bp::initializers::on_exec_setup(
+          [cgroup_fd, output_fd, place, placement_masks](bp::executor&) {
+            // Join the cgroup and apply the placement before exec so that they apply from the
+            // outset.  Nothing can be logged here, so on failure the process simply runs
+            // unconstrained.
+            if (cgroup_fd != -1) {
+              ssize_t written(write(cgroup_fd, "0", 1));
+              static_cast<void>(written);
+            }
+            if (place)
+              placement_masks.Apply();
+            if (output_fd != -1) {
+              dup2(output_fd, STDOUT_FILENO);
+              dup2(output_fd, STDERR_FILENO);
+            }
+          }));
+#else
+  if (!request.placement.Empty())
+    LOG(kWarning) << "CPU placement is not supported on this platform.";
+  child = bp::execute(
+      bp::initializers::run_exe(request.executable),
+      bp::initializers::set_cmd_line(request.command_line),
+      bp::initializers::set_on_error(error_code),
+      bp::initializers::inherit_env());
+#endif
+  return !error_code;
+}
+
+#ifdef MAIDSAFE_LINUX
+bool Spawner::SpawnWithPosixSpawn(const SpawnRequest& request, bp::child& child,
+                                  boost::system::error_code& error_code) {
+  std::vector<char*> argv;
+  argv.reserve(request.argv.size() + 1);
+  for (const auto& arg : request.argv)
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t file_actions;
+  posix_spawn_file_actions_init(&file_actions);
+  if (request.output_fd != -1) {
+    posix_spawn_file_actions_adddup2(&file_actions, request.output_fd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, request.output_fd, STDERR_FILENO);
+  }
+  pid_t pid(0);
+  int result(0);
+  {
+    ScopedThreadPlacement placement(request.placement);
+    result = posix_spawn(&pid, request.executable.c_str(), &file_actions, nullptr, argv.data(),
+                         environ);
+  }
+  posix_spawn_file_actions_destroy(&file_actions);
+  if (result != 0) {
+    error_code = boost::system::error_code(result, boost::system::system_category());
+    return false;
+  }
+  // Unlike the other backends, the child can only be moved into its cgroup once it is running.
+  if (request.cgroup_fd != -1) {
+    std::string pid_string(std::to_string(pid));
+    if (write(request.cgroup_fd, pid_string.c_str(), pid_string.size()) !=
+        static_cast<ssize_t>(pid_string.size()))
+      LOG(kWarning) << "Failed to move process " << pid << " into its cgroup: "
+                    << std::strerror(errno);
+  }
+  child = bp::child(pid);
+  return true;
+}
+
+bool Spawner::StartZygote() {
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0) {
+    LOG(kError) << "Failed to create zygote socket: " << std::strerror(errno);
+    return false;
+  }
+  pid_t pid(fork());
+  if (pid == -1) {
+    LOG(kError) << "Failed to fork zygote: " << std::strerror(errno);
+    close(sockets[0]);
+    close(sockets[1]);
+    return false;
+  }
+  if (pid == 0) {
+    close(sockets[0]);
+    RunZygote(sockets[1]);
+  }
+  close(sockets[1]);
+  zygote_socket_ = sockets[0];
+  zygote_pid_ = pid;
+  LOG(kInfo) << "Started zygote with PID " << pid;
+  return true;
+}
+
+bool Spawner::SpawnWithZygote(const SpawnRequest& request, bp::child& child,
+                              boost::system::error_code& error_code) {
+  ZygoteRequestHeader header = { static_cast<uint32_t>(request.argv.size()),
+                                 request.cgroup_fd != -1, request.output_fd != -1,
+                                 !request.placement.Empty(), PlacementMasks(request.placement) };
+  std::string payload(reinterpret_cast<const char*>(&header), sizeof(header));
+  payload.append(request.executable.c_str(), request.executable.size() + 1);
+  for (const auto& arg : request.argv)
+    payload.append(arg.c_str(), arg.size() + 1);
+  if (request.argv.size() > kMaxArguments || payload.size() > kMaxZygoteRequestSize) {
+    error_code = boost::system::error_code(E2BIG, boost::system::system_category());
+    return false;
+  }
+
+  iovec io_vector = { &payload[0], payload.size() };
+  int fds[2];
+  size_t fd_count(0);
+  if (request.cgroup_fd != -1)
+    fds[fd_count++] = request.cgroup_fd;
+  if (request.output_fd != -1)
+    fds[fd_count++] = request.output_fd;
+  char control[CMSG_SPACE(2 * sizeof(int))];
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = &io_vector;
+  message.msg_iovlen = 1;
+  if (fd_count != 0) {
+    std::memset(control, 0, sizeof(control));
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(fd_count * sizeof(int));
+    cmsghdr* control_message(CMSG_FIRSTHDR(&message));
+    control_message->cmsg_level = SOL_SOCKET;
+    control_message->cmsg_type = SCM_RIGHTS;
+    control_message->cmsg_len = CMSG_LEN(fd_count * sizeof(int));
+    std::memcpy(CMSG_DATA(control_message), fds, fd_count * sizeof(int));
+  }
+
+  ZygoteReply reply = { 0, 0 };
+  {
+    std::lock_guard<std::mutex> lock(zygote_mutex_);
+    if (zygote_socket_ != -1) {
+      ssize_t length(0);
+      if (sendmsg(zygote_socket_, &message, MSG_NOSIGNAL) ==
+          static_cast<ssize_t>(payload.size())) {
+        do {
+          length = recv(zygote_socket_, &reply, sizeof(reply), 0);
+        } while (length == -1 && errno == EINTR);
+      }
+      if (length != sizeof(reply)) {
+        LOG(kError) << "Lost contact with zygote; using posix_spawn from now on.";
+        StopZygote();
+      }
+    }
+    if (zygote_socket_ == -1)
+      return SpawnWithPosixSpawn(request, child, error_code);
+  }
+
+  if (reply.error != 0) {
+    // A child whose exec failed has already exited, and is the manager's to reap.
+    if (reply.pid > 0)
+      waitpid(reply.pid, nullptr, 0);
+    error_code = boost::system::error_code(reply.error, boost::system::system_category());
+    return false;
+  }
+  child = bp::child(reply.pid);
+  return true;
+}
+
+// NOTE: zygote_mutex_ must be locked when calling this function.
+void Spawner::StopZygote() {
+  if (zygote_socket_ == -1)
+    return;
+  close(zygote_socket_);
+  zygote_socket_ = -1;
+  // The zygote exits as soon as it sees its socket close.
+  waitpid(zygote_pid_, nullptr, 0);
+}
+#endif
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,116 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#ifndef MAIDSAFE_CLIENT_MANAGER_SPAWNER_H_
+#define MAIDSAFE_CLIENT_MANAGER_SPAWNER_H_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "boost/process/child.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "maidsafe/client_manager/cpu_placement.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+enum class SpawnBackend {
+  // boost::process::execute, i.e. fork and exec.  The only backend available on Windows.
+  kBoostProcess,
+  // posix_spawn, which glibc implements with vfork semantics, so the cost doesn't grow with the
+  // manager's address space.
+  kPosixSpawn,
+  // A helper process forked from the manager while it is still small, which creates each child
+  // on the manager's behalf (Linux only).  The children are created with CLONE_PARENT, so they
+  // are still the manager's own children.
+  kZygote
+};
+
+namespace detail {
+
+// Splits arguments on spaces outside double quotes, as boost::process splits a command line, so
+// that every backend gives a child the same argv.  Process arguments such as "--runtime 2" rely on
+// this.
+std::vector<std::string> SplitArguments(const std::vector<std::string>& args);
+
+// Everything the child needs, prepared by the caller so that the child side of each backend has
+// nothing to allocate or look up.  'command_line' is only used by kBoostProcess, and 'argv' by
+// the others.  'cgroup_fd' is a descriptor open on the child's cgroup.procs, or -1.  'output_fd',
+// if not -1, becomes the child's stdout and stderr; otherwise it inherits the manager's.
+struct SpawnRequest {
+  SpawnRequest(const std::string& executable_in, const std::vector<std::string>& argv_in,
+               const std::string& command_line_in, const CpuPlacement& placement_in,
+               int cgroup_fd_in, int output_fd_in)
+      : executable(executable_in),
+        argv(argv_in),
+        command_line(command_line_in),
+        placement(placement_in),
+        cgroup_fd(cgroup_fd_in),
+        output_fd(output_fd_in) {}
+  const std::string& executable;
+  const std::vector<std::string>& argv;
+  const std::string& command_line;
+  const CpuPlacement& placement;
+  int cgroup_fd, output_fd;
+};
+
+// Starts child processes using the chosen backend.  If the zygote can't be started (or later
+// dies), posix_spawn is used instead; on Windows kBoostProcess is always used.  Since the zygote is
+// forked in the constructor, a Spawner using it should be constructed as early as possible.
+// Children started by the zygote inherit the environment the manager had at that point.
+class Spawner {
+ public:
+  explicit Spawner(SpawnBackend backend);
+  ~Spawner();
+  // Thread-safe.  Returns false and sets 'error_code' if the child couldn't be started, including
+  // if exec failed (except with kBoostProcess, where that is only seen as the child exiting).
+  bool Spawn(const SpawnRequest& request, boost::process::child& child,
+             boost::system::error_code& error_code);
+  SpawnBackend backend() const { return backend_; }
+
+ private:
+  Spawner(const Spawner&);
+  Spawner& operator=(const Spawner&);
+  bool SpawnWithBoostProcess(const SpawnRequest& request, boost::process::child& child,
+                             boost::system::error_code& error_code);
+#ifdef MAIDSAFE_LINUX
+  bool SpawnWithPosixSpawn(const SpawnRequest& request, boost::process::child& child,
+                           boost::system::error_code& error_code);
+  bool StartZygote();
+  bool SpawnWithZygote(const SpawnRequest& request, boost::process::child& child,
+                       boost::system::error_code& error_code);
+  void StopZygote();
+
+  int zygote_socket_;
+  pid_t zygote_pid_;
+  std::mutex zygote_mutex_;
+#endif
+  SpawnBackend backend_;
+};
+
+}  // namespace detail
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_CLIENT_MANAGER_SPAWNER_H_
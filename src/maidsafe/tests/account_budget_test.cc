@@ -0,0 +1,219 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/account_budget.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+const uint64_t kMiB(1024 * 1024);
+
+VaultUsage MakeUsage(uint64_t chunkstore_bytes, uint64_t memory, double cpu) {
+  VaultUsage usage;
+  usage.chunkstore_bytes = chunkstore_bytes;
+  usage.memory = memory;
+  usage.cpu = cpu;
+  return usage;
+}
+
+}  // unnamed namespace
+
+TEST(AccountBudgetTest, BEH_DefaultAndAccountBudgets) {
+  detail::AccountLedger ledger;
+  EXPECT_TRUE(ledger.budget("alice").Empty());
+  AccountBudget budget;
+  budget.max_cpu = -1.0;
+  EXPECT_FALSE(ledger.SetDefaultBudget(budget));
+  EXPECT_FALSE(ledger.SetBudget("alice", budget));
+
+  budget.max_cpu = 0.0;
+  budget.max_vaults = 2;
+  EXPECT_TRUE(ledger.SetDefaultBudget(budget));
+  budget.max_vaults = 5;
+  EXPECT_TRUE(ledger.SetBudget("alice", budget));
+  EXPECT_EQ(2U, ledger.budget("bob").max_vaults);
+  EXPECT_EQ(5U, ledger.budget("alice").max_vaults);
+  ASSERT_EQ(1U, ledger.budgets().size());
+  EXPECT_EQ("alice", ledger.budgets().begin()->first);
+
+  // Clearing an account's budget puts it back on the default.
+  EXPECT_TRUE(ledger.SetBudget("alice", AccountBudget()));
+  EXPECT_EQ(2U, ledger.budget("alice").max_vaults);
+  EXPECT_TRUE(ledger.budgets().empty());
+}
+
+TEST(AccountBudgetTest, BEH_CountersFollowVaults) {
+  detail::AccountLedger ledger;
+  ledger.StartVault(0, "alice");
+  ledger.StartVault(0, "alice");
+  ledger.StartVault(1, "alice");
+  ledger.StartVault(2, "bob");
+  EXPECT_EQ(2U, ledger.Usage("alice").vaults);
+  EXPECT_EQ(1U, ledger.Usage("bob").vaults);
+  EXPECT_EQ(0U, ledger.Usage("carol").vaults);
+
+  ledger.SetVaultUsage(0, MakeUsage(10 * kMiB, 100 * kMiB, 0.5));
+  ledger.SetVaultUsage(1, MakeUsage(20 * kMiB, 50 * kMiB, 0.25));
+  ledger.SetVaultUsage(0, MakeUsage(15 * kMiB, 80 * kMiB, 0.25));
+  ledger.SetVaultUsage(7, MakeUsage(15 * kMiB, 80 * kMiB, 0.25));
+  AccountUsage usage(ledger.Usage("alice"));
+  EXPECT_EQ(35 * kMiB, usage.chunkstore_bytes);
+  EXPECT_EQ(130 * kMiB, usage.memory);
+  EXPECT_DOUBLE_EQ(0.5, usage.cpu);
+  EXPECT_EQ(0U, ledger.Usage("bob").chunkstore_bytes);
+
+  // A stopped vault's chunkstore still counts, but nothing else does.
+  ledger.StopVault(1);
+  ledger.StopVault(1);
+  usage = ledger.Usage("alice");
+  EXPECT_EQ(1U, usage.vaults);
+  EXPECT_EQ(35 * kMiB, usage.chunkstore_bytes);
+  EXPECT_EQ(80 * kMiB, usage.memory);
+  EXPECT_DOUBLE_EQ(0.25, usage.cpu);
+  ledger.SetVaultUsage(1, MakeUsage(25 * kMiB, 50 * kMiB, 0.25));
+  usage = ledger.Usage("alice");
+  EXPECT_EQ(40 * kMiB, usage.chunkstore_bytes);
+  EXPECT_EQ(80 * kMiB, usage.memory);
+
+  // Restarting keeps the vault's account.
+  ledger.StartVault(1, "bob");
+  EXPECT_EQ(2U, ledger.Usage("alice").vaults);
+  EXPECT_EQ(1U, ledger.Usage("bob").vaults);
+
+  // Once removed, nothing of the vault counts.
+  ledger.RemoveVault(0);
+  ledger.RemoveVault(0);
+  usage = ledger.Usage("alice");
+  EXPECT_EQ(1U, usage.vaults);
+  EXPECT_EQ(25 * kMiB, usage.chunkstore_bytes);
+  EXPECT_EQ(0U, usage.memory);
+  EXPECT_DOUBLE_EQ(0.0, usage.cpu);
+  ledger.SetVaultUsage(0, MakeUsage(15 * kMiB, 80 * kMiB, 0.25));
+  EXPECT_EQ(25 * kMiB, ledger.Usage("alice").chunkstore_bytes);
+}
+
+TEST(AccountBudgetTest, BEH_AdmitWithinBudget) {
+  detail::AccountLedger ledger;
+  EXPECT_EQ(AdmissionRefusal::kNone, ledger.Admit("alice"));
+  AccountBudget budget;
+  budget.max_vaults = 2;
+  budget.max_chunkstore_bytes = 100 * kMiB;
+  budget.max_memory = 200 * kMiB;
+  budget.max_cpu = 1.0;
+  ASSERT_TRUE(ledger.SetBudget("alice", budget));
+
+  ledger.StartVault(0, "alice");
+  EXPECT_EQ(AdmissionRefusal::kNone, ledger.Admit("alice"));
+  ledger.StartVault(1, "alice");
+  EXPECT_EQ(AdmissionRefusal::kAccountVaults, ledger.Admit("alice"));
+  // Other accounts are unaffected.
+  EXPECT_EQ(AdmissionRefusal::kNone, ledger.Admit("bob"));
+  ledger.StopVault(1);
+  EXPECT_EQ(AdmissionRefusal::kNone, ledger.Admit("alice"));
+
+  ledger.SetVaultUsage(0, MakeUsage(100 * kMiB, 0, 0.0));
+  EXPECT_EQ(AdmissionRefusal::kAccountStorage, ledger.Admit("alice"));
+  ledger.SetVaultUsage(0, MakeUsage(0, 200 * kMiB, 0.0));
+  EXPECT_EQ(AdmissionRefusal::kAccountMemory, ledger.Admit("alice"));
+  ledger.SetVaultUsage(0, MakeUsage(0, 0, 1.0));
+  EXPECT_EQ(AdmissionRefusal::kAccountCpu, ledger.Admit("alice"));
+  ledger.SetVaultUsage(0, MakeUsage(50 * kMiB, 100 * kMiB, 0.5));
+  EXPECT_EQ(AdmissionRefusal::kNone, ledger.Admit("alice"));
+}
+
+TEST(AccountBudgetTest, BEH_Overspent) {
+  detail::AccountLedger ledger;
+  AccountBudget budget;
+  budget.max_chunkstore_bytes = 100 * kMiB;
+  budget.max_memory = 200 * kMiB;
+  budget.max_cpu = 0.5;
+  ASSERT_TRUE(ledger.SetDefaultBudget(budget));
+  ledger.StartVault(0, "alice");
+  ledger.StartVault(1, "bob");
+  ledger.StartVault(2, "carol");
+  ledger.SetVaultUsage(0, MakeUsage(101 * kMiB, 0, 0.0));
+  ledger.SetVaultUsage(1, MakeUsage(0, 201 * kMiB, 0.0));
+  // Reaching a limit isn't overspending it, and CPU is only ever throttled.
+  ledger.SetVaultUsage(2, MakeUsage(100 * kMiB, 200 * kMiB, 2.0));
+
+  auto overspent(ledger.Overspent());
+  ASSERT_EQ(2U, overspent.size());
+  std::sort(overspent.begin(), overspent.end());
+  EXPECT_EQ("alice", overspent[0].first);
+  EXPECT_EQ(AdmissionRefusal::kAccountStorage, overspent[0].second);
+  EXPECT_EQ("bob", overspent[1].first);
+  EXPECT_EQ(AdmissionRefusal::kAccountMemory, overspent[1].second);
+
+  ledger.StopVault(1);
+  overspent = ledger.Overspent();
+  ASSERT_EQ(1U, overspent.size());
+  EXPECT_EQ("alice", overspent[0].first);
+
+  // An account over both budgets is reported for each.
+  ledger.SetVaultUsage(0, MakeUsage(101 * kMiB, 201 * kMiB, 0.0));
+  overspent = ledger.Overspent();
+  ASSERT_EQ(2U, overspent.size());
+  std::sort(overspent.begin(), overspent.end());
+  EXPECT_EQ(std::make_pair(std::string("alice"), AdmissionRefusal::kAccountStorage), overspent[0]);
+  EXPECT_EQ(std::make_pair(std::string("alice"), AdmissionRefusal::kAccountMemory), overspent[1]);
+}
+
+TEST(AccountBudgetTest, BEH_VaultLimits) {
+  detail::AccountLedger ledger;
+  EXPECT_TRUE(ledger.VaultLimits("alice").Empty());
+  AccountBudget budget;
+  budget.max_vaults = 4;
+  ASSERT_TRUE(ledger.SetBudget("alice", budget));
+  EXPECT_TRUE(ledger.VaultLimits("alice").Empty());
+
+  budget.max_memory = 300 * kMiB;
+  budget.max_cpu = 1.5;
+  ASSERT_TRUE(ledger.SetBudget("alice", budget));
+  // With no vaults counted yet, the first gets the whole budget.
+  ResourceLimits limits(ledger.VaultLimits("alice"));
+  EXPECT_EQ(300 * kMiB, limits.memory_high);
+  EXPECT_EQ(std::chrono::microseconds(150000), limits.cpu_quota);
+
+  for (ProcessIndex index(0); index != 3; ++index)
+    ledger.StartVault(index, "alice");
+  limits = ledger.VaultLimits("alice");
+  EXPECT_EQ(100 * kMiB, limits.memory_high);
+  EXPECT_EQ(std::chrono::microseconds(50000), limits.cpu_quota);
+  EXPECT_EQ(0U, limits.memory_max);
+
+  // The CPU quota never drops below the kernel's minimum.
+  budget.max_cpu = 0.01;
+  ASSERT_TRUE(ledger.SetBudget("alice", budget));
+  EXPECT_EQ(std::chrono::microseconds(1000), ledger.VaultLimits("alice").cpu_quota);
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
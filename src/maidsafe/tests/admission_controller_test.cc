@@ -0,0 +1,138 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/admission_controller.h"
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+const uint64_t kMiB(1024 * 1024);
+
+HostLoad IdleHost() {
+  HostLoad host_load;
+  host_load.available_memory = 4096 * kMiB;
+  host_load.load_average = 0.5;
+  host_load.cpu_count = 4;
+  return host_load;
+}
+
+}  // unnamed namespace
+
+TEST(AdmissionControllerTest, BEH_AdmitOnIdleHost) {
+  detail::AdmissionController admission_controller;
+  AdmissionDecision decision(admission_controller.Decide(IdleHost()));
+  EXPECT_TRUE(AdmissionDecision::Outcome::kAdmit == decision.outcome);
+  EXPECT_TRUE(AdmissionRefusal::kNone == decision.refusal);
+}
+
+TEST(AdmissionControllerTest, BEH_DeferUnderPressure) {
+  AdmissionThresholds thresholds;
+  thresholds.min_available_memory = 512 * kMiB;
+  thresholds.max_load_per_cpu = 1.5;
+  thresholds.retry_after = std::chrono::seconds(30);
+  detail::AdmissionController admission_controller(thresholds);
+
+  HostLoad low_memory(IdleHost());
+  low_memory.available_memory = 256 * kMiB;
+  AdmissionDecision decision(admission_controller.Decide(low_memory));
+  EXPECT_TRUE(AdmissionDecision::Outcome::kDefer == decision.outcome);
+  EXPECT_TRUE(AdmissionRefusal::kLowMemory == decision.refusal);
+  EXPECT_EQ(30, decision.retry_after.count());
+
+  // A new vault is expected to need as much as the average running one (here 300 MiB).
+  HostLoad tight_memory(IdleHost());
+  tight_memory.available_memory = 700 * kMiB;
+  tight_memory.vault_memory = 600 * kMiB;
+  tight_memory.vault_count = 2;
+  decision = admission_controller.Decide(tight_memory);
+  EXPECT_TRUE(AdmissionRefusal::kLowMemory == decision.refusal);
+  tight_memory.available_memory = 900 * kMiB;
+  EXPECT_TRUE(AdmissionDecision::Outcome::kAdmit ==
+              admission_controller.Decide(tight_memory).outcome);
+
+  // A load of 7 is too high for 4 CPUs, but not for 8.
+  HostLoad busy(IdleHost());
+  busy.load_average = 7.0;
+  decision = admission_controller.Decide(busy);
+  EXPECT_TRUE(AdmissionDecision::Outcome::kDefer == decision.outcome);
+  EXPECT_TRUE(AdmissionRefusal::kHighLoad == decision.refusal);
+  busy.cpu_count = 8;
+  EXPECT_TRUE(AdmissionDecision::Outcome::kAdmit == admission_controller.Decide(busy).outcome);
+}
+
+TEST(AdmissionControllerTest, BEH_RejectBeyondVaultMemoryBudget) {
+  AdmissionThresholds thresholds;
+  thresholds.max_vault_memory = 1024 * kMiB;
+  detail::AdmissionController admission_controller(thresholds);
+  HostLoad host_load(IdleHost());
+  host_load.vault_memory = 768 * kMiB;
+  host_load.vault_count = 3;
+  EXPECT_TRUE(AdmissionDecision::Outcome::kAdmit ==
+              admission_controller.Decide(host_load).outcome);
+  ++host_load.vault_count;
+  host_load.vault_memory = 1000 * kMiB;
+  AdmissionDecision decision(admission_controller.Decide(host_load));
+  EXPECT_TRUE(AdmissionDecision::Outcome::kReject == decision.outcome);
+  EXPECT_TRUE(AdmissionRefusal::kVaultMemoryBudget == decision.refusal);
+  // Waiting won't help, so no retry time is suggested.
+  EXPECT_EQ(0, decision.retry_after.count());
+}
+
+TEST(AdmissionControllerTest, BEH_SetThresholds) {
+  detail::AdmissionController admission_controller;
+  AdmissionThresholds thresholds;
+  thresholds.max_load_per_cpu = 0.0;
+  EXPECT_FALSE(admission_controller.SetThresholds(thresholds));
+  EXPECT_EQ(AdmissionThresholds().max_load_per_cpu,
+            admission_controller.thresholds().max_load_per_cpu);
+  // Nothing can be admitted once the host is required to have more memory than it could.
+  thresholds.max_load_per_cpu = 1000.0;
+  thresholds.min_available_memory = std::numeric_limits<uint64_t>::max() / 2;
+  EXPECT_TRUE(admission_controller.SetThresholds(thresholds));
+  EXPECT_TRUE(AdmissionRefusal::kLowMemory == admission_controller.Decide(IdleHost()).refusal);
+#ifdef MAIDSAFE_LINUX
+  EXPECT_TRUE(AdmissionRefusal::kLowMemory == admission_controller.Admit(0, 0).refusal);
+#endif
+}
+
+#ifdef MAIDSAFE_LINUX
+TEST(AdmissionControllerTest, BEH_ReadHostLoad) {
+  HostLoad host_load;
+  ASSERT_TRUE(detail::ReadHostLoad(host_load));
+  EXPECT_GT(host_load.available_memory, 0U);
+  EXPECT_GE(host_load.load_average, 0.0);
+  EXPECT_GE(host_load.cpu_count, 1U);
+}
+#endif
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
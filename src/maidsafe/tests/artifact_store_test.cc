@@ -0,0 +1,172 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/artifact_store.h"
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+size_t CountObjects(const fs::path& root) {
+  size_t count(0);
+  for (fs::directory_iterator itr(root / "objects"), end; itr != end; ++itr)
+    ++count;
+  return count;
+}
+
+// Makes everything in the store look older than the grace period.
+void Age(const fs::path& root) {
+  const std::time_t kOld(std::time(nullptr) -
+                         3600 * (detail::ArtifactStore::kGracePeriod().count() + 1));
+  for (fs::recursive_directory_iterator itr(root), end; itr != end; ++itr)
+    fs::last_write_time(itr->path(), kOld);
+}
+
+}  // unnamed namespace
+
+TEST(ArtifactStoreTest, BEH_AddAndActivate) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestArtifacts"));
+  const fs::path kDownloads(*test_dir / "downloads");
+  ASSERT_TRUE(fs::create_directory(kDownloads));
+  const std::string kVault1(RandomString(5000)), kVault2(RandomString(5000)),
+      kInstaller(RandomString(8000));
+  ASSERT_TRUE(WriteFile(kDownloads / "vault1", kVault1));
+  ASSERT_TRUE(WriteFile(kDownloads / "vault2", kVault2));
+  ASSERT_TRUE(WriteFile(kDownloads / "installer", kInstaller));
+  fs::permissions(kDownloads / "vault2", fs::owner_all);
+
+  detail::ArtifactStore store(*test_dir / "store");
+  EXPECT_TRUE(store.ActiveVersion().empty());
+  EXPECT_TRUE(store.Versions().empty());
+  std::map<std::string, fs::path> files;
+  files["vault"] = kDownloads / "vault1";
+  files["installer"] = kDownloads / "installer";
+  ASSERT_TRUE(store.AddVersion("1.01.001", files));
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  files["vault"] = kDownloads / "vault2";
+  ASSERT_TRUE(store.AddVersion("1.01.002", files));
+  // The installer didn't change, so it's only stored once.
+  EXPECT_EQ(3U, CountObjects(store.root()));
+  EXPECT_EQ(std::vector<std::string>({"1.01.001", "1.01.002"}), store.Versions());
+  EXPECT_TRUE(fs::exists(kDownloads / "vault1"));
+
+  std::string content;
+  ASSERT_TRUE(ReadFile(store.Path("1.01.002", "vault"), &content));
+  EXPECT_EQ(kVault2, content);
+  EXPECT_EQ(fs::owner_all, fs::status(store.Path("1.01.002", "vault")).permissions());
+  ASSERT_TRUE(ReadFile(store.Path("1.01.001", "vault"), &content));
+  EXPECT_EQ(kVault1, content);
+  EXPECT_EQ(store.Path("1.01.001", "installer"), store.Path("1.01.002", "installer"));
+  EXPECT_TRUE(store.Path("1.01.002", "missing").empty());
+  EXPECT_TRUE(store.Path("1.01.003", "vault").empty());
+
+  // Rolling back is just switching the active version.
+  ASSERT_TRUE(store.Activate("1.01.002"));
+  EXPECT_EQ("1.01.002", store.ActiveVersion());
+  ASSERT_TRUE(store.Activate("1.01.001"));
+  EXPECT_EQ("1.01.001", store.ActiveVersion());
+  EXPECT_FALSE(store.Activate("1.01.003"));
+  EXPECT_EQ("1.01.001", store.ActiveVersion());
+
+  // A second store on the same root, e.g. in another ClientManager, sees the same versions.
+  detail::ArtifactStore other_store(store.root());
+  EXPECT_EQ("1.01.001", other_store.ActiveVersion());
+  EXPECT_EQ(store.Path("1.01.002", "vault"), other_store.Path("1.01.002", "vault"));
+
+  EXPECT_FALSE(store.AddVersion("../1.01.003", files));
+  files["../vault"] = kDownloads / "vault1";
+  EXPECT_FALSE(store.AddVersion("1.01.003", files));
+  files.erase("../vault");
+  files["vault"] = kDownloads / "missing";
+  EXPECT_FALSE(store.AddVersion("1.01.003", files));
+  EXPECT_EQ(2U, store.Versions().size());
+}
+
+TEST(ArtifactStoreTest, BEH_CollectGarbage) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestArtifacts"));
+  const fs::path kInstaller(*test_dir / "installer");
+  ASSERT_TRUE(WriteFile(kInstaller, RandomString(1000)));
+  detail::ArtifactStore store(*test_dir / "store");
+  std::vector<std::string> versions;
+  for (int i(0); i != 5; ++i) {
+    versions.push_back("1.01.00" + std::to_string(i));
+    const fs::path kVault(*test_dir / versions.back());
+    ASSERT_TRUE(WriteFile(kVault, RandomString(1000)));
+    std::map<std::string, fs::path> files;
+    files["vault"] = kVault;
+    files["installer"] = kInstaller;
+    ASSERT_TRUE(store.AddVersion(versions.back(), files));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  EXPECT_EQ(6U, CountObjects(store.root()));
+  ASSERT_TRUE(store.Activate(versions[1]));
+
+  // Nothing older than the grace period, so only version records go at first.
+  RetentionPolicy policy;
+  policy.versions = 2;
+  store.CollectGarbage(policy);
+  EXPECT_EQ(std::vector<std::string>({versions[1], versions[3], versions[4]}), store.Versions());
+  EXPECT_EQ(6U, CountObjects(store.root()));
+  Age(store.root());
+  ASSERT_TRUE(WriteFile(store.root() / "tmp" / "abandoned", "partial"));
+  Age(store.root());
+  store.CollectGarbage(policy);
+  EXPECT_EQ(4U, CountObjects(store.root()));
+  EXPECT_TRUE(fs::is_empty(store.root() / "tmp"));
+  for (const auto& version : store.Versions()) {
+    EXPECT_FALSE(store.Path(version, "vault").empty());
+    EXPECT_FALSE(store.Path(version, "installer").empty());
+  }
+
+  // The active version is kept regardless, and recent versions are kept if the policy says so.
+  policy.versions = 0;
+  policy.min_age = std::chrono::hours(1);
+  store.CollectGarbage(policy);
+  EXPECT_EQ(3U, store.Versions().size());
+  policy.min_age = std::chrono::hours(0);
+  store.CollectGarbage(policy);
+  EXPECT_EQ(std::vector<std::string>({versions[1]}), store.Versions());
+  Age(store.root());
+  store.CollectGarbage(policy);
+  EXPECT_EQ(2U, CountObjects(store.root()));
+  EXPECT_TRUE(store.Activate(versions[1]));
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,96 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/bootstrap_cache.h"
+
+#include <chrono>
+#include <string>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+TEST(BootstrapCacheTest, BEH_AddAndDedupe) {
+  BootstrapCache cache(3);
+  EXPECT_TRUE(cache.Empty());
+  EXPECT_TRUE(cache.Add(EndPoint("10.0.0.1", 5483)));
+  EXPECT_TRUE(cache.Add(EndPoint("10.0.0.2", 5483)));
+  EXPECT_TRUE(cache.Add(EndPoint("10.0.0.1", 5484)));
+  EXPECT_FALSE(cache.Add(EndPoint("10.0.0.2", 5483)));
+  ASSERT_EQ(3U, cache.Size());
+
+  // Re-adding moves the endpoint to the front.
+  auto endpoints(cache.Endpoints());
+  EXPECT_EQ(EndPoint("10.0.0.2", 5483), endpoints[0]);
+  EXPECT_EQ(EndPoint("10.0.0.1", 5484), endpoints[1]);
+  EXPECT_EQ(EndPoint("10.0.0.1", 5483), endpoints[2]);
+}
+
+TEST(BootstrapCacheTest, BEH_EvictLeastRecent) {
+  BootstrapCache cache(100);
+  for (uint16_t port(0); port != 1000; ++port)
+    cache.Add(EndPoint("10.0.0.1", port));
+  ASSERT_EQ(100U, cache.Size());
+  auto endpoints(cache.Endpoints());
+  EXPECT_EQ(EndPoint("10.0.0.1", 999), endpoints.front());
+  EXPECT_EQ(EndPoint("10.0.0.1", 900), endpoints.back());
+  // An evicted endpoint is treated as new.
+  EXPECT_TRUE(cache.Add(EndPoint("10.0.0.1", 0)));
+  EXPECT_EQ(100U, cache.Size());
+}
+
+TEST(BootstrapCacheTest, BEH_CountsAndPersistence) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestBootstrapCache"));
+  fs::path file_path(*test_dir / "bootstrap.dat");
+  BootstrapCache cache;
+  cache.Add(EndPoint("10.0.0.1", 5483));
+  cache.Add(EndPoint("10.0.0.2", 5483));
+  cache.RecordSuccess(EndPoint("10.0.0.1", 5483), std::chrono::milliseconds(40));
+  cache.RecordSuccess(EndPoint("10.0.0.1", 5483), std::chrono::milliseconds(80));
+  cache.RecordFailure(EndPoint("10.0.0.2", 5483));
+  cache.RecordFailure(EndPoint("10.0.0.3", 5483));
+  ASSERT_TRUE(cache.WriteToFile(file_path));
+
+  BootstrapCache read_cache;
+  EXPECT_FALSE(read_cache.ReadFromFile(*test_dir / "missing.dat"));
+  ASSERT_TRUE(read_cache.ReadFromFile(file_path));
+  auto entries(read_cache.Entries());
+  ASSERT_EQ(2U, entries.size());
+  EXPECT_EQ(EndPoint("10.0.0.2", 5483), entries[0].endpoint);
+  EXPECT_EQ(0U, entries[0].success_count);
+  EXPECT_EQ(1U, entries[0].failure_count);
+  EXPECT_EQ(EndPoint("10.0.0.1", 5483), entries[1].endpoint);
+  EXPECT_EQ(2U, entries[1].success_count);
+  EXPECT_EQ(0U, entries[1].failure_count);
+  EXPECT_EQ(50, entries[1].latency_ms);
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
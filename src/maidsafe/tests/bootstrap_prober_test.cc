@@ -0,0 +1,214 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/bootstrap_prober.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/tcp.hpp"
+
+#include "maidsafe/common/test.h"
+
+namespace asio = boost::asio;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+// Stands in for a set of remote bootstrap nodes.  Each fake endpoint answers a probe after its
+// configured delay, unless the probe is dropped (with the configured probability).  Unknown
+// endpoints never answer.  Unanswered probes fail after 'drop_timeout' (or the probe's own timeout
+// if that's shorter) to keep the tests quick.
+class FakeEndpoints {
+ public:
+  FakeEndpoints(asio::io_service& asio_service, const bptime::time_duration& drop_timeout)
+      : asio_service_(asio_service), drop_timeout_(drop_timeout), behaviours_(), mutex_(),
+        rng_(0) {}
+
+  void Add(const EndPoint& endpoint, int delay_ms, double drop_rate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    behaviours_[endpoint] = Behaviour(bptime::milliseconds(delay_ms), drop_rate);
+  }
+
+  BootstrapProber::Probe probe() {
+    return [this](const EndPoint& endpoint, const bptime::time_duration& timeout,
+                  std::function<void(bool)> on_result) {
+      bool respond(false);
+      bptime::time_duration delay(std::min(timeout, drop_timeout_));
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto itr(behaviours_.find(endpoint));
+        if (itr != behaviours_.end() &&
+            std::uniform_real_distribution<double>(0.0, 1.0)(rng_) >= itr->second.drop_rate &&
+            itr->second.delay < timeout) {
+          respond = true;
+          delay = itr->second.delay;
+        }
+      }
+      auto timer(std::make_shared<asio::deadline_timer>(asio_service_, delay));
+      timer->async_wait([timer, respond, on_result](const boost::system::error_code&) {
+        on_result(respond);
+      });
+    };
+  }
+
+ private:
+  struct Behaviour {
+    Behaviour() : delay(), drop_rate(0.0) {}
+    Behaviour(bptime::time_duration delay_in, double drop_rate_in)
+        : delay(delay_in), drop_rate(drop_rate_in) {}
+    bptime::time_duration delay;
+    double drop_rate;
+  };
+
+  asio::io_service& asio_service_;
+  const bptime::time_duration drop_timeout_;
+  std::map<EndPoint, Behaviour> behaviours_;
+  std::mutex mutex_;
+  std::mt19937 rng_;
+};
+
+class BootstrapProberTest : public testing::Test {
+ protected:
+  BootstrapProberTest()
+      : asio_service_(),
+        work_(new asio::io_service::work(asio_service_)),
+        thread_([this] { asio_service_.run(); }),
+        fake_endpoints_(asio_service_, bptime::milliseconds(300)),
+        cache_() {}
+
+  ~BootstrapProberTest() {
+    work_.reset();
+    asio_service_.stop();
+    thread_.join();
+  }
+
+  void RunRounds(std::shared_ptr<BootstrapProber> prober, int rounds) {
+    for (int i(0); i != rounds; ++i) {
+      std::mutex mutex;
+      std::condition_variable cond_var;
+      bool done(false);
+      prober->ProbeAll([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cond_var.notify_one();
+      });
+      std::unique_lock<std::mutex> lock(mutex);
+      ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10), [&] { return done; }));
+    }
+  }
+
+  asio::io_service asio_service_;
+  std::unique_ptr<asio::io_service::work> work_;
+  std::thread thread_;
+  FakeEndpoints fake_endpoints_;
+  BootstrapCache cache_;
+};
+
+TEST_F(BootstrapProberTest, BEH_RankByLatencyAndReachability) {
+  const EndPoint kSlow("10.0.0.1", 5483), kFast("10.0.0.2", 5483), kMedium("10.0.0.3", 5483),
+      kDead("10.0.0.4", 5483), kLossy("10.0.0.5", 5483);
+  fake_endpoints_.Add(kSlow, 150, 0.0);
+  fake_endpoints_.Add(kFast, 5, 0.0);
+  fake_endpoints_.Add(kMedium, 60, 0.0);
+  fake_endpoints_.Add(kLossy, 5, 0.5);
+  for (const auto& endpoint : {kDead, kLossy, kMedium, kFast, kSlow})
+    cache_.Add(endpoint);
+  auto prober(std::make_shared<BootstrapProber>(asio_service_, cache_, fake_endpoints_.probe()));
+
+  // Insertion order until probed.
+  auto ranked(cache_.RankedEndpoints());
+  ASSERT_EQ(5U, ranked.size());
+  EXPECT_EQ(kSlow, ranked[0]);
+  EXPECT_EQ(kDead, ranked[4]);
+
+  RunRounds(prober, 8);
+  ranked = cache_.RankedEndpoints();
+  ASSERT_EQ(5U, ranked.size());
+  auto position([&ranked](const EndPoint& endpoint) {
+    return std::find(ranked.begin(), ranked.end(), endpoint) - ranked.begin();
+  });
+  // Where the lossy endpoint lands depends on which of its probes were dropped.
+  EXPECT_EQ(0, position(kFast));
+  EXPECT_LT(position(kMedium), position(kSlow));
+  EXPECT_EQ(4, position(kDead));
+
+  // Probing must not disturb the recency order.
+  auto endpoints(cache_.Endpoints());
+  EXPECT_EQ(kSlow, endpoints.front());
+  EXPECT_EQ(kDead, endpoints.back());
+  for (const auto& entry : cache_.Entries()) {
+    EXPECT_EQ(8U, entry.success_count + entry.failure_count);
+    if (entry.endpoint == kDead)
+      EXPECT_EQ(8U, entry.consecutive_failures);
+  }
+}
+
+TEST_F(BootstrapProberTest, BEH_ProbeManyEndpointsConcurrently) {
+  for (uint16_t port(0); port != 200; ++port) {
+    EndPoint endpoint("10.0.1.1", port);
+    fake_endpoints_.Add(endpoint, 20, 0.0);
+    cache_.Add(endpoint);
+  }
+  auto prober(std::make_shared<BootstrapProber>(asio_service_, cache_, fake_endpoints_.probe()));
+  auto start(std::chrono::steady_clock::now());
+  RunRounds(prober, 1);
+  auto elapsed(std::chrono::steady_clock::now() - start);
+  // Serial probing would take at least 4 seconds.
+  EXPECT_LT(elapsed, std::chrono::seconds(2));
+  for (const auto& entry : cache_.Entries())
+    EXPECT_EQ(1U, entry.success_count);
+}
+
+TEST_F(BootstrapProberTest, BEH_TcpConnectProbe) {
+  asio::ip::tcp::acceptor acceptor(asio_service_,
+                                   asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  EndPoint listening("127.0.0.1", acceptor.local_endpoint().port());
+  EndPoint invalid("not an address", 5483);
+  cache_.Add(listening);
+  cache_.Add(invalid);
+  auto prober(std::make_shared<BootstrapProber>(asio_service_, cache_));
+  RunRounds(prober, 1);
+  for (const auto& entry : cache_.Entries()) {
+    if (entry.endpoint == listening) {
+      EXPECT_EQ(1U, entry.success_count);
+      EXPECT_NE(BootstrapCache::kUnknownLatency(), entry.latency_ms);
+    } else {
+      EXPECT_EQ(1U, entry.failure_count);
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,178 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/bootstrap_refresher.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace asio = boost::asio;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+class BootstrapRefresherTest : public testing::Test {
+ protected:
+  BootstrapRefresherTest()
+      : asio_service_(),
+        work_(new asio::io_service::work(asio_service_)),
+        threads_(),
+        cache_(),
+        fetch_count_(0),
+        fetch_delay_(0),
+        failures_remaining_(0) {
+    for (int i(0); i != 2; ++i)
+      threads_.emplace_back([this] { asio_service_.run(); });
+  }
+
+  ~BootstrapRefresherTest() {
+    work_.reset();
+    asio_service_.stop();
+    for (auto& thread : threads_)
+      thread.join();
+  }
+
+  // Stands in for the download from the bootstrap server.
+  BootstrapRefresher::Fetch fetch() {
+    return [this]()->bool {
+      ++fetch_count_;
+      Sleep(std::chrono::milliseconds(fetch_delay_));
+      if (failures_remaining_ > 0) {
+        --failures_remaining_;
+        return false;
+      }
+      cache_.Add(EndPoint("10.0.0.1", 5483));
+      return true;
+    };
+  }
+
+  asio::io_service asio_service_;
+  std::unique_ptr<asio::io_service::work> work_;
+  std::vector<std::thread> threads_;
+  BootstrapCache cache_;
+  std::atomic<int> fetch_count_, fetch_delay_, failures_remaining_;
+};
+
+// ClientManager's own startup against a slow server is covered by ClientManagerTest.
+TEST_F(BootstrapRefresherTest, BEH_BackgroundFetchFromSlowBootstrapServer) {
+  fetch_delay_ = 3000;
+  auto refresher(std::make_shared<BootstrapRefresher>(asio_service_, cache_, fetch()));
+
+  auto start(std::chrono::steady_clock::now());
+  refresher->FetchInBackground();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+  EXPECT_TRUE(refresher->FetchInFlight());
+
+  // A vault asking in the meantime waits no longer than it's prepared to.
+  start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(refresher->Endpoints(std::chrono::milliseconds(100)).empty());
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+
+  // Later requests get the endpoints once they arrive, and all share the one fetch.
+  std::vector<std::future<std::vector<EndPoint>>> requests;
+  for (int i(0); i != 10; ++i) {
+    requests.push_back(std::async(std::launch::async, [refresher] {
+      return refresher->Endpoints(std::chrono::seconds(10));
+    }));
+  }
+  for (auto& request : requests)
+    EXPECT_EQ(1U, request.get().size());
+  EXPECT_EQ(1, fetch_count_);
+  refresher->Stop();
+}
+
+TEST_F(BootstrapRefresherTest, BEH_RetryInBackgroundUntilSuccessful) {
+  failures_remaining_ = 2;
+  auto refresher(std::make_shared<BootstrapRefresher>(asio_service_, cache_, fetch(),
+                                                      bptime::milliseconds(100)));
+  refresher->FetchInBackground();
+  auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+  while (cache_.Empty() && std::chrono::steady_clock::now() < deadline)
+    Sleep(std::chrono::milliseconds(20));
+  EXPECT_FALSE(cache_.Empty());
+  EXPECT_EQ(3, fetch_count_);
+
+  // Nothing further is fetched once the cache is filled.
+  refresher->FetchInBackground();
+  Sleep(std::chrono::milliseconds(300));
+  EXPECT_EQ(3, fetch_count_);
+  refresher->Stop();
+}
+
+TEST_F(BootstrapRefresherTest, BEH_ServeStaleWhileRefreshing) {
+  fetch_delay_ = 500;
+  const EndPoint kStale("10.0.0.2", 5483);
+  cache_.Add(kStale);
+  auto refresher(std::make_shared<BootstrapRefresher>(asio_service_, cache_, fetch()));
+
+  // Never fetched, so stale: served immediately, with a single refresh started.
+  auto start(std::chrono::steady_clock::now());
+  for (int i(0); i != 10; ++i) {
+    auto endpoints(refresher->Endpoints(std::chrono::seconds(10)));
+    ASSERT_EQ(1U, endpoints.size());
+    EXPECT_EQ(kStale, endpoints.front());
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(250));
+  EXPECT_TRUE(refresher->FetchInFlight());
+
+  while (refresher->FetchInFlight())
+    Sleep(std::chrono::milliseconds(20));
+  EXPECT_EQ(1, fetch_count_);
+  EXPECT_EQ(2U, refresher->Endpoints(std::chrono::seconds(0)).size());
+  // Now fresh, so no further fetch.
+  EXPECT_FALSE(refresher->FetchInFlight());
+  EXPECT_EQ(1, fetch_count_);
+  refresher->Stop();
+}
+
+TEST_F(BootstrapRefresherTest, BEH_StopWaitsForFetchInFlight) {
+  fetch_delay_ = 500;
+  failures_remaining_ = 1;
+  auto refresher(std::make_shared<BootstrapRefresher>(asio_service_, cache_, fetch(),
+                                                      bptime::milliseconds(100)));
+  refresher->FetchInBackground();
+  Sleep(std::chrono::milliseconds(100));
+  ASSERT_TRUE(refresher->FetchInFlight());
+  refresher->Stop();
+  EXPECT_FALSE(refresher->FetchInFlight());
+  EXPECT_EQ(1, fetch_count_);
+
+  // Neither the retry nor a caller can start another fetch once stopped.
+  EXPECT_TRUE(refresher->Endpoints(std::chrono::milliseconds(100)).empty());
+  Sleep(std::chrono::milliseconds(300));
+  EXPECT_EQ(1, fetch_count_);
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,89 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/child_reaper.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/process.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/client_manager/cpu_placement.h"
+#include "maidsafe/client_manager/spawner.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+#ifdef MAIDSAFE_LINUX
+TEST(ChildReaperTest, BEH_PolledChildAddedDuringWait) {
+  const std::chrono::seconds kLongWait(10);
+  const std::string kShell("/bin/sh");
+  std::vector<std::string> argv;
+  argv.push_back(kShell);
+  argv.push_back("-c");
+  argv.push_back("sleep 0.5");
+  detail::ChildReaper reaper(false);
+  detail::Spawner spawner(SpawnBackend::kPosixSpawn);
+
+  // The waiter is already blocked, with nothing to poll, when the child is added.
+  std::vector<detail::ChildReaper::Exit> exits;
+  std::chrono::steady_clock::time_point reaped;
+  std::thread waiter([&] {
+    auto start(std::chrono::steady_clock::now());
+    while (exits.empty() && std::chrono::steady_clock::now() - start < kLongWait)
+      exits = reaper.Wait(kLongWait);
+    reaped = std::chrono::steady_clock::now();
+  });
+  Sleep(std::chrono::milliseconds(200));
+
+  boost::process::child child(0);
+  boost::system::error_code error_code;
+  bool spawned(spawner.Spawn(detail::SpawnRequest(kShell, argv, kShell + " -c \"sleep 0.5\"",
+                                                  CpuPlacement(), -1, -1),
+                             child, error_code));
+  EXPECT_TRUE(spawned);
+  if (!spawned) {
+    // The waiter gives up after kLongWait, and must be joined before it's destroyed.
+    waiter.join();
+    return;
+  }
+  auto added(std::chrono::steady_clock::now());
+  reaper.Add(1, child);
+  waiter.join();
+
+  ASSERT_EQ(1U, exits.size());
+  EXPECT_EQ(1U, exits.front().index);
+  EXPECT_EQ(0, exits.front().exit_code);
+  EXPECT_EQ(0U, reaper.Size());
+  // The child's own half second, plus up to kPollInterval() and some scheduling slack.
+  EXPECT_LT(reaped - added, std::chrono::seconds(2));
+}
+#endif
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,177 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/chunked_download.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+protobuf::UpdateFile ManifestEntry(const std::string& name, const std::string& content,
+                                   uint32_t chunk_size) {
+  protobuf::UpdateFile file;
+  file.set_name(name);
+  file.set_size(content.size());
+  file.set_hash(crypto::Hash<crypto::SHA512>(content).string());
+  file.set_chunk_size(chunk_size);
+  for (size_t offset(0); offset < content.size(); offset += chunk_size) {
+    std::string chunk(content.substr(offset, chunk_size));
+    file.add_chunk_hashes(crypto::Hash<crypto::SHA512>(chunk).string());
+  }
+  return file;
+}
+
+bool ReadRange(const std::string& content, uint64_t offset, uint64_t length, std::string& range) {
+  if (offset > content.size())
+    return false;
+  range = content.substr(static_cast<size_t>(offset), static_cast<size_t>(length));
+  return true;
+}
+
+}  // unnamed namespace
+
+TEST(ChunkedDownloadTest, BEH_DownloadChunks) {
+  const std::string kContent(RandomString(1000));
+  protobuf::UpdateFile file(ManifestEntry("vault", kContent, 300));
+  std::vector<detail::DownloadChunk> chunks(detail::DownloadChunks(file));
+  ASSERT_EQ(4U, chunks.size());
+  EXPECT_EQ(900U, chunks[3].offset);
+  EXPECT_EQ(100U, chunks[3].length);
+  EXPECT_EQ(file.chunk_hashes(3), chunks[3].hash);
+
+  // Without chunk hashes, the file is a single chunk.
+  file.clear_chunk_hashes();
+  chunks = detail::DownloadChunks(file);
+  ASSERT_EQ(1U, chunks.size());
+  EXPECT_EQ(1000U, chunks[0].length);
+  EXPECT_EQ(file.hash(), chunks[0].hash);
+
+  // Chunk hashes which don't cover the file are rejected.
+  file.add_chunk_hashes("hash");
+  EXPECT_TRUE(detail::DownloadChunks(file).empty());
+  file.clear_chunk_size();
+  EXPECT_TRUE(detail::DownloadChunks(file).empty());
+}
+
+TEST(ChunkedDownloadTest, BEH_ParallelDownload) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestDownload"));
+  const fs::path kTarget(*test_dir / "vault");
+  const std::string kContent(RandomString(1024 * 1024));
+  std::atomic<int> in_flight(0), max_in_flight(0);
+  detail::ChunkedDownload download(
+      [&](const std::string& name, uint64_t offset, uint64_t length, std::string& content) {
+        int now_in_flight(++in_flight);
+        int previous_max(max_in_flight);
+        while (now_in_flight > previous_max &&
+               !max_in_flight.compare_exchange_weak(previous_max, now_in_flight)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        --in_flight;
+        return name == "vault" && ReadRange(kContent, offset, length, content);
+      },
+      4);
+  ASSERT_TRUE(download.Download(ManifestEntry("vault", kContent, 64 * 1024), kTarget));
+  std::string downloaded;
+  ASSERT_TRUE(ReadFile(kTarget, &downloaded));
+  EXPECT_TRUE(downloaded == kContent);
+  EXPECT_EQ(kContent.size(), download.bytes_fetched());
+  EXPECT_GT(max_in_flight, 1);
+  EXPECT_LE(max_in_flight, 4);
+  EXPECT_FALSE(fs::exists(kTarget.string() + ".part"));
+}
+
+TEST(ChunkedDownloadTest, BEH_ResumeDownload) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestDownload"));
+  const fs::path kTarget(*test_dir / "vault"), kPart(*test_dir / "vault.part");
+  const uint32_t kChunkSize(10000);
+  const std::string kContent(RandomString(20 * kChunkSize + 123));
+  const protobuf::UpdateFile kFile(ManifestEntry("vault", kContent, kChunkSize));
+
+  // The second half of the file can't be fetched, and one chunk arrives corrupted every time.
+  std::atomic<int> attempts(0);
+  {
+    detail::ChunkedDownload download(
+        [&](const std::string&, uint64_t offset, uint64_t length, std::string& content) {
+          ++attempts;
+          if (offset >= kContent.size() / 2 || !ReadRange(kContent, offset, length, content))
+            return false;
+          if (offset == 3 * kChunkSize)
+            content[0] ^= 1;
+          return true;
+        },
+        1);
+    EXPECT_FALSE(download.Download(kFile, kTarget));
+    EXPECT_FALSE(fs::exists(kTarget));
+    EXPECT_TRUE(fs::exists(kPart));
+    // A single thread stops at the first chunk to fail, after retrying it.
+    EXPECT_EQ(3 + detail::ChunkedDownload::kMaxAttempts(), attempts);
+  }
+
+  // Chunks already downloaded aren't fetched again, unless they've since been damaged.
+  std::string part;
+  ASSERT_TRUE(ReadFile(kPart, &part));
+  part[kChunkSize + 5] ^= 1;
+  ASSERT_TRUE(WriteFile(kPart, part));
+  detail::ChunkedDownload download(
+      [&](const std::string&, uint64_t offset, uint64_t length, std::string& content) {
+        return ReadRange(kContent, offset, length, content);
+      });
+  ASSERT_TRUE(download.Download(kFile, kTarget));
+  std::string downloaded;
+  ASSERT_TRUE(ReadFile(kTarget, &downloaded));
+  EXPECT_TRUE(downloaded == kContent);
+  EXPECT_EQ(kContent.size() - 2 * kChunkSize, download.bytes_fetched());
+  EXPECT_FALSE(fs::exists(kPart));
+
+  // A .part file of the wrong size is started over.
+  ASSERT_TRUE(WriteFile(kPart, "stale"));
+  fs::remove(kTarget);
+  ASSERT_TRUE(download.Download(kFile, kTarget));
+  ASSERT_TRUE(ReadFile(kTarget, &downloaded));
+  EXPECT_TRUE(downloaded == kContent);
+
+  download.Stop();
+  fs::remove(kTarget);
+  EXPECT_FALSE(download.Download(kFile, kTarget));
+  EXPECT_FALSE(fs::exists(kTarget));
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,165 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/chunkstore_placer.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <sys/mount.h>
+#endif
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+const uint64_t kMiB(1024 * 1024);
+
+StorageRootUsage MakeUsage(uint64_t free_mib, size_t vault_count) {
+  StorageRootUsage usage;
+  usage.free_bytes = free_mib * kMiB;
+  usage.free_inodes = usage.total_inodes = 1000;
+  usage.vault_count = vault_count;
+  return usage;
+}
+
+}  // unnamed namespace
+
+TEST(ChunkstorePlacerTest, BEH_SelectLeastLoadedRoot) {
+  typedef detail::ChunkstorePlacer Placer;
+  std::vector<StorageRootUsage> usages;
+  EXPECT_EQ(-1, Placer::Select(usages, 0, 0.0));
+  usages.push_back(MakeUsage(1000, 0));
+  usages.push_back(MakeUsage(3000, 1));
+  // 3000 MiB shared by two vaults beats 1000 MiB for one.
+  EXPECT_EQ(1, Placer::Select(usages, 0, 0.0));
+  usages[1].vault_count = 2;
+  EXPECT_EQ(0, Placer::Select(usages, 0, 0.0));
+
+  // Roots without enough free space or inodes are skipped, however lightly loaded.
+  EXPECT_EQ(1, Placer::Select(usages, 2000 * kMiB, 0.0));
+  usages[1].free_inodes = 10;
+  EXPECT_EQ(-1, Placer::Select(usages, 2000 * kMiB, 0.05));
+  // Filesystems without a fixed number of inodes report none.
+  usages[1].free_inodes = usages[1].total_inodes = 0;
+  EXPECT_EQ(1, Placer::Select(usages, 2000 * kMiB, 0.05));
+}
+
+TEST(ChunkstorePlacerTest, BEH_SpreadVaultsAcrossRoots) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestPlacer"));
+  std::vector<fs::path> roots;
+  roots.push_back(*test_dir / "a");
+  roots.push_back(*test_dir / "b");
+  for (const auto& root : roots)
+    ASSERT_TRUE(fs::create_directory(root));
+
+  detail::ChunkstorePlacer placer(0, 0.0);
+  EXPECT_TRUE(placer.Choose().empty());
+  placer.SetRoots(roots);
+  // Both roots are on the same volume, so the vaults alternate between them.
+  for (int i(0); i != 4; ++i) {
+    fs::path chosen(placer.Choose());
+    ASSERT_FALSE(chosen.empty());
+    placer.AddVault(chosen);
+  }
+  std::vector<StorageRootUsage> usages(placer.Usage());
+  ASSERT_EQ(2U, usages.size());
+  EXPECT_EQ(2U, usages[0].vault_count);
+  EXPECT_EQ(2U, usages[1].vault_count);
+
+  // Counts survive for retained roots, and vaults on unknown roots are ignored.
+  roots.push_back(*test_dir / "missing");
+  placer.SetRoots(roots);
+  placer.AddVault(*test_dir / "unknown");
+  usages = placer.Usage();
+  ASSERT_EQ(3U, usages.size());
+  EXPECT_EQ(2U, usages[0].vault_count);
+  EXPECT_EQ(0U, usages[2].vault_count);
+  // A root whose capacity can't be read is never chosen.
+  EXPECT_EQ(0U, usages[2].free_bytes);
+  EXPECT_NE(roots.back(), placer.Choose());
+
+  // Recounting starts from zero.
+  placer.ClearVaults();
+  placer.AddVault(roots.front());
+  usages = placer.Usage();
+  EXPECT_EQ(1U, usages[0].vault_count);
+  EXPECT_EQ(0U, usages[1].vault_count);
+}
+
+#ifdef MAIDSAFE_LINUX
+TEST(ChunkstorePlacerTest, FUNC_PlaceOnTmpfsRoots) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestPlacer"));
+  const fs::path kLarge(*test_dir / "large"), kSmall(*test_dir / "small");
+  ASSERT_TRUE(fs::create_directory(kLarge));
+  ASSERT_TRUE(fs::create_directory(kSmall));
+  if (mount("tmpfs", kLarge.c_str(), "tmpfs", 0, "size=96m,nr_inodes=1000") != 0) {
+    LOG(kWarning) << "Skipping test: mounting tmpfs requires privileges.";
+    return;
+  }
+  ASSERT_EQ(0, mount("tmpfs", kSmall.c_str(), "tmpfs", 0, "size=32m,nr_inodes=1000"));
+
+  detail::ChunkstorePlacer placer(8 * kMiB, 0.05);
+  std::vector<fs::path> roots;
+  roots.push_back(kLarge);
+  roots.push_back(kSmall);
+  placer.SetRoots(roots);
+  // With three times the space, the large root takes three vaults for each on the small one.
+  std::vector<fs::path> chosen;
+  for (int i(0); i != 8; ++i) {
+    chosen.push_back(placer.Choose());
+    placer.AddVault(chosen.back());
+  }
+  std::vector<StorageRootUsage> usages(placer.Usage());
+  EXPECT_EQ(6U, usages[0].vault_count);
+  EXPECT_EQ(2U, usages[1].vault_count);
+
+  // Once the large root is nearly full, only the small one is chosen.
+  std::string chunk(1024 * 1024, 'x');
+  for (int i(0); i != 90; ++i)
+    ASSERT_TRUE(WriteFile(kLarge / ("chunk" + std::to_string(i)), chunk));
+  EXPECT_EQ(kSmall, placer.Choose());
+  // And once the small root's inodes are exhausted too, neither is.
+  for (int i(0); i != 960; ++i)
+    ASSERT_TRUE(WriteFile(kSmall / ("empty" + std::to_string(i)), ""));
+  EXPECT_TRUE(placer.Choose().empty());
+
+  EXPECT_EQ(0, umount(kLarge.c_str()));
+  EXPECT_EQ(0, umount(kSmall.c_str()));
+}
+#endif
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,360 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/client_manager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/ip/udp.hpp"
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/asio_service.h"
+#include "maidsafe/common/process.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+#include "maidsafe/passport/passport.h"
+
+#include "maidsafe/client_manager/config.h"
+#include "maidsafe/client_manager/controller_messages.pb.h"
+#include "maidsafe/client_manager/local_tcp_transport.h"
+#include "maidsafe/client_manager/return_codes.h"
+#include "maidsafe/client_manager/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+// Runs the real ClientManager::Initialise in a test environment whose stand-in for the bootstrap
+// server is slow to answer.
+class ClientManagerTest : public testing::Test {
+ protected:
+  ClientManagerTest()
+      : test_dir_(maidsafe::test::CreateTestPath("MaidSafe_TestClientManager")),
+        asio_service_(1),
+        client_manager_() {}
+
+  void SetUp() {
+    detail::SetTestEnvironmentVariables(
+        ClientManager::kDefaultPort() + 200, *test_dir_,
+        process::GetOtherExecutablePath(detail::kVaultName).parent_path(),
+        std::vector<boost::asio::ip::udp::endpoint>());
+  }
+
+  void TearDown() {
+    if (client_manager_) {
+      client_manager_->transport_->StopListening();
+      client_manager_.reset();
+    }
+    asio_service_.Stop();
+    detail::SetBootstrapServerDelay(std::chrono::milliseconds(0));
+  }
+
+  // The constructor doesn't yet create the transport or call Initialise, so both are done here.
+  void Initialise() {
+    client_manager_.reset(new ClientManager);
+    client_manager_->transport_ =
+        std::make_shared<LocalTcpTransport>(client_manager_->asio_service_.service());
+    client_manager_->Initialise();
+  }
+
+  // Starts a vault for 'account' as if it had been requested by a client.
+  void StartVault(const std::string& account) {
+    ClientManager::VaultInfoPtr vault_info(std::make_shared<ClientManager::VaultInfo>());
+    vault_info->pmid.reset(new passport::Pmid(passport::Maid(passport::Anmaid())));
+    vault_info->account_name = account;
+    vault_info->chunkstore_path =
+        (*test_dir_ / ("chunkstore_" + RandomAlphaNumericString(8))).string();
+    vault_info->requested_to_run = true;
+    std::lock_guard<std::mutex> lock(client_manager_->vault_infos_mutex_);
+    ASSERT_TRUE(client_manager_->StartVaultProcess(vault_info));
+  }
+
+  // Reports every current vault as having 'chunkstore_bytes' stored.
+  void SetChunkstoreUsage(uint64_t chunkstore_bytes) {
+    VaultUsage usage;
+    usage.chunkstore_bytes = chunkstore_bytes;
+    std::lock_guard<std::mutex> lock(client_manager_->vault_infos_mutex_);
+    for (const auto& vault_info : client_manager_->vault_infos_)
+      client_manager_->account_ledger_.SetVaultUsage(vault_info->process_index, usage);
+  }
+
+  // The config file as written by Initialise, so holding everything but the vaults.
+  protobuf::ClientManagerConfig InitialConfig() {
+    protobuf::ClientManagerConfig config;
+    EXPECT_TRUE(client_manager_->ReadFileToClientManagerConfig(client_manager_->config_file_path_,
+                                                               config));
+    EXPECT_TRUE(config.has_bootstrap_endpoints());
+    return config;
+  }
+
+  ProcessIndex FirstVaultProcessIndex() {
+    std::lock_guard<std::mutex> lock(client_manager_->vault_infos_mutex_);
+    return client_manager_->vault_infos_.front()->process_index;
+  }
+
+#ifdef MAIDSAFE_LINUX
+  // Waits for the process to be running 'executable'.  Returns false if it isn't within 10s.
+  bool WaitForExecutable(ProcessIndex index, const fs::path& executable) {
+    boost::system::error_code error_code;
+    const fs::path kExpected(fs::canonical(executable, error_code));
+    auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(10));
+    while (std::chrono::steady_clock::now() < deadline) {
+      uint32_t pid(client_manager_->process_manager_.GetSystemProcessId(index));
+      if (pid != 0 &&
+          fs::read_symlink("/proc/" + std::to_string(pid) + "/exe", error_code) == kExpected)
+        return true;
+      Sleep(std::chrono::milliseconds(100));
+    }
+    return false;
+  }
+#endif
+
+  bool FetchInFlight() const { return client_manager_->bootstrap_refresher_->FetchInFlight(); }
+
+  // Asks for bootstrap endpoints as a client does.  Returns the number received, or -1 if there was
+  // no reply within 'timeout'.
+  int RequestBootstrapEndpoints(const std::chrono::milliseconds& timeout) {
+    std::mutex mutex;
+    std::condition_variable cond_var;
+    int endpoint_count(-1);
+    std::shared_ptr<LocalTcpTransport> request_transport(
+        std::make_shared<LocalTcpTransport>(asio_service_.service()));
+    int result(kUninitialised);
+    request_transport->Connect(client_manager_->local_port_, result);
+    if (result != kSuccess)
+      return -1;
+    request_transport->on_message_received().connect([&](const std::string& message,
+                                                            Port /*client_manager_port*/) {
+      MessageType type;
+      std::string payload;
+      protobuf::BootstrapResponse bootstrap_response;
+      if (!detail::UnwrapMessage(message, type, payload) ||
+          !bootstrap_response.ParseFromString(payload))
+        return;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        endpoint_count = bootstrap_response.bootstrap_endpoint_ip_size();
+      }
+      cond_var.notify_one();
+    });
+    protobuf::BootstrapRequest bootstrap_request;
+    bootstrap_request.set_message_id(RandomUint32());
+    std::unique_lock<std::mutex> lock(mutex);
+    request_transport->Send(detail::WrapMessage(MessageType::kBootstrapRequest,
+                                                bootstrap_request.SerializeAsString()),
+                            client_manager_->local_port_);
+    cond_var.wait_for(lock, timeout, [&] { return endpoint_count != -1; });
+    return endpoint_count;
+  }
+
+  maidsafe::test::TestPath test_dir_;
+  AsioService asio_service_;
+  std::unique_ptr<ClientManager> client_manager_;
+};
+
+TEST_F(ClientManagerTest, FUNC_TimeToListeningWithSlowBootstrapServer) {
+  detail::SetBootstrapServerDelay(std::chrono::seconds(3));
+  auto start(std::chrono::steady_clock::now());
+  Initialise();
+  auto time_to_listening(std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start));
+  RecordProperty("time_to_listening_ms", static_cast<int>(time_to_listening.count()));
+  EXPECT_LT(time_to_listening, std::chrono::milliseconds(500));
+  EXPECT_TRUE(FetchInFlight());
+
+  // A client asking in the meantime gets an empty reply rather than waiting for the server.
+  start = std::chrono::steady_clock::now();
+  EXPECT_EQ(0, RequestBootstrapEndpoints(std::chrono::seconds(10)));
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            ClientManager::kMaxBootstrapWait() + std::chrono::milliseconds(500));
+
+  // Once the server has answered, the endpoints are served.
+  while (FetchInFlight())
+    Sleep(std::chrono::milliseconds(20));
+  EXPECT_EQ(1, RequestBootstrapEndpoints(std::chrono::seconds(10)));
+}
+
+TEST_F(ClientManagerTest, FUNC_RestartVaultsFromConfigFile) {
+  const std::string kAccount("account");
+  const uint32_t kVaultCount(2);
+  const uint64_t kChunkstoreBytes(1000);
+  Initialise();
+  for (uint32_t i(0); i != kVaultCount; ++i)
+    StartVault(kAccount);
+  ASSERT_TRUE(client_manager_->WriteConfigFile());
+  SetChunkstoreUsage(kChunkstoreBytes);
+  EXPECT_EQ(kVaultCount * kChunkstoreBytes,
+            client_manager_->account_ledger_.Usage(kAccount).chunkstore_bytes);
+
+  // As after a non-rolling update, the vaults are stopped and re-read under new process indices.
+  client_manager_->StopAllVaults();
+  ASSERT_TRUE(client_manager_->RestartVaultsFromConfigFile());
+  EXPECT_EQ(kVaultCount, client_manager_->process_manager_.NumberOfProcesses());
+  AccountUsage usage(client_manager_->account_ledger_.Usage(kAccount));
+  EXPECT_EQ(kVaultCount, usage.vaults);
+  EXPECT_EQ(0U, usage.chunkstore_bytes);
+
+  // The old vaults' chunkstores aren't counted alongside those of the new processes.
+  SetChunkstoreUsage(kChunkstoreBytes);
+  EXPECT_EQ(kVaultCount * kChunkstoreBytes,
+            client_manager_->account_ledger_.Usage(kAccount).chunkstore_bytes);
+  client_manager_->StopAllVaults();
+
+  // A config which can't be parsed leaves the vaults as they were.
+  ASSERT_TRUE(WriteFile(client_manager_->config_file_path_, "not a config"));
+  EXPECT_FALSE(client_manager_->RestartVaultsFromConfigFile());
+  EXPECT_EQ(kVaultCount, client_manager_->process_manager_.NumberOfProcesses());
+  std::lock_guard<std::mutex> lock(client_manager_->vault_infos_mutex_);
+  EXPECT_EQ(kVaultCount, client_manager_->vault_infos_.size());
+}
+
+// Each vault is started as soon as its entry has been parsed, rather than once the whole config has
+// been, and a bad entry doesn't stop the others.
+TEST_F(ClientManagerTest, FUNC_TimeToFirstVaultStartedFromConfig) {
+  // Each of StartRequestedVaults' workers has several entries to get through, so the first vault
+  // should be started well before the last.
+  const int kEntriesPerWorker(4);
+  const int kVaultCount(kEntriesPerWorker *
+                        static_cast<int>(std::max(std::thread::hardware_concurrency(), 1U)));
+  Initialise();
+  protobuf::ClientManagerConfig config(InitialConfig());
+  for (int i(0); i != kVaultCount; ++i) {
+    ClientManager::VaultInfo vault_info;
+    vault_info.pmid.reset(new passport::Pmid(passport::Maid(passport::Anmaid())));
+    vault_info.account_name = "account";
+    vault_info.chunkstore_path = (*test_dir_ / ("chunkstore_" + std::to_string(i))).string();
+    vault_info.requested_to_run = true;
+    vault_info.ToProtobuf(config.add_vault_info());
+  }
+  protobuf::VaultInfo* bad_entry(config.add_vault_info());
+  bad_entry->set_pmid("not a pmid");
+  bad_entry->set_chunkstore_path((*test_dir_ / "chunkstore_bad").string());
+  bad_entry->set_requested_to_run(true);
+
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::chrono::steady_clock::time_point first_spawned;
+  bool spawned(false);
+  boost::signals2::scoped_connection connection(
+      client_manager_->process_manager_.on_process_event().connect([&](const ProcessEvent& event) {
+        if (event.type != ProcessEvent::Type::kSpawned)
+          return;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (spawned)
+            return;
+          spawned = true;
+          first_spawned = std::chrono::steady_clock::now();
+        }
+        cond_var.notify_one();
+      }));
+  auto start(std::chrono::steady_clock::now());
+  client_manager_->StartRequestedVaults(config);
+  auto all_started(std::chrono::steady_clock::now());
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10), [&] { return spawned; }));
+  }
+  auto time_to_first(
+      std::chrono::duration_cast<std::chrono::milliseconds>(first_spawned - start));
+  auto time_to_all(std::chrono::duration_cast<std::chrono::milliseconds>(all_started - start));
+  RecordProperty("time_to_first_spawned_ms", static_cast<int>(time_to_first.count()));
+  RecordProperty("time_to_all_started_ms", static_cast<int>(time_to_all.count()));
+  EXPECT_LT(first_spawned, all_started);
+  EXPECT_LT(time_to_first * 2, time_to_all);
+  EXPECT_EQ(static_cast<size_t>(kVaultCount),
+            client_manager_->process_manager_.NumberOfProcesses());
+  client_manager_->StopAllVaults();
+}
+
+// Vaults started from the config are subject to their account's budget, as a client's would be.
+// Those refused stay recorded, but aren't started.
+TEST_F(ClientManagerTest, FUNC_BudgetAppliedToVaultsStartedFromConfig) {
+  const std::string kAccount("account");
+  const uint32_t kMaxVaults(2);
+  Initialise();
+  AccountBudget budget;
+  budget.max_vaults = kMaxVaults;
+  ASSERT_TRUE(client_manager_->account_ledger_.SetBudget(kAccount, budget));
+  protobuf::ClientManagerConfig config(InitialConfig());
+  for (uint32_t i(0); i != kMaxVaults + 1; ++i) {
+    ClientManager::VaultInfo vault_info;
+    vault_info.pmid.reset(new passport::Pmid(passport::Maid(passport::Anmaid())));
+    vault_info.account_name = kAccount;
+    vault_info.chunkstore_path = (*test_dir_ / ("chunkstore_" + std::to_string(i))).string();
+    vault_info.requested_to_run = true;
+    vault_info.ToProtobuf(config.add_vault_info());
+  }
+  client_manager_->StartRequestedVaults(config);
+  EXPECT_EQ(kMaxVaults, client_manager_->account_ledger_.Usage(kAccount).vaults);
+  {
+    std::lock_guard<std::mutex> lock(client_manager_->vault_infos_mutex_);
+    EXPECT_EQ(kMaxVaults + 1, client_manager_->vault_infos_.size());
+  }
+  client_manager_->StopAllVaults();
+}
+
+#ifdef MAIDSAFE_LINUX
+TEST_F(ClientManagerTest, FUNC_RollBackChangesExecutable) {
+  Initialise();
+  // The second version's binary only differs by some trailing bytes, so it's stored separately.
+  const fs::path kVault(process::GetOtherExecutablePath(detail::kVaultName));
+  const fs::path kPatchedVault(*test_dir_ / detail::kVaultName);
+  std::string content;
+  ASSERT_TRUE(ReadFile(kVault, &content));
+  ASSERT_TRUE(WriteFile(kPatchedVault, content + RandomString(64)));
+  fs::permissions(kPatchedVault, fs::status(kVault).permissions());
+  std::map<std::string, fs::path> first_version, second_version;
+  first_version[detail::kVaultName] = kVault;
+  second_version[detail::kVaultName] = kPatchedVault;
+  detail::ArtifactStore& store(client_manager_->artifact_store_);
+  ASSERT_TRUE(store.AddVersion("1.0", first_version));
+  ASSERT_TRUE(store.AddVersion("2.0", second_version));
+  ASSERT_TRUE(client_manager_->ActivateVersion("2.0"));
+
+  StartVault("account");
+  const ProcessIndex kIndex(FirstVaultProcessIndex());
+  EXPECT_TRUE(WaitForExecutable(kIndex, store.Path("2.0", detail::kVaultName)));
+
+  ASSERT_TRUE(client_manager_->RollBack("1.0"));
+  EXPECT_EQ("1.0", store.ActiveVersion());
+  EXPECT_EQ(store.Path("1.0", detail::kVaultName), client_manager_->VaultExecutablePath());
+  EXPECT_TRUE(WaitForExecutable(kIndex, store.Path("1.0", detail::kVaultName)));
+  EXPECT_FALSE(client_manager_->RollBack("3.0"));
+  client_manager_->StopAllVaults();
+}
+#endif
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
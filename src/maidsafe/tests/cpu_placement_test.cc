@@ -0,0 +1,115 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/cpu_placement.h"
+
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+TEST(CpuPlacementTest, BEH_ParseCpuList) {
+  EXPECT_EQ(std::vector<uint32_t>({ 0 }), detail::ParseCpuList("0\n"));
+  EXPECT_EQ(std::vector<uint32_t>({ 0, 1, 2, 3, 8, 10, 11 }),
+            detail::ParseCpuList("0-3,8,10-11"));
+  EXPECT_EQ(std::vector<uint32_t>({ 1, 2, 3 }), detail::ParseCpuList("2-3,1-2"));
+  EXPECT_TRUE(detail::ParseCpuList("").empty());
+  EXPECT_TRUE(detail::ParseCpuList("\n").empty());
+  EXPECT_TRUE(detail::ParseCpuList("a").empty());
+  EXPECT_TRUE(detail::ParseCpuList("3-1").empty());
+  EXPECT_TRUE(detail::ParseCpuList("0-").empty());
+  EXPECT_TRUE(detail::ParseCpuList("0-1x").empty());
+  EXPECT_TRUE(detail::ParseCpuList("0-100000").empty());
+}
+
+TEST(CpuPlacementTest, BEH_Validation) {
+  CpuPlacement placement;
+  EXPECT_TRUE(placement.IsValid());
+  EXPECT_TRUE(placement.Empty());
+  placement.cpus.push_back(1024);
+  EXPECT_FALSE(placement.IsValid());
+  placement.cpus.back() = 3;
+  EXPECT_TRUE(placement.IsValid());
+  EXPECT_FALSE(placement.Empty());
+  placement.bind_memory = true;
+  EXPECT_FALSE(placement.IsValid());
+  placement.numa_node = 1;
+  EXPECT_TRUE(placement.IsValid());
+}
+
+TEST(CpuPlacementTest, BEH_RoundRobinNodes) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestCpuTopology"));
+  fs::path node_dir(*test_dir / "devices" / "system" / "node");
+  ASSERT_TRUE(fs::create_directories(node_dir / "node0"));
+  ASSERT_TRUE(fs::create_directories(node_dir / "node1"));
+  ASSERT_TRUE(fs::create_directories(node_dir / "node2"));
+  ASSERT_TRUE(WriteFile(node_dir / "node0" / "cpulist", "0-1,4-5\n"));
+  ASSERT_TRUE(WriteFile(node_dir / "node1" / "cpulist", "2-3,6-7\n"));
+  // Memory-only node.
+  ASSERT_TRUE(WriteFile(node_dir / "node2" / "cpulist", "\n"));
+  ASSERT_TRUE(WriteFile(node_dir / "possible", "0-2\n"));
+
+  detail::CpuTopology topology(*test_dir);
+  ASSERT_EQ(2U, topology.nodes().size());
+  EXPECT_EQ(0U, topology.nodes()[0].id);
+  EXPECT_EQ(1U, topology.nodes()[1].id);
+
+  for (size_t count(0); count != 4; ++count) {
+    CpuPlacement placement(topology.RoundRobin(count));
+    EXPECT_EQ(static_cast<int32_t>(count % 2), placement.numa_node);
+    EXPECT_EQ(count % 2 == 0 ? std::vector<uint32_t>({ 0, 1, 4, 5 })
+                             : std::vector<uint32_t>({ 2, 3, 6, 7 }),
+              placement.cpus);
+    EXPECT_FALSE(placement.bind_memory);
+    EXPECT_TRUE(placement.IsValid());
+  }
+}
+
+TEST(CpuPlacementTest, BEH_NoNumaSupport) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestCpuTopology"));
+  detail::CpuTopology missing(*test_dir);
+  EXPECT_TRUE(missing.nodes().empty());
+  EXPECT_TRUE(missing.RoundRobin(0).Empty());
+
+  fs::path cpu_dir(*test_dir / "devices" / "system" / "cpu");
+  ASSERT_TRUE(fs::create_directories(cpu_dir));
+  ASSERT_TRUE(WriteFile(cpu_dir / "online", "0-3\n"));
+  detail::CpuTopology topology(*test_dir);
+  ASSERT_EQ(1U, topology.nodes().size());
+  CpuPlacement placement(topology.RoundRobin(1));
+  EXPECT_EQ(0, placement.numa_node);
+  EXPECT_EQ(std::vector<uint32_t>({ 0, 1, 2, 3 }), placement.cpus);
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
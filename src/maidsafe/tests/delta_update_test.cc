@@ -0,0 +1,209 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/delta_update.h"
+
+#include <string>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/rsa.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+std::string HashOf(const std::string& content) {
+  return crypto::Hash<crypto::SHA512>(content).string();
+}
+
+// Stands in for the update server.
+detail::UpdateFetcher DirectoryFetcher(const fs::path& directory) {
+  return [directory](const std::string& name, uint64_t offset, uint64_t length,
+                     std::string& content) {
+    if (!ReadFile(directory / name, &content) || offset > content.size())
+      return false;
+    content = content.substr(static_cast<size_t>(offset), static_cast<size_t>(length));
+    return true;
+  };
+}
+
+// An edited copy of 'source': bytes changed, inserted and removed, and blocks moved.
+std::string Edit(const std::string& source) {
+  std::string target(source);
+  target.replace(1000, 10, RandomString(10));
+  target.insert(5000, RandomString(300));
+  target.erase(20000, 700);
+  target += target.substr(2000, 4000);
+  target.replace(40000, 8000, target.substr(10000, 8000));
+  return target;
+}
+
+std::string SignManifest(const protobuf::UpdateManifest& manifest, const asymm::Keys& keys) {
+  protobuf::SignedUpdateManifest signed_manifest;
+  signed_manifest.set_serialised_manifest(manifest.SerializeAsString());
+  signed_manifest.set_signature(
+      asymm::Sign(asymm::PlainText(signed_manifest.serialised_manifest()), keys.private_key)
+          .string());
+  return signed_manifest.SerializeAsString();
+}
+
+}  // unnamed namespace
+
+TEST(DeltaUpdateTest, BEH_CreateAndApplyDelta) {
+  const std::string kSource(RandomString(64 * 1024));
+  const std::string kTarget(Edit(kSource));
+  std::string delta(detail::CreateDelta(kSource, kTarget)), result;
+  ASSERT_TRUE(detail::ApplyDelta(kSource, delta, result));
+  EXPECT_EQ(kTarget, result);
+  EXPECT_LT(delta.size(), 2000U);
+
+  // Degenerate cases.
+  for (const auto& source : {std::string(), std::string("short"), kSource}) {
+    for (const auto& target : {std::string(), std::string("tiny"), kTarget}) {
+      ASSERT_TRUE(detail::ApplyDelta(source, detail::CreateDelta(source, target), result));
+      EXPECT_EQ(target, result);
+    }
+  }
+  const std::string kRepetitive(100000, 'a');
+  ASSERT_TRUE(detail::ApplyDelta(kRepetitive.substr(0, 1000),
+                                 detail::CreateDelta(kRepetitive.substr(0, 1000), kRepetitive),
+                                 result));
+  EXPECT_EQ(kRepetitive, result);
+
+  // Malformed deltas, and ones for a different source, are rejected.
+  EXPECT_FALSE(detail::ApplyDelta(kSource, delta.substr(0, delta.size() / 2), result));
+  EXPECT_FALSE(detail::ApplyDelta(kSource, delta + "C", result));
+  EXPECT_FALSE(detail::ApplyDelta(kSource.substr(0, 1000), delta, result));
+  EXPECT_FALSE(detail::ApplyDelta(kSource, std::string(), result));
+}
+
+TEST(DeltaUpdateTest, BEH_UpdateFile) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestDeltaUpdate"));
+  const fs::path kServer(*test_dir / "server"), kInstalled(*test_dir / "vault"),
+      kStaged(*test_dir / "vault.new");
+  ASSERT_TRUE(fs::create_directory(kServer));
+  const std::string kOld(RandomString(100 * 1024)), kOlder(RandomString(100 * 1024)),
+      kNew(Edit(kOld));
+  const std::string kDelta(detail::CreateDelta(kOld, kNew));
+  ASSERT_TRUE(WriteFile(kServer / "vault", kNew));
+  ASSERT_TRUE(WriteFile(kServer / "vault.delta", kDelta));
+
+  asymm::Keys keys(asymm::GenerateKeyPair());
+  protobuf::UpdateManifest manifest;
+  manifest.set_version("1.02.003");
+  protobuf::UpdateFile* file(manifest.add_files());
+  file->set_name("vault");
+  file->set_size(kNew.size());
+  file->set_hash(HashOf(kNew));
+  protobuf::UpdateDelta* delta(file->add_deltas());
+  delta->set_from_hash(HashOf(kOld));
+  delta->set_name("vault.delta");
+  delta->set_size(kDelta.size());
+
+  detail::DeltaUpdater updater(keys.public_key, DirectoryFetcher(kServer));
+  protobuf::UpdateManifest read_manifest;
+  ASSERT_TRUE(updater.ReadManifest(SignManifest(manifest, keys), read_manifest));
+  ASSERT_EQ(1, read_manifest.files_size());
+  const protobuf::UpdateFile& kFile(read_manifest.files(0));
+  std::string staged;
+
+  // Only the delta is fetched for the version it was made against.
+  ASSERT_TRUE(WriteFile(kInstalled, kOld));
+  ASSERT_TRUE(updater.UpdateFile(kFile, kInstalled, kStaged));
+  ASSERT_TRUE(ReadFile(kStaged, &staged));
+  EXPECT_EQ(kNew, staged);
+  EXPECT_EQ(kDelta.size(), updater.bytes_fetched());
+
+  // Nothing is fetched if the installed file is already up to date.
+  ASSERT_TRUE(WriteFile(kInstalled, kNew));
+  ASSERT_TRUE(updater.UpdateFile(kFile, kInstalled, kStaged));
+  EXPECT_EQ(kDelta.size(), updater.bytes_fetched());
+
+  // Other versions, and missing files, get the whole file.
+  ASSERT_TRUE(WriteFile(kInstalled, kOlder));
+  ASSERT_TRUE(updater.UpdateFile(kFile, kInstalled, kStaged));
+  ASSERT_TRUE(ReadFile(kStaged, &staged));
+  EXPECT_EQ(kNew, staged);
+  EXPECT_EQ(kDelta.size() + kNew.size(), updater.bytes_fetched());
+  fs::remove(kInstalled);
+  fs::remove(kStaged);
+  ASSERT_TRUE(updater.UpdateFile(kFile, kInstalled, kStaged));
+  ASSERT_TRUE(ReadFile(kStaged, &staged));
+  EXPECT_EQ(kNew, staged);
+
+  // A delta which doesn't produce the file in the manifest is abandoned for the whole file.
+  ASSERT_TRUE(WriteFile(kInstalled, kOld));
+  ASSERT_TRUE(WriteFile(kServer / "vault.delta", detail::CreateDelta(kOld, kOlder)));
+  fs::remove(kStaged);
+  ASSERT_TRUE(updater.UpdateFile(kFile, kInstalled, kStaged));
+  ASSERT_TRUE(ReadFile(kStaged, &staged));
+  EXPECT_EQ(kNew, staged);
+}
+
+TEST(DeltaUpdateTest, BEH_RejectUnverified) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestDeltaUpdate"));
+  const fs::path kServer(*test_dir / "server"), kStaged(*test_dir / "vault.new");
+  ASSERT_TRUE(fs::create_directory(kServer));
+  const std::string kNew(RandomString(10000));
+  ASSERT_TRUE(WriteFile(kServer / "vault", kNew));
+
+  asymm::Keys keys(asymm::GenerateKeyPair()), other_keys(asymm::GenerateKeyPair());
+  protobuf::UpdateManifest manifest;
+  manifest.set_version("1.02.003");
+  protobuf::UpdateFile* file(manifest.add_files());
+  file->set_name("vault");
+  file->set_size(kNew.size());
+  file->set_hash(HashOf(kNew));
+
+  detail::DeltaUpdater updater(keys.public_key, DirectoryFetcher(kServer));
+  protobuf::UpdateManifest read_manifest;
+  EXPECT_FALSE(updater.ReadManifest(SignManifest(manifest, other_keys), read_manifest));
+  std::string tampered(SignManifest(manifest, keys));
+  tampered[tampered.size() / 2] ^= 1;
+  EXPECT_FALSE(updater.ReadManifest(tampered, read_manifest));
+  EXPECT_FALSE(updater.ReadManifest("garbage", read_manifest));
+
+  // A file which doesn't match the manifest isn't written.
+  file->set_hash(HashOf(kNew + "x"));
+  EXPECT_FALSE(updater.UpdateFile(*file, *test_dir / "missing", kStaged));
+  EXPECT_FALSE(fs::exists(kStaged));
+  file->set_hash(HashOf(kNew));
+  file->set_size(kNew.size() + 1);
+  EXPECT_FALSE(updater.UpdateFile(*file, *test_dir / "missing", kStaged));
+  EXPECT_FALSE(fs::exists(kStaged));
+  file->set_name("absent");
+  EXPECT_FALSE(updater.UpdateFile(*file, *test_dir / "missing", kStaged));
+  EXPECT_FALSE(fs::exists(kStaged));
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,168 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/disk_usage_tracker.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+// Walks the whole tree, to check the tracker's running totals against.
+DiskUsage WalkTree(const fs::path& root) {
+  DiskUsage total;
+  std::vector<fs::path> pending(1, root);
+  while (!pending.empty()) {
+    fs::path directory(pending.back());
+    pending.pop_back();
+    DiskUsage usage;
+    detail::ScanDirectory(directory, usage, pending);
+    total.bytes += usage.bytes;
+    total.files += usage.files;
+  }
+  return total;
+}
+
+testing::AssertionResult UsageBecomes(const detail::DiskUsageTracker& tracker,
+                                      const fs::path& root, const DiskUsage& expected) {
+  DiskUsage usage;
+  for (int i(0); i != 100; ++i) {
+    if (tracker.Usage(root, usage) && usage.bytes == expected.bytes &&
+        usage.files == expected.files) {
+      return testing::AssertionSuccess();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return testing::AssertionFailure() << "Usage of " << root << " is " << usage.files
+                                     << " files, " << usage.bytes << " bytes; expected "
+                                     << expected.files << " files, " << expected.bytes << " bytes";
+}
+
+void WriteFiles(const fs::path& directory, int count, size_t size) {
+  for (int i(0); i != count; ++i) {
+    ASSERT_TRUE(WriteFile(directory / ("chunk" + std::to_string(i)),
+                          std::string(size * (i + 1), 'x')));
+  }
+}
+
+}  // unnamed namespace
+
+TEST(DiskUsageTrackerTest, BEH_ScanDirectory) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestDiskUsage"));
+  WriteFiles(*test_dir, 3, 10000);
+  ASSERT_TRUE(fs::create_directory(*test_dir / "sub"));
+  WriteFiles(*test_dir / "sub", 2, 10000);
+#ifndef MAIDSAFE_WIN32
+  fs::create_symlink(*test_dir / "sub", *test_dir / "link");
+#endif
+  DiskUsage usage;
+  std::vector<fs::path> subdirectories;
+  ASSERT_TRUE(detail::ScanDirectory(*test_dir, usage, subdirectories));
+  EXPECT_EQ(3U, usage.files);
+  EXPECT_GE(usage.bytes, 60000U);
+  ASSERT_EQ(1U, subdirectories.size());
+  EXPECT_EQ(*test_dir / "sub", subdirectories.front());
+  EXPECT_FALSE(detail::ScanDirectory(*test_dir / "missing", usage, subdirectories));
+}
+
+TEST(DiskUsageTrackerTest, BEH_InitialScan) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestDiskUsage"));
+  const fs::path kChunkstore(*test_dir / "chunkstore");
+  for (int i(0); i != 8; ++i) {
+    fs::path directory(kChunkstore / std::to_string(i) / "nested");
+    ASSERT_TRUE(fs::create_directories(directory));
+    WriteFiles(directory, i, 1000);
+    WriteFiles(directory.parent_path(), 2, 3000);
+  }
+  const DiskUsage kExpected(WalkTree(kChunkstore));
+  EXPECT_EQ(44U, kExpected.files);
+
+  detail::DiskUsageTracker tracker(4);
+  DiskUsage usage;
+  EXPECT_FALSE(tracker.Usage(kChunkstore, usage));
+  tracker.Add(kChunkstore);
+  tracker.Add(kChunkstore);
+  EXPECT_TRUE(UsageBecomes(tracker, kChunkstore, kExpected));
+  EXPECT_FALSE(tracker.Usage(*test_dir, usage));
+
+  // A chunkstore which doesn't exist yet is empty.
+  tracker.Add(*test_dir / "missing");
+  EXPECT_TRUE(UsageBecomes(tracker, *test_dir / "missing", DiskUsage()));
+}
+
+#ifdef MAIDSAFE_LINUX
+TEST(DiskUsageTrackerTest, BEH_FollowChanges) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestDiskUsage"));
+  const fs::path kChunkstore(*test_dir / "chunkstore");
+  ASSERT_TRUE(fs::create_directories(kChunkstore / "a"));
+  WriteFiles(kChunkstore / "a", 5, 2000);
+  // The rescan interval is too long to come into play, so only events can update the totals.
+  detail::DiskUsageTracker tracker(2, std::chrono::milliseconds(100), std::chrono::hours(1));
+  tracker.Add(kChunkstore);
+  ASSERT_TRUE(UsageBecomes(tracker, kChunkstore, WalkTree(kChunkstore)));
+
+  // Files added and removed in watched directories.
+  WriteFiles(kChunkstore, 3, 5000);
+  fs::remove(kChunkstore / "a" / "chunk0");
+  EXPECT_TRUE(UsageBecomes(tracker, kChunkstore, WalkTree(kChunkstore)));
+  // A file rewritten with a different size.
+  ASSERT_TRUE(WriteFile(kChunkstore / "a" / "chunk1", std::string(100000, 'y')));
+  EXPECT_TRUE(UsageBecomes(tracker, kChunkstore, WalkTree(kChunkstore)));
+
+  // New directories, including ones which already hold files when they appear.
+  ASSERT_TRUE(fs::create_directories(kChunkstore / "b" / "c"));
+  WriteFiles(kChunkstore / "b" / "c", 4, 3000);
+  ASSERT_TRUE(fs::create_directories(*test_dir / "staging" / "d"));
+  WriteFiles(*test_dir / "staging" / "d", 2, 7000);
+  fs::rename(*test_dir / "staging", kChunkstore / "staging");
+  EXPECT_TRUE(UsageBecomes(tracker, kChunkstore, WalkTree(kChunkstore)));
+  EXPECT_EQ(13U, WalkTree(kChunkstore).files);
+
+  // Directories removed or moved out.
+  fs::remove_all(kChunkstore / "b");
+  EXPECT_TRUE(UsageBecomes(tracker, kChunkstore, WalkTree(kChunkstore)));
+  fs::rename(kChunkstore / "staging", *test_dir / "staging");
+  EXPECT_TRUE(UsageBecomes(tracker, kChunkstore, WalkTree(kChunkstore)));
+  // Changes outside the chunkstore aren't counted.
+  WriteFiles(*test_dir / "staging", 2, 1000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  EXPECT_TRUE(UsageBecomes(tracker, kChunkstore, WalkTree(kChunkstore)));
+  EXPECT_EQ(7U, WalkTree(kChunkstore).files);
+}
+#endif
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -16,9 +16,13 @@
     See the Licences for the specific language governing permissions and limitations relating to
     use of the MaidSafe Software.                                                                 */
 
+#include <chrono>
+#include <csignal>
+#include <memory>
 #include <string>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 
 #include "boost/asio/ip/udp.hpp"
 #include "boost/program_options.hpp"
@@ -27,6 +31,8 @@
 #include "maidsafe/common/rsa.h"
 #include "maidsafe/common/utils.h"
 
+#include "maidsafe/client_manager/heartbeat.h"
+#include "maidsafe/client_manager/utils.h"
 #include "maidsafe/client_manager/vault_controller.h"
 
 namespace po = boost::program_options;
@@ -56,6 +62,10 @@ int main(int argc, char* argv[]) {
   options_description.add_options()("help", "produce help message")(
       "runtime", po::value<int>(), "Set runtime in seconds then crash")(
       "nocrash", "set no crash on runtime ended")(
+      "ignore_sigterm", "ignore SIGTERM")(
+      "heartbeat_for", po::value<int>(), "beat for this many seconds, then hang")(
+      "hang_after", po::value<int>(),
+      "with a vault controller, hang this many seconds after taking over, but keep running")(
       "vmid", po::value<std::string>(), "vaults manager ID")("nocontroller",
                                                              "set to use no vault controller")(
       "usr_id", po::value<std::string>()->default_value("client"),
@@ -71,6 +81,8 @@ int main(int argc, char* argv[]) {
       std::cout << options_description;
       return -1;
     }
+    if (variables_map.count("ignore_sigterm"))
+      std::signal(SIGTERM, SIG_IGN);
     if (!variables_map.count("vmid")) {
       LOG(kError) << "dummy_vault: You must supply a vaults manager ID";
       return -2;
@@ -80,12 +92,30 @@ int main(int argc, char* argv[]) {
       usr_id = variables_map.at("usr_id").as<std::string>();
 
     std::string client_manager_id = variables_map["vmid"].as<std::string>();
+    if (variables_map.count("heartbeat_for")) {
+      namespace detail = maidsafe::client_manager::detail;
+      maidsafe::client_manager::ProcessIndex process_index(0);
+      uint16_t client_manager_port(0);
+      detail::ParseVmidParameter(client_manager_id, process_index, client_manager_port);
+      std::shared_ptr<detail::Heartbeat> heartbeat(
+          new detail::Heartbeat(detail::HeartbeatName(process_index, client_manager_port)));
+      auto beat_until(std::chrono::steady_clock::now() +
+                      std::chrono::seconds(variables_map["heartbeat_for"].as<int>()));
+      std::thread([heartbeat, beat_until] {
+        while (std::chrono::steady_clock::now() < beat_until) {
+          heartbeat->Beat();
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+      }).detach();
+    }
     if (!variables_map.count("nocontroller")) {
       LOG(kInfo) << "dummy_vault: Starting VaultController: " << usr_id;
-      maidsafe::client_manager::VaultController vault_controller(usr_id, [&] { StopHandler(); });
+      maidsafe::client_manager::VaultController vault_controller(client_manager_id,
+                                                                 [&] { StopHandler(); });
       std::unique_ptr<maidsafe::passport::Pmid> pmid;
       std::vector<boost::asio::ip::udp::endpoint> bootstrap_endpoints;
-      vault_controller.GetIdentity(pmid, bootstrap_endpoints);
+      if (!vault_controller.GetIdentity(pmid, bootstrap_endpoints))
+        return 0;
       LOG(kInfo) << "dummy_vault: Identity: " << maidsafe::Base64Substr(pmid->name().value);
       LOG(kInfo) << "Validation Token: "
                  << maidsafe::Base64Substr(pmid->validation_token().string());
@@ -94,13 +124,34 @@ int main(int argc, char* argv[]) {
       LOG(kInfo) << "Private Key: "
                  << maidsafe::Base64Substr(maidsafe::asymm::EncodeKey(pmid->private_key()));
       vault_controller.ConfirmJoin();
+      // A standby joins the network alongside the vault it's replacing, but has to wait for that
+      // vault to exit before it may use the chunkstore.
+      if (!vault_controller.WaitForTakeover())
+        return 0;
 
       boost::asio::ip::udp::endpoint endpoint;
       endpoint.address(boost::asio::ip::address::from_string("127.0.0.46"));
       endpoint.port(3658);
       vault_controller.SendEndpointToClientManager(endpoint);
+
+      // The main loop beats for as long as it's making progress.  A hung one stops beating, though
+      // the process and its controller carry on.
+      const auto kBeatInterval(maidsafe::client_manager::detail::Heartbeat::kDefaultInterval());
+      auto hang_time(std::chrono::steady_clock::time_point::max());
+      if (variables_map.count("hang_after")) {
+        hang_time = std::chrono::steady_clock::now() +
+                    std::chrono::seconds(variables_map["hang_after"].as<int>());
+      }
       std::unique_lock<std::mutex> lock(mutex);
-      cond_var.wait(lock, [] { return g_check_finished; });  // NOLINT (Fraser)
+      while (!cond_var.wait_for(lock, kBeatInterval, [] { return g_check_finished; })) {  // NOLINT
+        if (std::chrono::steady_clock::now() >= hang_time) {
+          LOG(kInfo) << "dummy_vault: Main loop hanging.";
+          lock.unlock();
+          for (;;)
+            std::this_thread::sleep_for(std::chrono::hours(1));
+        }
+        vault_controller.Heartbeat();
+      }
     }
 
     if (variables_map.count("runtime")) {
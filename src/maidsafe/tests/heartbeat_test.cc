@@ -0,0 +1,75 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/heartbeat.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+TEST(HeartbeatTest, BEH_PolicyValidity) {
+  EXPECT_TRUE(HeartbeatPolicy().Empty());
+  EXPECT_TRUE(HeartbeatPolicy().IsValid());
+  EXPECT_TRUE(HeartbeatPolicy(std::chrono::seconds(1), std::chrono::seconds(5)).IsValid());
+  EXPECT_FALSE(HeartbeatPolicy(std::chrono::seconds(-1), std::chrono::seconds(5)).IsValid());
+  // A watched process must be given some time to start.
+  EXPECT_FALSE(HeartbeatPolicy(std::chrono::seconds(1), std::chrono::seconds(0)).IsValid());
+}
+
+TEST(HeartbeatTest, BEH_BeatsSeenByMonitor) {
+  const std::string kName(detail::HeartbeatName(1, 65535));
+  {
+    detail::HeartbeatMonitor monitor(kName);
+    EXPECT_EQ(0U, monitor.Count());
+    detail::Heartbeat heartbeat(kName);
+    heartbeat.Beat();
+    heartbeat.Beat();
+    EXPECT_EQ(2U, monitor.Count());
+    monitor.Reset();
+    EXPECT_EQ(0U, monitor.Count());
+    heartbeat.Beat();
+    EXPECT_EQ(1U, monitor.Count());
+
+    // A monitor left behind (e.g. by a crashed manager) is replaced.
+    std::unique_ptr<detail::HeartbeatMonitor> replacement;
+    EXPECT_NO_THROW(replacement.reset(new detail::HeartbeatMonitor(kName)));
+    EXPECT_EQ(0U, replacement->Count());
+  }
+  // The monitor removes the shared memory, so the process can't find it.
+  EXPECT_ANY_THROW(detail::Heartbeat heartbeat(kName));
+}
+
+TEST(HeartbeatTest, BEH_NamesAreDistinct) {
+  EXPECT_NE(detail::HeartbeatName(1, 5483), detail::HeartbeatName(2, 5483));
+  EXPECT_NE(detail::HeartbeatName(1, 5483), detail::HeartbeatName(1, 5484));
+  EXPECT_NE(detail::HeartbeatName(1, 23), detail::HeartbeatName(12, 3));
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
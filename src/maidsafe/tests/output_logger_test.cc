@@ -0,0 +1,262 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/output_logger.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/client_manager/spawner.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+#ifdef MAIDSAFE_LINUX
+namespace {
+
+std::string ReadAll(const fs::path& path) {
+  std::string content;
+  ReadFile(path, &content);
+  return content;
+}
+
+void WriteAll(int fd, const std::string& data) {
+  size_t offset(0);
+  while (offset != data.size()) {
+    ssize_t written(write(fd, data.data() + offset, data.size() - offset));
+    ASSERT_GT(written, 0);
+    offset += written;
+  }
+}
+
+// Returns false if the content of 'path' doesn't end with 'tail' within a few seconds.
+bool WaitForContent(const fs::path& path, const std::string& tail) {
+  auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+  while (std::chrono::steady_clock::now() < deadline) {
+    std::string content(ReadAll(path));
+    if (content.size() >= tail.size() &&
+        content.compare(content.size() - tail.size(), tail.size(), tail) == 0)
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+// Whether this process has 'path' open.
+bool IsOpen(const fs::path& path) {
+  boost::system::error_code error_code;
+  for (fs::directory_iterator itr("/proc/self/fd", error_code), end; itr != end; ++itr) {
+    if (fs::read_symlink(itr->path(), error_code) == path)
+      return true;
+  }
+  return false;
+}
+
+}  // unnamed namespace
+
+TEST(OutputLoggerTest, BEH_CaptureOutput) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestOutputLogger"));
+  const fs::path kLogFile(*test_dir / "logs" / "process.log");
+  {
+    detail::OutputLogger output_logger;
+    int fd(output_logger.Open(1, kLogFile));
+    ASSERT_NE(-1, fd);
+    WriteAll(fd, "first run\n");
+    // A restarted process's output goes to the same file, even while the previous pipe is open.
+    int restarted_fd(output_logger.Open(1, kLogFile));
+    ASSERT_NE(-1, restarted_fd);
+    close(fd);
+    ASSERT_TRUE(WaitForContent(kLogFile, "first run\n"));
+    WriteAll(restarted_fd, "second run\n");
+    close(restarted_fd);
+    // Output still in the pipe when the logger is destroyed is written out.
+    fd = output_logger.Open(2, *test_dir / "other.log");
+    ASSERT_NE(-1, fd);
+    WriteAll(fd, "unread\n");
+  }
+  EXPECT_EQ("first run\nsecond run\n", ReadAll(kLogFile));
+  EXPECT_EQ("unread\n", ReadAll(*test_dir / "other.log"));
+}
+
+// Closing a process's log only releases the file once its pipe is closed and all of its output has
+// been written.
+TEST(OutputLoggerTest, BEH_CloseLog) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestOutputLogger"));
+  const fs::path kLogFile(fs::canonical(*test_dir) / "process.log");
+  detail::OutputLogger output_logger;
+  int fd(output_logger.Open(1, kLogFile));
+  ASSERT_NE(-1, fd);
+  WriteAll(fd, "before close\n");
+  ASSERT_TRUE(WaitForContent(kLogFile, "before close\n"));
+  output_logger.Close(1);
+  WriteAll(fd, "after close\n");
+  ASSERT_TRUE(WaitForContent(kLogFile, "after close\n"));
+  EXPECT_TRUE(IsOpen(kLogFile));
+  close(fd);
+  auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+  while (IsOpen(kLogFile) && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_FALSE(IsOpen(kLogFile));
+  EXPECT_EQ("before close\nafter close\n", ReadAll(kLogFile));
+  // Closing again, or closing an unknown process, does nothing.
+  output_logger.Close(1);
+  output_logger.Close(2);
+}
+
+TEST(OutputLoggerTest, BEH_RotateLogFiles) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestOutputLogger"));
+  const fs::path kLogFile(*test_dir / "process.log");
+  // Two of these 40-byte lines fit in each file.
+  auto line([](int number) { return std::to_string(number) + std::string(38, 'x') + "\n"; });
+  {
+    detail::OutputLogger output_logger(100, 2);
+    int fd(output_logger.Open(1, kLogFile));
+    ASSERT_NE(-1, fd);
+    // Each write is waited for, so that the writer sees them separately.
+    for (int i(0); i != 8; ++i) {
+      WriteAll(fd, line(i));
+      ASSERT_TRUE(WaitForContent(kLogFile, line(i)));
+    }
+    close(fd);
+  }
+  EXPECT_EQ(line(6) + line(7), ReadAll(kLogFile));
+  EXPECT_EQ(line(4) + line(5), ReadAll(kLogFile.string() + ".1"));
+  EXPECT_EQ(line(2) + line(3), ReadAll(kLogFile.string() + ".2"));
+  EXPECT_FALSE(fs::exists(kLogFile.string() + ".3"));
+}
+
+TEST(OutputLoggerTest, BEH_DiscardOutputWhenBufferFull) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestOutputLogger"));
+  // Opening a FIFO for writing blocks until it has a reader, so the writer thread stalls.
+  const fs::path kLogFile(*test_dir / "stalled.log");
+  ASSERT_EQ(0, mkfifo(kLogFile.c_str(), 0600));
+  const size_t kMaxBuffered(4096), kTotal(1024 * 1024);
+  std::string output;
+  std::thread reader;
+  {
+    detail::OutputLogger output_logger(detail::OutputLogger::kDefaultMaxFileSize(),
+                                       detail::OutputLogger::kDefaultMaxFiles(), kMaxBuffered);
+    int fd(output_logger.Open(1, kLogFile));
+    ASSERT_NE(-1, fd);
+    // This would block forever if the pipe weren't being drained.
+    WriteAll(fd, std::string(kTotal, 'x'));
+    close(fd);
+    // At most one buffer is held by the stalled writer and one more is pending.
+    auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+    while (output_logger.DroppedBytes(1) < kTotal - 2 * kMaxBuffered &&
+           std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_GE(output_logger.DroppedBytes(1), kTotal - 2 * kMaxBuffered);
+
+    int fifo(open(kLogFile.c_str(), O_RDONLY | O_NONBLOCK));
+    ASSERT_NE(-1, fifo);
+    fcntl(fifo, F_SETFL, 0);
+    reader = std::thread([fifo, &output] {
+      char buffer[4096];
+      // Until the writer thread has opened the FIFO, reading it reports end-of-file.
+      auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+      for (;;) {
+        ssize_t length(read(fifo, buffer, sizeof(buffer)));
+        if (length > 0)
+          output.append(buffer, length);
+        else if (length == 0 && output.empty() && std::chrono::steady_clock::now() < deadline)
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        else
+          break;
+      }
+      close(fifo);
+    });
+  }
+  // The logger's destruction flushes the buffers and closes the FIFO, ending the reader.
+  if (reader.joinable())
+    reader.join();
+  EXPECT_NE(std::string::npos, output.find("bytes of output discarded]"));
+  EXPECT_LE(output.size(), 2 * kMaxBuffered + 128);
+}
+
+TEST(OutputLoggerTest, FUNC_ManyChattyProcesses) {
+  const int kProcessCount(300);
+  const size_t kOutputSize(1024 * 1024);
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestOutputLogger"));
+  const std::string kShell("/bin/sh");
+  std::vector<std::string> argv;
+  argv.push_back(kShell);
+  argv.push_back("-c");
+  argv.push_back("head -c " + std::to_string(kOutputSize) + " /dev/zero");
+  CpuPlacement cpu_placement;
+  detail::Spawner spawner(SpawnBackend::kPosixSpawn);
+  uint64_t dropped(0);
+  auto start(std::chrono::steady_clock::now());
+  {
+    detail::OutputLogger output_logger;
+    std::vector<pid_t> children;
+    for (int i(0); i != kProcessCount; ++i) {
+      int fd(output_logger.Open(i, *test_dir / ("process_" + std::to_string(i) + ".log")));
+      ASSERT_NE(-1, fd);
+      boost::process::child child(0);
+      boost::system::error_code error_code;
+      ASSERT_TRUE(spawner.Spawn(detail::SpawnRequest(kShell, argv, "", cpu_placement, -1, fd),
+                                child, error_code));
+      close(fd);
+      children.push_back(child.pid);
+    }
+    // Every child can only finish if its pipe is drained.
+    for (const auto& pid : children) {
+      int status(0);
+      EXPECT_EQ(pid, waitpid(pid, &status, 0));
+      EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    for (int i(0); i != kProcessCount; ++i)
+      dropped += output_logger.DroppedBytes(i);
+  }
+  auto elapsed(std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start));
+  uint64_t logged(0);
+  for (int i(0); i != kProcessCount; ++i)
+    logged += fs::file_size(*test_dir / ("process_" + std::to_string(i) + ".log"));
+  EXPECT_EQ(kProcessCount * kOutputSize, logged + dropped);
+  RecordProperty("elapsed_ms", static_cast<int>(elapsed.count()));
+  RecordProperty("dropped_bytes", static_cast<int>(dropped));
+}
+#endif
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -16,10 +16,21 @@
     See the Licences for the specific language governing permissions and limitations relating to
     use of the MaidSafe Software.                                                                 */
 
+#ifdef MAIDSAFE_LINUX
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
 #include <thread>
 #include <string>
 #include <vector>
 
+#include "boost/filesystem/operations.hpp"
 #include "boost/filesystem/path.hpp"
 
 #include "maidsafe/common/process.h"
@@ -27,6 +38,7 @@
 #include "maidsafe/common/utils.h"
 
 #include "maidsafe/client_manager/config.h"
+#include "maidsafe/client_manager/heartbeat.h"
 #include "maidsafe/client_manager/process_manager.h"
 #include "maidsafe/client_manager/utils.h"
 #include "maidsafe/client_manager/tests/test_utils.h"
@@ -473,6 +485,588 @@ TEST_F(ProcessManagerTest, BEH_StartManyDifferentProcesses) {
   process_manager_.WaitForProcesses();
 }
 
+TEST_F(ProcessManagerTest, BEH_RestartCrashingProcess) {
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  test.AddArgument("--runtime");
+  test.AddArgument("0");
+  test.AddArgument("--nocontroller");
+  RestartPolicy restart_policy;
+  restart_policy.initial_delay = std::chrono::milliseconds(50);
+  restart_policy.max_delay = std::chrono::milliseconds(200);
+  restart_policy.max_crashes = 3;
+  ASSERT_TRUE(test.SetRestartPolicy(restart_policy));
+
+  // Started, then restarted three times after 50, 100 and 200 ms (+/- 20%), then given up on.
+  ProcessIndex process_index = process_manager_.AddProcess(test, 0);
+  auto start(boost::posix_time::microsec_clock::universal_time());
+  process_manager_.StartProcess(process_index);
+  while (process_manager_.NumberOfLiveProcesses() != 0 &&
+         boost::posix_time::microsec_clock::universal_time() - start <
+             boost::posix_time::seconds(5)) {
+    Sleep(std::chrono::milliseconds(10));
+  }
+  auto elapsed(boost::posix_time::microsec_clock::universal_time() - start);
+  EXPECT_EQ(0, process_manager_.NumberOfLiveProcesses());
+  EXPECT_GE(elapsed.total_milliseconds(), 280);
+  EXPECT_LT(elapsed.total_milliseconds(), 2000);
+  EXPECT_EQ(ProcessStatus::kStopped, process_manager_.GetProcessStatus(process_index));
+  process_manager_.LetProcessDie(process_index);
+}
+
+TEST_F(ProcessManagerTest, BEH_StartProcessWithResourceLimits) {
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  test.AddArgument("--runtime");
+  test.AddArgument("2");
+  test.AddArgument("--nocrash");
+  test.AddArgument("--nocontroller");
+  ResourceLimits resource_limits;
+  resource_limits.cpu_weight = 50;
+  resource_limits.memory_max = 256 << 20;
+  EXPECT_TRUE(test.SetResourceLimits(resource_limits));
+  resource_limits.cpu_weight = 10001;
+  EXPECT_FALSE(test.SetResourceLimits(resource_limits));
+
+  // Where cgroups are unavailable the process runs unconstrained and no usage is reported.
+  ProcessIndex process_index = process_manager_.AddProcess(test, 0);
+  process_manager_.StartProcess(process_index);
+  EXPECT_EQ(ProcessStatus::kRunning, process_manager_.GetProcessStatus(process_index));
+  Sleep(std::chrono::milliseconds(500));
+  ResourceUsage resource_usage;
+  if (process_manager_.GetResourceUsage(process_index, resource_usage))
+    EXPECT_NE(0U, resource_usage.memory_current);
+  EXPECT_TRUE(process_manager_.WaitForProcessToStop(process_index));
+  EXPECT_FALSE(process_manager_.GetResourceUsage(process_index, resource_usage));
+  process_manager_.LetProcessDie(process_index);
+}
+
+#ifdef MAIDSAFE_LINUX
+TEST_F(ProcessManagerTest, BEH_CpuPlacementAppliedToChild) {
+  // Place the child on the last CPU this process may use, along with that CPU's NUMA node.
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+  uint32_t cpu(0);
+  for (uint32_t i(0); i != CPU_SETSIZE; ++i) {
+    if (CPU_ISSET(i, &allowed))
+      cpu = i;
+  }
+  CpuPlacement cpu_placement;
+  cpu_placement.cpus.push_back(cpu);
+  for (const auto& node : detail::CpuTopology().nodes()) {
+    if (std::find(node.cpus.begin(), node.cpus.end(), cpu) != node.cpus.end())
+      cpu_placement.numa_node = static_cast<int32_t>(node.id);
+  }
+
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  test.AddArgument("--runtime");
+  test.AddArgument("2");
+  test.AddArgument("--nocrash");
+  test.AddArgument("--nocontroller");
+  ASSERT_TRUE(test.SetCpuPlacement(cpu_placement));
+  ProcessIndex process_index = process_manager_.AddProcess(test, 0);
+  process_manager_.StartProcess(process_index);
+  Sleep(std::chrono::milliseconds(200));
+  uint32_t pid(process_manager_.GetSystemProcessId(process_index));
+  ASSERT_NE(0U, pid);
+  const fs::path proc_dir(fs::path("/proc") / std::to_string(pid));
+
+  std::ifstream status((proc_dir / "status").string());
+  std::string line, cpus_allowed;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 18, "Cpus_allowed_list:") == 0)
+      cpus_allowed = line.substr(18);
+  }
+  EXPECT_EQ(std::vector<uint32_t>(1, cpu), detail::ParseCpuList(cpus_allowed));
+
+  // Each mapping in numa_maps is listed with the process's memory policy, e.g. "prefer:0".
+  std::ifstream numa_maps((proc_dir / "numa_maps").string());
+  if (cpu_placement.numa_node >= 0 && std::getline(numa_maps, line)) {
+    EXPECT_NE(std::string::npos,
+              line.find(" prefer:" + std::to_string(cpu_placement.numa_node) + " ")) << line;
+  }
+  process_manager_.LetProcessDie(process_index);
+  EXPECT_TRUE(process_manager_.WaitForProcessToStop(process_index));
+}
+#endif
+
+TEST_F(ProcessManagerTest, BEH_LifecycleEvents) {
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  test.AddArgument("--runtime");
+  test.AddArgument("0");
+  test.AddArgument("--nocontroller");
+  RestartPolicy restart_policy;
+  restart_policy.initial_delay = std::chrono::milliseconds(50);
+  restart_policy.jitter = 0.0;
+  restart_policy.max_crashes = 1;
+  ASSERT_TRUE(test.SetRestartPolicy(restart_policy));
+
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<ProcessEvent> events;
+  boost::signals2::scoped_connection connection(process_manager_.on_process_event().connect(
+      [&](const ProcessEvent & event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(event);
+        cond_var.notify_one();
+      }));
+
+  ProcessIndex process_index = process_manager_.AddProcess(test, 0);
+  process_manager_.StartProcess(process_index);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(5), [&] {
+      return !events.empty() && events.back().type == ProcessEvent::Type::kGivenUp;
+    }));
+  }
+
+  std::vector<ProcessEvent::Type> expected_types;
+  expected_types.push_back(ProcessEvent::Type::kSpawned);
+  expected_types.push_back(ProcessEvent::Type::kExited);
+  expected_types.push_back(ProcessEvent::Type::kRestarting);
+  expected_types.push_back(ProcessEvent::Type::kSpawned);
+  expected_types.push_back(ProcessEvent::Type::kExited);
+  expected_types.push_back(ProcessEvent::Type::kGivenUp);
+  std::lock_guard<std::mutex> lock(mutex);
+  ASSERT_EQ(expected_types.size(), events.size());
+  for (size_t i(0); i != events.size(); ++i) {
+    EXPECT_EQ(process_index, events[i].index);
+    EXPECT_TRUE(expected_types[i] == events[i].type) << "Event " << i;
+  }
+  // dummy_vault returns a non-zero exit code when it "crashes".
+  EXPECT_NE(0, events[1].exit_code);
+  EXPECT_EQ(50, events[2].restart_delay.count());
+  process_manager_.LetProcessDie(process_index);
+}
+
+TEST_F(ProcessManagerTest, BEH_WaitForProcessToStop) {
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  test.AddArgument("--runtime");
+  test.AddArgument("1");
+  test.AddArgument("--nocrash");
+  test.AddArgument("--nocontroller");
+  ProcessIndex process_index = process_manager_.AddProcess(test, 0);
+  process_manager_.StartProcess(process_index);
+  process_manager_.LetProcessDie(process_index);
+  auto start(std::chrono::steady_clock::now());
+  EXPECT_TRUE(process_manager_.WaitForProcessToStop(process_index));
+  auto elapsed(std::chrono::steady_clock::now() - start);
+  EXPECT_EQ(ProcessStatus::kStopped, process_manager_.GetProcessStatus(process_index));
+  EXPECT_GE(elapsed, std::chrono::milliseconds(800));
+  EXPECT_LT(elapsed, std::chrono::seconds(3));
+  // Returns immediately if not running.
+  EXPECT_TRUE(process_manager_.WaitForProcessToStop(process_index));
+  EXPECT_FALSE(process_manager_.WaitForProcessToStop(process_index + 1));
+}
+
+TEST_F(ProcessManagerTest, BEH_WaitForProcessToStopCancelsRestart) {
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  test.AddArgument("--runtime");
+  test.AddArgument("0");
+  test.AddArgument("--nocontroller");
+  RestartPolicy restart_policy;
+  restart_policy.initial_delay = std::chrono::milliseconds(500);
+  restart_policy.jitter = 0.0;
+  ASSERT_TRUE(test.SetRestartPolicy(restart_policy));
+
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  int spawned(0);
+  bool restarting(false);
+  boost::signals2::scoped_connection connection(process_manager_.on_process_event().connect(
+      [&](const ProcessEvent & event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (event.type == ProcessEvent::Type::kSpawned)
+          ++spawned;
+        else if (event.type == ProcessEvent::Type::kRestarting)
+          restarting = true;
+        cond_var.notify_one();
+      }));
+
+  ProcessIndex process_index = process_manager_.AddProcess(test, 0);
+  process_manager_.StartProcess(process_index);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(5), [&] { return restarting; }));
+  }
+  // The crashed process is waiting out its restart delay, so has already stopped.
+  EXPECT_TRUE(process_manager_.WaitForProcessToStop(process_index));
+  EXPECT_EQ(0U, process_manager_.NumberOfLiveProcesses());
+  Sleep(restart_policy.initial_delay * 2);
+  EXPECT_EQ(ProcessStatus::kStopped, process_manager_.GetProcessStatus(process_index));
+  std::lock_guard<std::mutex> lock(mutex);
+  EXPECT_EQ(1, spawned);
+}
+
+TEST_F(ProcessManagerTest, BEH_StopProcessEscalation) {
+  const TerminationPolicy kShortPolicy(std::chrono::milliseconds(300),
+                                       std::chrono::milliseconds(300));
+  // Exits of its own accord within the first stage.
+  Process graceful;
+  ASSERT_TRUE(graceful.SetExecutablePath(kExecutablePath_));
+  graceful.AddArgument("--runtime 1");
+  graceful.AddArgument("--nocrash");
+  graceful.AddArgument("--nocontroller");
+  EXPECT_FALSE(graceful.SetTerminationPolicy(TerminationPolicy(std::chrono::milliseconds(-1),
+                                                               std::chrono::milliseconds(0))));
+  // Exits on SIGTERM.
+  Process terminated;
+  ASSERT_TRUE(terminated.SetExecutablePath(kExecutablePath_));
+  terminated.AddArgument("--runtime 60");
+  terminated.AddArgument("--nocontroller");
+  ASSERT_TRUE(terminated.SetTerminationPolicy(kShortPolicy));
+  // Has to be killed.
+  Process killed(terminated);
+  killed.AddArgument("--ignore_sigterm");
+
+  ProcessIndex graceful_index(process_manager_.AddProcess(graceful, 0));
+  ProcessIndex terminated_index(process_manager_.AddProcess(terminated, 0));
+  ProcessIndex killed_index(process_manager_.AddProcess(killed, 0));
+  std::vector<ProcessIndex> indices;
+  indices.push_back(graceful_index);
+  indices.push_back(terminated_index);
+  indices.push_back(killed_index);
+  for (const auto& index : indices)
+    process_manager_.StartProcess(index);
+  // Give the processes time to ignore SIGTERM if required.
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  // As if each had been sent a shutdown request, which only 'graceful' heeds.
+  auto start(std::chrono::steady_clock::now());
+  for (const auto& index : indices)
+    process_manager_.StopProcess(index, true);
+  for (const auto& index : indices) {
+    EXPECT_TRUE(process_manager_.WaitForProcessToStop(index));
+    EXPECT_EQ(ProcessStatus::kStopped, process_manager_.GetProcessStatus(index));
+  }
+  auto elapsed(std::chrono::steady_clock::now() - start);
+  EXPECT_TRUE(TerminationStage::kShutdownRequest == process_manager_.GetStopStage(graceful_index));
+  EXPECT_TRUE(TerminationStage::kTerminate == process_manager_.GetStopStage(terminated_index));
+  EXPECT_TRUE(TerminationStage::kKill == process_manager_.GetStopStage(killed_index));
+  // The processes are stopped concurrently, so this is bounded by the graceful one's runtime.
+  EXPECT_LT(elapsed, std::chrono::seconds(2));
+}
+
+// Without a shutdown request there's nothing to wait for, so SIGTERM is sent immediately, both by
+// StopProcess and when the manager is destroyed.
+TEST_F(ProcessManagerTest, BEH_StopWithoutShutdownRequest) {
+  const TerminationPolicy kLongPolicy(std::chrono::seconds(10), std::chrono::seconds(10));
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  test.AddArgument("--runtime 60");
+  test.AddArgument("--nocontroller");
+  ASSERT_TRUE(test.SetTerminationPolicy(kLongPolicy));
+
+  ProcessIndex process_index(process_manager_.AddProcess(test, 0));
+  process_manager_.StartProcess(process_index);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  auto start(std::chrono::steady_clock::now());
+  process_manager_.StopProcess(process_index);
+  EXPECT_TRUE(process_manager_.WaitForProcessToStop(process_index));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(3));
+  EXPECT_TRUE(TerminationStage::kTerminate == process_manager_.GetStopStage(process_index));
+
+  start = std::chrono::steady_clock::now();
+  {
+    ProcessManager process_manager;
+    process_manager.StartProcess(process_manager.AddProcess(test, 0));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(3));
+}
+
+TEST_F(ProcessManagerTest, BEH_RemoveProcess) {
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  test.AddArgument("--runtime 60");
+  test.AddArgument("--heartbeat_for 60");
+  test.AddArgument("--nocontroller");
+  test.SetHeartbeatPolicy(HeartbeatPolicy(std::chrono::seconds(5), std::chrono::seconds(5)));
+
+  ProcessIndex process_index(process_manager_.AddProcess(test, 0));
+  ProcessIndex other_index(process_manager_.AddProcess(test, 0));
+  EXPECT_EQ(2U, process_manager_.NumberOfProcesses());
+  process_manager_.StartProcess(process_index);
+  EXPECT_FALSE(process_manager_.RemoveProcess(process_index));
+  EXPECT_TRUE(process_manager_.WaitForProcessToStop(process_index));
+
+  EXPECT_TRUE(process_manager_.RemoveProcess(process_index));
+  EXPECT_FALSE(process_manager_.RemoveProcess(process_index));
+  EXPECT_EQ(1U, process_manager_.NumberOfProcesses());
+  EXPECT_EQ(ProcessStatus::kError, process_manager_.GetProcessStatus(process_index));
+  EXPECT_TRUE(process_manager_.GetResourceSamples(process_index).empty());
+  // Its heartbeat's shared memory has gone, but that of the process never started remains.
+  EXPECT_THROW(detail::Heartbeat(detail::HeartbeatName(process_index, 0)), std::exception);
+  EXPECT_NO_THROW(detail::Heartbeat(detail::HeartbeatName(other_index, 0)));
+  EXPECT_TRUE(process_manager_.RemoveProcess(other_index));
+  EXPECT_EQ(0U, process_manager_.NumberOfProcesses());
+}
+
+TEST_F(ProcessManagerTest, BEH_RestartUnresponsiveProcess) {
+  const HeartbeatPolicy kShortPolicy(std::chrono::milliseconds(300),
+                                     std::chrono::milliseconds(500));
+  RestartPolicy restart_policy;
+  restart_policy.initial_delay = std::chrono::milliseconds(50);
+  restart_policy.jitter = 0.0;
+  auto watched_process([&](int heartbeat_seconds) -> Process {
+    Process process;
+    process.SetExecutablePath(kExecutablePath_);
+    process.AddArgument("--runtime 60");
+    if (heartbeat_seconds != 0)
+      process.AddArgument("--heartbeat_for " + std::to_string(heartbeat_seconds));
+    process.AddArgument("--nocontroller");
+    process.SetHeartbeatPolicy(kShortPolicy);
+    process.SetRestartPolicy(restart_policy);
+    return process;
+  });
+  // Beats throughout.
+  Process healthy(watched_process(60));
+  // Hangs before its first beat.
+  Process never_beats(watched_process(0));
+  // Hangs after a second of beating.
+  Process hangs(watched_process(1));
+
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<ProcessEvent> events;
+  boost::signals2::scoped_connection connection(process_manager_.on_process_event().connect(
+      [&](const ProcessEvent & event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(event);
+        cond_var.notify_one();
+      }));
+  ProcessIndex healthy_index(process_manager_.AddProcess(healthy, 0));
+  ProcessIndex never_beats_index(process_manager_.AddProcess(never_beats, 0));
+  ProcessIndex hangs_index(process_manager_.AddProcess(hangs, 0));
+  process_manager_.StartProcess(healthy_index);
+  process_manager_.StartProcess(never_beats_index);
+  process_manager_.StartProcess(hangs_index);
+
+  auto restarted_after_hang([&](ProcessIndex index) {
+    bool unresponsive(false);
+    for (const auto& event : events) {
+      if (event.index == index && event.type == ProcessEvent::Type::kUnresponsive)
+        unresponsive = event.hang_count != 0;
+      else if (unresponsive && event.index == index && event.type == ProcessEvent::Type::kSpawned)
+        return true;
+    }
+    return false;
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    EXPECT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(5), [&] {
+      return restarted_after_hang(never_beats_index) && restarted_after_hang(hangs_index);
+    }));
+  }
+  EXPECT_EQ(0U, process_manager_.GetHangCount(healthy_index));
+  EXPECT_LE(1U, process_manager_.GetHangCount(never_beats_index));
+  EXPECT_LE(1U, process_manager_.GetHangCount(hangs_index));
+  EXPECT_EQ(ProcessStatus::kRunning, process_manager_.GetProcessStatus(healthy_index));
+  EXPECT_EQ(ProcessStatus::kRunning, process_manager_.GetProcessStatus(hangs_index));
+  for (const auto& index : {healthy_index, never_beats_index, hangs_index}) {
+    process_manager_.KillProcess(index);
+    EXPECT_TRUE(process_manager_.WaitForProcessToStop(index));
+  }
+}
+
+// A process which never beats isn't watched, but one which stops beating is still restarted.
+TEST_F(ProcessManagerTest, BEH_HeartbeatArmedByFirstBeat) {
+  const HeartbeatPolicy kArmedPolicy(std::chrono::milliseconds(300), std::chrono::milliseconds(500),
+                                     true);
+  auto watched_process([&](int heartbeat_seconds) -> Process {
+    Process process;
+    process.SetExecutablePath(kExecutablePath_);
+    process.AddArgument("--runtime 60");
+    if (heartbeat_seconds != 0)
+      process.AddArgument("--heartbeat_for " + std::to_string(heartbeat_seconds));
+    process.AddArgument("--nocontroller");
+    process.SetHeartbeatPolicy(kArmedPolicy);
+    return process;
+  });
+  ProcessIndex never_beats_index(process_manager_.AddProcess(watched_process(0), 0));
+  ProcessIndex hangs_index(process_manager_.AddProcess(watched_process(1), 0));
+  process_manager_.StartProcess(never_beats_index);
+  process_manager_.StartProcess(hangs_index);
+
+  auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+  while (process_manager_.GetHangCount(hangs_index) == 0 &&
+         std::chrono::steady_clock::now() < deadline)
+    Sleep(std::chrono::milliseconds(50));
+  EXPECT_LE(1U, process_manager_.GetHangCount(hangs_index));
+  EXPECT_EQ(0U, process_manager_.GetHangCount(never_beats_index));
+  EXPECT_EQ(ProcessStatus::kRunning, process_manager_.GetProcessStatus(never_beats_index));
+  for (const auto& index : {never_beats_index, hangs_index}) {
+    process_manager_.KillProcess(index);
+    EXPECT_TRUE(process_manager_.WaitForProcessToStop(index));
+  }
+}
+
+TEST_F(ProcessManagerTest, BEH_ConcurrentShutdown) {
+  const int kProcessCount(20);
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  test.AddArgument("--runtime 60");
+  test.AddArgument("--ignore_sigterm");
+  test.AddArgument("--nocontroller");
+  ASSERT_TRUE(test.SetTerminationPolicy(
+      TerminationPolicy(std::chrono::milliseconds(200), std::chrono::milliseconds(200))));
+  std::chrono::steady_clock::time_point start;
+  {
+    ProcessManager process_manager;
+    for (int i(0); i < kProcessCount; ++i)
+      process_manager.StartProcess(process_manager.AddProcess(test, 0));
+    EXPECT_EQ(kProcessCount, process_manager.NumberOfLiveProcesses());
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    start = std::chrono::steady_clock::now();
+  }
+  // Destroying the manager takes every process through each stage at once, rather than in turn.
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+}
+
+TEST_F(ProcessManagerTest, BEH_CaptureProcessOutput) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestProcessManager"));
+  const fs::path kLogFile(*test_dir / "dummy_vault.log");
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  EXPECT_FALSE(test.SetOutputLogFile(fs::path()));
+  ASSERT_TRUE(test.SetOutputLogFile(kLogFile));
+  test.AddArgument("--help");
+  ProcessIndex process_index = process_manager_.AddProcess(test, 0);
+  process_manager_.StartProcess(process_index);
+  process_manager_.LetProcessDie(process_index);
+  EXPECT_TRUE(process_manager_.WaitForProcessToStop(process_index));
+  // The output is written asynchronously.
+  std::string content;
+  auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+  while (content.find("Allowed options") == std::string::npos &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ReadFile(kLogFile, &content);
+  }
+  EXPECT_NE(std::string::npos, content.find("Allowed options"));
+}
+
+#ifdef MAIDSAFE_LINUX
+TEST_F(ProcessManagerTest, BEH_ReplaceExecutable) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestProcessManager"));
+  const fs::path kUpgradedPath(*test_dir / kExecutablePath_.filename());
+  fs::copy_file(kExecutablePath_, kUpgradedPath);
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  test.AddArgument("--runtime");
+  test.AddArgument("2");
+  test.AddArgument("--nocrash");
+  test.AddArgument("--nocontroller");
+  ProcessIndex process_index = process_manager_.AddProcess(test, 0);
+  EXPECT_FALSE(process_manager_.SetExecutablePath(process_index, *test_dir / "missing"));
+  EXPECT_FALSE(process_manager_.SetExecutablePath(process_index + 1, kUpgradedPath));
+  ASSERT_TRUE(process_manager_.SetExecutablePath(process_index, kUpgradedPath));
+  process_manager_.StartProcess(process_index);
+  uint32_t pid(process_manager_.GetSystemProcessId(process_index));
+  ASSERT_NE(0U, pid);
+  // Until the forked child has called exec, it's still an image of this test.
+  const fs::path kExeLink("/proc/" + std::to_string(pid) + "/exe");
+  boost::system::error_code error_code;
+  auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(1));
+  while (fs::read_symlink(kExeLink, error_code) != kUpgradedPath &&
+         std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(kUpgradedPath, fs::read_symlink(kExeLink, error_code));
+  process_manager_.LetProcessDie(process_index);
+  EXPECT_TRUE(process_manager_.WaitForProcessToStop(process_index));
+}
+#endif
+
+TEST_F(ProcessManagerTest, FUNC_SuperviseManyProcesses) {
+  const int kProcessCount(1000);
+  std::vector<ProcessIndex> process_indices;
+  for (int i(0); i < kProcessCount; ++i) {
+    Process test;
+    ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+    test.AddArgument("--runtime");
+    test.AddArgument("120");
+    test.AddArgument("--nocrash");
+    test.AddArgument("--nocontroller");
+    process_indices.push_back(process_manager_.AddProcess(test, 0));
+  }
+
+  int threads_before(GetNumThreadsInThisProcess());
+  int64_t memory_before(GetResidentMemoryOfThisProcessKb());
+  auto start(std::chrono::steady_clock::now());
+  for (const auto& process_index : process_indices)
+    process_manager_.StartProcess(process_index);
+  auto start_duration(std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start));
+  Sleep(std::chrono::seconds(2));
+  EXPECT_EQ(kProcessCount, process_manager_.NumberOfLiveProcesses());
+  EXPECT_EQ(kProcessCount, GetNumRunningProcesses(detail::kVaultName));
+  int threads_during(GetNumThreadsInThisProcess());
+  int64_t memory_during(GetResidentMemoryOfThisProcessKb());
+
+  RecordProperty("start_duration_ms", static_cast<int>(start_duration.count()));
+  RecordProperty("threads_before", threads_before);
+  RecordProperty("threads_during", threads_during);
+  RecordProperty("resident_memory_before_kb", static_cast<int>(memory_before));
+  RecordProperty("resident_memory_during_kb", static_cast<int>(memory_during));
+  // Supervision shouldn't need any threads beyond the one the manager already has.
+  EXPECT_EQ(threads_before, threads_during);
+
+  for (const auto& process_index : process_indices)
+    process_manager_.KillProcess(process_index);
+  process_manager_.WaitForProcesses();
+  EXPECT_EQ(0, process_manager_.NumberOfLiveProcesses());
+  EXPECT_EQ(0, GetNumRunningProcesses(detail::kVaultName));
+}
+
+TEST_F(ProcessManagerTest, FUNC_StatusQueryThroughput) {
+  Process test;
+  ASSERT_TRUE(test.SetExecutablePath(kExecutablePath_));
+  const int kThreadCount(4), kQueriesPerThread(200000);
+
+  // Returns the mean time per status query in ns, with entries being added concurrently.
+  auto time_queries([&](ProcessIndex table_size)->double {
+    ProcessManager process_manager;
+    for (ProcessIndex i(0); i != table_size; ++i)
+      process_manager.AddProcess(test, 0);
+    std::atomic<bool> adding(true);
+    std::thread adder([&] {
+      for (int i(0); i != 1000; ++i)
+        process_manager.AddProcess(test, 0);
+      adding = false;
+    });
+    std::vector<std::thread> queriers;
+    auto start(std::chrono::steady_clock::now());
+    for (int i(0); i != kThreadCount; ++i) {
+      queriers.emplace_back([&, i] {
+        ProcessIndex index(static_cast<ProcessIndex>(i));
+        for (int j(0); j != kQueriesPerThread; ++j) {
+          index = (index * 7919 + 1) % table_size + 1;
+          EXPECT_EQ(ProcessStatus::kStopped, process_manager.GetProcessStatus(index));
+        }
+      });
+    }
+    for (auto& querier : queriers)
+      querier.join();
+    auto elapsed(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start));
+    adder.join();
+    EXPECT_FALSE(adding);
+    EXPECT_EQ(table_size + 1000, process_manager.NumberOfProcesses());
+    return static_cast<double>(elapsed.count()) / (kThreadCount * kQueriesPerThread);
+  });
+
+  double small_table(time_queries(100)), large_table(time_queries(10000));
+  RecordProperty("status_query_ns_100_entries", static_cast<int>(small_table));
+  RecordProperty("status_query_ns_10000_entries", static_cast<int>(large_table));
+  // A linear scan would be around 100 times slower for the larger table.
+  EXPECT_LT(large_table, small_table * 10);
+}
+
 // TEST(ProcessManagerTest, FUNC_StartSingleProcessForLongTime) {
 //   ProcessManager manager;
 //   Process test;
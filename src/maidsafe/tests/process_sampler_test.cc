@@ -0,0 +1,174 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/process_sampler.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+#ifdef MAIDSAFE_LINUX
+// Forks 'count' children which do nothing until killed.
+std::vector<pid_t> ForkIdleChildren(size_t count) {
+  std::vector<pid_t> children;
+  for (size_t i(0); i != count; ++i) {
+    pid_t pid(fork());
+    if (pid == 0) {
+      pause();
+      _exit(0);
+    }
+    if (pid > 0)
+      children.push_back(pid);
+  }
+  return children;
+}
+
+void KillChildren(const std::vector<pid_t>& children) {
+  for (const auto& pid : children) {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+  }
+}
+
+std::chrono::nanoseconds ThreadCpuTime() {
+  timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+}
+#endif
+
+}  // unnamed namespace
+
+TEST(ProcessSamplerTest, BEH_SampleRing) {
+  detail::SampleRing ring(3);
+  EXPECT_TRUE(ring.Contents().empty());
+  for (uint32_t i(0); i != 5; ++i) {
+    ResourceSample sample;
+    sample.threads = i;
+    ring.Push(sample);
+    EXPECT_EQ(std::min<size_t>(i + 1, 3), ring.Size());
+  }
+  std::vector<ResourceSample> contents(ring.Contents());
+  ASSERT_EQ(3U, contents.size());
+  EXPECT_EQ(2U, contents[0].threads);
+  EXPECT_EQ(3U, contents[1].threads);
+  EXPECT_EQ(4U, contents[2].threads);
+  ring.Clear();
+  EXPECT_EQ(0U, ring.Size());
+  EXPECT_TRUE(ring.Contents().empty());
+}
+
+#ifdef MAIDSAFE_LINUX
+TEST(ProcessSamplerTest, BEH_SampleOwnProcess) {
+  // Use some CPU so that at least one clock tick is recorded.
+  auto start(std::chrono::steady_clock::now());
+  volatile uint64_t total(0);
+  while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(50))
+    total = total + 1;
+
+  ResourceSample sample;
+  ASSERT_TRUE(detail::ProcessSampler::Sample(static_cast<uint32_t>(getpid()), sample));
+  EXPECT_GT(sample.cpu_time.count(), 0);
+  EXPECT_GT(sample.rss, 0U);
+  EXPECT_GE(sample.threads, 1U);
+  // At least stdin, stdout and stderr.
+  EXPECT_GE(sample.open_fds, 3U);
+  EXPECT_GT(sample.context_switches, 0U);
+}
+
+TEST(ProcessSamplerTest, BEH_SampleChildren) {
+  std::vector<pid_t> children(ForkIdleChildren(2));
+  ASSERT_EQ(2U, children.size());
+  detail::ProcessSampler sampler(std::chrono::milliseconds(20), 4);
+  EXPECT_TRUE(sampler.Samples(1).empty());
+  sampler.Add(1, static_cast<uint32_t>(children[0]));
+  Sleep(std::chrono::milliseconds(300));
+
+  std::vector<ResourceSample> samples(sampler.Samples(1));
+  ASSERT_EQ(4U, samples.size());
+  for (size_t i(1); i != samples.size(); ++i)
+    EXPECT_LT(samples[i - 1].time, samples[i].time);
+  EXPECT_GT(samples.back().rss, 0U);
+  EXPECT_EQ(1U, samples.back().threads);
+
+  // Samples are retained once removed, and discarded once re-added.
+  sampler.Remove(1);
+  KillChildren(std::vector<pid_t>(1, children[0]));
+  Sleep(std::chrono::milliseconds(100));
+  EXPECT_EQ(samples.back().time, sampler.Samples(1).back().time);
+  sampler.Add(1, static_cast<uint32_t>(children[1]));
+  EXPECT_TRUE(sampler.Samples(1).empty());
+  KillChildren(std::vector<pid_t>(1, children[1]));
+
+  ResourceSample sample;
+  EXPECT_FALSE(detail::ProcessSampler::Sample(static_cast<uint32_t>(children[1]), sample));
+}
+
+TEST(ProcessSamplerTest, FUNC_SampleThousandProcesses) {
+  const size_t kProcessCount(1000);
+  const int kRounds(10);
+  std::vector<pid_t> children(ForkIdleChildren(kProcessCount));
+  ASSERT_EQ(kProcessCount, children.size());
+  // The sampling thread is kept idle; rounds are run from here so that their cost can be timed.
+  detail::ProcessSampler sampler(std::chrono::hours(1));
+  for (size_t i(0); i != children.size(); ++i)
+    sampler.Add(static_cast<ProcessIndex>(i), static_cast<uint32_t>(children[i]));
+
+  auto cpu_start(ThreadCpuTime());
+  auto wall_start(std::chrono::steady_clock::now());
+  for (int round(0); round != kRounds; ++round)
+    sampler.SampleAll();
+  auto cpu_per_round((ThreadCpuTime() - cpu_start) / kRounds);
+  auto wall_per_round((std::chrono::steady_clock::now() - wall_start) / kRounds);
+  KillChildren(children);
+
+  EXPECT_EQ(static_cast<size_t>(kRounds), sampler.Samples(0).size());
+  double percent_of_core(100.0 * cpu_per_round.count() /
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             detail::ProcessSampler::kDefaultInterval()).count());
+  RecordProperty("cpu_per_round_us", static_cast<int>(
+      std::chrono::duration_cast<std::chrono::microseconds>(cpu_per_round).count()));
+  RecordProperty("wall_per_round_us", static_cast<int>(
+      std::chrono::duration_cast<std::chrono::microseconds>(wall_per_round).count()));
+  EXPECT_LT(percent_of_core, 1.0);
+}
+#endif
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
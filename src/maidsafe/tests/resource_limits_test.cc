@@ -0,0 +1,201 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+
+#include "maidsafe/client_manager/resource_limits.h"
+
+#include <string>
+#include <vector>
+
+#ifdef MAIDSAFE_LINUX
+#include <unistd.h>
+#endif
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+std::string Contents(const fs::path& path) {
+  std::string contents;
+  ReadFile(path, &contents);
+  return contents;
+}
+
+#ifdef MAIDSAFE_LINUX
+// Lays out a directory as the kernel would a delegated cgroup with a single child group, which may
+// be nested.  The kernel creates each group's control files itself, so these are created here too.
+void CreateFakeHierarchy(const fs::path& root, const std::string& controllers,
+                         const std::string& group) {
+  ASSERT_TRUE(WriteFile(root / "cgroup.controllers", controllers + "\n"));
+  ASSERT_TRUE(WriteFile(root / "cgroup.procs", ""));
+  ASSERT_TRUE(WriteFile(root / "cgroup.subtree_control", ""));
+  ASSERT_TRUE(fs::create_directories(root / group));
+  for (fs::path parent((root / group).parent_path()); parent != root;
+       parent = parent.parent_path())
+    ASSERT_TRUE(WriteFile(parent / "cgroup.subtree_control", ""));
+  std::vector<std::string> files;
+  files.push_back("cgroup.procs");
+  files.push_back("cpu.weight");
+  files.push_back("cpu.max");
+  files.push_back("memory.high");
+  files.push_back("memory.max");
+  files.push_back("io.weight");
+  for (const auto& file : files)
+    ASSERT_TRUE(WriteFile(root / group / file, ""));
+  ASSERT_TRUE(WriteFile(root / group / "memory.current", "1048576\n"));
+  ASSERT_TRUE(WriteFile(root / group / "cpu.stat",
+                        "usage_usec 2500\nuser_usec 2000\nsystem_usec 500\nnr_periods 0\n"));
+}
+#endif
+
+}  // unnamed namespace
+
+TEST(ResourceLimitsTest, BEH_Validation) {
+  ResourceLimits limits;
+  EXPECT_TRUE(limits.IsValid());
+  EXPECT_TRUE(limits.Empty());
+
+  limits.cpu_weight = 10001;
+  EXPECT_FALSE(limits.IsValid());
+  limits.cpu_weight = 200;
+  EXPECT_TRUE(limits.IsValid());
+  EXPECT_FALSE(limits.Empty());
+
+  limits.cpu_quota = std::chrono::microseconds(500);
+  EXPECT_FALSE(limits.IsValid());
+  limits.cpu_quota = std::chrono::milliseconds(50);
+  EXPECT_TRUE(limits.IsValid());
+  limits.cpu_period = std::chrono::seconds(2);
+  EXPECT_FALSE(limits.IsValid());
+  limits.cpu_period = std::chrono::milliseconds(100);
+
+  limits.memory_high = 2 << 20;
+  limits.memory_max = 1 << 20;
+  EXPECT_FALSE(limits.IsValid());
+  limits.memory_max = 4 << 20;
+  EXPECT_TRUE(limits.IsValid());
+
+  limits.io_weight = 10001;
+  EXPECT_FALSE(limits.IsValid());
+}
+
+TEST(ResourceLimitsTest, BEH_Unavailable) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestCgroups"));
+  detail::Cgroups cgroups(*test_dir / "missing");
+  ResourceLimits limits;
+  limits.cpu_weight = 50;
+  EXPECT_FALSE(cgroups.Available());
+  EXPECT_FALSE(cgroups.Prepare("process_1", limits));
+  EXPECT_EQ(-1, cgroups.OpenProcsFile("process_1"));
+  ResourceUsage usage;
+  EXPECT_FALSE(cgroups.ReadUsage("process_1", usage));
+  EXPECT_FALSE(cgroups.Remove("process_1"));
+}
+
+#ifdef MAIDSAFE_LINUX
+TEST(ResourceLimitsTest, BEH_ApplyLimits) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestCgroups"));
+  CreateFakeHierarchy(*test_dir, "cpuset cpu io memory pids", "process_1");
+  detail::Cgroups cgroups(*test_dir);
+  EXPECT_TRUE(cgroups.Available());
+
+  ResourceLimits limits;
+  limits.cpu_weight = 200;
+  limits.cpu_quota = std::chrono::milliseconds(50);
+  limits.memory_max = 256 << 20;
+  limits.io_weight = 50;
+  ASSERT_TRUE(cgroups.Prepare("process_1", limits));
+  fs::path group(*test_dir / "process_1");
+  EXPECT_EQ("200", Contents(group / "cpu.weight"));
+  EXPECT_EQ("50000 100000", Contents(group / "cpu.max"));
+  EXPECT_EQ("max", Contents(group / "memory.high"));
+  EXPECT_EQ("268435456", Contents(group / "memory.max"));
+  EXPECT_EQ("default 50", Contents(group / "io.weight"));
+
+  // Reapplying resets anything no longer limited.
+  limits = ResourceLimits();
+  limits.memory_high = 128 << 20;
+  ASSERT_TRUE(cgroups.Prepare("process_1", limits));
+  EXPECT_EQ("100", Contents(group / "cpu.weight"));
+  EXPECT_EQ("max 100000", Contents(group / "cpu.max"));
+  EXPECT_EQ("134217728", Contents(group / "memory.high"));
+  EXPECT_EQ("max", Contents(group / "memory.max"));
+  EXPECT_EQ("default 100", Contents(group / "io.weight"));
+
+  int fd(cgroups.OpenProcsFile("process_1"));
+  ASSERT_NE(-1, fd);
+  close(fd);
+
+  ResourceUsage usage;
+  ASSERT_TRUE(cgroups.ReadUsage("process_1", usage));
+  EXPECT_EQ(1048576U, usage.memory_current);
+  EXPECT_EQ(2500, usage.cpu_usage.count());
+  EXPECT_EQ(2000, usage.cpu_user.count());
+  EXPECT_EQ(500, usage.cpu_system.count());
+  EXPECT_FALSE(cgroups.ReadUsage("process_2", usage));
+}
+
+TEST(ResourceLimitsTest, BEH_MissingController) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestCgroups"));
+  CreateFakeHierarchy(*test_dir, "cpu pids", "process_1");
+  detail::Cgroups cgroups(*test_dir);
+
+  ResourceLimits limits;
+  limits.cpu_weight = 300;
+  limits.memory_max = 256 << 20;
+  limits.io_weight = 50;
+  // The process can still be placed in its group, but only the CPU limit is applied.
+  ASSERT_TRUE(cgroups.Prepare("process_1", limits));
+  fs::path group(*test_dir / "process_1");
+  EXPECT_EQ("300", Contents(group / "cpu.weight"));
+  EXPECT_TRUE(Contents(group / "memory.max").empty());
+  EXPECT_TRUE(Contents(group / "io.weight").empty());
+}
+
+// The controllers are enabled for an intermediate group's children before its child is created.
+TEST(ResourceLimitsTest, BEH_NestedGroup) {
+  maidsafe::test::TestPath test_dir(maidsafe::test::CreateTestPath("MaidSafe_TestCgroups"));
+  CreateFakeHierarchy(*test_dir, "cpu io memory", "manager/process_1");
+  detail::Cgroups cgroups(*test_dir);
+  ResourceLimits limits;
+  limits.cpu_weight = 200;
+  ASSERT_TRUE(cgroups.Prepare("manager/process_1", limits));
+  EXPECT_EQ("+cpu +memory +io", Contents(*test_dir / "manager" / "cgroup.subtree_control"));
+  EXPECT_EQ("200", Contents(*test_dir / "manager" / "process_1" / "cpu.weight"));
+  ResourceUsage usage;
+  EXPECT_TRUE(cgroups.ReadUsage("manager/process_1", usage));
+  EXPECT_EQ(1048576U, usage.memory_current);
+}
+#endif
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
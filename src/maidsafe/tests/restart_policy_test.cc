@@ -0,0 +1,173 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/restart_policy.h"
+
+#include <chrono>
+#include <set>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+typedef detail::RestartTracker::TimePoint TimePoint;
+typedef std::chrono::milliseconds Ms;
+
+// Stands in for the steady clock, so that hours of crash history take no time to run through.
+class FakeClock {
+ public:
+  FakeClock() : now_() {}
+  TimePoint now() const { return now_; }
+  void Advance(const std::chrono::steady_clock::duration& duration) { now_ += duration; }
+
+ private:
+  TimePoint now_;
+};
+
+RestartPolicy NoJitterPolicy() {
+  RestartPolicy policy;
+  policy.initial_delay = Ms(100);
+  policy.max_delay = Ms(1000);
+  policy.backoff_factor = 2.0;
+  policy.jitter = 0.0;
+  policy.healthy_run = std::chrono::minutes(1);
+  policy.max_crashes = 100;
+  policy.crash_window = std::chrono::hours(1);
+  return policy;
+}
+
+// Runs the process for 'run_time', then records its exit.  Returns the delay, or -1 if given up.
+int64_t RunAndCrash(detail::RestartTracker& tracker, FakeClock& clock,
+                    const std::chrono::steady_clock::duration& run_time) {
+  tracker.OnStart(clock.now());
+  clock.Advance(run_time);
+  Ms delay(0);
+  if (!tracker.OnExit(clock.now(), delay))
+    return -1;
+  clock.Advance(delay);
+  return delay.count();
+}
+
+}  // unnamed namespace
+
+TEST(RestartPolicyTest, BEH_ExponentialBackoffUpToMaxDelay) {
+  FakeClock clock;
+  detail::RestartTracker tracker(NoJitterPolicy());
+  std::vector<int64_t> delays;
+  for (int i(0); i != 7; ++i)
+    delays.push_back(RunAndCrash(tracker, clock, Ms(10)));
+  EXPECT_EQ(std::vector<int64_t>({100, 200, 400, 800, 1000, 1000, 1000}), delays);
+  EXPECT_EQ(7, tracker.consecutive_crashes());
+}
+
+TEST(RestartPolicyTest, BEH_HealthyRunResetsBackoff) {
+  FakeClock clock;
+  detail::RestartTracker tracker(NoJitterPolicy());
+  for (int i(0); i != 4; ++i)
+    RunAndCrash(tracker, clock, Ms(10));
+  EXPECT_EQ(4, tracker.consecutive_crashes());
+
+  EXPECT_EQ(100, RunAndCrash(tracker, clock, std::chrono::minutes(1)));
+  EXPECT_EQ(1, tracker.consecutive_crashes());
+  EXPECT_EQ(200, RunAndCrash(tracker, clock, Ms(10)));
+
+  tracker.Reset();
+  EXPECT_EQ(100, RunAndCrash(tracker, clock, Ms(10)));
+}
+
+TEST(RestartPolicyTest, BEH_CrashBudgetIsASlidingWindow) {
+  RestartPolicy policy(NoJitterPolicy());
+  policy.max_crashes = 3;
+  policy.crash_window = std::chrono::minutes(10);
+
+  // A process flapping within the window is given up on.
+  {
+    FakeClock clock;
+    detail::RestartTracker tracker(policy);
+    for (int i(0); i != 3; ++i)
+      EXPECT_NE(-1, RunAndCrash(tracker, clock, Ms(10)));
+    EXPECT_EQ(-1, RunAndCrash(tracker, clock, Ms(10)));
+  }
+
+  // A process crashing once a week never is.
+  {
+    FakeClock clock;
+    detail::RestartTracker tracker(policy);
+    for (int i(0); i != 52; ++i) {
+      EXPECT_EQ(100, RunAndCrash(tracker, clock, std::chrono::hours(24 * 7)));
+      EXPECT_EQ(1U, tracker.crashes_in_window());
+    }
+  }
+
+  // Older crashes age out of the window.
+  {
+    FakeClock clock;
+    detail::RestartTracker tracker(policy);
+    for (int i(0); i != 3; ++i)
+      EXPECT_NE(-1, RunAndCrash(tracker, clock, std::chrono::minutes(6)));
+    EXPECT_EQ(2U, tracker.crashes_in_window());
+    EXPECT_NE(-1, RunAndCrash(tracker, clock, Ms(10)));
+    EXPECT_EQ(-1, RunAndCrash(tracker, clock, Ms(10)));
+  }
+}
+
+TEST(RestartPolicyTest, BEH_JitterStaysWithinBounds) {
+  RestartPolicy policy(NoJitterPolicy());
+  policy.jitter = 0.5;
+  policy.max_delay = Ms(120);
+  std::set<int64_t> delays;
+  for (int i(0); i != 1000; ++i) {
+    FakeClock clock;
+    detail::RestartTracker tracker(policy);
+    int64_t delay(RunAndCrash(tracker, clock, Ms(10)));
+    EXPECT_GE(delay, 50);
+    EXPECT_LE(delay, 120);
+    delays.insert(delay);
+  }
+  EXPECT_GT(delays.size(), 10U);
+}
+
+TEST(RestartPolicyTest, BEH_Validation) {
+  EXPECT_TRUE(RestartPolicy().IsValid());
+  EXPECT_TRUE(NoJitterPolicy().IsValid());
+  RestartPolicy policy(NoJitterPolicy());
+  policy.max_delay = Ms(10);
+  EXPECT_FALSE(policy.IsValid());
+  policy = NoJitterPolicy();
+  policy.backoff_factor = 0.5;
+  EXPECT_FALSE(policy.IsValid());
+  policy = NoJitterPolicy();
+  policy.jitter = 1.5;
+  EXPECT_FALSE(policy.IsValid());
+  policy = NoJitterPolicy();
+  policy.max_crashes = -1;
+  EXPECT_FALSE(policy.IsValid());
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,176 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/rolling_upgrade.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+typedef detail::RollingUpgrade::Step Step;
+
+const boost::filesystem::path kOldExecutable("vault");
+const boost::filesystem::path kNewExecutable("upgrade/vault");
+
+std::vector<ProcessIndex> Indices(ProcessIndex first, ProcessIndex last) {
+  std::vector<ProcessIndex> indices;
+  for (ProcessIndex index(first); index <= last; ++index)
+    indices.push_back(index);
+  return indices;
+}
+
+}  // unnamed namespace
+
+TEST(RollingUpgradeTest, BEH_UpgradeInBatches) {
+  detail::RollingUpgrade upgrade(kOldExecutable, kNewExecutable, Indices(1, 5), 2,
+                                 std::chrono::minutes(1));
+  EXPECT_EQ(kOldExecutable, upgrade.old_executable());
+  EXPECT_EQ(kNewExecutable, upgrade.new_executable());
+  std::vector<ProcessIndex> vaults;
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  EXPECT_EQ(Indices(1, 2), vaults);
+
+  // The next batch waits until the whole of this one has rejoined.
+  EXPECT_EQ(Step::kWait, upgrade.Next(vaults));
+  EXPECT_TRUE(vaults.empty());
+  upgrade.Joined(1, true);
+  upgrade.Joined(3, true);
+  EXPECT_EQ(Step::kWait, upgrade.Next(vaults));
+  upgrade.Joined(2, true);
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  EXPECT_EQ(Indices(3, 4), vaults);
+  upgrade.Joined(3, true);
+  upgrade.Joined(4, true);
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  EXPECT_EQ(Indices(5, 5), vaults);
+  upgrade.Joined(5, true);
+  EXPECT_EQ(Step::kFinish, upgrade.Next(vaults));
+  EXPECT_TRUE(vaults.empty());
+
+  // With nothing running, there's nothing to wait for.
+  detail::RollingUpgrade empty(kOldExecutable, kNewExecutable, std::vector<ProcessIndex>(), 0,
+                               std::chrono::minutes(1));
+  EXPECT_EQ(Step::kFinish, empty.Next(vaults));
+}
+
+TEST(RollingUpgradeTest, BEH_RollBackOnFailedJoin) {
+  detail::RollingUpgrade upgrade(kOldExecutable, kNewExecutable, Indices(1, 4), 2,
+                                 std::chrono::minutes(1));
+  std::vector<ProcessIndex> vaults;
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  upgrade.Joined(1, true);
+  upgrade.Joined(2, true);
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  upgrade.Joined(3, true);
+  upgrade.Joined(4, false);
+  // Every vault moved onto the new binary goes back, including those of earlier batches, but the
+  // one which failed to move is still on the old binary.
+  ASSERT_EQ(Step::kRollBack, upgrade.Next(vaults));
+  EXPECT_EQ(Indices(1, 3), vaults);
+}
+
+TEST(RollingUpgradeTest, BEH_RollBackOnTimeout) {
+  detail::RollingUpgrade upgrade(kOldExecutable, kNewExecutable, Indices(1, 3), 1,
+                                 std::chrono::milliseconds(100));
+  std::vector<ProcessIndex> vaults;
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  upgrade.Joined(1, true);
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  EXPECT_EQ(Step::kWait, upgrade.Next(vaults));
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  ASSERT_EQ(Step::kRollBack, upgrade.Next(vaults));
+  EXPECT_EQ(Indices(1, 1), vaults);
+  // Late joins don't undo the rollback.
+  upgrade.Joined(2, true);
+  EXPECT_EQ(Step::kRollBack, upgrade.Next(vaults));
+}
+
+TEST(RollingUpgradeTest, BEH_VaultsStartedAndStopped) {
+  detail::RollingUpgrade upgrade(kOldExecutable, kNewExecutable, Indices(1, 3), 2,
+                                 std::chrono::minutes(1));
+  std::vector<ProcessIndex> vaults;
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  // A vault stopped mid-batch isn't waited for, and one stopped before its batch is skipped.
+  upgrade.RemoveVault(2);
+  upgrade.RemoveVault(3);
+  upgrade.Joined(1, true);
+  // Vaults started during the upgrade are added to the end, but only once.
+  upgrade.AddVault(6);
+  upgrade.AddVault(6);
+  upgrade.AddVault(1);
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  EXPECT_EQ(Indices(6, 6), vaults);
+  // Only vaults in the current batch count.
+  upgrade.Joined(1, false);
+  upgrade.Joined(6, true);
+  EXPECT_EQ(Step::kFinish, upgrade.Next(vaults));
+}
+
+TEST(RollingUpgradeTest, BEH_VaultsHandedOver) {
+  detail::RollingUpgrade upgrade(kOldExecutable, kNewExecutable, Indices(1, 3), 2,
+                                 std::chrono::minutes(1));
+  std::vector<ProcessIndex> vaults;
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  // Once handed over, a vault's join is reported under its new process's index.
+  upgrade.ReplaceVault(1, 11);
+  upgrade.ReplaceVault(2, 12);
+  upgrade.ReplaceVault(3, 13);
+  upgrade.Joined(1, true);
+  upgrade.Joined(11, true);
+  EXPECT_EQ(Step::kWait, upgrade.Next(vaults));
+  upgrade.Joined(12, true);
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  EXPECT_EQ(Indices(13, 13), vaults);
+  upgrade.Joined(13, false);
+  ASSERT_EQ(Step::kRollBack, upgrade.Next(vaults));
+  EXPECT_EQ(Indices(11, 12), vaults);
+}
+
+TEST(RollingUpgradeTest, BEH_RollBackOnlyUpgradedVaults) {
+  detail::RollingUpgrade upgrade(kOldExecutable, kNewExecutable, Indices(1, 4), 2,
+                                 std::chrono::minutes(1));
+  std::vector<ProcessIndex> vaults;
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  // A vault which isn't running moves without rejoining, and isn't moved again if it's started.
+  upgrade.Joined(1, true);
+  upgrade.Upgraded(2);
+  upgrade.AddVault(2);
+  ASSERT_EQ(Step::kUpgrade, upgrade.Next(vaults));
+  EXPECT_EQ(Indices(3, 4), vaults);
+  // Nor is a vault stopped since it moved rolled back.
+  upgrade.RemoveVault(1);
+  upgrade.Joined(3, false);
+  ASSERT_EQ(Step::kRollBack, upgrade.Next(vaults));
+  EXPECT_EQ(Indices(2, 2), vaults);
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,61 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/single_flight.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+TEST(SingleFlightTest, BEH_ConcurrentCallersShareOneExecution) {
+  std::atomic<int> executions(0);
+  SingleFlight<int> single_flight([&executions]()->int {
+    Sleep(std::chrono::milliseconds(200));
+    return ++executions;
+  });
+
+  std::vector<std::future<int>> callers;
+  for (int i(0); i != 100; ++i)
+    callers.push_back(std::async(std::launch::async, [&] { return single_flight.Run().get(); }));
+  for (auto& caller : callers)
+    EXPECT_EQ(1, caller.get());
+  EXPECT_EQ(1, executions);
+  EXPECT_FALSE(single_flight.InFlight());
+
+  // Once complete, the next call starts a new execution.
+  auto result(single_flight.Run());
+  EXPECT_TRUE(single_flight.InFlight());
+  EXPECT_EQ(2, result.get());
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -0,0 +1,235 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/spawner.h"
+
+#ifdef MAIDSAFE_LINUX
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/process.h"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/client_manager/config.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+namespace {
+
+#ifdef MAIDSAFE_LINUX
+std::string BackendName(SpawnBackend backend) {
+  switch (backend) {
+    case SpawnBackend::kPosixSpawn:
+      return "posix_spawn";
+    case SpawnBackend::kZygote:
+      return "zygote";
+    default:
+      return "boost::process";
+  }
+}
+
+int WaitForExitCode(pid_t pid) {
+  int status(0);
+  if (waitpid(pid, &status, 0) != pid)
+    return -1;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+#endif
+
+}  // unnamed namespace
+
+TEST(SpawnerTest, BEH_SplitArguments) {
+  std::vector<std::string> args;
+  args.push_back("/path/to/vault");
+  args.push_back("--runtime 2");
+  args.push_back("--chunk_path \"/a path/with spaces\"");
+  args.push_back("--quoted \\\"x\\\"");
+  args.push_back("  --padded  ");
+  args.push_back("\"\"");
+  std::vector<std::string> expected;
+  expected.push_back("/path/to/vault");
+  expected.push_back("--runtime");
+  expected.push_back("2");
+  expected.push_back("--chunk_path");
+  expected.push_back("/a path/with spaces");
+  expected.push_back("--quoted");
+  expected.push_back("\"x\"");
+  expected.push_back("--padded");
+  expected.push_back("");
+  EXPECT_EQ(expected, detail::SplitArguments(args));
+}
+
+#ifdef MAIDSAFE_LINUX
+TEST(SpawnerTest, BEH_SpawnWithEachBackend) {
+  const std::string kExecutable(process::GetOtherExecutablePath(detail::kVaultName).string());
+  std::vector<std::string> args;
+  args.push_back(kExecutable);
+  args.push_back("--runtime 0");
+  args.push_back("--nocontroller");
+  std::vector<std::string> argv(detail::SplitArguments(args));
+  std::vector<std::string> nocrash_args(args);
+  nocrash_args.push_back("--nocrash");
+  std::vector<std::string> nocrash_argv(detail::SplitArguments(nocrash_args));
+  const std::string kMissing("/no/such/executable");
+  const std::string kShell("/bin/sh");
+  std::vector<std::string> shell_argv;
+  shell_argv.push_back(kShell);
+  shell_argv.push_back("-c");
+  shell_argv.push_back("echo out; echo err >&2");
+  const std::string shell_command_line(kShell + " -c \"echo out; echo err >&2\"");
+  CpuPlacement cpu_placement;
+
+  std::vector<SpawnBackend> backends;
+  backends.push_back(SpawnBackend::kBoostProcess);
+  backends.push_back(SpawnBackend::kPosixSpawn);
+  backends.push_back(SpawnBackend::kZygote);
+  for (const auto& backend : backends) {
+    SCOPED_TRACE(BackendName(backend));
+    detail::Spawner spawner(backend);
+    EXPECT_TRUE(backend == spawner.backend());
+    boost::process::child child(0);
+    boost::system::error_code error_code;
+
+    // The exit code shows that the arguments arrived intact.
+    ASSERT_TRUE(spawner.Spawn(detail::SpawnRequest(kExecutable, argv,
+                                                   process::ConstructCommandLine(args),
+                                                   cpu_placement, -1, -1),
+                              child, error_code));
+    EXPECT_FALSE(error_code);
+    EXPECT_NE(0, WaitForExitCode(child.pid));
+    ASSERT_TRUE(spawner.Spawn(
+        detail::SpawnRequest(kExecutable, nocrash_argv,
+                             process::ConstructCommandLine(nocrash_args), cpu_placement, -1,
+                             -1),
+        child, error_code));
+    EXPECT_EQ(0, WaitForExitCode(child.pid));
+
+    // Both of the child's streams are redirected to the output descriptor.
+    int output[2];
+    ASSERT_EQ(0, pipe2(output, O_CLOEXEC));
+    ASSERT_TRUE(spawner.Spawn(detail::SpawnRequest(kShell, shell_argv, shell_command_line,
+                                                   cpu_placement, -1, output[1]),
+                              child, error_code));
+    close(output[1]);
+    std::string captured;
+    char buffer[64];
+    ssize_t length(0);
+    while ((length = read(output[0], buffer, sizeof(buffer))) > 0)
+      captured.append(buffer, length);
+    close(output[0]);
+    EXPECT_EQ(0, WaitForExitCode(child.pid));
+    EXPECT_EQ("out\nerr\n", captured);
+
+    // boost::process only reports a failed exec through the child's exit code.
+    std::vector<std::string> missing_argv(1, kMissing);
+    bool spawned(spawner.Spawn(
+        detail::SpawnRequest(kMissing, missing_argv, kMissing, cpu_placement, -1, -1), child,
+        error_code));
+    if (backend == SpawnBackend::kBoostProcess) {
+      if (spawned)
+        EXPECT_NE(0, WaitForExitCode(child.pid));
+    } else {
+      EXPECT_FALSE(spawned);
+      EXPECT_EQ(ENOENT, error_code.value());
+    }
+  }
+}
+
+TEST(SpawnerTest, FUNC_SpawnRateAndLatency) {
+  const int kSpawnCount(200);
+  const size_t kManagerSizeMb(512);
+  const std::string kExecutable(process::GetOtherExecutablePath(detail::kVaultName).string());
+  std::vector<std::string> args;
+  args.push_back(kExecutable);
+  args.push_back("--runtime 0");
+  args.push_back("--nocrash");
+  args.push_back("--nocontroller");
+  const std::vector<std::string> argv(detail::SplitArguments(args));
+  const std::string command_line(process::ConstructCommandLine(args));
+  CpuPlacement cpu_placement;
+
+  // The zygote is forked while this process is small.  The manager is then grown, as a long-running
+  // one would, since that is what makes forking it expensive.
+  detail::Spawner zygote(SpawnBackend::kZygote);
+  ASSERT_TRUE(SpawnBackend::kZygote == zygote.backend());
+  detail::Spawner posix_spawn(SpawnBackend::kPosixSpawn);
+  detail::Spawner boost_process(SpawnBackend::kBoostProcess);
+  std::unique_ptr<char[]> ballast(new char[kManagerSizeMb << 20]);
+  for (size_t i(0); i < (kManagerSizeMb << 20); i += 4096)
+    ballast[i] = static_cast<char>(i);
+
+  std::vector<detail::Spawner*> spawners;
+  spawners.push_back(&boost_process);
+  spawners.push_back(&posix_spawn);
+  spawners.push_back(&zygote);
+  for (auto spawner : spawners) {
+    std::vector<std::chrono::microseconds> latencies;
+    std::vector<pid_t> children;
+    auto start(std::chrono::steady_clock::now());
+    for (int i(0); i != kSpawnCount; ++i) {
+      boost::process::child child(0);
+      boost::system::error_code error_code;
+      auto spawn_start(std::chrono::steady_clock::now());
+      ASSERT_TRUE(spawner->Spawn(
+          detail::SpawnRequest(kExecutable, argv, command_line, cpu_placement, -1, -1), child,
+          error_code));
+      latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - spawn_start));
+      children.push_back(child.pid);
+    }
+    auto elapsed(std::chrono::steady_clock::now() - start);
+    for (const auto& pid : children)
+      EXPECT_EQ(0, WaitForExitCode(pid));
+
+    std::sort(latencies.begin(), latencies.end());
+    // Used in XML attribute names, which can't contain "::".
+    std::string name(BackendName(spawner->backend()));
+    std::replace(name.begin(), name.end(), ':', '_');
+    RecordProperty(name + "_spawns_per_s",
+                   static_cast<int>(kSpawnCount * 1000000 /
+                                    std::chrono::duration_cast<std::chrono::microseconds>(
+                                        elapsed).count()));
+    RecordProperty(name + "_latency_p50_us",
+                   static_cast<int>(latencies[latencies.size() / 2].count()));
+    RecordProperty(name + "_latency_p99_us",
+                   static_cast<int>(latencies[latencies.size() * 99 / 100].count()));
+  }
+}
+#endif
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
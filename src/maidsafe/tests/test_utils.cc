@@ -19,6 +19,7 @@
 #include "maidsafe/client_manager/tests/test_utils.h"
 
 #include <cstdlib>
+#include <fstream>
 
 #include "boost/algorithm/string/find_iterator.hpp"
 #include "boost/algorithm/string/trim.hpp"
@@ -73,6 +74,28 @@ int GetNumRunningProcesses(std::string process_name) {
   }
 }
 
+namespace {
+
+int64_t GetProcStatusValue(const std::string& field) {
+#ifdef MAIDSAFE_LINUX
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, field.size() + 1, field + ":") == 0)
+      return std::stoll(line.substr(field.size() + 1));
+  }
+#else
+  static_cast<void>(field);
+#endif
+  return -1;
+}
+
+}  // unnamed namespace
+
+int GetNumThreadsInThisProcess() { return static_cast<int>(GetProcStatusValue("Threads")); }
+
+int64_t GetResidentMemoryOfThisProcessKb() { return GetProcStatusValue("VmRSS"); }
+
 }  // namespace test
 
 }  //  namespace client_manager
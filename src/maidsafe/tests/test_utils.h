@@ -19,6 +19,7 @@
 #ifndef MAIDSAFE_CLIENT_MANAGER_TESTS_TEST_UTILS_H_
 #define MAIDSAFE_CLIENT_MANAGER_TESTS_TEST_UTILS_H_
 
+#include <cstdint>
 #include <string>
 
 namespace maidsafe {
@@ -29,6 +30,10 @@ namespace test {
 
 int GetNumRunningProcesses(std::string process_name);
 
+// These return -1 where unsupported (currently everywhere but Linux).
+int GetNumThreadsInThisProcess();
+int64_t GetResidentMemoryOfThisProcessKb();
+
 }  // namespace test
 
 }  // namespace client_manager
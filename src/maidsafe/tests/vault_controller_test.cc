@@ -0,0 +1,310 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/client_manager/vault_controller.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "maidsafe/common/asio_service.h"
+#include "maidsafe/common/process.h"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/passport/passport.h"
+
+#include "maidsafe/client_manager/client_manager.h"
+#include "maidsafe/client_manager/config.h"
+#include "maidsafe/client_manager/controller_messages.pb.h"
+#include "maidsafe/client_manager/local_tcp_transport.h"
+#include "maidsafe/client_manager/process_manager.h"
+#include "maidsafe/client_manager/return_codes.h"
+#include "maidsafe/client_manager/utils.h"
+
+namespace maidsafe {
+
+namespace client_manager {
+
+namespace test {
+
+// Stands in for ClientManager, answering dummy_vault's VaultController as ClientManager would, so
+// that a vault can be handed over to a standby as HandOverVaults does.
+class VaultControllerTest : public testing::Test {
+ public:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  VaultControllerTest()
+      : asio_service_(2),
+        transport_(std::make_shared<LocalTcpTransport>(asio_service_.service())),
+        port_(0),
+        pmid_(passport::Maid(passport::Anmaid())),
+        kExecutablePath_(process::GetOtherExecutablePath(detail::kVaultName)),
+        mutex_(),
+        cond_var_(),
+        standby_index_(ProcessManager::kInvalidIndex()),
+        vault_ports_(),
+        joined_(),
+        exited_(),
+        unresponsive_(),
+        taken_over_(),
+        endpoints_received_(0),
+        process_manager_() {}
+
+ protected:
+  void SetUp() {
+    int result(0);
+    port_ = transport_->StartListening(0, result);
+    ASSERT_EQ(kSuccess, result);
+    transport_->on_message_received().connect([this](const std::string& message, Port peer_port) {
+      HandleMessage(message, peer_port);
+    });
+    process_manager_.on_process_event().connect([this](const ProcessEvent& event) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (event.type == ProcessEvent::Type::kExited)
+          exited_[event.index] = std::chrono::steady_clock::now();
+        else if (event.type == ProcessEvent::Type::kUnresponsive)
+          unresponsive_[event.index] = std::chrono::steady_clock::now();
+        else
+          return;
+      }
+      cond_var_.notify_all();
+    });
+  }
+
+  void TearDown() {
+    transport_->StopListening();
+    asio_service_.Stop();
+  }
+
+  ProcessIndex AddVault(const HeartbeatPolicy& heartbeat_policy = HeartbeatPolicy(),
+                        const std::string& argument = "") {
+    Process vault;
+    EXPECT_TRUE(vault.SetExecutablePath(kExecutablePath_));
+    EXPECT_TRUE(vault.SetHeartbeatPolicy(heartbeat_policy));
+    if (!argument.empty())
+      vault.AddArgument(argument);
+    return process_manager_.AddProcess(vault, port_);
+  }
+
+  bool WaitFor(std::function<bool()> predicate) {  // NOLINT (Fraser)
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cond_var_.wait_for(lock, std::chrono::seconds(10), predicate);
+  }
+
+  void SendToVault(ProcessIndex index, MessageType type, const std::string& payload) {
+    Port vault_port(0);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      vault_port = vault_ports_[index];
+    }
+    std::shared_ptr<LocalTcpTransport> sending_transport(
+        std::make_shared<LocalTcpTransport>(asio_service_.service()));
+    int result(0);
+    sending_transport->Connect(vault_port, result);
+    ASSERT_EQ(kSuccess, result);
+    sending_transport->Send(detail::WrapMessage(type, payload), vault_port);
+  }
+
+  void RequestShutdown(ProcessIndex index) {
+    protobuf::VaultShutdownRequest vault_shutdown_request;
+    vault_shutdown_request.set_process_index(index);
+    vault_shutdown_request.set_data("data");
+    vault_shutdown_request.set_signature("signature");
+    SendToVault(index, MessageType::kVaultShutdownRequest,
+                vault_shutdown_request.SerializeAsString());
+  }
+
+  void SendTakeover(ProcessIndex index) {
+    protobuf::VaultTakeover vault_takeover;
+    vault_takeover.set_process_index(index);
+    SendToVault(index, MessageType::kVaultTakeover, vault_takeover.SerializeAsString());
+  }
+
+  AsioService asio_service_;
+  std::shared_ptr<LocalTcpTransport> transport_;
+  Port port_;
+  passport::Pmid pmid_;
+  const boost::filesystem::path kExecutablePath_;
+  std::mutex mutex_;
+  std::condition_variable cond_var_;
+  // Guarded by mutex_.
+  ProcessIndex standby_index_;
+  std::map<ProcessIndex, Port> vault_ports_;
+  std::map<ProcessIndex, TimePoint> joined_, exited_, unresponsive_, taken_over_;
+  // dummy_vault sends its endpoint once it may use its chunkstore.
+  int endpoints_received_;
+  // Declared last, so that the vaults are stopped before anything their events use is destroyed.
+  ProcessManager process_manager_;
+
+ private:
+  void HandleMessage(const std::string& message, Port peer_port) {
+    MessageType type;
+    std::string payload;
+    ASSERT_TRUE(detail::UnwrapMessage(message, type, payload));
+    std::string response;
+    switch (type) {
+      case MessageType::kVaultIdentityRequest: {
+        protobuf::VaultIdentityRequest request;
+        ASSERT_TRUE(request.ParseFromString(payload));
+        protobuf::VaultIdentityResponse identity_response;
+        identity_response.set_pmid(passport::SerialisePmid(pmid_).string());
+        identity_response.set_chunkstore_path("chunkstore");
+        identity_response.add_bootstrap_endpoint_ip("127.0.0.1");
+        identity_response.add_bootstrap_endpoint_port(5483);
+        std::lock_guard<std::mutex> lock(mutex_);
+        identity_response.set_standby(request.process_index() == standby_index_);
+        vault_ports_[request.process_index()] = static_cast<Port>(request.listening_port());
+        response = detail::WrapMessage(MessageType::kVaultIdentityResponse,
+                                       identity_response.SerializeAsString());
+        break;
+      }
+      case MessageType::kVaultJoinedNetwork: {
+        protobuf::VaultJoinedNetwork request;
+        ASSERT_TRUE(request.ParseFromString(payload));
+        protobuf::VaultJoinedNetworkAck ack;
+        ack.set_ack(true);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (request.joined())
+          joined_[request.process_index()] = std::chrono::steady_clock::now();
+        response = detail::WrapMessage(MessageType::kVaultJoinedNetworkAck,
+                                       ack.SerializeAsString());
+        break;
+      }
+      case MessageType::kSendEndpointToClientManagerRequest: {
+        protobuf::SendEndpointToClientManagerResponse endpoint_response;
+        endpoint_response.set_result(true);
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++endpoints_received_;
+        response = detail::WrapMessage(MessageType::kSendEndpointToClientManagerResponse,
+                                       endpoint_response.SerializeAsString());
+        break;
+      }
+      case MessageType::kVaultTakeoverConfirmation: {
+        protobuf::VaultTakeover confirmation;
+        ASSERT_TRUE(confirmation.ParseFromString(payload));
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          taken_over_[confirmation.process_index()] = std::chrono::steady_clock::now();
+        }
+        cond_var_.notify_all();
+        return;
+      }
+      default:
+        return;
+    }
+    cond_var_.notify_all();
+    transport_->Send(response, peer_port);
+  }
+};
+
+// The standby joins the network while the old vault is still running, so the vault is never off the
+// network, but it doesn't go on to use the chunkstore until it's told to take over.  The vault is
+// only unavailable from the old process exiting until the standby confirms it has taken over.
+TEST_F(VaultControllerTest, BEH_StandbyJoinsBeforeOldVaultExits) {
+  ProcessIndex old_index(AddVault());
+  process_manager_.StartProcess(old_index);
+  ASSERT_TRUE(WaitFor([&] { return joined_.count(old_index) != 0 && endpoints_received_ == 1; }));
+
+  ProcessIndex standby_index(AddVault());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    standby_index_ = standby_index;
+  }
+  process_manager_.StartProcess(standby_index);
+  ASSERT_TRUE(WaitFor([&] { return joined_.count(standby_index) != 0; }));
+  EXPECT_EQ(ProcessStatus::kRunning, process_manager_.GetProcessStatus(old_index));
+
+  RequestShutdown(old_index);
+  ASSERT_TRUE(WaitFor([&] { return exited_.count(old_index) != 0; }));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    EXPECT_LT(joined_[standby_index], exited_[old_index]);
+    EXPECT_EQ(1, endpoints_received_);
+  }
+
+  SendTakeover(standby_index);
+  ASSERT_TRUE(WaitFor([&] {
+    return taken_over_.count(standby_index) != 0 && endpoints_received_ == 2;
+  }));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto gap(std::chrono::duration_cast<std::chrono::milliseconds>(taken_over_[standby_index] -
+                                                                   exited_[old_index]));
+    RecordProperty("takeover_gap_ms", static_cast<int>(gap.count()));
+    EXPECT_LT(gap, std::chrono::seconds(1));
+  }
+  EXPECT_EQ(ProcessStatus::kRunning, process_manager_.GetProcessStatus(standby_index));
+  RequestShutdown(standby_index);
+  ASSERT_TRUE(WaitFor([&] { return exited_.count(standby_index) != 0; }));
+}
+
+// A standby which is stopped before it takes over exits without using the chunkstore.
+TEST_F(VaultControllerTest, BEH_StandbyStoppedBeforeTakeover) {
+  ProcessIndex standby_index(AddVault());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    standby_index_ = standby_index;
+  }
+  process_manager_.StartProcess(standby_index);
+  ASSERT_TRUE(WaitFor([&] { return joined_.count(standby_index) != 0; }));
+  RequestShutdown(standby_index);
+  ASSERT_TRUE(WaitFor([&] { return exited_.count(standby_index) != 0; }));
+  std::lock_guard<std::mutex> lock(mutex_);
+  EXPECT_EQ(0, endpoints_received_);
+}
+
+// The vault's main loop beats, not its controller, so a vault which hangs is restarted even though
+// its process and controller carry on.
+TEST_F(VaultControllerTest, BEH_HungVaultRestarted) {
+  const HeartbeatPolicy kPolicy(std::chrono::seconds(2), std::chrono::seconds(5));
+  ProcessIndex healthy_index(AddVault(kPolicy));
+  ProcessIndex hung_index(AddVault(kPolicy, "--hang_after 1"));
+  process_manager_.StartProcess(healthy_index);
+  process_manager_.StartProcess(hung_index);
+  ASSERT_TRUE(WaitFor([&] {
+    return joined_.count(healthy_index) != 0 && joined_.count(hung_index) != 0 &&
+           endpoints_received_ == 2;
+  }));
+
+  // Still running when it's found to have hung.
+  ASSERT_TRUE(WaitFor([&] { return unresponsive_.count(hung_index) != 0; }));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    EXPECT_EQ(0U, exited_.count(hung_index));
+  }
+  ASSERT_TRUE(WaitFor([&] { return exited_.count(hung_index) != 0; }));
+  EXPECT_LE(1U, process_manager_.GetHangCount(hung_index));
+  EXPECT_EQ(0U, process_manager_.GetHangCount(healthy_index));
+  EXPECT_EQ(ProcessStatus::kRunning, process_manager_.GetProcessStatus(healthy_index));
+
+  for (const auto& index : {healthy_index, hung_index}) {
+    process_manager_.KillProcess(index);
+    EXPECT_TRUE(process_manager_.WaitForProcessToStop(index));
+  }
+}
+
+}  // namespace test
+
+}  // namespace client_manager
+
+}  // namespace maidsafe
@@ -18,6 +18,7 @@
 
 #include "maidsafe/client_manager/utils.h"
 
+#include <atomic>
 #include <cstdint>
 #include <iterator>
 #include <mutex>
@@ -56,6 +57,7 @@ fs::path g_test_env_root_dir, g_path_to_vault;
 bool g_using_default_environment(true);
 std::vector<boost::asio::ip::udp::endpoint> g_bootstrap_ips;
 int g_identity_index(0);
+std::atomic<int64_t> g_bootstrap_server_delay_ms(0);
 #endif
 
 }  // unnamed namespace
@@ -165,6 +167,12 @@ std::vector<boost::asio::ip::udp::endpoint> GetBootstrapIps() { return g_bootstr
 void SetIdentityIndex(int identity_index) { g_identity_index = identity_index; }
 int IdentityIndex() { return g_identity_index; }
 bool UsingDefaultEnvironment() { return g_using_default_environment; }
+void SetBootstrapServerDelay(const std::chrono::milliseconds& delay) {
+  g_bootstrap_server_delay_ms = delay.count();
+}
+std::chrono::milliseconds BootstrapServerDelay() {
+  return std::chrono::milliseconds(g_bootstrap_server_delay_ms);
+}
 #endif  // TESTING
 
 }  // namespace detail
@@ -19,6 +19,7 @@
 #ifndef MAIDSAFE_CLIENT_MANAGER_UTILS_H_
 #define MAIDSAFE_CLIENT_MANAGER_UTILS_H_
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -65,6 +66,9 @@ std::vector<boost::asio::ip::udp::endpoint> GetBootstrapIps();
 void SetIdentityIndex(int identity_index);
 int IdentityIndex();
 bool UsingDefaultEnvironment();
+// How long the stand-in for the bootstrap server takes to answer in a test environment.
+void SetBootstrapServerDelay(const std::chrono::milliseconds& delay);
+std::chrono::milliseconds BootstrapServerDelay();
 #endif
 
 }  // namespace detail
@@ -32,6 +32,7 @@
 #include "maidsafe/passport/types.h"
 #include "maidsafe/passport/passport.h"
 #include "maidsafe/client_manager/controller_messages.pb.h"
+#include "maidsafe/client_manager/heartbeat.h"
 #include "maidsafe/client_manager/local_tcp_transport.h"
 #include "maidsafe/client_manager/return_codes.h"
 #include "maidsafe/client_manager/utils.h"
@@ -67,6 +68,11 @@ VaultController::VaultController(const std::string& client_manager_identifier,
       pmid_(),
       bootstrap_endpoints_(),
       stop_callback_(std::move(stop_callback)),
+      standby_(false),
+      stopping_(false),
+      standby_mutex_(),
+      standby_cond_var_(),
+      heartbeat_(),
       asio_service_(3),
       receiving_transport_(std::make_shared<LocalTcpTransport>(asio_service_.service())) {
   if (!stop_callback_)
@@ -79,10 +85,14 @@ VaultController::VaultController(const std::string& client_manager_identifier,
         Port client_manager_port) { HandleReceivedRequest(message, client_manager_port); });
     detail::StartControllerListeningPort(receiving_transport_, on_message_slot, local_port_);
     RequestVaultIdentity(local_port_);
+    OpenHeartbeat();
   }
 }
 
-VaultController::~VaultController() { receiving_transport_->StopListening(); }
+VaultController::~VaultController() {
+  receiving_transport_->StopListening();
+  asio_service_.Stop();
+}
 
 bool VaultController::GetIdentity(
     std::unique_ptr<passport::Pmid>& pmid,
@@ -92,11 +102,54 @@ bool VaultController::GetIdentity(
     LOG(kError) << "Invalid ClientManager port.";
     return false;
   }
+  {
+    std::lock_guard<std::mutex> lock(standby_mutex_);
+    if (stopping_) {
+      LOG(kInfo) << "Asked to stop before starting.";
+      return false;
+    }
+  }
   pmid.reset(new passport::Pmid(*pmid_));
   bootstrap_endpoints = bootstrap_endpoints_;
   return true;
 }
 
+bool VaultController::WaitForTakeover() {
+  {
+    std::unique_lock<std::mutex> lock(standby_mutex_);
+    if (!standby_)
+      return !stopping_;
+    LOG(kInfo) << "Waiting to take over from the vault being replaced.";
+    // The vault's own loop isn't running yet, so it's beaten for while waiting.
+    while (!standby_cond_var_.wait_for(lock, detail::Heartbeat::kDefaultInterval(),
+                                       [this] { return !standby_ || stopping_; })) {
+      Heartbeat();
+    }
+    if (stopping_) {
+      LOG(kInfo) << "Asked to stop before taking over.";
+      return false;
+    }
+  }
+  ConfirmTakeover();
+  return true;
+}
+
+void VaultController::ConfirmTakeover() {
+  TransportPtr request_transport(std::make_shared<LocalTcpTransport>(asio_service_.service()));
+  int result(0);
+  request_transport->Connect(client_manager_port_, result);
+  if (result != kSuccess) {
+    LOG(kError) << "Failed to connect request transport to ClientManager.";
+    return;
+  }
+  protobuf::VaultTakeover vault_takeover;
+  vault_takeover.set_process_index(process_index_);
+  request_transport->Send(
+      detail::WrapMessage(MessageType::kVaultTakeoverConfirmation,
+                          vault_takeover.SerializeAsString()),
+      client_manager_port_);
+}
+
 void VaultController::ConfirmJoin() {
   std::mutex local_mutex;
   std::condition_variable local_cond_var;
@@ -347,6 +400,21 @@ void VaultController::RequestVaultIdentity(uint16_t listening_port) {
   }
 }
 
+void VaultController::OpenHeartbeat() {
+  try {
+    heartbeat_.reset(
+        new detail::Heartbeat(detail::HeartbeatName(process_index_, client_manager_port_)));
+  }
+  catch (const std::exception& e) {
+    LOG(kWarning) << "ClientManager isn't watching this vault's heartbeat: " << e.what();
+  }
+}
+
+void VaultController::Heartbeat() {
+  if (heartbeat_)
+    heartbeat_->Beat();
+}
+
 void VaultController::HandleVaultIdentityResponse(const std::string& message, std::mutex& mutex) {
   MessageType type;
   std::string payload;
@@ -362,6 +430,10 @@ void VaultController::HandleVaultIdentityResponse(const std::string& message, st
     return;
   }
 
+  {
+    std::lock_guard<std::mutex> standby_lock(standby_mutex_);
+    standby_ = vault_identity_response.standby();
+  }
   pmid_.reset(
       new passport::Pmid(passport::ParsePmid(NonEmptyString(vault_identity_response.pmid()))));
 
@@ -398,6 +470,9 @@ void VaultController::HandleReceivedRequest(const std::string& message, Port /*p
     case MessageType::kVaultShutdownRequest:
       HandleVaultShutdownRequest(payload, response);
       break;
+    case MessageType::kVaultTakeover:
+      HandleVaultTakeover(payload);
+      break;
     default:
       return;
   }
@@ -418,9 +493,32 @@ void VaultController::HandleVaultShutdownRequest(const std::string& request,
     vault_shutdown_response.set_shutdown(true);
   }
   vault_shutdown_response.set_process_index(process_index_);
+  {
+    std::lock_guard<std::mutex> lock(standby_mutex_);
+    stopping_ = true;
+  }
+  standby_cond_var_.notify_all();
   stop_callback_();
 }
 
+void VaultController::HandleVaultTakeover(const std::string& request) {
+  protobuf::VaultTakeover vault_takeover;
+  if (!vault_takeover.ParseFromString(request)) {
+    LOG(kError) << "Failed to parse VaultTakeover.";
+    return;
+  }
+  if (vault_takeover.process_index() != process_index_) {
+    LOG(kError) << "This takeover is not for this process.";
+    return;
+  }
+  LOG(kInfo) << "Taking over from the vault being replaced.";
+  {
+    std::lock_guard<std::mutex> lock(standby_mutex_);
+    standby_ = false;
+  }
+  standby_cond_var_.notify_all();
+}
+
 }  // namespace client_manager
 
 }  // namespace maidsafe